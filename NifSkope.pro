@@ -5,7 +5,7 @@
 TEMPLATE = app
 TARGET   = NifSkope
 
-QT += xml opengl network widgets
+QT += xml opengl network widgets concurrent
 
 # Require Qt 5.7 or higher
 contains(QT_VERSION, ^5\\.[0-6]\\..*) {
@@ -17,7 +17,7 @@ contains(QT_VERSION, ^5\\.[0-6]\\..*) {
 CONFIG += c++14
 
 # Dependencies
-CONFIG += nvtristrip qhull zlib lz4 fsengine gli
+CONFIG += qhull zlib lz4 fsengine gli
 
 # Debug/Release options
 CONFIG(debug, debug|release) {
@@ -159,9 +159,17 @@ HEADERS += \
 	src/gl/renderer.h \
 	src/io/material.h \
 	src/io/nifstream.h \
+	src/lib/bcdecode.h \
+	src/lib/boundingvolume.h \
+	src/lib/convexdecomp.h \
 	src/lib/importex/3ds.h \
-	src/lib/nvtristripwrapper.h \
+	src/lib/moppgen.h \
 	src/lib/qhull.h \
+	src/lib/skinpartition.h \
+	src/lib/smoothnormals.h \
+	src/lib/stripify.h \
+	src/lib/vertexcache.h \
+	src/lib/vertexweld.h \
 	src/model/basemodel.h \
 	src/model/kfmmodel.h \
 	src/model/nifmodel.h \
@@ -195,10 +203,12 @@ HEADERS += \
 	src/ui/settingsdialog.h \
 	src/ui/settingspane.h \
 	src/xml/nifexpr.h \
+	src/xml/schemacache.h \
 	src/glview.h \
 	src/message.h \
 	src/nifskope.h \
 	src/spellbook.h \
+	src/startuptrace.h \
 	src/version.h \
 	lib/dds.h \
 	lib/dxgiformat.h \
@@ -222,12 +232,20 @@ SOURCES += \
 	src/gl/renderer.cpp \
 	src/io/material.cpp \
 	src/io/nifstream.cpp \
+	src/lib/bcdecode.cpp \
+	src/lib/boundingvolume.cpp \
+	src/lib/convexdecomp.cpp \
 	src/lib/importex/3ds.cpp \
 	src/lib/importex/importex.cpp \
 	src/lib/importex/obj.cpp \
 	src/lib/importex/col.cpp \
-	src/lib/nvtristripwrapper.cpp \
+	src/lib/moppgen.cpp \
 	src/lib/qhull.cpp \
+	src/lib/skinpartition.cpp \
+	src/lib/smoothnormals.cpp \
+	src/lib/stripify.cpp \
+	src/lib/vertexcache.cpp \
+	src/lib/vertexweld.cpp \
 	src/model/basemodel.cpp \
 	src/model/kfmmodel.cpp \
 	src/model/nifdelegate.cpp \
@@ -278,12 +296,14 @@ SOURCES += \
 	src/xml/kfmxml.cpp \
 	src/xml/nifexpr.cpp \
 	src/xml/nifxml.cpp \
+	src/xml/schemacache.cpp \
 	src/glview.cpp \
 	src/main.cpp \
 	src/message.cpp \
 	src/nifskope.cpp \
 	src/nifskope_ui.cpp \
 	src/spellbook.cpp \
+	src/startuptrace.cpp \
 	src/version.cpp \
 	lib/half.cpp
 
@@ -317,23 +337,11 @@ fsengine {
 		lib/fsengine/fsmanager.cpp
 }
 
-nvtristrip {
-	INCLUDEPATH += lib/NvTriStrip
-	HEADERS += \
-		lib/NvTriStrip/NvTriStrip.h \
-		lib/NvTriStrip/NvTriStripObjects.h \
-		lib/NvTriStrip/VertexCache.h
-	SOURCES += \
-		lib/NvTriStrip/NvTriStrip.cpp \
-		lib/NvTriStrip/NvTriStripObjects.cpp \
-		lib/NvTriStrip/VertexCache.cpp
-}
-
 qhull {
     !*msvc*:QMAKE_CFLAGS += -isystem ../nifskope/lib/qhull/src
     !*msvc*:QMAKE_CXXFLAGS += -isystem ../nifskope/lib/qhull/src
     else:INCLUDEPATH += lib/qhull/src
-    HEADERS += $$files($$PWD/lib/qhull/src/libqhull/*.h, false)
+    HEADERS += $$files($$PWD/lib/qhull/src/libqhull_r/*.h, false)
 }
 
 gli {
@@ -36,13 +36,21 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "lz4frame.h"
 
 #include <QByteArray>
+#include <QCryptographicHash>
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QRegExp>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
 #include <QStringBuilder>
 
+#include <algorithm>
+#include <numeric>
+
 
 // see bsa.h
 quint32 BSA::BSAFile::size() const
@@ -61,71 +69,107 @@ bool BSA::BSAFile::compressed() const
 	return sizeFlags & OB_BSAFILE_FLAG_COMPRESS;
 }
 
-//! Reads a foldername sized string (length + null-terminated string) from the BSA
-static bool BSAReadSizedString( QFile & bsa, QString & s )
+//! Bytes fetched at once when reading the directory of an unmapped archive
+static const qint64 BSA_READ_BLOCK = 256 * 1024;
+
+//! Reads the directory of an archive sequentially, fetching it in large blocks
+/*!
+ * When the archive is mapped the whole remainder of the file is a single
+ * block, so reading is just copying from memory.
+ */
+class BSAReader final
 {
-	quint8 len;
-	if ( bsa.read( (char *)&len, 1 ) != 1 )
-		return false;
-	
-	QByteArray b( len, char(0) );
-	if ( bsa.read( b.data(), len ) == len ) {
-		s = QString::fromLatin1( b );
+public:
+	//! Constructor
+	BSAReader( BSA & archive, quint64 offset = 0 ) : bsa( archive ), pos( offset ) {}
+
+	//! Moves to an absolute offset in the archive
+	void seek( quint64 offset ) { pos = offset; }
+
+	//! Reads raw bytes, returns false past the end of the archive
+	bool read( void * data, qint64 size )
+	{
+		if ( size <= 0 )
+			return size == 0;
+
+		if ( pos < blockStart || pos + size > blockStart + block.size() ) {
+			if ( pos + size > quint64( bsa.archiveSize ) )
+				return false;
+
+			qint64 len = bsa.archiveSize - qint64( pos );
+			if ( !bsa.mapped )
+				len = qMin( len, qMax( size, BSA_READ_BLOCK ) );
+
+			block = bsa.rawData( pos, len );
+			blockStart = pos;
+			if ( block.size() < size )
+				return false;
+		}
+
+		memcpy( data, block.constData() + ( pos - blockStart ), size );
+		pos += size;
 		return true;
 	}
 
-	return false;
-}
-
-QByteArray gUncompress( const QByteArray & data, const int size )
-{
-	if ( data.size() <= 4 ) {
-		qWarning( "gUncompress: Input data is truncated" );
-		return QByteArray();
+	//! Reads a value
+	template <typename T> bool read( T & value )
+	{
+		return read( &value, sizeof( T ) );
 	}
 
-	QByteArray result;
+	//! Reads a string prefixed by its length, up to its first null
+	template <typename L> bool readString( QString & s )
+	{
+		L len;
+		if ( !read( len ) )
+			return false;
+
+		QByteArray b( len, char( 0 ) );
+		if ( !read( b.data(), len ) )
+			return false;
 
-	int ret;
-	z_stream strm;
-	static const int CHUNK_SIZE = 1024;
-	char out[CHUNK_SIZE];
+		s = QString::fromLatin1( b.constData(), qstrnlen( b.constData(), len ) );
+		return true;
+	}
 
-	/* allocate inflate state */
-	strm.zalloc = Z_NULL;
-	strm.zfree = Z_NULL;
-	strm.opaque = Z_NULL;
-	strm.avail_in = size;
-	strm.next_in = (Bytef*)(data.data());
+private:
+	BSA & bsa;
+	quint64 pos;
 
-	ret = inflateInit2( &strm, 15 + 32 ); // gzip decoding
-	Q_ASSERT( ret == Z_OK );
-	if ( ret != Z_OK )
-		return QByteArray();
+	QByteArray block;
+	quint64 blockStart = 0;
+};
 
-	// run inflate()
-	do {
-		strm.avail_out = CHUNK_SIZE;
-		strm.next_out = (Bytef*)(out);
+//! Lower case path with forward slashes and no leading slash, as used for lookups
+static QString normalizedPath( QString path )
+{
+	path = path.replace( '\\', '/' ).toLower();
+	while ( path.startsWith( '/' ) )
+		path.remove( 0, 1 );
+	return path;
+}
 
-		ret = inflate( &strm, Z_NO_FLUSH );
-		Q_ASSERT( ret != Z_STREAM_ERROR );  // state not clobbered
+//! Inflates zlib or gzip data straight into a buffer of its exact unpacked size
+static bool zlibUncompress( const QByteArray & packed, char * dst, quint32 size )
+{
+	if ( packed.size() <= 4 ) {
+		qWarning( "zlibUncompress: Input data is truncated" );
+		return false;
+	}
 
-		switch ( ret ) {
-		case Z_NEED_DICT:
-			ret = Z_DATA_ERROR;     // and fall through
-		case Z_DATA_ERROR:
-		case Z_MEM_ERROR:
-			(void)inflateEnd( &strm );
-			return QByteArray();
-		}
+	z_stream strm = {};
+	strm.avail_in = packed.size();
+	strm.next_in = (Bytef *)packed.constData();
+	strm.avail_out = size;
+	strm.next_out = (Bytef *)dst;
 
-		result.append( out, CHUNK_SIZE - strm.avail_out );
-	} while ( strm.avail_out == 0 );
+	if ( inflateInit2( &strm, 15 + 32 ) != Z_OK ) // gzip decoding
+		return false;
 
-	// clean up and return
+	int ret = inflate( &strm, Z_FINISH );
 	inflateEnd( &strm );
-	return result;
+
+	return ret == Z_STREAM_END && strm.total_out == size;
 }
 
 // see bsa.h
@@ -178,270 +222,461 @@ bool BSA::canOpen( const QString & fn )
 // see bsa.h
 bool BSA::open()
 {
-	QMutexLocker lock( & bsaMutex );
-	
 	try
 	{
 		if ( ! bsa.open( QIODevice::ReadOnly ) )
 			throw QString( "file open" );
-		
-		quint32 magic;
-		
-		bsa.read( (char*) &magic, sizeof( magic ) );
-
-		if ( magic == F4_BSAHEADER_FILEID ) {
-			bsa.read( (char*)&version, sizeof( version ) );
 
-			if ( version != F4_BSAHEADER_VERSION )
-				throw QString( "file version" );
+		// Map the whole archive so that files can be extracted without a shared cursor,
+		// rawData() falls back to reading the file if this fails
+		archiveSize = bsa.size();
+		mapped = bsa.map( 0, archiveSize );
 
-			F4BSAHeader header;
-			if ( bsa.read( (char *)&header, sizeof( header ) ) != sizeof( header ) )
-				throw QString( "header size" );
-
-			numFiles = header.numFiles;
-
-			auto offset = header.nameTableOffset;
-
-			QVector<QString> filepaths;
-			if ( bsa.seek( offset ) ) {
-				for ( quint32 i = 0; i < numFiles; i++ ) {
-					quint8 length;
-					bsa.read( (char*)&length, 2 );
+		QVector<QString> paths;
+		if ( !loadIndex( paths ) ) {
+			readDirectory( paths );
+			saveIndex( paths );
+		}
 
-					QByteArray strdata( length, char( 0 ) );
-					bsa.read( strdata.data(), length );
+		files.reserve( records.count() );
+		BSAFile * record = records.data();
+		for ( int i = 0; i < records.count(); i++ )
+			files.insert( paths[i], record + i );
+	}
+	catch ( QString & e )
+	{
+		status = e;
+		return false;
+	}
+	
+	status = "loaded successful";
+	
+	return true;
+}
 
-					filepaths.append( QString::fromLatin1( strdata ) );
-				}
-			}
+// see bsa.h
+void BSA::readDirectory( QVector<QString> & paths )
+{
+	records.clear();
+	paths.clear();
 
-			QString h = QString::fromLatin1( header.type, 4 );
-			if ( h == "GNRL" ) {
-				// General BA2 Format
-				if ( bsa.seek( sizeof( header ) + 8 ) ) {
-					for ( quint32 i = 0; i < numFiles; i++ ) {
-						F4GeneralInfo finfo;
-						bsa.read( (char*)&finfo, sizeof( F4GeneralInfo ) );
+	BSAReader r( *this );
 
-						QString fullpath = filepaths[i];
-						fullpath.replace( "\\", "/" );
+	quint32 magic;
+	if ( !r.read( magic ) )
+		throw QString( "file magic" );
 
-						QString filename = fullpath.right( fullpath.length() - fullpath.lastIndexOf( "/" ) - 1 );
-						QString folderName = fullpath.left( fullpath.lastIndexOf( "/" ) );
+	if ( magic == F4_BSAHEADER_FILEID ) {
+		if ( !r.read( version ) || version != F4_BSAHEADER_VERSION )
+			throw QString( "file version" );
 
-						insertFile( insertFolder( folderName ), filename, finfo.packedSize, finfo.unpackedSize, finfo.offset );
-					}
-				}
-			} else if ( h == "DX10" ) {
-				// Texture BA2 Format
-				if ( bsa.seek( sizeof( header ) + 8 ) ) {
-					for ( quint32 i = 0; i < numFiles; i++ ) {
-						F4Tex tex;
-						bsa.read( (char*)&tex.header, 24 );
+		F4BSAHeader header;
+		if ( !r.read( header ) )
+			throw QString( "header size" );
 
-						QVector<F4TexChunk> texChunks;
-						for ( quint32 j = 0; j < tex.header.numChunks; j++ ) {
-							F4TexChunk texChunk;
-							bsa.read( (char*)&texChunk, 24 );
-							texChunks.append( texChunk );
-						}
+		numFiles = header.numFiles;
 
-						tex.chunks = texChunks;
+		// The name table is at the end of the archive
+		paths.resize( header.numFiles );
+		BSAReader names( *this, header.nameTableOffset );
+		for ( quint32 i = 0; i < header.numFiles; i++ ) {
+			if ( !names.readString<quint16>( paths[i] ) )
+				throw QString( "file name read" );
 
-						QString fullpath = filepaths[i];
-						fullpath.replace( "\\", "/" );
+			paths[i] = normalizedPath( paths[i] );
+		}
 
-						QString filename = fullpath.right( fullpath.length() - fullpath.lastIndexOf( "/" ) - 1 );
-						QString folderName = fullpath.left( fullpath.lastIndexOf( "/" ) );
+		records.resize( header.numFiles );
 
-						F4TexChunk chunk = tex.chunks[0];
+		QString h = QString::fromLatin1( header.type, 4 );
+		if ( h == "GNRL" ) {
+			// General BA2 Format
+			for ( quint32 i = 0; i < header.numFiles; i++ ) {
+				F4GeneralInfo finfo;
+				if ( !r.read( finfo ) )
+					throw QString( "file info read" );
 
-						insertFile( insertFolder( folderName ), filename, chunk.packedSize, chunk.unpackedSize, chunk.offset, tex );
-					}
+				records[i].packedLength = finfo.packedSize;
+				records[i].unpackedLength = finfo.unpackedSize;
+				records[i].offset = finfo.offset;
+			}
+		} else if ( h == "DX10" ) {
+			// Texture BA2 Format
+			for ( quint32 i = 0; i < header.numFiles; i++ ) {
+				F4Tex & tex = records[i].tex;
+				if ( !r.read( tex.header ) )
+					throw QString( "texture info read" );
+
+				tex.chunks.resize( tex.header.numChunks );
+				if ( !r.read( tex.chunks.data(), tex.chunks.count() * sizeof( F4TexChunk ) ) )
+					throw QString( "texture chunk read" );
+
+				if ( tex.chunks.count() ) {
+					records[i].packedLength = tex.chunks[0].packedSize;
+					records[i].unpackedLength = tex.chunks[0].unpackedSize;
+					records[i].offset = tex.chunks[0].offset;
 				}
 			}
+		} else {
+			throw QString( "archive type" );
 		}
-		else if ( magic == OB_BSAHEADER_FILEID )
-		{
-			bsa.read( (char*) &version, sizeof( version ) );
-			
-			if ( version != OB_BSAHEADER_VERSION && version != F3_BSAHEADER_VERSION && version != SSE_BSAHEADER_VERSION )
-				throw QString( "file version" );
-			
-			OBBSAHeader header;
-			
-			if ( bsa.read( (char *) & header, sizeof( header ) ) != sizeof( header ) )
-				throw QString( "header size" );
-			
-			numFiles = header.FileCount;
-			
-			//qDebug() << bsaName << header;
-			
-			if ( ( header.ArchiveFlags & OB_BSAARCHIVE_PATHNAMES ) == 0 || ( header.ArchiveFlags & OB_BSAARCHIVE_FILENAMES ) == 0 )
-				throw QString( "header flags" );
-			
-			compressToggle = header.ArchiveFlags & OB_BSAARCHIVE_COMPRESSFILES;
-			
-			if (version == F3_BSAHEADER_VERSION || version == SSE_BSAHEADER_VERSION) {
-				namePrefix = header.ArchiveFlags & F3_BSAARCHIVE_PREFIXFULLFILENAMES;
-			}
-			
-			int folderSize = 0;
-			if ( version != SSE_BSAHEADER_VERSION )
-				folderSize = sizeof( OBBSAFolderInfo );
-			else
-				folderSize = sizeof( SEBSAFolderInfo );
-
-			if ( !bsa.seek( header.FolderRecordOffset + header.FolderNameLength + header.FolderCount * (1 + folderSize) + header.FileCount * sizeof( OBBSAFileInfo ) ) )
-				throw QString( "file name seek" );
-			
-			QByteArray fileNames( header.FileNameLength, char(0) );
-			if ( bsa.read( fileNames.data(), header.FileNameLength ) != header.FileNameLength )
-				throw QString( "file name read" );
-			quint32 fileNameIndex = 0;
-			
-			//qDebug() << bsa.pos() - header.FileNameLength << fileNames;
-			
-			if ( ! bsa.seek( header.FolderRecordOffset ) )
-				throw QString( "folder info seek" );
-
-			quint32 totalFileCount = 0;
-			bool ok = true;
-
-			QVector<BSAFolderInfo> folderInfos;
-			folderInfos.reserve( header.FolderCount );
-			for ( quint32 i = 0; i < header.FolderCount; i++ ) {
-				BSAFolderInfo info = {};
-
-				// Hash
-				ok &= bsa.read( (char *)&info, 8 ) == 8;
-				// Filesize
-				ok &= bsa.read( (char *)&info + 8, 4 ) == 4;
-				if ( version == SSE_BSAHEADER_VERSION ) {
-					// Unknown value & Offset
-					ok &= bsa.read( (char *)&info + 12, 12 ) == 12;
-				} else {
-					// Offset
-					// Note: this is reading a uint32 into a uint64 whose memory must be zeroed.
-					ok &= bsa.read( (char *)&info + 16, 4 ) == 4;
-				}
-
-				if ( !ok )
-					throw QString( "folder info read" );
+	}
+	else if ( magic == OB_BSAHEADER_FILEID )
+	{
+		if ( !r.read( version ) )
+			throw QString( "file version" );
 
-				folderInfos << info;
+		if ( version != OB_BSAHEADER_VERSION && version != F3_BSAHEADER_VERSION && version != SSE_BSAHEADER_VERSION )
+			throw QString( "file version" );
+		
+		OBBSAHeader header;
+		if ( !r.read( header ) )
+			throw QString( "header size" );
+		
+		numFiles = header.FileCount;
+		
+		if ( ( header.ArchiveFlags & OB_BSAARCHIVE_PATHNAMES ) == 0 || ( header.ArchiveFlags & OB_BSAARCHIVE_FILENAMES ) == 0 )
+			throw QString( "header flags" );
+		
+		compressToggle = header.ArchiveFlags & OB_BSAARCHIVE_COMPRESSFILES;
+		
+		if (version == F3_BSAHEADER_VERSION || version == SSE_BSAHEADER_VERSION) {
+			namePrefix = header.ArchiveFlags & F3_BSAARCHIVE_PREFIXFULLFILENAMES;
+		}
+		
+		int folderSize = 0;
+		if ( version != SSE_BSAHEADER_VERSION )
+			folderSize = sizeof( OBBSAFolderInfo );
+		else
+			folderSize = sizeof( SEBSAFolderInfo );
+
+		// The file names follow the folder and file records
+		BSAReader names( *this, header.FolderRecordOffset + header.FolderNameLength + header.FolderCount * (1 + folderSize) + header.FileCount * sizeof( OBBSAFileInfo ) );
+		QByteArray fileNames( header.FileNameLength, char(0) );
+		if ( !names.read( fileNames.data(), header.FileNameLength ) )
+			throw QString( "file name read" );
+		quint32 fileNameIndex = 0;
+		
+		r.seek( header.FolderRecordOffset );
+
+		quint32 totalFileCount = 0;
+		bool ok = true;
+
+		QVector<BSAFolderInfo> folderInfos;
+		folderInfos.reserve( header.FolderCount );
+		for ( quint32 i = 0; i < header.FolderCount; i++ ) {
+			BSAFolderInfo info = {};
+
+			// Hash
+			ok &= r.read( (char *)&info, 8 );
+			// Filesize
+			ok &= r.read( (char *)&info + 8, 4 );
+			if ( version == SSE_BSAHEADER_VERSION ) {
+				// Unknown value & Offset
+				ok &= r.read( (char *)&info + 12, 12 );
+			} else {
+				// Offset
+				// Note: this is reading a uint32 into a uint64 whose memory must be zeroed.
+				ok &= r.read( (char *)&info + 16, 4 );
 			}
 
-			for ( const BSAFolderInfo folderInfo : folderInfos ) {
-				QString folderName;
-				if ( ! BSAReadSizedString( bsa, folderName ) || folderName.isEmpty() )
-				{
-					//qDebug() << "folderName" << folderName;
-					throw QString( "folder name read" );
-				}
-				
-				
-				BSAFolder * folder = insertFolder( folderName );
-				
-				quint32 fcnt = folderInfo.fileCount;
-				totalFileCount += fcnt;
-				QVector<OBBSAFileInfo> fileInfos( fcnt );
-				if ( bsa.read( (char *) fileInfos.data(), fcnt * sizeof( OBBSAFileInfo ) ) != fcnt * sizeof( OBBSAFileInfo ) )
-					throw QString( "file info read" );
-				
-				for ( const OBBSAFileInfo fileInfo : fileInfos )
-				{
-					if ( fileNameIndex >= header.FileNameLength )
-						throw QString( "file name size" );
-
-					QString fileName = QString::fromLatin1( fileNames.data() + fileNameIndex );
-					fileNameIndex += fileName.length() + 1;
-					
-					insertFile( folder, fileName, fileInfo.sizeFlags, fileInfo.offset );
-				}
-			}
-			
-			if ( totalFileCount != header.FileCount )
-				throw QString( "file count" );
+			if ( !ok )
+				throw QString( "folder info read" );
+
+			folderInfos << info;
 		}
-		else if ( magic == MW_BSAHEADER_FILEID )
-		{
-			MWBSAHeader header;
-			
-			if ( bsa.read( (char *) & header, sizeof( header ) ) != sizeof( header ) )
-				throw QString( "header" );
-			
-			numFiles = header.FileCount;
-			compressToggle = false;
-			namePrefix = false;
-			
-			// header is 12 bytes, hash table is 8 bytes per entry
-			quint32 dataOffset = 12 + header.HashOffset + header.FileCount * 8;
-			
-			// file size/offset table
-			QVector<MWBSAFileSizeOffset> sizeOffset( header.FileCount );
-			if ( bsa.read( (char *) sizeOffset.data(), header.FileCount * sizeof( MWBSAFileSizeOffset ) ) != header.FileCount * sizeof( MWBSAFileSizeOffset ) )
-				throw QString( "file size/offset" );
-			
-			// filename offset table
-			QVector<quint32> nameOffset( header.FileCount );
-			if ( bsa.read( (char *) nameOffset.data(), header.FileCount * sizeof( quint32 ) ) != header.FileCount * sizeof( quint32 ) )
-				throw QString( "file name offset" );
+
+		records.reserve( header.FileCount );
+		paths.reserve( header.FileCount );
+
+		QVector<OBBSAFileInfo> fileInfos;
+		for ( const BSAFolderInfo & folderInfo : folderInfos ) {
+			QString folderName;
+			if ( !r.readString<quint8>( folderName ) || folderName.isEmpty() )
+				throw QString( "folder name read" );
+
+			folderName = normalizedPath( folderName );
 			
-			// filenames. size is given by ( HashOffset - ( 8 * number of file/size offsets) - ( 4 * number of filenames) )
-			// i.e. ( HashOffset - ( 12 * number of files ) )
-			QByteArray fileNames;
-			fileNames.resize( header.HashOffset - 12 * header.FileCount );
-			if ( bsa.read( (char *) fileNames.data(), header.HashOffset - 12 * header.FileCount ) != header.HashOffset - 12 * header.FileCount )
-				throw QString( "file names" );
-
-			// table of 8 bytes of hash values follow, but we don't need to know what they are
-			// file data follows that, which is fetched by fileContents
+			quint32 fcnt = folderInfo.fileCount;
+			totalFileCount += fcnt;
+			fileInfos.resize( fcnt );
+			if ( !r.read( fileInfos.data(), fcnt * sizeof( OBBSAFileInfo ) ) )
+				throw QString( "file info read" );
 			
-			for ( quint32 c = 0; c < header.FileCount; c++ )
+			for ( const OBBSAFileInfo & fileInfo : fileInfos )
 			{
-				QString fname = fileNames.data() + nameOffset[ c ];
-				QString dname;
-				int x = fname.lastIndexOf( "\\" );
-				if ( x > 0 )
-				{
-					dname = fname.left( x );
-					fname = fname.remove( 0, x + 1 );
-				}
-				
-				// qDebug() << "inserting" << dname << fname;
-				
-				insertFile( insertFolder( dname ), fname, sizeOffset[ c ].size, dataOffset + sizeOffset[ c ].offset );
+				if ( fileNameIndex >= header.FileNameLength )
+					throw QString( "file name size" );
+
+				const char * fileName = fileNames.constData() + fileNameIndex;
+				int len = qstrnlen( fileName, header.FileNameLength - fileNameIndex );
+				fileNameIndex += len + 1;
+
+				BSAFile file;
+				file.sizeFlags = fileInfo.sizeFlags;
+				file.offset = fileInfo.offset;
+				records << file;
+				paths << folderName % "/" % QString::fromLatin1( fileName, len ).toLower();
 			}
 		}
-		else
-			throw QString( "file magic" );
+		
+		if ( totalFileCount != header.FileCount )
+			throw QString( "file count" );
 	}
-	catch ( QString & e )
+	else if ( magic == MW_BSAHEADER_FILEID )
 	{
-		status = e;
+		MWBSAHeader header;
+		if ( !r.read( header ) )
+			throw QString( "header" );
+		
+		numFiles = header.FileCount;
+		compressToggle = false;
+		namePrefix = false;
+		
+		// header is 12 bytes, hash table is 8 bytes per entry
+		quint32 dataOffset = 12 + header.HashOffset + header.FileCount * 8;
+		
+		// file size/offset table
+		QVector<MWBSAFileSizeOffset> sizeOffset( header.FileCount );
+		if ( !r.read( sizeOffset.data(), header.FileCount * sizeof( MWBSAFileSizeOffset ) ) )
+			throw QString( "file size/offset" );
+		
+		// filename offset table
+		QVector<quint32> nameOffset( header.FileCount );
+		if ( !r.read( nameOffset.data(), header.FileCount * sizeof( quint32 ) ) )
+			throw QString( "file name offset" );
+		
+		// filenames. size is given by ( HashOffset - ( 8 * number of file/size offsets) - ( 4 * number of filenames) )
+		// i.e. ( HashOffset - ( 12 * number of files ) )
+		quint32 namesLength = header.HashOffset - 12 * header.FileCount;
+		QByteArray fileNames( namesLength, char(0) );
+		if ( !r.read( fileNames.data(), namesLength ) )
+			throw QString( "file names" );
+
+		// table of 8 bytes of hash values follow, but we don't need to know what they are
+		// file data follows that, which is fetched by fileContents
+		
+		records.resize( header.FileCount );
+		paths.resize( header.FileCount );
+		for ( quint32 c = 0; c < header.FileCount; c++ )
+		{
+			if ( nameOffset[c] >= namesLength )
+				throw QString( "file name offset" );
+
+			const char * fileName = fileNames.constData() + nameOffset[c];
+			paths[c] = normalizedPath( QString::fromLatin1( fileName, qstrnlen( fileName, namesLength - nameOffset[c] ) ) );
+
+			records[c].sizeFlags = sizeOffset[c].size;
+			records[c].offset = dataOffset + sizeOffset[c].offset;
+		}
+	}
+	else
+		throw QString( "file magic" );
+
+	if ( paths.count() != records.count() )
+		throw QString( "file count" );
+}
+
+//! Magic of a cached archive index, the literal string "NSBI"
+static const quint32 BSA_INDEX_MAGIC = 0x4942534E;
+//! Version of the cached index layout, bump when BSAIndexHeader or BSAIndexRecord change
+static const quint32 BSA_INDEX_VERSION = 1;
+
+//! The header of a cached archive index
+struct BSAIndexHeader
+{
+	quint32 magic; //!< BSA_INDEX_MAGIC
+	quint32 indexVersion; //!< BSA_INDEX_VERSION
+	qint64 archiveSize; //!< Size of the archive when it was indexed
+	qint64 archiveTime; //!< Modification time of the archive when it was indexed
+	quint32 version; //!< Version of the archive
+	quint32 flags; //!< 1 if the archive toggles compression, 2 if names prefix the data
+	quint32 numRecords; //!< Number of BSAIndexRecord following the archive path
+	quint32 numChunks; //!< Number of F4TexChunk following the records
+	quint32 pathLength; //!< Length of the archive path following the header
+	quint32 namesLength; //!< Length of the file paths following the chunks
+};
+
+//! A file record in a cached archive index
+struct BSAIndexRecord
+{
+	quint64 offset;
+	quint32 sizeFlags;
+	quint32 packedLength;
+	quint32 unpackedLength;
+	quint32 nameLength; //!< Length of the file path in the names block
+	F4TexInfo tex; //!< Texture info, its chunk count gives the chunks used
+};
+
+// see bsa.h
+QString BSA::indexPath() const
+{
+	QString cache = QStandardPaths::writableLocation( QStandardPaths::CacheLocation );
+	if ( cache.isEmpty() )
+		return QString();
+
+	QByteArray key = QCryptographicHash::hash( bsaPath.toUtf8(), QCryptographicHash::Sha1 ).toHex();
+	return cache % "/archives/" % QString::fromLatin1( key ) % ".idx";
+}
+
+// see bsa.h
+bool BSA::loadIndex( QVector<QString> & paths )
+{
+	QString fn = indexPath();
+	if ( fn.isEmpty() )
+		return false;
+
+	QFile f( fn );
+	if ( !f.open( QIODevice::ReadOnly ) )
+		return false;
+
+	QByteArray data = f.readAll();
+	const char * p = data.constData();
+	const char * end = p + data.size();
+
+	BSAIndexHeader header;
+	if ( data.size() < int( sizeof( header ) ) )
+		return false;
+
+	memcpy( &header, p, sizeof( header ) );
+	p += sizeof( header );
+
+	if ( header.magic != BSA_INDEX_MAGIC || header.indexVersion != BSA_INDEX_VERSION
+	     || header.archiveSize != bsaInfo.size() || header.archiveTime != bsaInfo.lastModified().toMSecsSinceEpoch() )
+		return false;
+
+	qint64 expected = qint64( header.pathLength ) + qint64( header.numRecords ) * sizeof( BSAIndexRecord )
+	                  + qint64( header.numChunks ) * sizeof( F4TexChunk ) + header.namesLength;
+	if ( end - p != expected )
 		return false;
+
+	if ( QByteArray::fromRawData( p, header.pathLength ) != bsaPath.toUtf8() )
+		return false;
+	p += header.pathLength;
+
+	const char * recordData = p;
+	const char * chunkData = recordData + header.numRecords * sizeof( BSAIndexRecord );
+	const char * names = chunkData + header.numChunks * sizeof( F4TexChunk );
+	const char * chunksEnd = names;
+
+	records.resize( header.numRecords );
+	paths.resize( header.numRecords );
+
+	for ( quint32 i = 0; i < header.numRecords; i++ ) {
+		BSAIndexRecord rec;
+		memcpy( &rec, recordData + i * sizeof( rec ), sizeof( rec ) );
+
+		if ( names + rec.nameLength > end )
+			return false;
+
+		BSAFile & file = records[i];
+		file.offset = rec.offset;
+		file.sizeFlags = rec.sizeFlags;
+		file.packedLength = rec.packedLength;
+		file.unpackedLength = rec.unpackedLength;
+		file.tex.header = rec.tex;
+
+		if ( rec.tex.numChunks ) {
+			if ( chunkData + rec.tex.numChunks * sizeof( F4TexChunk ) > chunksEnd )
+				return false;
+
+			file.tex.chunks.resize( rec.tex.numChunks );
+			memcpy( file.tex.chunks.data(), chunkData, rec.tex.numChunks * sizeof( F4TexChunk ) );
+			chunkData += rec.tex.numChunks * sizeof( F4TexChunk );
+		}
+
+		paths[i] = QString::fromUtf8( names, rec.nameLength );
+		names += rec.nameLength;
 	}
-	
-	status = "loaded successful";
-	
+
+	version = header.version;
+	compressToggle = header.flags & 1;
+	namePrefix = header.flags & 2;
+	numFiles = header.numRecords;
+
 	return true;
 }
 
+// see bsa.h
+void BSA::saveIndex( const QVector<QString> & paths ) const
+{
+	QString fn = indexPath();
+	if ( fn.isEmpty() || !QDir().mkpath( QFileInfo( fn ).absolutePath() ) )
+		return;
+
+	QByteArray path = bsaPath.toUtf8();
+
+	QByteArray recordData;
+	QByteArray chunkData;
+	QByteArray names;
+	recordData.reserve( records.count() * sizeof( BSAIndexRecord ) );
+
+	for ( int i = 0; i < records.count(); i++ ) {
+		const BSAFile & file = records[i];
+		QByteArray name = paths[i].toUtf8();
+
+		BSAIndexRecord rec = {};
+		rec.offset = file.offset;
+		rec.sizeFlags = file.sizeFlags;
+		rec.packedLength = file.packedLength;
+		rec.unpackedLength = file.unpackedLength;
+		rec.nameLength = name.size();
+		rec.tex = file.tex.header;
+		rec.tex.numChunks = file.tex.chunks.count();
+
+		recordData.append( (const char *)&rec, sizeof( rec ) );
+		chunkData.append( (const char *)file.tex.chunks.constData(), file.tex.chunks.count() * sizeof( F4TexChunk ) );
+		names.append( name );
+	}
+
+	BSAIndexHeader header = {};
+	header.magic = BSA_INDEX_MAGIC;
+	header.indexVersion = BSA_INDEX_VERSION;
+	header.archiveSize = bsaInfo.size();
+	header.archiveTime = bsaInfo.lastModified().toMSecsSinceEpoch();
+	header.version = version;
+	header.flags = ( compressToggle ? 1 : 0 ) | ( namePrefix ? 2 : 0 );
+	header.numRecords = records.count();
+	header.numChunks = chunkData.size() / sizeof( F4TexChunk );
+	header.pathLength = path.size();
+	header.namesLength = names.size();
+
+	QSaveFile f( fn );
+	if ( !f.open( QIODevice::WriteOnly ) )
+		return;
+
+	f.write( (const char *)&header, sizeof( header ) );
+	f.write( path );
+	f.write( recordData );
+	f.write( chunkData );
+	f.write( names );
+	f.commit();
+}
+
 // see bsa.h
 void BSA::close()
 {
 	QMutexLocker lock( & bsaMutex );
 	
+	if ( mapped ) {
+		bsa.unmap( mapped );
+		mapped = nullptr;
+	}
+
 	bsa.close();
-	qDeleteAll( root->children );
-	qDeleteAll( root->files );
-	root->children.clear();
-	root->files.clear();
-	folders.clear();
 
-	delete root;
+	if ( root ) {
+		qDeleteAll( root->children );
+		root->children.clear();
+		root->files.clear();
+		folders.clear();
+
+		delete root;
+		root = nullptr;
+	}
+
+	files.clear();
+	records.clear();
 }
 
 // see bsa.h
@@ -456,203 +691,269 @@ qint64 BSA::fileSize( const QString & fn ) const
 }
 
 // see bsa.h
-bool BSA::fileContents( const QString & fn, QByteArray & content )
+QByteArray BSA::rawData( quint64 offset, qint64 size )
 {
-	//qDebug() << "entering fileContents for" << fn;
-	if ( const BSAFile * file = getFile( fn ) )
-	{
-		QMutexLocker lock( & bsaMutex );
-		if ( bsa.seek( file->offset ) )
-		{
-			qint64 filesz = file->size();
-			bool ok = true;
-			if (namePrefix) {
-				char len;
-				ok = bsa.read(&len, 1);
-				filesz -= len + 1;
-				if (ok) ok = bsa.seek( file->offset + 1 + len );
-			}
+	if ( size < 0 )
+		return QByteArray();
 
-			quint32 filesize = filesz;
-			if ( version == SSE_BSAHEADER_VERSION && file->sizeFlags > 0 && (file->compressed() ^ compressToggle) ) {
-				ok = bsa.read( (char*)&filesize, 4 );
-				filesz -= 4;
-			}
+	if ( mapped ) {
+		if ( offset > quint64( archiveSize ) || quint64( size ) > quint64( archiveSize ) - offset )
+			return QByteArray();
 
-			content.resize( filesz );
-			if ( ok && bsa.read( content.data(), filesz ) == filesz ) {
-				if ( file->sizeFlags > 0 && (file->compressed() ^ compressToggle) ) {
-					// BSA
-					if ( version != SSE_BSAHEADER_VERSION ) {
-						content.remove( 0, 4 );
-						QByteArray tmp3( content );
-
-						content = gUncompress( tmp3, filesz - 4 );
-					} else {
-						QByteArray tmp;
-						tmp.resize( filesize );
-
-						LZ4F_decompressionContext_t dCtx = nullptr;
-						LZ4F_createDecompressionContext( &dCtx, LZ4F_VERSION );
-						size_t dstSize = filesize;
-						size_t srcSize = content.size();
-
-						LZ4F_decompressOptions_t options = {};
-
-						LZ4F_decompress( dCtx, tmp.data(), &dstSize, content.data(), &srcSize, &options );
-						LZ4F_errorCode_t error = LZ4F_freeDecompressionContext( dCtx );
-						if ( error ) {
-							// TODO: Message logger
-							qDebug() << fn << "Error Code: " << error;
-						}
-
-						content = tmp;
-					}
-				} else if ( file->packedLength > 0 && !file->tex.chunks.count() ) {
-					// General BA2
-					QByteArray tmp( content );
-					content.resize( file->unpackedLength );
-					content = gUncompress( tmp, file->packedLength );
-				} else if ( file->tex.chunks.count() ) {
-					// Fill DDS Header
-					DDS_HEADER ddsHeader = {};
-					DDS_HEADER_DXT10 dx10Header = {};
-
-					bool dx10 = false;
-
-					ddsHeader.dwSize = sizeof( ddsHeader );
-					ddsHeader.dwHeaderFlags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_LINEARSIZE | DDS_HEADER_FLAGS_MIPMAP;
-					ddsHeader.dwHeight = file->tex.header.height;
-					ddsHeader.dwWidth = file->tex.header.width;
-					ddsHeader.dwMipMapCount = file->tex.header.numMips;
-					ddsHeader.ddspf.dwSize = sizeof( DDS_PIXELFORMAT );
-					ddsHeader.dwSurfaceFlags = DDS_SURFACE_FLAGS_TEXTURE | DDS_SURFACE_FLAGS_MIPMAP;
-
-					if ( file->tex.header.unk16 == 2049 )
-						ddsHeader.dwCubemapFlags = DDS_CUBEMAP_ALLFACES;
-
-					bool supported = true;
-
-					switch ( file->tex.header.format ) {
-					case DXGI_FORMAT_BC1_UNORM:
-						ddsHeader.ddspf.dwFlags = DDS_FOURCC;
-						ddsHeader.ddspf.dwFourCC = MAKEFOURCC( 'D', 'X', 'T', '1' );
-						ddsHeader.dwPitchOrLinearSize = file->tex.header.width * file->tex.header.height / 2;	// 4bpp
-						break;
-
-					case DXGI_FORMAT_BC2_UNORM:
-						ddsHeader.ddspf.dwFlags = DDS_FOURCC;
-						ddsHeader.ddspf.dwFourCC = MAKEFOURCC( 'D', 'X', 'T', '3' );
-						ddsHeader.dwPitchOrLinearSize = file->tex.header.width * file->tex.header.height;	// 8bpp
-						break;
-
-					case DXGI_FORMAT_BC3_UNORM:
-						ddsHeader.ddspf.dwFlags = DDS_FOURCC;
-						ddsHeader.ddspf.dwFourCC = MAKEFOURCC( 'D', 'X', 'T', '5' );
-						ddsHeader.dwPitchOrLinearSize = file->tex.header.width * file->tex.header.height;	// 8bpp
-						break;
-
-					case DXGI_FORMAT_BC5_UNORM:
-						ddsHeader.ddspf.dwFlags = DDS_FOURCC;
-						ddsHeader.ddspf.dwFourCC = MAKEFOURCC( 'A', 'T', 'I', '2' );
-						ddsHeader.dwPitchOrLinearSize = file->tex.header.width * file->tex.header.height;	// 8bpp
-						break;
-
-					case DXGI_FORMAT_B8G8R8A8_UNORM:
-						ddsHeader.ddspf.dwFlags = DDS_RGBA;
-						ddsHeader.ddspf.dwRGBBitCount = 32;
-						ddsHeader.ddspf.dwRBitMask = 0x00FF0000;
-						ddsHeader.ddspf.dwGBitMask = 0x0000FF00;
-						ddsHeader.ddspf.dwBBitMask = 0x000000FF;
-						ddsHeader.ddspf.dwABitMask = 0xFF000000;
-						ddsHeader.dwPitchOrLinearSize = file->tex.header.width * file->tex.header.height * 4;	// 32bpp
-						break;
-
-					case DXGI_FORMAT_R8_UNORM:
-						ddsHeader.ddspf.dwFlags = DDS_RGB;
-						ddsHeader.ddspf.dwRGBBitCount = 8;
-						ddsHeader.ddspf.dwRBitMask = 0xFF;
-						ddsHeader.dwPitchOrLinearSize = file->tex.header.width * file->tex.header.height;	// 8bpp
-						break;
-
-					case DXGI_FORMAT_BC7_UNORM:
-					case DXGI_FORMAT_BC1_UNORM_SRGB:
-					case DXGI_FORMAT_BC2_UNORM_SRGB:
-					case DXGI_FORMAT_BC3_UNORM_SRGB:
-					case DXGI_FORMAT_BC7_UNORM_SRGB:
-						ddsHeader.ddspf.dwFlags = DDS_FOURCC;
-						ddsHeader.ddspf.dwFourCC = MAKEFOURCC( 'D', 'X', '1', '0' );
-						ddsHeader.dwPitchOrLinearSize = file->tex.header.width * file->tex.header.height;
-
-						dx10 = true;
-						dx10Header.dxgiFormat = DXGI_FORMAT( file->tex.header.format );
-						break;
-
-					default:
-						supported = false;
-						break;
-					}
-
-					if ( !supported )
-						return false;
-
-					char dds[sizeof( ddsHeader )];
-					memcpy( dds, &ddsHeader, sizeof( ddsHeader ) );
-
-					int texSize = 0; // = file->unpackedLength;
-					int hdrSize = sizeof( ddsHeader ) + 4;
-
-					content.clear();
-					content.append( QByteArray::fromStdString( "DDS " ) );
-					content.append( QByteArray::fromRawData( dds, sizeof( ddsHeader ) ) );
-					Q_ASSERT( content.size() == hdrSize );
-
-					if ( dx10 ) {
-						dx10Header.resourceDimension = DDS_DIMENSION_TEXTURE2D;
-						dx10Header.miscFlag = 0;
-						dx10Header.arraySize = 1;
-						dx10Header.miscFlags2 = 0;
-
-						char dds2[sizeof( dx10Header )];
-						memcpy( dds2, &dx10Header, sizeof( dx10Header ) );
-						content.append( QByteArray::fromRawData( dds2, sizeof( dx10Header ) ) );
-					}
-
-					// Start at 1st chunk now
-					for ( int i = 0; i < file->tex.chunks.count(); i++ ) {
-						F4TexChunk chunk = file->tex.chunks[i];
-						if ( bsa.seek( chunk.offset ) ) {
-							QByteArray chunkData;
-
-							if ( chunk.packedSize > 0 ) {
-								chunkData.resize( chunk.packedSize );
-								if ( bsa.read( chunkData.data(), chunk.packedSize ) == chunk.packedSize ) {
-									chunkData = gUncompress( chunkData, chunk.packedSize );
-
-									if ( chunkData.size() != chunk.unpackedSize )
-										qCritical() << "Size does not match at " << chunk.offset;
-								}
-							} else if ( !(bsa.read( chunkData.data(), chunk.unpackedSize ) == chunk.unpackedSize) ) {
-								qCritical() << "Size does not match at " << chunk.offset;
-							}
-							texSize += chunk.unpackedSize;
-
-							content.append( chunkData );
-							//Q_ASSERT( content.size() - hdrSize == texSize );
-						} else {
-							qCritical() << "Seek error";
-						}
-					}
+		return QByteArray::fromRawData( (const char *)mapped + offset, size );
+	}
 
-				}
+	// Without a mapping the file cursor is shared between threads
+	QMutexLocker lock( &bsaMutex );
+	if ( !bsa.seek( offset ) )
+		return QByteArray();
 
-				return true;
-			}
+	QByteArray data = bsa.read( size );
+	if ( data.size() != size )
+		return QByteArray();
+
+	return data;
+}
+
+//! Decompresses a block of LZ4 frames straight into a buffer of its exact unpacked size
+static bool lz4Uncompress( const QByteArray & packed, char * dst, quint32 size )
+{
+	LZ4F_decompressionContext_t dCtx = nullptr;
+	if ( LZ4F_isError( LZ4F_createDecompressionContext( &dCtx, LZ4F_VERSION ) ) )
+		return false;
+
+	size_t dstSize = size;
+	size_t srcSize = packed.size();
+
+	LZ4F_decompressOptions_t options = {};
+
+	size_t ret = LZ4F_decompress( dCtx, dst, &dstSize, packed.constData(), &srcSize, &options );
+	LZ4F_freeDecompressionContext( dCtx );
+
+	return !LZ4F_isError( ret ) && dstSize == size;
+}
+
+//! Builds the DDS header of a texture BA2 entry, false if its format is not supported
+static bool ddsHeader( const F4Tex & tex, QByteArray & header )
+{
+	DDS_HEADER ddsHeader = {};
+	DDS_HEADER_DXT10 dx10Header = {};
+
+	bool dx10 = false;
+
+	ddsHeader.dwSize = sizeof( ddsHeader );
+	ddsHeader.dwHeaderFlags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_LINEARSIZE | DDS_HEADER_FLAGS_MIPMAP;
+	ddsHeader.dwHeight = tex.header.height;
+	ddsHeader.dwWidth = tex.header.width;
+	ddsHeader.dwMipMapCount = tex.header.numMips;
+	ddsHeader.ddspf.dwSize = sizeof( DDS_PIXELFORMAT );
+	ddsHeader.dwSurfaceFlags = DDS_SURFACE_FLAGS_TEXTURE | DDS_SURFACE_FLAGS_MIPMAP;
+
+	if ( tex.header.unk16 == 2049 )
+		ddsHeader.dwCubemapFlags = DDS_CUBEMAP_ALLFACES;
+
+	switch ( tex.header.format ) {
+	case DXGI_FORMAT_BC1_UNORM:
+		ddsHeader.ddspf.dwFlags = DDS_FOURCC;
+		ddsHeader.ddspf.dwFourCC = MAKEFOURCC( 'D', 'X', 'T', '1' );
+		ddsHeader.dwPitchOrLinearSize = tex.header.width * tex.header.height / 2;	// 4bpp
+		break;
+
+	case DXGI_FORMAT_BC2_UNORM:
+		ddsHeader.ddspf.dwFlags = DDS_FOURCC;
+		ddsHeader.ddspf.dwFourCC = MAKEFOURCC( 'D', 'X', 'T', '3' );
+		ddsHeader.dwPitchOrLinearSize = tex.header.width * tex.header.height;	// 8bpp
+		break;
+
+	case DXGI_FORMAT_BC3_UNORM:
+		ddsHeader.ddspf.dwFlags = DDS_FOURCC;
+		ddsHeader.ddspf.dwFourCC = MAKEFOURCC( 'D', 'X', 'T', '5' );
+		ddsHeader.dwPitchOrLinearSize = tex.header.width * tex.header.height;	// 8bpp
+		break;
+
+	case DXGI_FORMAT_BC5_UNORM:
+		ddsHeader.ddspf.dwFlags = DDS_FOURCC;
+		ddsHeader.ddspf.dwFourCC = MAKEFOURCC( 'A', 'T', 'I', '2' );
+		ddsHeader.dwPitchOrLinearSize = tex.header.width * tex.header.height;	// 8bpp
+		break;
+
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+		ddsHeader.ddspf.dwFlags = DDS_RGBA;
+		ddsHeader.ddspf.dwRGBBitCount = 32;
+		ddsHeader.ddspf.dwRBitMask = 0x00FF0000;
+		ddsHeader.ddspf.dwGBitMask = 0x0000FF00;
+		ddsHeader.ddspf.dwBBitMask = 0x000000FF;
+		ddsHeader.ddspf.dwABitMask = 0xFF000000;
+		ddsHeader.dwPitchOrLinearSize = tex.header.width * tex.header.height * 4;	// 32bpp
+		break;
+
+	case DXGI_FORMAT_R8_UNORM:
+		ddsHeader.ddspf.dwFlags = DDS_RGB;
+		ddsHeader.ddspf.dwRGBBitCount = 8;
+		ddsHeader.ddspf.dwRBitMask = 0xFF;
+		ddsHeader.dwPitchOrLinearSize = tex.header.width * tex.header.height;	// 8bpp
+		break;
+
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		ddsHeader.ddspf.dwFlags = DDS_FOURCC;
+		ddsHeader.ddspf.dwFourCC = MAKEFOURCC( 'D', 'X', '1', '0' );
+		ddsHeader.dwPitchOrLinearSize = tex.header.width * tex.header.height;
+
+		dx10 = true;
+		dx10Header.dxgiFormat = DXGI_FORMAT( tex.header.format );
+		break;
+
+	default:
+		return false;
+	}
+
+	header.clear();
+	header.append( "DDS ", 4 );
+	header.append( (const char *)&ddsHeader, sizeof( ddsHeader ) );
+
+	if ( dx10 ) {
+		dx10Header.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+		dx10Header.miscFlag = 0;
+		dx10Header.arraySize = 1;
+		dx10Header.miscFlags2 = 0;
+
+		header.append( (const char *)&dx10Header, sizeof( dx10Header ) );
+	}
+
+	return true;
+}
+
+// see bsa.h
+bool BSA::filePieces( const BSAFile * file, QByteArray & header, QVector<BSAPiece> & pieces )
+{
+	header.clear();
+	pieces.clear();
+
+	if ( file->tex.chunks.count() ) {
+		// Texture BA2
+		if ( !ddsHeader( file->tex, header ) )
+			return false;
+
+		pieces.reserve( file->tex.chunks.count() );
+		for ( const F4TexChunk & chunk : file->tex.chunks ) {
+			BSAPiece piece;
+			piece.codec = ( chunk.packedSize > 0 ) ? BSAPiece::Zlib : BSAPiece::Stored;
+			piece.offset = chunk.offset;
+			piece.packedSize = ( chunk.packedSize > 0 ) ? chunk.packedSize : chunk.unpackedSize;
+			piece.unpackedSize = chunk.unpackedSize;
+			pieces << piece;
 		}
+
+		return true;
 	}
+
+	BSAPiece piece;
+	piece.offset = file->offset;
+
+	if ( file->packedLength > 0 ) {
+		// General BA2
+		piece.codec = BSAPiece::Zlib;
+		piece.packedSize = file->packedLength;
+		piece.unpackedSize = file->unpackedLength;
+		pieces << piece;
+		return true;
+	}
+
+	qint64 filesz = file->size();
+
+	if ( namePrefix ) {
+		QByteArray len = rawData( piece.offset, 1 );
+		if ( len.size() != 1 )
+			return false;
+
+		quint8 prefix = quint8( len[0] );
+		piece.offset += 1 + prefix;
+		filesz -= 1 + prefix;
+	}
+
+	if ( filesz < 0 )
+		return false;
+
+	if ( !( file->sizeFlags > 0 && (file->compressed() ^ compressToggle) ) ) {
+		piece.packedSize = filesz;
+		piece.unpackedSize = filesz;
+		pieces << piece;
+		return true;
+	}
+
+	// Compressed BSA entries start with their uncompressed size
+	QByteArray size = rawData( piece.offset, 4 );
+	if ( filesz < 4 || size.size() != 4 )
+		return false;
+
+	memcpy( &piece.unpackedSize, size.constData(), 4 );
+	piece.codec = ( version == SSE_BSAHEADER_VERSION ) ? BSAPiece::LZ4 : BSAPiece::Zlib;
+	piece.offset += 4;
+	piece.packedSize = filesz - 4;
+	pieces << piece;
+	return true;
+}
+
+// see bsa.h
+bool BSA::unpackPiece( const BSAPiece & piece, char * dst )
+{
+	QByteArray packed = rawData( piece.offset, piece.packedSize );
+	if ( packed.size() != qint64( piece.packedSize ) ) {
+		qCritical() << bsaName << "Size does not match at " << piece.offset;
+		return false;
+	}
+
+	switch ( piece.codec ) {
+	case BSAPiece::Stored:
+		memcpy( dst, packed.constData(), piece.unpackedSize );
+		return true;
+	case BSAPiece::Zlib:
+		return zlibUncompress( packed, dst, piece.unpackedSize );
+	case BSAPiece::LZ4:
+		return lz4Uncompress( packed, dst, piece.unpackedSize );
+	}
+
 	return false;
 }
 
+// see bsa.h
+bool BSA::fileContents( const QString & fn, QByteArray & content )
+{
+	const BSAFile * file = getFile( fn );
+	if ( !file )
+		return false;
+
+	QByteArray header;
+	QVector<BSAPiece> pieces;
+	if ( !filePieces( file, header, pieces ) )
+		return false;
+
+	qint64 total = header.size();
+	for ( const BSAPiece & piece : pieces )
+		total += piece.unpackedSize;
+
+	// One allocation of the final size, reusing the capacity of the caller's buffer
+	content.resize( total );
+	char * dst = content.data();
+
+	memcpy( dst, header.constData(), header.size() );
+	dst += header.size();
+
+	for ( const BSAPiece & piece : pieces ) {
+		if ( !unpackPiece( piece, dst ) ) {
+			content.clear();
+			return false;
+		}
+		dst += piece.unpackedSize;
+	}
+
+	return true;
+}
+
 // see bsa.h
 QString BSA::getAbsoluteFilePath( const QString & fn ) const
 {
@@ -668,8 +969,6 @@ BSA::BSAFolder * BSA::insertFolder( QString name )
 	if ( name.isEmpty() )
 		return root;
 	
-	name = name.replace( "\\", "/" ).toLower();
-	
 	BSAFolder * folder = folders.value( name );
 	if ( !folder ) {
 		folder = new BSAFolder;
@@ -690,43 +989,41 @@ BSA::BSAFolder * BSA::insertFolder( QString name )
 }
 
 // see bsa.h
-BSA::BSAFile * BSA::insertFile( BSAFolder * folder, QString name, quint32 sizeFlags, quint32 offset )
+void BSA::buildFolders() const
 {
-	BSAFile * file = new BSAFile;
-	file->sizeFlags = sizeFlags;
-	file->offset = offset;
-	folder->files.insert( name, file );
+	QMutexLocker lock( &folderMutex );
+	if ( foldersBuilt || !root )
+		return;
 
-	files.insert( QString( folder->name % "/" % name ).toLower(), file );
-	return file;
-}
+	// The folder tree only caches the flat file hash for browsing
+	BSA * self = const_cast<BSA *>( this );
 
-BSA::BSAFile * BSA::insertFile( BSAFolder * folder, QString name, quint32 packed, quint32 unpacked, quint64 offset, F4Tex dds )
-{
-	BSAFile * file = new BSAFile;
-	file->tex = dds;
-	file->packedLength = packed;
-	file->unpackedLength = unpacked;
-	file->offset = offset;
-	folder->files.insert( name, file );
+	for ( auto it = files.constBegin(); it != files.constEnd(); ++it ) {
+		const QString & path = it.key();
+		int p = path.lastIndexOf( '/' );
 
-	files.insert( QString( folder->name % "/" % name ).toLower(), file );
-	return file;
+		BSAFolder * folder = self->insertFolder( ( p > 0 ) ? path.left( p ) : QString() );
+		folder->files.insert( path.mid( p + 1 ), it.value() );
+	}
+
+	foldersBuilt = true;
 }
 
 // see bsa.h
 const BSA::BSAFolder * BSA::getFolder( QString fn ) const
 {
+	buildFolders();
+
 	if ( fn.isEmpty() )
 		return root;
 	else
-		return folders.value( fn );
+		return folders.value( normalizedPath( fn ) );
 }
 
 // see bsa.h
 const BSA::BSAFile * BSA::getFile( QString fn ) const
 {
-	return files.value( fn.toLower() );
+	return files.value( normalizedPath( fn ) );
 }
 
 // see bsa.h
@@ -759,146 +1056,439 @@ QDateTime BSA::fileTime( const QString & ) const
 	return bsaInfo.created( );
 }
 
-bool BSA::scan( const BSA::BSAFolder * folder, QStandardItem * item, QString path )
+//! Number of trigrams over the 6-bit alphabet of trigramChar()
+static const int trigramCount = 1 << 18;
+
+//! Maps a path character to 6 bits; rare characters share codes, which only widens the candidates
+static inline quint32 trigramChar( QChar c )
 {
-	if ( !folder || folder->children.count() == 0 )
-		return false;
+	ushort u = c.unicode();
+	if ( u >= 'a' && u <= 'z' )
+		return u - 'a' + 1;
+	if ( u >= '0' && u <= '9' )
+		return u - '0' + 27;
+
+	switch ( u ) {
+	case '_': return 37;
+	case '.': return 38;
+	case '-': return 39;
+	case ' ': return 40;
+	default:  return 41 + u % 23;
+	}
+}
 
-	auto& children = folder->children;
-	QHash<QString, BSAFolder *>::const_iterator i;
-	for ( i = children.begin(); i != children.end(); ++i ) {
-		auto f = i.value()->files;
-		auto c = i.value()->children;
-		if ( !f.count() && !c.count() )
-			continue;
+//! Trigram at position i of a string
+static inline quint32 trigramAt( const QChar * s, int i )
+{
+	return (trigramChar( s[i] ) << 12) | (trigramChar( s[i + 1] ) << 6) | trigramChar( s[i + 2] );
+}
+
+void BSAModel::TrigramIndex::build( int count, const std::function<QStringRef( int )> & text )
+{
+	offsets.fill( 0, trigramCount + 1 );
+	QVector<int> last( trigramCount, -1 );
+
+	// Count, then fill, skipping repeats of a trigram in the same item
+	for ( int pass = 0; pass < 2; pass++ ) {
+		QVector<int> fill;
+		if ( pass == 1 ) {
+			for ( int t = 0; t < trigramCount; t++ )
+				offsets[t + 1] += offsets[t];
+
+			postings.resize( offsets[trigramCount] );
+			fill = offsets;
+			last.fill( -1 );
+		}
 
-		auto folderItem = new QStandardItem( i.key() );
-		auto pathDummy = new QStandardItem( "" );
-		auto sizeDummy = new QStandardItem( "" );
+		for ( int n = 0; n < count; n++ ) {
+			QStringRef str = text( n );
+			const QChar * s = str.unicode();
 
-		item->appendRow( { folderItem, pathDummy, sizeDummy } );
+			for ( int i = 0; i + 2 < str.length(); i++ ) {
+				quint32 t = trigramAt( s, i );
+				if ( last[t] == n )
+					continue;
 
-		// Recurse through folders
-		if ( c.count() ) {
-			QString fullpath = ((path.isEmpty()) ? path : path % "/") % i.key();
-			scan( i.value(), folderItem, fullpath );
+				last[t] = n;
+				if ( pass == 0 )
+					offsets[t + 1]++;
+				else
+					postings[fill[t]++] = n;
+			}
 		}
+	}
+}
 
-		// List files
-		if ( f.count() ) {
-			QHash<QString, BSAFile *>::const_iterator it;
-			for ( it = f.begin(); it != f.end(); ++it ) {
-				QString fullpath = path % "/" % i.key() % "/" % it.key();
+void BSAModel::TrigramIndex::clear()
+{
+	offsets.clear();
+	postings.clear();
+}
 
-				int bytes = it.value()->size();
-				QString filesize = (bytes > 1024) ? QString::number( bytes / 1024 ) + "KB" : QString::number( bytes ) + "B";
 
-				auto fileItem = new QStandardItem( it.key() );
-				auto pathItem = new QStandardItem( fullpath );
-				auto sizeItem = new QStandardItem( filesize );
+BSAModel::BSAModel( QObject * parent )
+	: QAbstractItemModel( parent )
+{
+	nodes.append( Node() );
+}
 
-				folderItem->appendRow( { fileItem, pathItem, sizeItem } );
-			}
+void BSAModel::setArchive( const BSA * bsa, const QString & folder, const QStringList & filetypes )
+{
+	beginResetModel();
+
+	rootPrefix = normalizedPath( folder );
+	if ( !rootPrefix.isEmpty() && !rootPrefix.endsWith( '/' ) )
+		rootPrefix += '/';
+
+	QStringList types;
+	for ( const QString & t : filetypes )
+		types << t.toLower();
+
+	QVector<QPair<QString, quint32>> entries;
+	for ( auto it = bsa->files.cbegin(); it != bsa->files.cend(); ++it ) {
+		if ( !it.key().startsWith( rootPrefix ) )
+			continue;
+
+		bool typeMatch = types.isEmpty();
+		for ( const QString & t : types )
+			typeMatch |= it.key().endsWith( t );
+
+		if ( typeMatch )
+			entries.append( { it.key(), it.value()->size() } );
+	}
+
+	std::sort( entries.begin(), entries.end() );
+
+	paths.resize( entries.count() );
+	sizes.resize( entries.count() );
+	nameStart.resize( entries.count() );
+	fileFolder.resize( entries.count() );
+	folderPaths.clear();
+
+	QHash<QString, int> folderIds;
+	for ( int f = 0; f < entries.count(); f++ ) {
+		paths[f] = entries[f].first;
+		sizes[f] = entries[f].second;
+		nameStart[f] = paths[f].lastIndexOf( '/' ) + 1;
+
+		QString folderPath = paths[f].left( std::max( nameStart[f] - 1, 0 ) );
+		auto id = folderIds.constFind( folderPath );
+		if ( id == folderIds.cend() ) {
+			id = folderIds.insert( folderPath, folderPaths.count() );
+			folderPaths.append( folderPath );
 		}
+		fileFolder[f] = id.value();
 	}
 
-	return true;
+	nameIndex.build( paths.count(), [this]( int f ) { return paths[f].midRef( nameStart[f] ); } );
+	folderIndex.build( folderPaths.count(), [this]( int d ) { return QStringRef( &folderPaths[d] ); } );
+
+	applyFilter();
+
+	endResetModel();
 }
 
-bool BSA::fillModel( BSAModel * bsaModel, const QString & folder )
+void BSAModel::clear()
 {
-	return scan( getFolder( folder ), bsaModel->invisibleRootItem(), folder );
+	beginResetModel();
+
+	paths.clear();
+	sizes.clear();
+	nameStart.clear();
+	fileFolder.clear();
+	folderPaths.clear();
+	nameIndex.clear();
+	folderIndex.clear();
+	rootPrefix.clear();
+	visible.clear();
+	nodes = { Node() };
+
+	endResetModel();
 }
 
-
-BSAModel::BSAModel( QObject * parent )
-	: QStandardItemModel( parent )
+void BSAModel::setFilter( const QString & pattern, bool nameOnly )
 {
+	beginResetModel();
+
+	filterPattern = pattern;
+	filterByNameOnly = nameOnly;
+	applyFilter();
 
+	endResetModel();
 }
 
-void BSAModel::init()
+void BSAModel::applyFilter()
 {
-	setColumnCount( 3 );
-	setHorizontalHeaderLabels( { "File", "Path", "Size" } );
+	const int count = paths.count();
+	QString pattern = filterPattern.toLower();
+
+	visible.clear();
+
+	if ( pattern.isEmpty() || pattern == "*" ) {
+		visible.resize( count );
+		std::iota( visible.begin(), visible.end(), 0 );
+	} else if ( count > 0 ) {
+		// Literal runs of the pattern, the text between wildcards and sets
+		QStringList literals;
+		int start = 0;
+		for ( int i = 0; i <= pattern.length(); i++ ) {
+			if ( i < pattern.length() && pattern[i] != '*' && pattern[i] != '?' && pattern[i] != '[' )
+				continue;
+
+			literals << pattern.mid( start, i - start );
+
+			if ( i < pattern.length() && pattern[i] == '[' ) {
+				// A ']' straight after '[' belongs to the set
+				int close = pattern.indexOf( ']', i + 2 );
+				if ( close < 0 )
+					break;
+				i = close;
+			}
+			start = i + 1;
+		}
+
+		// Every trigram of a literal must appear in the file name or in its folder path,
+		// unless it spans the two
+		QSet<quint32> trigrams;
+		for ( const QString & literal : literals ) {
+			for ( int i = 0; i + 2 < literal.length(); i++ ) {
+				if ( !literal.midRef( i, 3 ).contains( '/' ) )
+					trigrams.insert( trigramAt( literal.unicode(), i ) );
+			}
+		}
+
+		QVector<bool> candidate( count, true );
+		QVector<bool> hit( count );
+		QVector<bool> folderHit( folderPaths.count() );
+
+		for ( quint32 t : trigrams ) {
+			hit.fill( false );
+			for ( int p = nameIndex.offsets[t]; p < nameIndex.offsets[t + 1]; p++ )
+				hit[nameIndex.postings[p]] = true;
+
+			if ( !filterByNameOnly ) {
+				folderHit.fill( false );
+				for ( int p = folderIndex.offsets[t]; p < folderIndex.offsets[t + 1]; p++ )
+					folderHit[folderIndex.postings[p]] = true;
+
+				for ( int f = 0; f < count; f++ )
+					hit[f] = hit[f] || folderHit[fileFolder[f]];
+			}
+
+			for ( int f = 0; f < count; f++ )
+				candidate[f] = candidate[f] && hit[f];
+		}
+
+		QRegExp rx( pattern, Qt::CaseInsensitive, QRegExp::Wildcard );
+		for ( int f = 0; f < count; f++ ) {
+			if ( !candidate[f] )
+				continue;
+
+			const QString & path = paths[f];
+			if ( (filterByNameOnly ? path.mid( nameStart[f] ) : path).contains( rx ) )
+				visible.append( f );
+		}
+	}
+
+	Node root;
+	root.end = visible.count();
+	root.prefixLength = rootPrefix.length();
+	nodes = { root };
 }
 
-Qt::ItemFlags BSAModel::flags( const QModelIndex & index ) const
+void BSAModel::populate( int n ) const
 {
-	return QStandardItemModel::flags( index ) ^ Qt::ItemIsEditable;
+	if ( nodes[n].populated || nodes[n].file >= 0 )
+		return;
+
+	const int begin = nodes[n].begin;
+	const int end = nodes[n].end;
+	const int prefixLength = nodes[n].prefixLength;
+
+	QVector<int> children;
+
+	// The files below a folder are consecutive since the paths are sorted
+	for ( int i = begin; i < end; ) {
+		const QString & path = paths[visible[i]];
+		int slash = path.indexOf( '/', prefixLength );
+
+		Node child;
+		child.parent = n;
+
+		if ( slash < 0 ) {
+			child.file = visible[i];
+			i++;
+		} else {
+			QStringRef folder = path.midRef( prefixLength, slash - prefixLength + 1 );
+
+			int j = i + 1;
+			while ( j < end && paths[visible[j]].midRef( prefixLength, folder.length() ) == folder )
+				j++;
+
+			child.name = folder.left( folder.length() - 1 ).toString();
+			child.begin = i;
+			child.end = j;
+			child.prefixLength = slash + 1;
+			i = j;
+		}
+
+		children.append( nodes.count() );
+		nodes.append( child );
+	}
+
+	Node & node = nodes[n];
+	node.children = children;
+	node.populated = true;
+	sortChildren( node );
 }
 
+void BSAModel::sortChildren( Node & node ) const
+{
+	auto lessThan = [this]( const Node & a, const Node & b ) {
+		if ( sortColumn == 2 && a.file >= 0 && b.file >= 0 && sizes[a.file] != sizes[b.file] )
+			return sizes[a.file] < sizes[b.file];
+
+		return nodeName( a ) < nodeName( b );
+	};
+
+	std::sort( node.children.begin(), node.children.end(), [this, &lessThan]( int l, int r ) {
+		const Node & a = nodes[l];
+		const Node & b = nodes[r];
 
-BSAProxyModel::BSAProxyModel( QObject * parent )
-	: QSortFilterProxyModel( parent )
+		// Folders first
+		if ( (a.file < 0) != (b.file < 0) )
+			return a.file < 0;
+
+		return (sortOrder == Qt::AscendingOrder) ? lessThan( a, b ) : lessThan( b, a );
+	} );
+
+	for ( int row = 0; row < node.children.count(); row++ )
+		nodes[node.children[row]].row = row;
+}
+
+QStringRef BSAModel::nodeName( const Node & node ) const
 {
+	if ( node.file >= 0 )
+		return paths[node.file].midRef( nameStart[node.file] );
 
+	return QStringRef( &node.name );
 }
 
-void BSAProxyModel::setFiletypes( QStringList types )
+QModelIndex BSAModel::index( int row, int column, const QModelIndex & parent ) const
 {
-	filetypes = types;
+	int p = parent.isValid() ? int( parent.internalId() ) : 0;
+	populate( p );
+
+	if ( row < 0 || row >= nodes[p].children.count() || column < 0 || column >= 3 )
+		return QModelIndex();
+
+	return createIndex( row, column, quintptr( nodes[p].children[row] ) );
 }
 
-void BSAProxyModel::setFilterByNameOnly( bool nameOnly )
+QModelIndex BSAModel::parent( const QModelIndex & child ) const
 {
-	filterByNameOnly = nameOnly;
+	if ( !child.isValid() )
+		return QModelIndex();
+
+	int p = nodes[int( child.internalId() )].parent;
+	if ( p <= 0 )
+		return QModelIndex();
 
-	setFilterRegExp( filterRegExp() );
+	return createIndex( nodes[p].row, 0, quintptr( p ) );
 }
 
-void BSAProxyModel::resetFilter()
+int BSAModel::rowCount( const QModelIndex & parent ) const
 {
-	setFilterRegExp( QRegExp( "*", Qt::CaseInsensitive, QRegExp::Wildcard ) );
+	if ( parent.column() > 0 )
+		return 0;
+
+	int n = parent.isValid() ? int( parent.internalId() ) : 0;
+	populate( n );
+
+	return nodes[n].children.count();
 }
 
-bool BSAProxyModel::filterAcceptsRow( int sourceRow, const QModelIndex & sourceParent ) const
+int BSAModel::columnCount( const QModelIndex & ) const
 {
-	if ( !filterRegExp().isEmpty() ) {
-		
-		QModelIndex sourceIndex0 = sourceModel()->index( sourceRow, 0, sourceParent );
-		QModelIndex sourceIndex1 = sourceModel()->index( sourceRow, 1, sourceParent );
-		if ( sourceIndex0.isValid() ) {
-			// If children match, parent matches
-			int c = sourceModel()->rowCount( sourceIndex0 );
-			for ( int i = 0; i < c; ++i ) {
-				if ( filterAcceptsRow( i, sourceIndex0 ) )
-					return true;
-			}
+	return 3;
+}
 
-			QString key0 = sourceModel()->data( sourceIndex0, filterRole() ).toString();
-			QString key1 = sourceModel()->data( sourceIndex1, filterRole() ).toString();
-			
-			bool typeMatch = true;
-			if ( filetypes.count() ) {
-				typeMatch = false;
-				for ( auto f : filetypes ) {
-					typeMatch |= key1.endsWith( f );
-				}
-			}
+bool BSAModel::hasChildren( const QModelIndex & parent ) const
+{
+	if ( !parent.isValid() )
+		return !visible.isEmpty();
 
-			bool stringMatch = (filterByNameOnly) ? key0.contains( filterRegExp() ) : key1.contains( filterRegExp() );
+	// Folders only exist while they have visible files
+	return parent.column() == 0 && nodes[int( parent.internalId() )].file < 0;
+}
 
-			return typeMatch && stringMatch;
+QVariant BSAModel::data( const QModelIndex & index, int role ) const
+{
+	if ( !index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole) )
+		return QVariant();
+
+	const Node & node = nodes[int( index.internalId() )];
+
+	switch ( index.column() ) {
+	case 0:
+		return nodeName( node ).toString();
+	case 1:
+		return (node.file >= 0) ? paths[node.file] : QString();
+	case 2:
+		if ( node.file >= 0 ) {
+			quint32 bytes = sizes[node.file];
+			return (bytes > 1024) ? QString::number( bytes / 1024 ) + "KB" : QString::number( bytes ) + "B";
 		}
+		return QString();
 	}
 
-	return QSortFilterProxyModel::filterAcceptsRow( sourceRow, sourceParent );
+	return QVariant();
 }
 
-bool BSAProxyModel::lessThan( const QModelIndex & left, const QModelIndex & right ) const
+QVariant BSAModel::headerData( int section, Qt::Orientation orientation, int role ) const
 {
-	QString leftString = sourceModel()->data( left ).toString();
-	QString rightString = sourceModel()->data( right ).toString();
+	static const QStringList labels = { "File", "Path", "Size" };
 
-	QModelIndex leftChild = left.child( 0, 0 );
-	QModelIndex rightChild = right.child( 0, 0 );
+	if ( orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < labels.count() )
+		return labels.at( section );
 
-	if ( !leftChild.isValid() && rightChild.isValid() )
-		return false;
+	return QVariant();
+}
 
-	if ( leftChild.isValid() && !rightChild.isValid() )
-		return true;
+Qt::ItemFlags BSAModel::flags( const QModelIndex & index ) const
+{
+	if ( !index.isValid() )
+		return Qt::NoItemFlags;
+
+	return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
+
+void BSAModel::sort( int column, Qt::SortOrder order )
+{
+	if ( column == 1 )
+		column = 0;
+
+	if ( column == sortColumn && order == sortOrder )
+		return;
+
+	emit layoutAboutToBeChanged();
+
+	sortColumn = column;
+	sortOrder = order;
+
+	for ( Node & node : nodes ) {
+		if ( node.populated )
+			sortChildren( node );
+	}
+
+	// Node numbers stay, only their rows change
+	QModelIndexList before = persistentIndexList();
+	QModelIndexList after;
+	for ( const QModelIndex & idx : before ) {
+		int n = int( idx.internalId() );
+		after << createIndex( nodes[n].row, idx.column(), quintptr( n ) );
+	}
+	changePersistentIndexList( before, after );
 
-	return leftString < rightString;
+	emit layoutChanged();
 }
@@ -35,8 +35,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "fsengine.h"
 
-#include <QStandardItemModel>
-#include <QSortFilterProxyModel>
+#include <QAbstractItemModel>
 
 #include <QDebug>
 #include <QDir>
@@ -45,6 +44,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QHash>
 #include <QMutex>
 
+#include <functional>
 #include <memory>
 
 using namespace std;
@@ -220,8 +220,21 @@ struct F4Tex
 };
 
 
-class BSAModel;
-class BSAProxyModel;
+//! A stored or compressed run of data in an archive, of which files are made up
+struct BSAPiece
+{
+	enum Codec
+	{
+		Stored, //!< Not compressed
+		Zlib,   //!< zlib or gzip stream
+		LZ4     //!< LZ4 frames
+	} codec = Stored;
+
+	quint64 offset = 0; //!< Offset of the data in the archive
+	quint32 packedSize = 0; //!< Size of the data in the archive
+	quint32 unpackedSize = 0; //!< Size of the data once decompressed
+};
+
 
 //! \file bsa.h BSA file, BSAIterator
 
@@ -262,6 +275,9 @@ public:
 	qint64 fileSize( const QString & ) const override final;
 	//! Returns the contents of the specified file
 	/*!
+	* Safe to call from several threads at once; each call decompresses
+	* with its own context straight from the mapped archive.
+	*
 	* \param fn The filename to get the contents for
 	* \param content Reference to the byte array that holds the file contents
 	* \return True if successful
@@ -310,39 +326,56 @@ public:
 		//! Constructor
 		BSAFolder() : parent( 0 ) {}
 		//! Destructor
-		~BSAFolder() { qDeleteAll( children ); qDeleteAll( files ); }
+		~BSAFolder() { qDeleteAll( children ); }
 
 		QString name;
 		BSAFolder * parent; //!< The parent item
 		QHash<QString, BSAFolder*> children; //!< A map of child folders
-		QHash<QString, BSAFile*> files; //!< A map of files inside the folder
+		QHash<QString, BSAFile*> files; //!< A map of files inside the folder, owned by BSA::records
 	};
 	
 	//! Recursive function to generate the tree structure of folders inside a %BSA
 	BSAFolder * insertFolder( QString name );
-	//! Inserts a file into the structure of a %BSA
-	BSAFile * insertFile( BSAFolder * folder, QString name, quint32 sizeFlags, quint32 offset );
-
-	BSAFile * insertFile( BSAFolder * folder, QString name, quint32 packed, quint32 unpacked, quint64 offset, F4Tex dds = F4Tex() );
 	
 	//! Gets the specified folder, or the root folder if not found
 	const BSAFolder * getFolder( QString fn ) const;
 	//! Gets the specified file, or null if not found
 	const BSAFile * getFile( QString fn ) const;
 
-	bool scan( const BSA::BSAFolder *, QStandardItem *, QString );
-	bool fillModel( BSAModel *, const QString & );
-
 protected:
-	
+	//! Gets raw bytes of the archive, pointing into the mapping when there is one
+	QByteArray rawData( quint64 offset, qint64 size );
+
+	//! Gets the DDS header and the stored or compressed pieces making up a file
+	bool filePieces( const BSAFile * file, QByteArray & header, QVector<BSAPiece> & pieces );
+	//! Decompresses a piece into a buffer of its unpacked size
+	bool unpackPiece( const BSAPiece & piece, char * dst );
+
+	//! Reads the file records and their paths from the archive directory
+	void readDirectory( QVector<QString> & paths );
+
+	//! Path of the cached index of this archive
+	QString indexPath() const;
+	//! Loads the file records from the cached index, false if it is missing or stale
+	bool loadIndex( QVector<QString> & paths );
+	//! Saves the file records to the cached index
+	void saveIndex( const QVector<QString> & paths ) const;
+
+	//! Builds the folder tree from the file hash on first use
+	void buildFolders() const;
+
 	//! The %BSA file
 	QFile bsa;
+	//! The mapped %BSA file, or null if it could not be mapped
+	uchar * mapped = nullptr;
+	//! The size of the %BSA file
+	qint64 archiveSize = 0;
 	//! File info for the %BSA
 	QFileInfo bsaInfo;
 
 	quint32 version = 0;
 
-	//! Mutual exclusion handler
+	//! Guards the file cursor when the archive is not mapped
 	QMutex bsaMutex;
 	
 	//! The absolute name of the file, e.g. "d:/temp/test.bsa"
@@ -356,13 +389,22 @@ protected:
 	QHash<QString, BSAFolder *> folders;
 	//! The root folder
 	BSAFolder * root;
-
-	//! Map of files inside a %BSA
+	//! Guards building the folder tree
+	mutable QMutex folderMutex;
+	//! Whether the folder tree has been built
+	mutable bool foldersBuilt = false;
+
+	//! The files inside a %BSA, in archive order
+	QVector<BSAFile> records;
+	//! Map of normalised full paths to files inside a %BSA
 	QHash<QString, BSAFile *> files;
 	
 	//! Error string for exception handling
 	QString status;
 
+	friend class BSAReader;
+	friend class BSAModel;
+
 	qint64 numFiles = 0;
 	int filesScanned = 0;
 	
@@ -373,40 +415,94 @@ protected:
 };
 
 
-class BSAModel : public QStandardItemModel
+//! The files of a %BSA as a tree, created lazily as folders are expanded
+/*!
+ * Only a sorted list of paths is kept; rows are made the first time their
+ * parent is asked for them. Filtering narrows the candidates with trigram
+ * indexes over the file names and folder paths before matching the pattern.
+ */
+class BSAModel final : public QAbstractItemModel
 {
 	Q_OBJECT
 
 public:
 	BSAModel( QObject * parent = nullptr );
 
-	void init();
-
+	//! Lists the files below a folder of the archive which have one of the given extensions
+	void setArchive( const BSA * bsa, const QString & folder, const QStringList & filetypes );
+	//! Removes all files
+	void clear();
+
+	//! Shows only the files whose path, or name only, contains the wildcard pattern
+	void setFilter( const QString & pattern, bool nameOnly );
+	//! Number of files listed, whether shown or not
+	int fileCount() const { return paths.count(); }
+	//! Number of files shown with the current filter
+	int matchCount() const { return visible.count(); }
+
+	QModelIndex index( int row, int column, const QModelIndex & parent = QModelIndex() ) const override;
+	QModelIndex parent( const QModelIndex & child ) const override;
+	int rowCount( const QModelIndex & parent = QModelIndex() ) const override;
+	int columnCount( const QModelIndex & parent = QModelIndex() ) const override;
+	bool hasChildren( const QModelIndex & parent = QModelIndex() ) const override;
+	QVariant data( const QModelIndex & index, int role = Qt::DisplayRole ) const override;
+	QVariant headerData( int section, Qt::Orientation orientation, int role = Qt::DisplayRole ) const override;
 	Qt::ItemFlags flags( const QModelIndex & index ) const override;
-};
+	void sort( int column, Qt::SortOrder order = Qt::AscendingOrder ) override;
 
+private:
+	//! Lists of items per trigram of their text
+	struct TrigramIndex
+	{
+		QVector<int> offsets; //!< Start of the postings of each trigram
+		QVector<int> postings; //!< Item numbers, ascending per trigram
 
-class BSAProxyModel : public QSortFilterProxyModel
-{
-	Q_OBJECT
+		void build( int count, const std::function<QStringRef( int )> & text );
+		void clear();
+	};
 
-public:
-	BSAProxyModel( QObject * parent = nullptr );
+	//! A folder or file row
+	struct Node
+	{
+		int parent = -1; //!< Node number of the parent, -1 for the root
+		int row = 0; //!< Row below the parent
+		int file = -1; //!< File number, -1 for folders
+		QString name; //!< Folder name
+		int begin = 0; //!< First visible file below the folder
+		int end = 0; //!< End of the visible files below the folder
+		int prefixLength = 0; //!< Length of the folder path including the trailing slash
+		bool populated = false; //!< Whether the children have been made
+		QVector<int> children;
+	};
 
-	void setFiletypes( QStringList types );
+	//! Makes the children of a folder node
+	void populate( int node ) const;
+	//! Orders the children of a folder node
+	void sortChildren( Node & node ) const;
+	//! Name of a node as displayed
+	QStringRef nodeName( const Node & node ) const;
 
-	void resetFilter();
+	//! Updates the visible files and resets the rows
+	void applyFilter();
 
-public slots:
-	void setFilterByNameOnly( bool nameOnly );
+	QVector<QString> paths; //!< Sorted normalised paths of the files
+	QVector<quint32> sizes; //!< Sizes of the files
+	QVector<int> nameStart; //!< Start of the file name in each path
+	QVector<int> fileFolder; //!< Folder number of each file
+	QVector<QString> folderPaths; //!< Paths of the folders containing files
 
-protected:
-	bool filterAcceptsRow( int sourceRow, const QModelIndex & sourceParent ) const;
-	bool lessThan( const QModelIndex & left, const QModelIndex & right ) const;
+	TrigramIndex nameIndex;
+	TrigramIndex folderIndex;
 
-private:
-	QStringList filetypes;
+	QString rootPrefix; //!< Path of the listed folder including the trailing slash
+	QVector<int> visible; //!< Files matching the filter, ascending
+	mutable QVector<Node> nodes; //!< Rows made so far, the root first
+
+	QString filterPattern;
 	bool filterByNameOnly = false;
+
+	int sortColumn = 0;
+	Qt::SortOrder sortOrder = Qt::AscendingOrder;
 };
 
 #endif
@@ -42,6 +42,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QPushButton>
 #include <QSettings>
 #include <QStringListModel>
+#include <QtConcurrent/QtConcurrentMap>
 
 
 //! Global BSA file manager
@@ -63,18 +64,18 @@ void FSManager::del()
 }
 
 // see fsmanager.h
-QList <FSArchiveFile *> FSManager::archiveList()
+QList<std::shared_ptr<FSArchiveHandler>> FSManager::archiveList()
 {
-	QList<FSArchiveFile *> archives;
-	for ( std::shared_ptr<FSArchiveHandler> an : get()->archives.values() ) {
-		archives.append( an->getArchive() );
-	}
-	return archives;
+	FSManager * manager = get();
+	QMutexLocker lock( &manager->archivesMutex );
+	manager->waitForArchives();
+
+	return manager->archives.values();
 }
 
 // see fsmanager.h
 FSManager::FSManager( QObject * parent )
-	: QObject( parent ), automatic( false )
+	: QObject( parent ), automatic( false ), archivesMutex( QMutex::Recursive )
 {
 	initialize();
 }
@@ -82,18 +83,41 @@ FSManager::FSManager( QObject * parent )
 // see fsmanager.h
 FSManager::~FSManager()
 {
+	pending.waitForFinished();
 	archives.clear();
 }
 
+// see fsmanager.h
 void FSManager::initialize()
 {
+	QMutexLocker lock( &archivesMutex );
+	waitForArchives();
+
 	QSettings cfg;
-	QStringList list = cfg.value( "Settings/Resources/Archives", QStringList() ).toStringList();
+	pendingList = cfg.value( "Settings/Resources/Archives", QStringList() ).toStringList();
+
+	// Most of the work is reading archive directories, so open them concurrently,
+	// without holding up startup; they are first needed when looking up a file
+	pending = QtConcurrent::mapped( pendingList, &FSArchiveHandler::openArchive );
+}
 
-	for ( const QString an : list ) {
-		if ( auto a = FSArchiveHandler::openArchive( an ) )
-			archives.insert( an, a );
+// see fsmanager.h
+void FSManager::waitForArchives()
+{
+	QMutexLocker lock( &archivesMutex );
+
+	if ( pendingList.isEmpty() )
+		return;
+
+	pending.waitForFinished();
+
+	for ( int i = 0; i < pendingList.count(); i++ ) {
+		if ( auto a = pending.resultAt( i ) )
+			archives.insert( pendingList.at( i ), a );
 	}
+
+	pending = QFuture<std::shared_ptr<FSArchiveHandler>>();
+	pendingList.clear();
 }
 
 // see fsmanager.h
@@ -36,8 +36,11 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
 #include <QDialog>
+#include <QFuture>
 #include <QObject>
 #include <QMap>
+#include <QMutex>
+#include <QStringList>
 
 #include <memory>
 
@@ -56,7 +59,11 @@ public:
 	static void del();
 
 	//! Gets the list of globally registered BSA files
-	static QList<FSArchiveFile *> archiveList();
+	/*!
+	 * The handlers keep their archives open while the caller holds them,
+	 * even if the settings replace the registered archives meanwhile.
+	 */
+	static QList<std::shared_ptr<FSArchiveHandler>> archiveList();
 
 	//! Filters a list of BSAs from a provided list
 	static QStringList filterArchives( const QStringList & list, const QString & folder = "" );
@@ -70,13 +77,23 @@ protected:
 protected:
 	QMap<QString, std::shared_ptr<FSArchiveHandler> > archives;
 	bool automatic;
+
+	//! Archives still being opened in the background by initialize()
+	QFuture<std::shared_ptr<FSArchiveHandler>> pending;
+	//! The paths of the pending archives
+	QStringList pendingList;
+	//! Guards archives, pending and pendingList; recursive so that holders can call waitForArchives()
+	QMutex archivesMutex;
 	
 	//! Builds a list of global BSAs on Windows platforms
 	static QStringList autodetectArchives( const QString & folder = "" );
 	//! Helper function to build a list of BSAs
 	static QStringList regPathBSAList( QString regKey, QString dataDir );
 
+	//! Starts opening the archives from the settings in the background
 	void initialize();
+	//! Waits for initialize() to finish and registers its archives
+	void waitForArchives();
 	
 	friend class NifSkope;
 	friend class SettingsResources;
@@ -44,6 +44,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 //! @file nifitem.h NifItem, NifBlock, NifData, NifSharedData
 
+class NifData;
+
 /*! Shared data for NifData.
  *
  * @see QSharedDataPointer
@@ -51,6 +53,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 class NifSharedData final : public QSharedData
 {
 	friend class NifData;
+	friend QDataStream & operator<<( QDataStream & ds, const NifData & d );
+	friend QDataStream & operator>>( QDataStream & ds, NifData & d );
 
 public:
 	enum DataFlag
@@ -114,6 +118,8 @@ private:
 	QString vercond;
 	//! Version condition as an expression.
 	NifExpr verexpr;
+	//! Default value.
+	QString defval;
 
 	DataFlags flags = None;
 };
@@ -164,6 +170,8 @@ public:
 	inline const QString & vercond() const { return d->vercond; }
 	//! Get the version condition attribute of the data, as an expression.
 	inline const NifExpr & verexpr() const { return d->verexpr; }
+	//! Get the default value attribute of the data.
+	inline const QString & defval() const { return d->defval; }
 	//! Get the abstract attribute of the data.
 	inline bool isAbstract() const { return d->flags & NifSharedData::Abstract; }
 	//! Is the data binary. Binary means the data is being treated as one blob.
@@ -215,6 +223,23 @@ public:
 		d->vercond = cond;
 		d->verexpr = NifExpr( cond );
 	}
+	//! Sets the default value attribute of the data, and the value from it.
+	void setDefault( const QString & defval )
+	{
+		d->defval = defval;
+
+		if ( defval.isEmpty() )
+			return;
+
+		bool ok;
+		quint32 enumVal = NifValue::enumOptionValue( d->type, defval, &ok );
+
+		if ( ok ) {
+			value.setCount( enumVal );
+		} else {
+			value.setFromString( defval );
+		}
+	}
 
 	inline void setFlag( NifSharedData::DataFlags flag, bool val )
 	{
@@ -237,6 +262,10 @@ public:
 	//! Sets the mixin data flag. Mixin is a specialized compound which creates no nesting.
 	inline void setIsMixin( bool flag ) { setFlag( NifSharedData::Mixin, flag ); }
 
+	//! Write the data with its compiled expressions, see schemacache.cpp
+	friend QDataStream & operator<<( QDataStream & ds, const NifData & d );
+	friend QDataStream & operator>>( QDataStream & ds, NifData & d );
+
 protected:
 	//! The internal shared data.
 	QSharedDataPointer<NifSharedData> d;
@@ -34,6 +34,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "model/nifmodel.h"
 
+#include <QDataStream>
+#include <QMutex>
 #include <QRegularExpression>
 #include <QSettings>
 
@@ -48,6 +50,16 @@ QHash<QString, QString>               NifValue::aliasMap;
 
 static int OPT_PER_LINE = -1;
 
+//! Enum values below this are also stored in EnumOptions::names for direct lookup
+static const quint32 ENUM_TABLE_SIZE = 1024;
+
+//! Payloads smaller than this are not worth pooling
+static const int SHARED_MIN_SIZE = 1024;
+
+//! Pool of binary payloads shared between all models, keyed by content hash
+static QMultiHash<uint, QByteArray> sharedData;
+static QMutex sharedMutex;
+
 /*
  *  NifValue
  */
@@ -188,14 +200,63 @@ bool NifValue::registerAlias( const QString & alias, const QString & original )
 	return false;
 }
 
+void NifValue::writeTypes( QDataStream & ds )
+{
+	ds << quint32( typeMap.count() );
+	for ( auto it = typeMap.constBegin(); it != typeMap.constEnd(); ++it )
+		ds << it.key() << quint32( it.value() );
+
+	ds << quint32( enumMap.count() );
+	for ( auto it = enumMap.constBegin(); it != enumMap.constEnd(); ++it )
+		ds << it.key() << quint32( it.value().t ) << it.value().o << it.value().names;
+
+	ds << typeTxt << aliasMap;
+}
+
+void NifValue::readTypes( QDataStream & ds )
+{
+	typeMap.clear();
+	enumMap.clear();
+
+	quint32 count, t;
+	QString id;
+
+	ds >> count;
+	typeMap.reserve( count );
+	for ( quint32 i = 0; i < count && ds.status() == QDataStream::Ok; i++ ) {
+		ds >> id >> t;
+		typeMap.insert( id, Type( t ) );
+	}
+
+	ds >> count;
+	enumMap.reserve( count );
+	for ( quint32 i = 0; i < count && ds.status() == QDataStream::Ok; i++ ) {
+		ds >> id >> t;
+		EnumOptions & eo = enumMap[id];
+		eo.t = EnumType( t );
+		ds >> eo.o >> eo.names;
+	}
+
+	ds >> typeTxt >> aliasMap;
+}
+
 bool NifValue::registerEnumOption( const QString & eid, const QString & oid, quint32 oval, const QString & otxt )
 {
-	QMap<quint32, QPair<QString, QString> > & e = enumMap[eid].o;
+	EnumOptions & eo = enumMap[eid];
+	QMap<quint32, QPair<QString, QString> > & e = eo.o;
 
 	if ( e.contains( oval ) )
 		return false;
 
 	e[oval] = QPair<QString, QString>( oid, otxt );
+
+	if ( oval < ENUM_TABLE_SIZE ) {
+		if ( eo.names.size() <= int(oval) )
+			eo.names.resize( oval + 1 );
+
+		eo.names[oval] = oid;
+	}
+
 	return true;
 }
 
@@ -231,8 +292,9 @@ NifValue::EnumType NifValue::enumType( const QString & eid )
 
 QString NifValue::enumOptionName( const QString & eid, quint32 val )
 {
-	if ( enumMap.contains( eid ) ) {
-		NifValue::EnumOptions & eo = enumMap[eid];
+	auto eit = enumMap.constFind( eid );
+	if ( eit != enumMap.constEnd() ) {
+		const NifValue::EnumOptions & eo = eit.value();
 
 		if ( eo.t == NifValue::eFlags ) {
 			QString text;
@@ -244,23 +306,22 @@ QString NifValue::enumOptionName( const QString & eid, quint32 val )
 			}
 
 			int opt = 0;
-			auto it = eo.o.constBegin();
-			while ( it != eo.o.constEnd() ) {
-				if ( val & ( 1 << it.key() ) ) {
-					val2 |= ( 1 << it.key() ); 
+			int bits = qMin( eo.names.size(), 32 );
+			for ( int bit = 0; bit < bits; bit++ ) {
+				if ( !( val & ( 1u << bit ) ) || eo.names[bit].isNull() )
+					continue;
 
-					if ( !text.isEmpty() )
-						text += " | ";
+				val2 |= ( 1u << bit );
 
-					if ( it != eo.o.constEnd() && opt != 0 && opt % OPT_PER_LINE == 0 )
-						text += "\n";
+				if ( !text.isEmpty() )
+					text += " | ";
 
-					text += it.value().first;
+				if ( opt != 0 && opt % OPT_PER_LINE == 0 )
+					text += "\n";
 
-					opt++;
-				}
+				text += eo.names[bit];
 
-				it++;
+				opt++;
 			}
 
 			// Append any leftover value not covered by enums
@@ -274,8 +335,14 @@ QString NifValue::enumOptionName( const QString & eid, quint32 val )
 
 			return text;
 		} else if ( eo.t == NifValue::eDefault ) {
-			if ( eo.o.contains( val ) )
-				return eo.o.value( val ).first;
+			if ( val < quint32(eo.names.size()) ) {
+				if ( !eo.names[val].isNull() )
+					return eo.names[val];
+			} else {
+				auto it = eo.o.constFind( val );
+				if ( it != eo.o.constEnd() )
+					return it.value().first;
+			}
 		}
 
 		return QString::number( val );
@@ -351,6 +418,35 @@ const NifValue::EnumOptions & NifValue::enumOptionData( const QString & eid )
 	return enumMap[eid];
 }
 
+QByteArray NifValue::share( const QByteArray & data )
+{
+	if ( data.size() < SHARED_MIN_SIZE )
+		return data;
+
+	uint h = qHash( data );
+
+	QMutexLocker lock( &sharedMutex );
+	for ( auto it = sharedData.constFind( h ); it != sharedData.constEnd() && it.key() == h; ++it ) {
+		if ( it.value().isSharedWith( data ) || it.value() == data )
+			return it.value();
+	}
+
+	sharedData.insert( h, data );
+	return data;
+}
+
+void NifValue::purgeShared()
+{
+	QMutexLocker lock( &sharedMutex );
+	for ( auto it = sharedData.begin(); it != sharedData.end(); ) {
+		// Only the pool itself still holds this buffer
+		if ( it.value().isDetached() )
+			it = sharedData.erase( it );
+		else
+			++it;
+	}
+}
+
 void NifValue::clear()
 {
 	switch ( typ ) {
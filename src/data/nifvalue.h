@@ -40,6 +40,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QPair>
 #include <QString>
 #include <QVariant>
+#include <QVector>
 
 
 //! @file nifvalue.h NifValue
@@ -194,11 +195,17 @@ public:
 	 */
 	static bool registerAlias( const QString & alias, const QString & internal );
 
+	//! Write the type, alias and enumeration dictionaries built from the xml.
+	static void writeTypes( QDataStream & ds );
+	//! Replace the type, alias and enumeration dictionaries with ones written by writeTypes().
+	static void readTypes( QDataStream & ds );
+
 	//! A struct holding information about a enumeration
 	struct EnumOptions
 	{
 		EnumType t;                                 //!< The enumeration type
 		QMap<quint32, QPair<QString, QString> > o;  //!< The enumeration dictionary as a value, a name and a description
+		QVector<QString> names;                     //!< The option names indexed by value (or bit for flags), for small values
 	};
 
 	//! Register an enum type.
@@ -234,6 +241,20 @@ public:
 	//! Get list of all options that have been registered for the given enum type.
 	static const EnumOptions & enumOptionData( const QString & eid );
 
+	/*! Get a shared copy of a binary payload.
+	 *
+	 * Large byte arrays are pooled by content, so identical data loaded into
+	 * several models (or pasted between them) shares one buffer.
+	 * QByteArray detaches on write, so editing one copy never affects another.
+	 *
+	 * Only ByteArray, StringPalette and Blob values of at least 1 KB are pooled.
+	 * Blocks themselves are not shared: every element of a compound or array,
+	 * such as a vertex or triangle, is its own NifItem owned by one model.
+	 */
+	static QByteArray share( const QByteArray & data );
+	//! Release pooled payloads which are no longer used by any value.
+	static void purgeShared();
+
 
 	//! Check if the type is not tNone.
 	static bool isValid( Type t ) { return t != tNone; }
@@ -97,8 +97,8 @@ void BSShape::update( const NifModel * nif, const QModelIndex & index )
 		if ( !iVertData.isValid() || !iTriData.isValid() )
 			return;
 
-		numVerts = std::min( nif->get<int>( iBlock, "Num Vertices" ), nif->rowCount( iVertData ) );
-		numTris = std::min( nif->get<int>( iBlock, "Num Triangles" ), nif->rowCount( iTriData ) );
+		numVerts = std::min( nif->get<int>( iBlock, "Num Vertices" ), nif->childCount( iVertData ) );
+		numTris = std::min( nif->get<int>( iBlock, "Num Triangles" ), nif->childCount( iTriData ) );
 
 		dataSize = nif->get<int>( iBlock, "Data Size" );
 	} else {
@@ -180,7 +180,7 @@ void BSShape::update( const NifModel * nif, const QModelIndex & index )
 			triangles = triangles.mid( 0, numTris );
 		} else {
 			auto partIdx = nif->getIndex( iSkinPart, "Partition" );
-			for ( int i = 0; i < nif->rowCount( partIdx ); i++ )
+			for ( int i = 0; i < nif->childCount( partIdx ); i++ )
 				triangles << nif->getArray<Triangle>( nif->index( i, 0, partIdx ), "Triangles" );
 		}
 	}
@@ -618,14 +618,14 @@ void BSShape::drawSelection() const
 			idxs += idx;
 		} else if ( n.startsWith( "BSPackedCombined" ) ) {
 			auto data = nif->getIndex( idx, "Object Data" );
-			int dataCt = nif->rowCount( data );
+			int dataCt = nif->childCount( data );
 
 			for ( int i = 0; i < dataCt; i++ ) {
 				auto d = data.child( i, 0 );
 
 				int numC = nif->get<int>( d, "Num Combined" );
 				auto c = nif->getIndex( d, "Combined" );
-				int cCt = nif->rowCount( c );
+				int cCt = nif->childCount( c );
 
 				for ( int j = 0; j < cCt; j++ ) {
 					idxs += nif->getIndex( c.child( j, 0 ), "Bounding Sphere" );
@@ -792,7 +792,7 @@ void BSShape::drawSelection() const
 
 		int loopNum = 1;
 		if ( isSegmentArray )
-			loopNum = nif->rowCount( idx );
+			loopNum = nif->childCount( idx );
 
 		for ( int l = 0; l < loopNum; l++ ) {
 
@@ -858,7 +858,7 @@ void BSShape::drawSelection() const
 		// Get shape block
 		if ( nif->getBlock( nif->getParent( nif->getParent( blk ) ) ) == iBlock ) {
 			auto iBones = nif->getIndex( blk, "Bone List" );
-			int ct = nif->rowCount( iBones );
+			int ct = nif->childCount( iBones );
 
 			for ( int i = 0; i < ct; i++ ) {
 				auto b = iBones.child( i, 0 );
@@ -872,7 +872,7 @@ void BSShape::drawSelection() const
 	// Draw bone bounding sphere
 	if ( n == "Bone List" ) {
 		if ( nif->isArray( idx ) ) {
-			for ( int i = 0; i < nif->rowCount( idx ); i++ )
+			for ( int i = 0; i < nif->childCount( idx ); i++ )
 				boneSphere( nif, idx.child( i, 0 ) );
 		} else {
 			boneSphere( nif, idx );
@@ -67,7 +67,7 @@ bool ControllerManager::update( const NifModel * nif, const QModelIndex & index
 						QModelIndex iKeys = nif->getBlock( nif->getLink( iSeq, "Text Keys" ), "NiTextKeyExtraData" );
 						QModelIndex iTags = nif->getIndex( iKeys, "Text Keys" );
 
-						for ( int r = 0; r < nif->rowCount( iTags ); r++ ) {
+						for ( int r = 0; r < nif->childCount( iTags ); r++ ) {
 							tags.insert( nif->get<QString>( iTags.child( r, 0 ), "Value" ), nif->get<float>( iTags.child( r, 0 ), "Time" ) );
 						}
 
@@ -108,7 +108,7 @@ void ControllerManager::setSequence( const QString & seqname )
 
 				QModelIndex iCtrlBlcks = nif->getIndex( iSeq, "Controlled Blocks" );
 
-				for ( int r = 0; r < nif->rowCount( iCtrlBlcks ); r++ ) {
+				for ( int r = 0; r < nif->childCount( iCtrlBlcks ); r++ ) {
 					QModelIndex iCB = iCtrlBlcks.child( r, 0 );
 
 					QModelIndex iInterp = nif->getBlock( nif->getLink( iCB, "Interpolator" ), "NiInterpolator" );
@@ -446,7 +446,7 @@ bool MorphController::update( const NifModel * nif, const QModelIndex & index )
 
 		QModelIndex midx = nif->getIndex( iData, "Morphs" );
 
-		for ( int r = 0; r < nif->rowCount( midx ); r++ ) {
+		for ( int r = 0; r < nif->childCount( midx ); r++ ) {
 			QModelIndex iInterpolators, iInterpolatorWeights;
 
 			if ( nif->checkVersion( 0, 0x14000005 ) ) {
@@ -502,7 +502,7 @@ void UVController::updateTime( float time )
 	float val[4] = { 0.0, 0.0, 1.0, 1.0 };
 
 	if ( uvGroups.isValid() ) {
-		for ( int i = 0; i < 4 && i < nif->rowCount( uvGroups ); i++ ) {
+		for ( int i = 0; i < 4 && i < nif->childCount( uvGroups ); i++ ) {
 			interpolate( val[i], uvGroups.child( i, 0 ), ctrlTime( time ), luv );
 		}
 
@@ -596,7 +596,7 @@ bool ParticleController::update( const NifModel * nif, const QModelIndex & index
 			//iParticles = nif->getIndex( iParticles, "Particles" );
 			//if ( iParticles.isValid() )
 			//{
-			for ( int p = 0; p < numValid && p < nif->rowCount( iParticles ); p++ ) {
+			for ( int p = 0; p < numValid && p < nif->childCount( iParticles ); p++ ) {
 				Particle particle;
 				particle.velocity = nif->get<Vector3>( iParticles.child( p, 0 ), "Velocity" );
 				particle.lifetime = nif->get<float>( iParticles.child( p, 0 ), "Lifetime" );
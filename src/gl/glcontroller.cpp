@@ -295,7 +295,7 @@ bool Controller::timeIndex( float time, const NifModel * nif, const QModelIndex
 {
 	int count;
 
-	if ( array.isValid() && ( count = nif->rowCount( array ) ) > 0 ) {
+	if ( array.isValid() && ( count = nif->childCount( array ) ) > 0 ) {
 		if ( time <= nif->get<float>( array.child( 0, 0 ), "Time" ) ) {
 			i = j = 0;
 			x = 0.0;
@@ -476,7 +476,7 @@ template <> bool Controller::interpolate( Matrix & value, const QModelIndex & ar
 				if ( subkeys.isValid() ) {
 					float r[3] = {};
 
-					for ( int s = 0; s < 3 && s < nif->rowCount( subkeys ); s++ ) {
+					for ( int s = 0; s < 3 && s < nif->childCount( subkeys ); s++ ) {
 						r[s] = 0;
 						interpolate( r[s], subkeys.child( s, 0 ), time, last );
 					}
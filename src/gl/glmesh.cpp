@@ -233,7 +233,7 @@ void Mesh::update( const NifModel * nif, const QModelIndex & index )
 			qDebug() << nif->get<ushort>( iBlock, "Num Submeshes" ) << " submeshes";
 			iData = nif->getIndex( iBlock, "Datastreams" );
 			if ( iData.isValid() ) {
-				qDebug() << "Got " << nif->rowCount( iData ) << " rows of data";
+				qDebug() << "Got " << nif->childCount( iData ) << " rows of data";
 				updateData = true;
 				updateBounds = true;
 			} else {
@@ -335,7 +335,7 @@ void Mesh::transform()
 			// and build the semantic-index maps for each datastream's components
 			using CompSemIdxMap = QVector<QPair<NiMesh::Semantic, uint>>;
 			QVector<CompSemIdxMap> compSemanticIndexMaps;
-			for ( int i = 0; i < nif->rowCount( iData ); i++ ) {
+			for ( int i = 0; i < nif->childCount( iData ); i++ ) {
 				auto stream = nif->getLink( iData.child( i, 0 ), "Stream" );
 				auto iDataStream = nif->getBlock( stream );
 
@@ -390,7 +390,7 @@ void Mesh::transform()
 			quint32 maxIndex = 0;
 			// The Nth component after ignoring DataStreamUsage > 1
 			int compIdx = 0;
-			for ( int i = 0; i < nif->rowCount( iData ); i++ ) {
+			for ( int i = 0; i < nif->childCount( iData ); i++ ) {
 				// TODO: For now, submeshes are not actually used and the regions are 
 				// filled in order for each data stream.
 				// Submeshes may be required if total index values exceed USHRT_MAX
@@ -685,7 +685,7 @@ void Mesh::transform()
 				uvcoord = nif->getIndex( iData, "UV Sets 2" );
 
 			if ( uvcoord.isValid() ) {
-				for ( int r = 0; r < nif->rowCount( uvcoord ); r++ ) {
+				for ( int r = 0; r < nif->childCount( uvcoord ); r++ ) {
 					TexCoords tc = nif->getArray<Vector2>( uvcoord.child( r, 0 ) );
 
 					if ( tc.count() < verts.count() )
@@ -734,7 +734,7 @@ void Mesh::transform()
 				QModelIndex points = nif->getIndex( iData, "Points" );
 
 				if ( points.isValid() ) {
-					for ( int r = 0; r < nif->rowCount( points ); r++ )
+					for ( int r = 0; r < nif->childCount( points ); r++ )
 						tristrips.append( nif->getArray<quint16>( points.child( r, 0 ) ) );
 				} else {
 					Message::append( tr( "Warnings were generated while rendering mesh." ),
@@ -753,7 +753,7 @@ void Mesh::transform()
 			QModelIndex iExtraData = nif->getIndex( iBlock, "Extra Data List" );
 
 			if ( iExtraData.isValid() ) {
-				for ( int e = 0; e < nif->rowCount( iExtraData ); e++ ) {
+				for ( int e = 0; e < nif->childCount( iExtraData ); e++ ) {
 					QModelIndex iExtra = nif->getBlock( nif->getLink( iExtraData.child( e, 0 ) ), "NiBinaryExtraData" );
 
 					if ( nif->get<QString>( iExtra, "Name" ) == "Tangent space (binormal & tangent vectors)" ) {
@@ -800,7 +800,7 @@ void Mesh::transform()
 			// Ignore weights listed in NiSkinData if NiSkinPartition exists
 			hvw = hvw && !iSkinPart.isValid();
 			int vcnt = hvw ? verts.count() : 0;
-			for ( int b = 0; b < nif->rowCount( idxBones ) && b < bones.count(); b++ ) {
+			for ( int b = 0; b < nif->childCount( idxBones ) && b < bones.count(); b++ ) {
 				weights.append( BoneWeights( nif, idxBones.child( b, 0 ), bones[ b ], vcnt ) );
 			}
 		}
@@ -810,7 +810,7 @@ void Mesh::transform()
 
 			uint numTris = 0;
 			uint numStrips = 0;
-			for ( int i = 0; i < nif->rowCount( idx ) && idx.isValid(); i++ ) {
+			for ( int i = 0; i < nif->childCount( idx ) && idx.isValid(); i++ ) {
 				partitions.append( SkinPartition( nif, idx.child( i, 0 ) ) );
 				numTris += partitions[i].triangles.size();
 				numStrips += partitions[i].tristrips.size();
@@ -1250,10 +1250,10 @@ void Mesh::drawSelection() const
 		QModelIndex points = nif->getIndex( iData, "Points" );
 
 		if ( points.isValid() ) {
-			for ( int j = 0; j < nif->rowCount( points ); j++ ) {
+			for ( int j = 0; j < nif->childCount( points ); j++ ) {
 				QModelIndex iPoints = points.child( j, 0 );
 
-				for ( int k = 0; k < nif->rowCount( iPoints ); k++ ) {
+				for ( int k = 0; k < nif->childCount( iPoints ); k++ ) {
 					glVertex( transVerts.value( nif->get<quint16>( iPoints.child( k, 0 ) ) ) );
 				}
 			}
@@ -1268,7 +1268,7 @@ void Mesh::drawSelection() const
 			QModelIndex iPoints = points.child( i, 0 );
 
 			if ( nif->isArray( idx ) ) {
-				for ( int j = 0; j < nif->rowCount( iPoints ); j++ ) {
+				for ( int j = 0; j < nif->childCount( iPoints ); j++ ) {
 					glVertex( transVerts.value( nif->get<quint16>( iPoints.child( j, 0 ) ) ) );
 				}
 			} else {
@@ -1500,7 +1500,7 @@ void Mesh::drawSelection() const
 
 	if ( n == "Bone List" ) {
 		if ( nif->isArray( idx ) ) {
-			for ( int i = 0; i < nif->rowCount( idx ); i++ )
+			for ( int i = 0; i < nif->childCount( idx ); i++ )
 				boneSphere( nif, idx.child( i, 0 ) );
 		} else {
 			boneSphere( nif, idx );
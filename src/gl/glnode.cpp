@@ -41,7 +41,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "model/nifmodel.h"
 #include "ui/settingsdialog.h"
 
-#include "lib/nvtristripwrapper.h"
+#include "lib/stripify.h"
 
 #include <QRegularExpression>
 #include <QSettings>
@@ -318,7 +318,7 @@ void Node::update( const NifModel * nif, const QModelIndex & index )
 		QList<qint32> lChildren = nif->getChildLinks( nif->getBlockNumber( iBlock ) );
 
 		if ( iChildren.isValid() ) {
-			for ( int c = 0; c < nif->rowCount( iChildren ); c++ ) {
+			for ( int c = 0; c < nif->childCount( iChildren ); c++ ) {
 				qint32 link = nif->getLink( iChildren.child( c, 0 ) );
 
 				if ( lChildren.contains( link ) ) {
@@ -641,7 +641,7 @@ void Node::drawSelection() const
 			sel = scene->currentIndex.parent().row();
 		}
 
-		int ct = nif->rowCount( cp );
+		int ct = nif->childCount( cp );
 		for ( int i = 0; i < ct; i++ ) {
 			auto p = cp.child( i, 0 );
 
@@ -790,7 +790,7 @@ void drawHvkShape( const NifModel * nif, const QModelIndex & iShape, QStack<QMod
 		QModelIndex iShapes = nif->getIndex( iShape, "Sub Shapes" );
 
 		if ( iShapes.isValid() ) {
-			for ( int r = 0; r < nif->rowCount( iShapes ); r++ ) {
+			for ( int r = 0; r < nif->childCount( iShapes ); r++ ) {
 				if ( !Node::SELECTING ) {
 					if ( scene->currentBlock == nif->getBlock( nif->getLink( iShapes.child( r, 0 ) ) ) ) {
 						// fix: add selected visual to havok meshes
@@ -835,7 +835,7 @@ void drawHvkShape( const NifModel * nif, const QModelIndex & iShape, QStack<QMod
 
 		QModelIndex iSpheres = nif->getIndex( iShape, "Spheres" );
 
-		for ( int r = 0; r < nif->rowCount( iSpheres ); r++ ) {
+		for ( int r = 0; r < nif->childCount( iSpheres ); r++ ) {
 			drawSphere( nif->get<Vector3>( iSpheres.child( r, 0 ), "Center" ), nif->get<float>( iSpheres.child( r, 0 ), "Radius" ) );
 		}
 	} else if ( name == "bhkBoxShape" ) {
@@ -916,7 +916,7 @@ void drawHvkShape( const NifModel * nif, const QModelIndex & iShape, QStack<QMod
 			QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
 			QModelIndex iTris = nif->getIndex( iData, "Triangles" );
 
-			for ( int t = 0; t < nif->rowCount( iTris ); t++ ) {
+			for ( int t = 0; t < nif->childCount( iTris ); t++ ) {
 				Triangle tri = nif->get<Triangle>( iTris.child( t, 0 ), "Triangle" );
 
 				if ( tri[0] != tri[1] || tri[1] != tri[2] || tri[2] != tri[0] ) {
@@ -947,7 +947,7 @@ void drawHvkShape( const NifModel * nif, const QModelIndex & iShape, QStack<QMod
 						glDepthFunc( GL_ALWAYS );
 						glHighlightColor();
 
-						//for ( int t = 0; t < nif->rowCount( iTris ); t++ )
+						//for ( int t = 0; t < nif->childCount( iTris ); t++ )
 						//	DrawTriangleIndex( verts, nif->get<Triangle>( iTris.child( t, 0 ), "Triangle" ), t );
 					} else if ( nif->isCompound( nif->getBlockType( scene->currentIndex ) ) ) {
 						Triangle tri = nif->get<Triangle>( iTris.child( i, 0 ), "Triangle" );
@@ -969,11 +969,11 @@ void drawHvkShape( const NifModel * nif, const QModelIndex & iShape, QStack<QMod
 					int end_vertex = 0;
 					int num_vertices = nif->get<int>( scene->currentIndex, "Num Vertices" );
 
-					int ct = nif->rowCount( iTris );
+					int ct = nif->childCount( iTris );
 					int totalVerts = 0;
 					if ( num_vertices > 0 ) {
 						QModelIndex iParent = scene->currentIndex.parent();
-						int rowCount = nif->rowCount( iParent );
+						int rowCount = nif->childCount( iParent );
 						for ( int j = 0; j < i; j++ ) {
 							totalVerts += nif->get<int>( iParent.child( j, 0 ), "Num Vertices" );
 						}
@@ -984,7 +984,7 @@ void drawHvkShape( const NifModel * nif, const QModelIndex & iShape, QStack<QMod
 						ct = (end_vertex - start_vertex) / 3;
 					}
 
-					for ( int t = 0; t < nif->rowCount( iTris ); t++ ) {
+					for ( int t = 0; t < nif->childCount( iTris ); t++ ) {
 						Triangle tri = nif->get<Triangle>( iTris.child( t, 0 ), "Triangle" );
 
 						if ( (start_vertex <= tri[0]) && (tri[0] < end_vertex) ) {
@@ -1019,7 +1019,7 @@ void drawHvkShape( const NifModel * nif, const QModelIndex & iShape, QStack<QMod
 					int start_vertex = 0;
 					int end_vertex = 0;
 
-					for ( int subshape = 0; subshape < nif->rowCount( iSubShapes ); subshape++ ) {
+					for ( int subshape = 0; subshape < nif->childCount( iSubShapes ); subshape++ ) {
 						QModelIndex iCurrentSubShape = iSubShapes.child( subshape, 0 );
 						int num_vertices = nif->get<int>( iCurrentSubShape, "Num Vertices" );
 						//qDebug() << num_vertices;
@@ -1033,7 +1033,7 @@ void drawHvkShape( const NifModel * nif, const QModelIndex & iShape, QStack<QMod
 					}
 
 					// highlight the triangles of the subshape
-					for ( int t = 0; t < nif->rowCount( iTris ); t++ ) {
+					for ( int t = 0; t < nif->childCount( iTris ); t++ ) {
 						Triangle tri = nif->get<Triangle>( iTris.child( t, 0 ), "Triangle" );
 
 						if ( (start_vertex <= tri[0]) && (tri[0] < end_vertex) ) {
@@ -1089,7 +1089,7 @@ void drawHvkConstraint( const NifModel * nif, const QModelIndex & iConstraint, c
 		return;
 	}
 
-	for ( int r = 0; r < nif->rowCount( iBodies ); r++ ) {
+	for ( int r = 0; r < nif->childCount( iBodies ); r++ ) {
 		qint32 l = nif->getLink( iBodies.child( r, 0 ) );
 
 		if ( !scene->bhkBodyTrans.contains( l ) )
@@ -1502,7 +1502,7 @@ void Node::drawHavok()
 	QModelIndex iExtraDataList = nif->getIndex( iBlock, "Extra Data List" );
 
 	if ( iExtraDataList.isValid() ) {
-		for ( int d = 0; d < nif->rowCount( iExtraDataList ); d++ ) {
+		for ( int d = 0; d < nif->childCount( iExtraDataList ); d++ ) {
 			QModelIndex iBound = nif->getBlock( nif->getLink( iExtraDataList.child( d, 0 ) ), "BSBound" );
 
 			if ( !iBound.isValid() )
@@ -1839,7 +1839,7 @@ void Node::drawFurn()
 
 	glMultMatrix( viewTrans() );
 
-	for ( int p = 0; p < nif->rowCount( iExtraDataList ); p++ ) {
+	for ( int p = 0; p < nif->childCount( iExtraDataList ); p++ ) {
 		// DONE: never seen Furn in nifs, so there may be a need of a fix here later - saw one, fixed a bug
 		QModelIndex iFurnMark = nif->getBlock( nif->getLink( iExtraDataList.child( p, 0 ) ), "BSFurnitureMarker" );
 
@@ -1851,7 +1851,7 @@ void Node::drawFurn()
 		if ( !iPositions.isValid() )
 			break;
 
-		for ( int j = 0; j < nif->rowCount( iPositions ); j++ ) {
+		for ( int j = 0; j < nif->childCount( iPositions ); j++ ) {
 			QModelIndex iPosition = iPositions.child( j, 0 );
 
 			if ( scene->currentIndex == iPosition )
@@ -1942,7 +1942,7 @@ BoundSphere Node::bounds() const
 	QModelIndex iExtraDataList = nif->getIndex( iBlock, "Extra Data List" );
 
 	if ( iExtraDataList.isValid() ) {
-		for ( int d = 0; d < nif->rowCount( iExtraDataList ); d++ ) {
+		for ( int d = 0; d < nif->childCount( iExtraDataList ); d++ ) {
 			QModelIndex iBound = nif->getBlock( nif->getLink( iExtraDataList.child( d, 0 ) ), "BSBound" );
 
 			if ( !iBound.isValid() )
@@ -1987,7 +1987,7 @@ void LODNode::update( const NifModel * nif, const QModelIndex & index )
 		}
 
 		if ( iLevels.isValid() ) {
-			for ( int r = 0; r < nif->rowCount( iLevels ); r++ ) {
+			for ( int r = 0; r < nif->childCount( iLevels ); r++ ) {
 				ranges.append( { nif->get<float>( iLevels.child( r, 0 ), "Near Extent" ),
 				                 nif->get<float>( iLevels.child( r, 0 ), "Far Extent" ) }
 				);
@@ -40,13 +40,17 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <fsengine/fsengine.h>
 #include <fsengine/fsmanager.h>
 
+#include <QCryptographicHash>
 #include <QDebug>
 #include <QDir>
 #include <QFileSystemWatcher>
 #include <QListView>
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
+#include <QSaveFile>
 #include <QSettings>
+#include <QStandardPaths>
+#include <QStringBuilder>
 
 #include <algorithm>
 
@@ -157,10 +161,21 @@ TexCache::~TexCache()
 
 QString TexCache::find( const QString & file, const QString & nifdir )
 {
-	return find( file, nifdir, *(new QByteArray()) );
+	return locate( file, nifdir, nullptr );
 }
 
 QString TexCache::find( const QString & file, const QString & nifdir, QByteArray & data )
+{
+	std::shared_ptr<FSArchiveHandler> archive;
+	QString filename = locate( file, nifdir, &archive );
+
+	if ( archive )
+		archive->getArchive()->fileContents( QDir::fromNativeSeparators( filename.toLower() ), data );
+
+	return filename;
+}
+
+QString TexCache::locate( const QString & file, const QString & nifdir, std::shared_ptr<FSArchiveHandler> * found )
 {
 	if ( file.isEmpty() )
 		return QString();
@@ -232,19 +247,17 @@ QString TexCache::find( const QString & file, const QString & nifdir, QByteArray
 			}
 		}
 
-		// Search through archives last, and load any requested textures into memory.
-		for ( FSArchiveFile * archive : FSManager::archiveList() ) {
+		// Search through archives last
+		for ( const std::shared_ptr<FSArchiveHandler> & handler : FSManager::archiveList() ) {
+			FSArchiveFile * archive = handler->getArchive();
 			if ( archive ) {
 				filename = QDir::fromNativeSeparators( filename.toLower() );
 				if ( archive->hasFile( filename ) ) {
-					QByteArray outData;
-					archive->fileContents( filename, outData );
+					if ( found )
+						*found = handler;
 
-					if ( !outData.isEmpty() ) {
-						data = outData;
-						filename = QDir::toNativeSeparators( filename );
-						return filename;
-					}
+					filename = QDir::toNativeSeparators( filename );
+					return filename;
 				}
 			}
 		}
@@ -263,7 +276,7 @@ QString TexCache::find( const QString & file, const QString & nifdir, QByteArray
 					filename.prepend( "textures\\" );
 			}
 
-			return find( filename, nifdir, data );
+			return locate( filename, nifdir, found );
 		}
 
 		if ( !replaceExt )
@@ -379,20 +392,26 @@ int TexCache::bind( const QString & fname )
 	if ( tx->id == 0xFFFFFFFF )
 		return 0;
 
-	QByteArray outData;
-
-	if ( tx->filepath.isEmpty() || tx->reload )
-		tx->filepath = find( tx->filename, nifFolder, outData );
+	// Previews are reloaded once they are wanted larger than they were loaded
+	bool upgrade = tx->sizeLimit && (!previewSize || previewSize > tx->sizeLimit);
 
-	if ( !outData.isEmpty() || tx->reload ) {
-		tx->data = outData;
-	}
+	if ( !tx->id || tx->reload || upgrade ) {
+		std::shared_ptr<FSArchiveHandler> handler;
+		tx->filepath = locate( tx->filename, nifFolder, &handler );
+		FSArchiveFile * archive = handler ? handler->getArchive() : nullptr;
 
-	if ( !tx->id || tx->reload ) {
-		if ( QFile::exists( tx->filepath ) && QFileInfo( tx->filepath ).isWritable()
+		if ( !archive && QFile::exists( tx->filepath ) && QFileInfo( tx->filepath ).isWritable()
 			 && ( !watcher->files().contains( tx->filepath ) ) )
 			watcher->addPath( tx->filepath );
 
+		tx->sizeLimit = 0;
+		tx->data.clear();
+
+		if ( !previewSize || !loadPreview( tx, archive ) ) {
+			if ( archive )
+				archive->fileContents( QDir::fromNativeSeparators( tx->filepath.toLower() ), tx->data );
+		}
+
 		tx->load();
 	} else {
 		if ( !tx->target )
@@ -404,6 +423,66 @@ int TexCache::bind( const QString & fname )
 	return tx->mipmaps;
 }
 
+bool TexCache::loadPreview( Tex * tx, FSArchiveFile * archive )
+{
+	if ( !tx->filepath.endsWith( ".dds", Qt::CaseInsensitive ) )
+		return false;
+
+	// Key on where the texture comes from and when that last changed
+	QFileInfo source( archive ? archive->path() : tx->filepath );
+	if ( !source.exists() )
+		return false;
+
+	QString key = source.absoluteFilePath() % "|" % tx->filepath.toLower()
+		% "|" % QString::number( source.lastModified().toMSecsSinceEpoch() )
+		% "|" % QString::number( source.size() ) % "|" % QString::number( previewSize );
+
+	QString cache = QStandardPaths::writableLocation( QStandardPaths::CacheLocation );
+	QString cachePath;
+	if ( !cache.isEmpty() ) {
+		QByteArray hash = QCryptographicHash::hash( key.toUtf8(), QCryptographicHash::Sha1 ).toHex();
+		cachePath = cache % "/textures/" % QString::fromLatin1( hash ) % ".dds";
+
+		QFile f( cachePath );
+		if ( f.open( QIODevice::ReadOnly ) ) {
+			tx->data = f.readAll();
+			if ( !tx->data.isEmpty() ) {
+				tx->sizeLimit = previewSize;
+				return true;
+			}
+		}
+	}
+
+	QByteArray full;
+	if ( archive ) {
+		archive->fileContents( QDir::fromNativeSeparators( tx->filepath.toLower() ), full );
+	} else {
+		QFile f( tx->filepath );
+		if ( f.open( QIODevice::ReadOnly ) )
+			full = f.readAll();
+	}
+
+	if ( full.isEmpty() )
+		return false;
+
+	QByteArray tail;
+	if ( !texMipTail( full, previewSize, tail ) ) {
+		// Already small enough, or not a plain 2D texture
+		tx->data = full;
+		return true;
+	}
+
+	if ( !cachePath.isEmpty() && QDir().mkpath( QFileInfo( cachePath ).absolutePath() ) ) {
+		QSaveFile f( cachePath );
+		if ( f.open( QIODevice::WriteOnly ) && f.write( tail ) == tail.size() )
+			f.commit();
+	}
+
+	tx->data = tail;
+	tx->sizeLimit = previewSize;
+	return true;
+}
+
 int TexCache::bind( const QModelIndex & iSource )
 {
 	const NifModel * nif = qobject_cast<const NifModel *>( iSource.model() );
@@ -464,6 +543,11 @@ void TexCache::flush()
 	}
 }
 
+void TexCache::setPreviewSize( int size )
+{
+	previewSize = size;
+}
+
 void TexCache::setNifFolder( const QString & folder )
 {
 	nifFolder = folder;
@@ -39,9 +39,13 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QPersistentModelIndex>
 #include <QString>
 
+#include <memory>
+
 
 //! @file gltex.h TexCache etc. header
 
+class FSArchiveFile;
+class FSArchiveHandler;
 class NifModel;
 class QFileSystemWatcher;
 class QOpenGLContext;
@@ -76,6 +80,8 @@ class TexCache final : public QObject
 		GLuint height = 0;
 		//! Number of mipmaps present
 		GLuint mipmaps = 0;
+		//! Largest width or height loaded for a preview, 0 if fully loaded
+		int sizeLimit = 0;
 		//! Determine whether the texture needs reloading
 		bool reload = false;
 		//! Format of the texture
@@ -112,6 +118,11 @@ public:
 	//! Find a texture based on its filename
 	static QString find( const QString & file, const QString & nifFolder );
 	static QString find( const QString & file, const QString & nifFolder, QByteArray & data );
+	//! Find a texture based on its filename, and the archive containing it without reading it
+	/*!
+	 * The handler keeps the archive open while it is read, even if the archive list changes.
+	 */
+	static QString locate( const QString & file, const QString & nifFolder, std::shared_ptr<FSArchiveHandler> * archive );
 	//! Remove the path from a filename
 	static QString stripPath( const QString & file, const QString & nifFolder );
 	//! Checks whether the given file can be loaded
@@ -132,15 +143,28 @@ public slots:
 	 */
 	void setNifFolder( const QString & );
 
+	/*! Limit the textures loaded from now on to the mip levels fitting in a size
+	 *
+	 * The levels are cached on disk, so previews of large textures only read
+	 * the whole file once. Textures are reloaded at full resolution when the
+	 * size grows beyond what they were loaded with. Use 0 for full resolution.
+	 */
+	void setPreviewSize( int size );
+
 protected slots:
 	void fileChanged( const QString & filepath );
 
 protected:
+	//! Fill in the data of a texture with the levels fitting the preview size, false if it cannot be read
+	bool loadPreview( Tex * tx, FSArchiveFile * archive );
+
 	QHash<QString, Tex *> textures;
 	QHash<QModelIndex, Tex *> embedTextures;
 	QFileSystemWatcher * watcher;
 
 	QString nifFolder;
+
+	int previewSize = 0;
 };
 
 void initializeTextureUnits( const QOpenGLContext * );
@@ -36,6 +36,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "model/nifmodel.h"
 
 #include "dds.h"
+#include "lib/bcdecode.h"
 
 #include <QBuffer>
 #include <QByteArray>
@@ -46,6 +47,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QOpenGLContext>
 #include <QString>
 #include <QtEndian>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
 
 #ifdef __APPLE__
 #include <gl3.h>
@@ -75,6 +79,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 bool extInitialized = false;
 bool extSupported = true;
 bool extStorageSupported = true;
+bool extS3TCSupported = true;
+bool extRGTCSupported = true;
+bool extBPTCSupported = true;
 
 
 #ifndef __APPLE__
@@ -623,17 +630,120 @@ GLuint texLoadBMP( QIODevice & f, QString & texformat, GLenum & target, GLuint &
 	return 0;
 }
 
+//! Gets the software decoder of a compressed format and whether the GL can sample it
+static bool bcFormat( gli::format format, BCFormat & bc, bool & srgb, bool & supported )
+{
+	switch ( format ) {
+	case gli::FORMAT_RGB_DXT1_UNORM_BLOCK8:
+	case gli::FORMAT_RGB_DXT1_SRGB_BLOCK8:
+		bc = BCFormat::BC1;
+		supported = extS3TCSupported;
+		break;
+	case gli::FORMAT_RGBA_DXT1_UNORM_BLOCK8:
+	case gli::FORMAT_RGBA_DXT1_SRGB_BLOCK8:
+		bc = BCFormat::BC1A;
+		supported = extS3TCSupported;
+		break;
+	case gli::FORMAT_RGBA_DXT3_UNORM_BLOCK16:
+	case gli::FORMAT_RGBA_DXT3_SRGB_BLOCK16:
+		bc = BCFormat::BC2;
+		supported = extS3TCSupported;
+		break;
+	case gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16:
+	case gli::FORMAT_RGBA_DXT5_SRGB_BLOCK16:
+		bc = BCFormat::BC3;
+		supported = extS3TCSupported;
+		break;
+	case gli::FORMAT_R_ATI1N_UNORM_BLOCK8:
+		bc = BCFormat::BC4;
+		supported = extRGTCSupported;
+		break;
+	case gli::FORMAT_RG_ATI2N_UNORM_BLOCK16:
+		bc = BCFormat::BC5;
+		supported = extRGTCSupported;
+		break;
+	case gli::FORMAT_RGBA_BP_UNORM_BLOCK16:
+	case gli::FORMAT_RGBA_BP_SRGB_BLOCK16:
+		bc = BCFormat::BC7;
+		supported = extBPTCSupported;
+		break;
+	default:
+		return false;
+	}
+
+	srgb = gli::is_srgb( format );
+	return true;
+}
+
+//! A band of block rows of one image of a texture
+struct BCBand
+{
+	const quint8 * src;
+	quint8 * dst;
+	int width;
+	int height;
+};
+
+//! Decodes a block compressed texture into RGBA8 if the GL cannot sample its format
+/*!
+ * Every mip level, face and layer is cut into bands of block rows,
+ * which are decoded concurrently.
+ *
+ * @return The decoded texture, or an empty one if the format is supported or has no decoder
+ */
+static gli::texture decompressUnsupported( const gli::texture & texture )
+{
+	BCFormat bc;
+	bool srgb, supported;
+	if ( !bcFormat( texture.format(), bc, srgb, supported ) || supported )
+		return gli::texture();
+
+	gli::texture rgba( texture.target(), srgb ? gli::FORMAT_RGBA8_SRGB_PACK8 : gli::FORMAT_RGBA8_UNORM_PACK8,
+		texture.extent(), texture.layers(), texture.faces(), texture.levels(), texture.swizzles() );
+
+	const int blockSize = bcBlockSize( bc );
+	QVector<BCBand> bands;
+
+	for ( std::size_t layer = 0; layer < texture.layers(); ++layer )
+	for ( std::size_t face = 0; face < texture.faces(); ++face )
+	for ( std::size_t level = 0; level < texture.levels(); ++level ) {
+		glm::tvec3<GLsizei> extent( texture.extent( level ) );
+		const int blocksX = (extent.x + 3) / 4;
+		const int blocksY = (extent.y + 3) / 4;
+
+		auto src = static_cast<const quint8 *>(texture.data( layer, face, level ));
+		auto dst = static_cast<quint8 *>(rgba.data( layer, face, level ));
+
+		// About 64K pixels per band, so small levels stay whole
+		const int rowsPerBand = std::max( 1, 4096 / blocksX );
+		for ( int by = 0; by < blocksY; by += rowsPerBand ) {
+			const int rows = std::min( rowsPerBand, blocksY - by );
+			bands.append( { src + by * blocksX * blockSize, dst + by * 4 * extent.x * 4,
+				extent.x, std::min( rows * 4, extent.y - by * 4 ) } );
+		}
+	}
+
+	QtConcurrent::blockingMap( bands, [bc]( const BCBand & band ) {
+		decodeBC( bc, band.src, band.width, band.height, band.dst );
+	} );
+
+	return rgba;
+}
+
 GLuint texLoadDDS( const QString & filepath, QString & format, GLenum & target, GLuint & width, GLuint & height, GLuint & mipmaps, QByteArray & data, GLuint & id )
 {
 	GLuint result = 0;
-	gli::texture texture;
-	if ( extStorageSupported ) {
-		texture = load_if_valid( data.constData(), data.size() );
-		if ( !texture.empty() )
+	gli::texture texture = load_if_valid( data.constData(), data.size() );
+
+	if ( !texture.empty() ) {
+		// Formats the GL cannot sample are decoded in software
+		gli::texture decoded = decompressUnsupported( texture );
+		if ( !decoded.empty() )
+			texture = decoded;
+
+		if ( extStorageSupported )
 			result = GLI_create_texture( texture, target, id );
-	} else if ( glCompressedTexImage2D ) {
-		texture = load_if_valid( data.constData(), data.size() );
-		if ( !texture.empty() )
+		else if ( glCompressedTexImage2D || !gli::is_compressed( texture.format() ) )
 			result = GLI_create_texture_fallback( texture, target, id );
 	}
 
@@ -655,6 +765,34 @@ GLuint texLoadDDS( const QString & filepath, QString & format, GLenum & target,
 	return mipmaps;
 }
 
+// (public function, documented in gltexloaders.h)
+bool texMipTail( const QByteArray & data, int maxSize, QByteArray & tail )
+{
+	gli::texture texture = load_if_valid( data.constData(), data.size() );
+	if ( texture.empty() || texture.target() != gli::TARGET_2D || texture.layers() > 1 )
+		return false;
+
+	std::size_t base = 0;
+	for ( ; base < texture.levels(); ++base ) {
+		glm::tvec3<GLsizei> extent( texture.extent( base ) );
+		if ( std::max( extent.x, extent.y ) <= maxSize )
+			break;
+	}
+
+	if ( base == 0 || base == texture.levels() )
+		return false;
+
+	// The levels of a single layer are consecutive, so the view saves as is
+	gli::texture view( texture, texture.target(), texture.format(), 0, 0, 0, 0, base, texture.levels() - 1 );
+
+	std::vector<char> memory;
+	if ( !gli::save_dds( view, memory ) )
+		return false;
+
+	tail = QByteArray( memory.data(), int( memory.size() ) );
+	return true;
+}
+
 // (public function, documented in gltexloaders.h)
 bool texLoad( const QModelIndex & iData, QString & texformat, GLenum & target, GLuint & width, GLuint & height, GLuint & mipmaps, GLuint & id )
 {
@@ -858,6 +996,12 @@ void initializeTextureLoaders( const QOpenGLContext * context )
 		if ( !glTexStorage2D || !glCompressedTexSubImage2D )
 			extStorageSupported = false;
 
+		// Compressed formats the GL cannot sample are decoded in software
+		auto version = context->format().version();
+		extS3TCSupported = context->hasExtension( "GL_EXT_texture_compression_s3tc" );
+		extRGTCSupported = version >= qMakePair( 3, 0 ) || context->hasExtension( "GL_ARB_texture_compression_rgtc" );
+		extBPTCSupported = version >= qMakePair( 4, 2 ) || context->hasExtension( "GL_ARB_texture_compression_bptc" );
+
 		extInitialized = true;
 	}
 }
@@ -1115,7 +1259,8 @@ gli::texture load_if_valid( const char * data, unsigned int size )
 
 bool texLoad( const QString & filepath, QString & format, GLenum & target, GLuint & width, GLuint & height, GLuint & mipmaps, GLuint & id)
 {
-	return texLoad( filepath, format, target, width, height, mipmaps, *(new QByteArray()), id );
+	QByteArray data;
+	return texLoad( filepath, format, target, width, height, mipmaps, data, id );
 }
 
 bool texLoad( const QString & filepath, QString & format, GLenum & target, GLuint & width, GLuint & height, GLuint & mipmaps, QByteArray & data, GLuint & id )
@@ -1616,7 +1761,7 @@ bool texSaveNIF( NifModel * nif, const QString & filepath, QModelIndex & iData )
 			QModelIndex fastCompareSrc = pix.getIndex( iPixData, "Old Fast Compare" );
 			QModelIndex fastCompareDest = nif->getIndex( iData, "Old Fast Compare" );
 
-			for ( int i = 0; i < pix.rowCount( fastCompareSrc ); i++ ) {
+			for ( int i = 0; i < pix.childCount( fastCompareSrc ); i++ ) {
 				nif->set<quint8>( fastCompareDest.child( i, 0 ), pix.get<quint8>( fastCompareSrc.child( i, 0 ) ) );
 			}
 
@@ -1671,7 +1816,7 @@ bool texSaveNIF( NifModel * nif, const QString & filepath, QModelIndex & iData )
 		QModelIndex destMipMaps = nif->getIndex( iData, "Mipmaps" );
 		nif->updateArray( destMipMaps );
 
-		for ( int i = 0; i < pix.rowCount( srcMipMaps ); i++ ) {
+		for ( int i = 0; i < pix.childCount( srcMipMaps ); i++ ) {
 			nif->set<quint32>( destMipMaps.child( i, 0 ), "Width", pix.get<quint32>( srcMipMaps.child( i, 0 ), "Width" ) );
 			nif->set<quint32>( destMipMaps.child( i, 0 ), "Height", pix.get<quint32>( srcMipMaps.child( i, 0 ), "Height" ) );
 			nif->set<quint32>( destMipMaps.child( i, 0 ), "Offset", pix.get<quint32>( srcMipMaps.child( i, 0 ), "Offset" ) );
@@ -1682,7 +1827,7 @@ bool texSaveNIF( NifModel * nif, const QString & filepath, QModelIndex & iData )
 		QModelIndex srcPixelData  = pix.getIndex( iPixData, "Pixel Data" );
 		QModelIndex destPixelData = nif->getIndex( iData, "Pixel Data" );
 
-		for ( int i = 0; i < pix.rowCount( srcPixelData ); i++ ) {
+		for ( int i = 0; i < pix.childCount( srcPixelData ); i++ ) {
 			nif->updateArray( destPixelData.child( i, 0 ) );
 			nif->set<QByteArray>( destPixelData.child( i, 0 ), "Pixel Data", pix.get<QByteArray>( srcPixelData.child( i, 0 ), "Pixel Data" ) );
 		}
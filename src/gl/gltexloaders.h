@@ -95,6 +95,17 @@ extern bool texLoad( const QString & filepath, QString & format, GLenum & target
  */
 extern bool texLoad( const QModelIndex & iData, QString & format, GLenum & target, GLuint & width, GLuint & height, GLuint & mipmaps, GLuint & id );
 
+/*! Cut a DDS texture down to the mip levels which fit in a size
+ *
+ * Only 2D textures with a single layer are cut down.
+ *
+ * @param data The DDS file
+ * @param maxSize The largest width or height to keep
+ * @param tail Receives a DDS file of the smaller levels
+ * @return False if the texture already fits or cannot be cut down
+ */
+extern bool texMipTail( const QByteArray & data, int maxSize, QByteArray & tail );
+
 /*! A function which checks whether the given file can be loaded.
  *
  * The function checks whether the file exists, is readable, and whether its extension
@@ -33,7 +33,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "gltools.h"
 
 #include "model/nifmodel.h"
+#include "lib/boundingvolume.h"
 
+#include <QHash>
 #include <QMap>
 #include <QStack>
 #include <QVector>
@@ -56,7 +58,7 @@ BoneWeights::BoneWeights( const NifModel * nif, const QModelIndex & index, int b
 
 	QModelIndex idxWeights = nif->getIndex( index, "Vertex Weights" );
 	if ( vcnt && idxWeights.isValid() ) {
-		for ( int c = 0; c < nif->rowCount( idxWeights ); c++ ) {
+		for ( int c = 0; c < nif->childCount( idxWeights ); c++ ) {
 			QModelIndex idx = idxWeights.child( c, 0 );
 			weights.append( VertexWeight( nif->get<int>( idx, "Index" ), nif->get<float>( idx, "Weight" ) ) );
 		}
@@ -104,7 +106,7 @@ SkinPartition::SkinPartition( const NifModel * nif, const QModelIndex & index )
 
 	QModelIndex iStrips = nif->getIndex( index, "Strips" );
 
-	for ( int s = 0; s < nif->rowCount( iStrips ); s++ ) {
+	for ( int s = 0; s < nif->childCount( iStrips ); s++ ) {
 		tristrips << nif->getArray<quint16>( iStrips.child( s, 0 ) );
 	}
 
@@ -169,25 +171,7 @@ BoundSphere::BoundSphere( const NifModel * nif, const QModelIndex & index )
 
 BoundSphere::BoundSphere( const QVector<Vector3> & verts )
 {
-	if ( verts.isEmpty() ) {
-		center = Vector3();
-		radius = -1;
-	} else {
-		center = Vector3();
-		for ( const Vector3& v : verts ) {
-			center += v;
-		}
-		center /= verts.count();
-
-		radius = 0;
-		for ( const Vector3& v : verts ) {
-			float d = ( center - v ).squaredLength();
-
-			if ( d > radius )
-				radius = d;
-		}
-		radius = sqrt( radius );
-	}
+	boundingSphere( verts, center, radius );
 }
 
 BoundSphere & BoundSphere::operator=( const BoundSphere & o )
@@ -213,11 +197,10 @@ BoundSphere & BoundSphere::operator|=( const BoundSphere & o )
 	if ( o.radius >= d + radius )
 		return operator=( o );
 
-	if ( o.radius > radius )
-		radius = o.radius;
-
-	radius += d / 2;
-	center  = ( center + o.center ) / 2;
+	// Smallest sphere touching both spheres on opposite sides
+	float r = ( d + radius + o.radius ) / 2;
+	center += ( o.center - center ) * ( ( r - radius ) / d );
+	radius  = r;
 
 	return *this;
 }
@@ -837,180 +820,188 @@ static QVector<Vector3> generateTris( const NifModel * nif, const QModelIndex &
 	return tris;
 }
 
-void drawConvexHull( const NifModel * nif, const QModelIndex & iShape, float scale, bool solid )
-{
-	static QMap<QModelIndex, QVector<Vector3>> shapes;
-	QVector<Vector3> shape;
+//! Triangle lists of collision shapes, keyed by block number and scale
+typedef QHash<QPair<int, float>, QVector<Vector3>> CollisionShapes;
 
-	shape = shapes[iShape];
+//! Decoded collision geometry per model, cleared whenever its model changes
+static QHash<const NifModel *, CollisionShapes> collisionCache;
 
-	if ( shape.empty() ) {
-		shape = generateTris( nif, iShape, scale );
-		shapes[iShape] = shape;
+/*! Get the triangle list of a collision shape, decoding it only once
+ *
+ * The first lookup on a model connects to its change signals, so that
+ * editing the model drops its decoded shapes.
+ */
+static const QVector<Vector3> & cachedCollision( const NifModel * nif, const QModelIndex & iShape, float scale,
+                                                 const std::function<QVector<Vector3>()> & decode )
+{
+	auto it = collisionCache.find( nif );
+	if ( it == collisionCache.end() ) {
+		it = collisionCache.insert( nif, CollisionShapes() );
+
+		auto invalidate = [nif]() { collisionCache[nif].clear(); };
+		QObject::connect( nif, &NifModel::dataChanged, nif, invalidate );
+		QObject::connect( nif, &NifModel::rowsInserted, nif, invalidate );
+		QObject::connect( nif, &NifModel::rowsRemoved, nif, invalidate );
+		QObject::connect( nif, &NifModel::layoutChanged, nif, invalidate );
+		QObject::connect( nif, &NifModel::modelReset, nif, invalidate );
+		QObject::connect( nif, &QObject::destroyed, [nif]() { collisionCache.remove( nif ); } );
 	}
 
+	QPair<int, float> key( nif->getBlockNumber( iShape ), scale );
+	auto shape = it->find( key );
+	if ( shape == it->end() )
+		shape = it->insert( key, decode() );
+
+	return *shape;
+}
+
+//! Draw a triangle list with a single call
+static void drawTriangles( const QVector<Vector3> & tris, bool solid )
+{
+	if ( tris.isEmpty() )
+		return;
+
 	glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_FILL : GL_LINE );
 	glDisable( GL_CULL_FACE );
-	glBegin( GL_TRIANGLES );
 
-	for ( int i = 0; i < shape.count(); i += 3 ) {
-		// DRAW ABC
-		glVertex( shape[i] );
-		glVertex( shape[i+1] );
-		glVertex( shape[i+2] );
-	}
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glVertexPointer( 3, GL_FLOAT, 0, tris.constData() );
+	glDrawArrays( GL_TRIANGLES, 0, tris.count() );
+	glDisableClientState( GL_VERTEX_ARRAY );
 
-	glEnd();
 	glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_LINE : GL_FILL );
 	glEnable( GL_CULL_FACE );
 }
 
-void drawNiTSS( const NifModel * nif, const QModelIndex & iShape, bool solid )
+void drawConvexHull( const NifModel * nif, const QModelIndex & iShape, float scale, bool solid )
+{
+	drawTriangles( cachedCollision( nif, iShape, scale, [nif, &iShape, scale]() {
+		return generateTris( nif, iShape, scale );
+	} ), solid );
+}
+
+//! Decode the strips of a NiTriStripsShape, as they appear in the tescs
+static QVector<Vector3> decodeNiTSS( const NifModel * nif, const QModelIndex & iShape )
 {
+	QVector<Vector3> tris;
+
 	QModelIndex iStrips = nif->getIndex( iShape, "Strips Data" );
-	for ( int r = 0; r < nif->rowCount( iStrips ); r++ ) {
+	for ( int r = 0; r < nif->childCount( iStrips ); r++ ) {
 		QModelIndex iStripData = nif->getBlock( nif->getLink( iStrips.child( r, 0 ) ), "NiTriStripsData" );
-		if ( iStripData.isValid() ) {
-			QVector<Vector3> verts = nif->getArray<Vector3>( iStripData, "Vertices" );
-
-			glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_FILL : GL_LINE );
-			glDisable( GL_CULL_FACE );
-			glBegin( GL_TRIANGLES );
-
-			QModelIndex iPoints = nif->getIndex( iStripData, "Points" );
-			for ( int r = 0; r < nif->rowCount( iPoints ); r++ ) {	// draw the strips like they appear in the tescs
-				// (use the unstich strips spell to avoid the spider web effect)
-				QVector<quint16> strip = nif->getArray<quint16>( iPoints.child( r, 0 ) );
-				if ( strip.count() >= 3 ) {
-					quint16 a = strip[0];
-					quint16 b = strip[1];
-
-					for ( int x = 2; x < strip.size(); x++ ) {
-						quint16 c = strip[x];
-						glVertex( verts.value( a ) );
-						glVertex( verts.value( b ) );
-						glVertex( verts.value( c ) );
-						a = b;
-						b = c;
-					}
-				}
+		if ( !iStripData.isValid() )
+			continue;
+
+		QVector<Vector3> verts = nif->getArray<Vector3>( iStripData, "Vertices" );
+
+		QModelIndex iPoints = nif->getIndex( iStripData, "Points" );
+		for ( int s = 0; s < nif->childCount( iPoints ); s++ ) {
+			// (use the unstich strips spell to avoid the spider web effect)
+			QVector<quint16> strip = nif->getArray<quint16>( iPoints.child( s, 0 ) );
+			if ( strip.count() < 3 )
+				continue;
+
+			quint16 a = strip[0];
+			quint16 b = strip[1];
+
+			for ( int x = 2; x < strip.size(); x++ ) {
+				quint16 c = strip[x];
+				tris << verts.value( a ) << verts.value( b ) << verts.value( c );
+				a = b;
+				b = c;
 			}
-
-			glEnd();
-			glEnable( GL_CULL_FACE );
-			glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_LINE : GL_FILL );
 		}
 	}
+
+	return tris;
 }
 
-void drawCMS( const NifModel * nif, const QModelIndex & iShape, bool solid )
+void drawNiTSS( const NifModel * nif, const QModelIndex & iShape, bool solid )
+{
+	drawTriangles( cachedCollision( nif, iShape, 1.0f, [nif, &iShape]() {
+		return decodeNiTSS( nif, iShape );
+	} ), solid );
+}
+
+//! Decode the big triangles and the compressed chunks of a bhkCompressedMeshShape
+static QVector<Vector3> decodeCMS( const NifModel * nif, const QModelIndex & iShape )
 {
+	QVector<Vector3> tris;
+
 	// Scale up for Skyrim
 	float havokScale = (nif->checkVersion( 0x14020007, 0x14020007 ) && nif->getUserVersion() >= 12) ? 10.0f : 1.0f;
 
-	//QModelIndex iParent = nif->getBlock( nif->getParent( nif->getBlockNumber( iShape ) ) );
-	//Vector4 origin = Vector4( nif->get<Vector3>( iParent, "Origin" ), 0 );
-
 	QModelIndex iData = nif->getBlock( nif->getLink( iShape, "Data" ) );
-	if ( iData.isValid() ) {
-		QModelIndex iBigVerts = nif->getIndex( iData, "Big Verts" );
-		QModelIndex iBigTris = nif->getIndex( iData, "Big Tris" );
-		QModelIndex iChunkTrans = nif->getIndex( iData, "Chunk Transforms" );
-
-		QVector<Vector4> verts = nif->getArray<Vector4>( iBigVerts );
-
-		glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_FILL : GL_LINE );
-		glDisable( GL_CULL_FACE );
-
-		for ( int r = 0; r < nif->rowCount( iBigTris ); r++ ) {
-			quint16 a = nif->get<quint16>( iBigTris.child( r, 0 ), "Triangle 1" );
-			quint16 b = nif->get<quint16>( iBigTris.child( r, 0 ), "Triangle 2" );
-			quint16 c = nif->get<quint16>( iBigTris.child( r, 0 ), "Triangle 3" );
-
-			glBegin( GL_TRIANGLES );
-
-			glVertex( verts[a] * havokScale );
-			glVertex( verts[b] * havokScale );
-			glVertex( verts[c] * havokScale );
-
-			glEnd();
-		}
-
-		glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_LINE : GL_FILL );
-		glEnable( GL_CULL_FACE );
-
-		QModelIndex iChunks = nif->getIndex( iData, "Chunks" );
-		for ( int r = 0; r < nif->rowCount( iChunks ); r++ ) {
-			Vector4 chunkOrigin = nif->get<Vector4>( iChunks.child( r, 0 ), "Translation" );
-
-			quint32 transformIndex = nif->get<quint32>( iChunks.child( r, 0 ), "Transform Index" );
-			QModelIndex chunkTransform = iChunkTrans.child( transformIndex, 0 );
-			Vector4 chunkTranslation = nif->get<Vector4>( chunkTransform.child( 0, 0 ) );
-			Quat chunkRotation = nif->get<Quat>( chunkTransform.child( 1, 0 ) );
-
-			quint32 numOffsets = nif->get<quint32>( iChunks.child( r, 0 ), "Num Vertices" );
-			quint32 numIndices = nif->get<quint32>( iChunks.child( r, 0 ), "Num Indices" );
-			quint32 numStrips = nif->get<quint32>( iChunks.child( r, 0 ), "Num Strips" );
-			QVector<quint16> offsets = nif->getArray<quint16>( iChunks.child( r, 0 ), "Vertices" );
-			QVector<quint16> indices = nif->getArray<quint16>( iChunks.child( r, 0 ), "Indices" );
-			QVector<quint16> strips = nif->getArray<quint16>( iChunks.child( r, 0 ), "Strips" );
-
-			QVector<Vector4> vertices( numOffsets / 3 );
-
-			int numStripVerts = 0;
-			int offset = 0;
+	if ( !iData.isValid() )
+		return tris;
 
-			for ( int v = 0; v < (int)numStrips; v++ ) {
-				numStripVerts += strips[v];
-			}
-
-			for ( int n = 0; n < ((int)numOffsets / 3); n++ ) {
-				vertices[n] = chunkOrigin + chunkTranslation + Vector4( offsets[3 * n], offsets[3 * n + 1], offsets[3 * n + 2], 0 ) / 1000.0f;
-				vertices[n] *= havokScale;
-			}
+	QModelIndex iBigVerts = nif->getIndex( iData, "Big Verts" );
+	QModelIndex iBigTris = nif->getIndex( iData, "Big Tris" );
+	QModelIndex iChunkTrans = nif->getIndex( iData, "Chunk Transforms" );
 
-			glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_FILL : GL_LINE );
-			glDisable( GL_CULL_FACE );
+	QVector<Vector4> verts = nif->getArray<Vector4>( iBigVerts );
 
-			Transform trans;
-			trans.rotation.fromQuat( chunkRotation );
+	for ( int r = 0; r < nif->childCount( iBigTris ); r++ ) {
+		quint16 a = nif->get<quint16>( iBigTris.child( r, 0 ), "Triangle 1" );
+		quint16 b = nif->get<quint16>( iBigTris.child( r, 0 ), "Triangle 2" );
+		quint16 c = nif->get<quint16>( iBigTris.child( r, 0 ), "Triangle 3" );
 
-			// Stripped tris
-			for ( int s = 0; s < (int)numStrips; s++ ) {
+		tris << Vector3( verts.value( a ) * havokScale )
+		     << Vector3( verts.value( b ) * havokScale )
+		     << Vector3( verts.value( c ) * havokScale );
+	}
 
-				for ( int idx = 0; idx < strips[s] - 2; idx++ ) {
+	QModelIndex iChunks = nif->getIndex( iData, "Chunks" );
+	for ( int r = 0; r < nif->childCount( iChunks ); r++ ) {
+		QModelIndex iChunk = iChunks.child( r, 0 );
+		Vector4 chunkOrigin = nif->get<Vector4>( iChunk, "Translation" );
 
-					glBegin( GL_TRIANGLES );
+		quint32 transformIndex = nif->get<quint32>( iChunk, "Transform Index" );
+		QModelIndex chunkTransform = iChunkTrans.child( transformIndex, 0 );
+		Vector4 chunkTranslation = nif->get<Vector4>( chunkTransform.child( 0, 0 ) );
+		Quat chunkRotation = nif->get<Quat>( chunkTransform.child( 1, 0 ) );
 
-					glVertex( trans.rotation * Vector3( vertices[indices[offset + idx]] ) );
-					glVertex( trans.rotation * Vector3( vertices[indices[offset + idx + 1]] ) );
-					glVertex( trans.rotation * Vector3( vertices[indices[offset + idx + 2]] ) );
+		QVector<quint16> offsets = nif->getArray<quint16>( iChunk, "Vertices" );
+		QVector<quint16> indices = nif->getArray<quint16>( iChunk, "Indices" );
+		QVector<quint16> strips = nif->getArray<quint16>( iChunk, "Strips" );
 
-					glEnd();
+		Transform trans;
+		trans.rotation.fromQuat( chunkRotation );
 
-				}
-
-				offset += strips[s];
+		QVector<Vector3> vertices( offsets.count() / 3 );
+		for ( int n = 0; n < vertices.count(); n++ ) {
+			Vector4 v = chunkOrigin + chunkTranslation + Vector4( offsets[3 * n], offsets[3 * n + 1], offsets[3 * n + 2], 0 ) / 1000.0f;
+			vertices[n] = trans.rotation * Vector3( v * havokScale );
+		}
 
-			}
+		auto addTriangle = [&tris, &vertices, &indices]( int i ) {
+			if ( i + 2 >= indices.count() )
+				return;
+			tris << vertices.value( indices[i] ) << vertices.value( indices[i + 1] ) << vertices.value( indices[i + 2] );
+		};
 
-			// Non-stripped tris
-			for ( int f = 0; f < (int)(numIndices - offset); f += 3 ) {
-				glBegin( GL_TRIANGLES );
+		int offset = 0;
 
-				glVertex( trans.rotation * Vector3( vertices[indices[offset + f]] ) );
-				glVertex( trans.rotation * Vector3( vertices[indices[offset + f + 1]] ) );
-				glVertex( trans.rotation * Vector3( vertices[indices[offset + f + 2]] ) );
+		// Stripped tris
+		for ( quint16 stripLength : strips ) {
+			for ( int idx = 0; idx < stripLength - 2; idx++ )
+				addTriangle( offset + idx );
 
-				glEnd();
+			offset += stripLength;
+		}
 
-			}
+		// Non-stripped tris
+		for ( int f = offset; f + 2 < indices.count(); f += 3 )
+			addTriangle( f );
+	}
 
-			glPolygonMode( GL_FRONT_AND_BACK, solid ? GL_LINE : GL_FILL );
-			glEnable( GL_CULL_FACE );
+	return tris;
+}
 
-		}
-	}
+void drawCMS( const NifModel * nif, const QModelIndex & iShape, bool solid )
+{
+	drawTriangles( cachedCollision( nif, iShape, 1.0f, [nif, &iShape]() {
+		return decodeCMS( nif, iShape );
+	} ), solid );
 }
 
 // Renders text using the font initialized in the primary view class
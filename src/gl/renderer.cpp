@@ -43,13 +43,21 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "ui/settingsdialog.h"
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QOffscreenSurface>
 #include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLFunctions>
+#include <QSaveFile>
 #include <QSettings>
+#include <QStandardPaths>
+#include <QStringBuilder>
 #include <QTextStream>
+#include <QThread>
 
 
 //! @file renderer.cpp Renderer and child classes implementation
@@ -66,6 +74,18 @@ bool Renderer::initialize()
 		if ( cfg.useShaders && fn->hasOpenGLFeature( QOpenGLFunctions::Shaders ) ) {
 			shader_ready = true;
 			shader_initialized = true;
+
+			driver = QByteArray( (const char *)fn->glGetString( GL_VENDOR ) ) % "|"
+				% QByteArray( (const char *)fn->glGetString( GL_RENDERER ) ) % "|"
+				% QByteArray( (const char *)fn->glGetString( GL_VERSION ) );
+
+			// Program binaries need GL 4.1 or GL_ARB_get_program_binary, and a driver that offers a format
+			binaryCache = cx->format().version() >= qMakePair( 4, 1 ) || cx->hasExtension( "GL_ARB_get_program_binary" );
+			if ( binaryCache ) {
+				GLint formats = 0;
+				fn->glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &formats );
+				binaryCache = formats > 0;
+			}
 		} else {
 			shader_ready = false;
 		}
@@ -238,8 +258,9 @@ bool Renderer::Shader::load( const QString & filepath )
 	}
 	catch ( QString & err )
 	{
+		// Reported by the programs which use the shader, this may run off the main thread
 		status = false;
-		Message::append( QObject::tr( "There were errors during shader compilation" ), QString( "%1:\r\n\r\n%2" ).arg( name ).arg( err ) );
+		log = err;
 		return false;
 	}
 	status = true;
@@ -250,17 +271,18 @@ bool Renderer::Shader::load( const QString & filepath )
 Renderer::Program::Program( const QString & n, QOpenGLFunctions * fn )
 	: f( fn ), name( n ), id( 0 )
 {
-	id = f->glCreateProgram();
 }
 
 Renderer::Program::~Program()
 {
 	if ( id )
-		f->glDeleteShader( id );
+		f->glDeleteProgram( id );
 }
 
-bool Renderer::Program::load( const QString & filepath, Renderer * renderer )
+bool Renderer::Program::load( const QString & filepath, Renderer * renderer, QOpenGLContext * gl, QString & error )
 {
+	QOpenGLFunctions * fn = gl->functions();
+
 	try
 	{
 		QFile file( filepath );
@@ -268,7 +290,11 @@ bool Renderer::Program::load( const QString & filepath, Renderer * renderer )
 		if ( !file.open( QIODevice::ReadOnly ) )
 			throw QString( "couldn't open %1 for read access" ).arg( filepath );
 
-		QTextStream stream( &file );
+		QByteArray source = file.readAll();
+		QTextStream stream( source );
+
+		QDir dir = QFileInfo( filepath ).dir();
+		QStringList shaderNames;
 
 		QStack<ConditionGroup *> chkgrps;
 		chkgrps.push( &conditions );
@@ -277,20 +303,7 @@ bool Renderer::Program::load( const QString & filepath, Renderer * renderer )
 			QString line = stream.readLine().trimmed();
 
 			if ( line.startsWith( "shaders" ) ) {
-				QStringList list = line.simplified().split( " " );
-
-				for ( int i = 1; i < list.count(); i++ ) {
-					Shader * shader = renderer->shaders.value( list[ i ] );
-
-					if ( shader ) {
-						if ( shader->status )
-							f->glAttachShader( id, shader->id );
-						else
-							throw QString( "depends on shader %1 which was not compiled successful" ).arg( list[ i ] );
-					} else {
-						throw QString( "shader %1 not found" ).arg( list[ i ] );
-					}
-				}
+				shaderNames << line.simplified().split( " " ).mid( 1 );
 			} else if ( line.startsWith( "checkgroup" ) ) {
 				QStringList list = line.simplified().split( " " );
 
@@ -349,46 +362,204 @@ bool Renderer::Program::load( const QString & filepath, Renderer * renderer )
 			}
 		}
 
-		f->glLinkProgram( id );
+		id = fn->glCreateProgram();
+
+		// The binary is keyed on the driver and all of the sources it was linked from
+		QString binaryPath;
+		QString cache = QStandardPaths::writableLocation( QStandardPaths::CacheLocation );
+		if ( renderer->binaryCache && !cache.isEmpty() ) {
+			QCryptographicHash hash( QCryptographicHash::Sha1 );
+			hash.addData( renderer->driver );
+			hash.addData( source );
+
+			for ( const QString & shaderName : shaderNames ) {
+				QFile shaderFile( dir.filePath( shaderName ) );
+				if ( shaderFile.open( QIODevice::ReadOnly ) )
+					hash.addData( shaderName.toUtf8() + shaderFile.readAll() );
+			}
+
+			binaryPath = cache % "/shaders/" % QString::fromLatin1( hash.result().toHex() ) % ".bin";
+
+			if ( loadBinary( binaryPath, gl ) ) {
+				setUniformLocations( fn );
+				status = true;
+				return true;
+			}
+		}
+
+		for ( const QString & shaderName : shaderNames ) {
+			Shader * shader = renderer->shader( shaderName, dir, fn );
+
+			if ( shader ) {
+				if ( shader->status )
+					fn->glAttachShader( id, shader->id );
+				else
+					throw QString( "depends on shader %1 which was not compiled successful:\r\n\r\n%2" ).arg( shaderName, shader->log );
+			} else {
+				throw QString( "shader %1 not found" ).arg( shaderName );
+			}
+		}
+
+		if ( !binaryPath.isEmpty() )
+			gl->extraFunctions()->glProgramParameteri( id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+
+		fn->glLinkProgram( id );
 
 		GLint result;
 
-		f->glGetProgramiv( id, GL_LINK_STATUS, &result );
+		fn->glGetProgramiv( id, GL_LINK_STATUS, &result );
 
 		if ( result != GL_TRUE ) {
 			GLint logLen = 0;
-			f->glGetProgramiv( id, GL_INFO_LOG_LENGTH, &logLen );
+			fn->glGetProgramiv( id, GL_INFO_LOG_LENGTH, &logLen );
 
 			if ( logLen != 0 ) {
 				char * log = new char[ logLen ];
-				f->glGetProgramInfoLog( id, logLen, 0, log );
+				fn->glGetProgramInfoLog( id, logLen, 0, log );
 				QString errlog( log );
 				delete[] log;
+				fn->glDeleteProgram( id );
 				id = 0;
 				throw errlog;
 			}
 		}
+
+		if ( !binaryPath.isEmpty() )
+			saveBinary( binaryPath, gl );
+
+		setUniformLocations( fn );
 	}
 	catch ( QString & x )
 	{
 		status = false;
-		Message::append( QObject::tr( "There were errors during shader compilation" ), QString( "%1:\r\n\r\n%2" ).arg( name ).arg( x ) );
+		error = x;
 		return false;
 	}
 	status = true;
 	return true;
 }
 
-void Renderer::Program::setUniformLocations()
+bool Renderer::Program::loadBinary( const QString & path, QOpenGLContext * gl )
+{
+	QFile file( path );
+	if ( !file.open( QIODevice::ReadOnly ) )
+		return false;
+
+	QByteArray data = file.readAll();
+
+	GLenum format;
+	if ( data.size() <= int( sizeof( format ) ) )
+		return false;
+
+	memcpy( &format, data.constData(), sizeof( format ) );
+	gl->extraFunctions()->glProgramBinary( id, format, data.constData() + sizeof( format ), data.size() - sizeof( format ) );
+
+	// The driver rejects binaries it can no longer use, e.g. after an update
+	GLint result = GL_FALSE;
+	gl->functions()->glGetProgramiv( id, GL_LINK_STATUS, &result );
+
+	return result == GL_TRUE;
+}
+
+void Renderer::Program::saveBinary( const QString & path, QOpenGLContext * gl )
+{
+	GLint length = 0;
+	gl->functions()->glGetProgramiv( id, GL_PROGRAM_BINARY_LENGTH, &length );
+	if ( length <= 0 || !QDir().mkpath( QFileInfo( path ).absolutePath() ) )
+		return;
+
+	GLenum format = 0;
+	QByteArray data( int( sizeof( format ) ) + length, Qt::Uninitialized );
+	gl->extraFunctions()->glGetProgramBinary( id, length, &length, &format, data.data() + sizeof( format ) );
+	memcpy( data.data(), &format, sizeof( format ) );
+	data.resize( int( sizeof( format ) ) + length );
+
+	QSaveFile file( path );
+	if ( file.open( QIODevice::WriteOnly ) && file.write( data ) == data.size() )
+		file.commit();
+}
+
+void Renderer::Program::setUniformLocations( QOpenGLFunctions * gl )
 {
 	for ( int i = 0; i < NUM_UNIFORM_TYPES; i++ )
-		uniformLocations[i] = f->glGetUniformLocation( id, uniforms[i].c_str() );
+		uniformLocations[i] = gl->glGetUniformLocation( id, uniforms[i].c_str() );
 }
 
+
+/*! Loads the shader programs on a context shared with the view
+ *
+ * Programs are shared between the contexts, so they can be used for drawing
+ * as soon as they are linked. Each one is handed to Renderer::collectPrograms()
+ * when it is ready, so that the view does not wait for all of them.
+ */
+class Renderer::Compiler final : public QThread
+{
+public:
+	Compiler( Renderer * r, const QDir & d, const QStringList & n )
+		: renderer( r ), dir( d ), names( n )
+	{
+		QOpenGLContext * current = QOpenGLContext::currentContext();
+		QSurface * currentSurface = current ? current->surface() : nullptr;
+
+		surface.setFormat( r->cx->format() );
+		surface.create();
+
+		context = new QOpenGLContext;
+		context->setFormat( r->cx->format() );
+		context->setShareContext( r->cx );
+
+		// Some drivers refuse to share or to make a context current on an offscreen surface
+		bool ok = surface.isValid() && context->create() && context->makeCurrent( &surface );
+		if ( ok )
+			context->doneCurrent();
+
+		if ( current )
+			current->makeCurrent( currentSurface );
+
+		if ( !ok ) {
+			delete context;
+			context = nullptr;
+			return;
+		}
+
+		context->moveToThread( this );
+	}
+
+	~Compiler()
+	{
+		requestInterruption();
+		wait();
+		delete context;
+	}
+
+	bool isValid() const { return context; }
+
+protected:
+	void run() override final
+	{
+		if ( context->makeCurrent( &surface ) ) {
+			renderer->loadPrograms( context, dir, names );
+			context->doneCurrent();
+		}
+
+		delete context;
+		context = nullptr;
+	}
+
+	Renderer * renderer;
+	QDir dir;
+	QStringList names;
+
+	QOffscreenSurface surface;
+	QOpenGLContext * context = nullptr;
+};
+
 Renderer::Renderer( QOpenGLContext * c, QOpenGLFunctions * f )
 	: cx( c ), fn( f )
 {
-	updateSettings();
+	// Only read the settings, the shaders are compiled once the view has initialized GL
+	QSettings settings;
+	cfg.useShaders = settings.value( "Settings/Render/General/Use Shaders", true ).toBool();
 
 	connect( NifSkope::getOptions(), &SettingsDialog::saveSettings, this, &Renderer::updateSettings );
 }
@@ -431,27 +602,96 @@ void Renderer::updateShaders()
 		dir.cd( "/usr/share/nifskope/shaders" );
 #endif
 
-	dir.setNameFilters( { "*.vert" } );
-	for ( const QString& name : dir.entryList() ) {
-		Shader * shader = new Shader( name, GL_VERTEX_SHADER, fn );
-		shader->load( dir.filePath( name ) );
-		shaders.insert( name, shader );
-	}
+	dir.setNameFilters( { "*.prog" } );
+	QStringList names = dir.entryList();
+
+	// Until the programs are ready, meshes are drawn with the fixed function pipeline
+	if ( QOpenGLContext::supportsThreadedOpenGL() ) {
+		compiler = new Compiler( this, dir, names );
 
-	dir.setNameFilters( { "*.frag" } );
-	for ( const QString& name : dir.entryList() ) {
-		Shader * shader = new Shader( name, GL_FRAGMENT_SHADER, fn );
-		shader->load( dir.filePath( name ) );
-		shaders.insert( name, shader );
+		if ( compiler->isValid() ) {
+			compiler->start();
+			return;
+		}
+
+		delete compiler;
+		compiler = nullptr;
 	}
 
-	dir.setNameFilters( { "*.prog" } );
-	for ( const QString& name : dir.entryList() ) {
+	loadPrograms( cx, dir, names );
+	collectPrograms();
+}
+
+void Renderer::loadPrograms( QOpenGLContext * gl, const QDir & dir, const QStringList & names )
+{
+	QOpenGLFunctions * glFuncs = gl->functions();
+
+	for ( const QString & name : names ) {
+		if ( QThread::currentThread()->isInterruptionRequested() )
+			break;
+
+		// Uniforms are set with the functions of the drawing context
 		Program * program = new Program( name, fn );
-		program->load( dir.filePath( name ), this );
-		program->setUniformLocations();
-		programs.insert( name, program );
+		QString error;
+		bool ok = program->load( dir.filePath( name ), this, gl, error );
+
+		// The program must be complete before another context uses it
+		if ( gl != cx )
+			glFuncs->glFinish();
+
+		QMutexLocker lock( &compiledMutex );
+		compiled.append( program );
+		if ( !ok )
+			compileErrors.append( QString( "%1:\r\n\r\n%2" ).arg( name, error ) );
+
+		if ( gl != cx )
+			QMetaObject::invokeMethod( this, "collectPrograms", Qt::QueuedConnection );
 	}
+
+	// Shaders are no longer needed once the programs are linked
+	qDeleteAll( shaders );
+	shaders.clear();
+}
+
+Renderer::Shader * Renderer::shader( const QString & name, const QDir & dir, QOpenGLFunctions * gl )
+{
+	Shader * shader = shaders.value( name );
+	if ( shader || !dir.exists( name ) )
+		return shader;
+
+	GLenum type;
+	if ( name.endsWith( ".vert" ) )
+		type = GL_VERTEX_SHADER;
+	else if ( name.endsWith( ".frag" ) )
+		type = GL_FRAGMENT_SHADER;
+	else
+		return nullptr;
+
+	shader = new Shader( name, type, gl );
+	shader->load( dir.filePath( name ) );
+	shaders.insert( name, shader );
+
+	return shader;
+}
+
+void Renderer::collectPrograms()
+{
+	QVector<Program *> ready;
+	QStringList errors;
+	{
+		QMutexLocker lock( &compiledMutex );
+		ready.swap( compiled );
+		errors.swap( compileErrors );
+	}
+
+	for ( Program * program : ready )
+		programs.insert( program->name, program );
+
+	for ( const QString & err : errors )
+		Message::append( QObject::tr( "There were errors during shader compilation" ), err );
+
+	if ( !ready.isEmpty() )
+		emit programsLoaded();
 }
 
 void Renderer::releaseShaders()
@@ -459,6 +699,14 @@ void Renderer::releaseShaders()
 	if ( !shader_ready )
 		return;
 
+	// Stop compiling, the programs it finished are released below
+	delete compiler;
+	compiler = nullptr;
+
+	qDeleteAll( compiled );
+	compiled.clear();
+	compileErrors.clear();
+
 	qDeleteAll( programs );
 	programs.clear();
 	qDeleteAll( shaders );
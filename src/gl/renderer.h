@@ -37,8 +37,10 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <QCoreApplication>
 #include <QMap>
+#include <QMutex>
 #include <QVector>
 #include <QString>
+#include <QStringList>
 
 #include <array>
 #include <string>
@@ -50,6 +52,7 @@ class NifModel;
 class Shape;
 class PropertyList;
 
+class QDir;
 class QOpenGLContext;
 class QOpenGLFunctions;
 
@@ -72,7 +75,7 @@ public:
 	//! Whether shader support is available
 	bool hasShaderSupport();
 
-	//! Updates shaders
+	//! Updates shaders, the programs are compiled in the background when possible
 	void updateShaders();
 	//! Releases shaders
 	void releaseShaders();
@@ -160,6 +163,14 @@ public:
 public slots:
 	void updateSettings();
 
+signals:
+	//! Emitted when programs compiled in the background have become available
+	void programsLoaded();
+
+protected slots:
+	//! Adds the programs finished by the background compiler
+	void collectPrograms();
+
 protected:
 	//! Base Condition class for shader programs
 	class Condition
@@ -225,6 +236,8 @@ public:
 		QString name;
 		GLuint id;
 		bool status;
+		//! Compilation errors
+		QString log;
 
 protected:
 		GLenum type;
@@ -237,7 +250,14 @@ public:
 		Program( const QString & name, QOpenGLFunctions * fn );
 		~Program();
 
-		bool load( const QString & filepath, Renderer * );
+		/*! Parse the .prog file and link the program
+		 *
+		 * @param filepath	The .prog file
+		 * @param renderer	The renderer providing the shaders
+		 * @param gl		The current context, which may differ from the drawing one
+		 * @param error		Set to the reason when loading fails
+		 */
+		bool load( const QString & filepath, Renderer * renderer, QOpenGLContext * gl, QString & error );
 
 		typedef enum
 		{
@@ -333,7 +353,12 @@ public:
 
 		int uniformLocations[NUM_UNIFORM_TYPES];
 
-		void setUniformLocations();
+		void setUniformLocations( QOpenGLFunctions * gl );
+
+		//! Load the linked program from the binary cache
+		bool loadBinary( const QString & path, QOpenGLContext * gl );
+		//! Save the linked program to the binary cache
+		void saveBinary( const QString & path, QOpenGLContext * gl );
 
 		void uni1f( UniformType var, float x );
 		void uni2f( UniformType var, float x, float y );
@@ -350,6 +375,26 @@ public:
 	QMap<QString, Shader *> shaders;
 	QMap<QString, Program *> programs;
 
+	//! Compiles the programs on a context shared with the view
+	class Compiler;
+	Compiler * compiler = nullptr;
+
+	//! Programs finished by the compiler and not yet collected
+	QVector<Program *> compiled;
+	//! Errors from the compiler not yet reported
+	QStringList compileErrors;
+	QMutex compiledMutex;
+
+	//! Identifies the GL driver, program binaries are only valid for the same one
+	QByteArray driver;
+	//! Whether program binaries can be retrieved and cached
+	bool binaryCache = false;
+
+	//! Get a shader by name from the shader folder, compiling it on the current context gl
+	Shader * shader( const QString & name, const QDir & dir, QOpenGLFunctions * gl );
+	//! Load the programs in the shader folder on the current context gl
+	void loadPrograms( QOpenGLContext * gl, const QDir & dir, const QStringList & names );
+
 	bool setupProgram( Program *, Shape *, const PropertyList &, const QVector<QModelIndex> & iBlocks, bool eval = true );
 	void setupFixedFunction( Shape *, const PropertyList & );
 
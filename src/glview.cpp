@@ -34,6 +34,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "message.h"
 #include "nifskope.h"
+#include "startuptrace.h"
 #include "gl/renderer.h"
 #include "gl/glmesh.h"
 #include "gl/gltex.h"
@@ -201,6 +202,7 @@ GLView::GLView( const QGLFormat & format, QWidget * p, const QGLWidget * shareWi
 	scene = new Scene( textures, glContext, glFuncs );
 	connect( textures, &TexCache::sigRefresh, this, static_cast<void (GLView::*)()>(&GLView::update) );
 	connect( scene, &Scene::sceneUpdated, this, static_cast<void (GLView::*)()>(&GLView::update) );
+	connect( scene->renderer, &Renderer::programsLoaded, this, static_cast<void (GLView::*)()>(&GLView::update) );
 
 	timer = new QTimer( this );
 	timer->setInterval( 1000 / FPS );
@@ -288,6 +290,8 @@ void GLView::updateAnimationState( bool checked )
 
 void GLView::initializeGL()
 {
+	StartupTrace::Phase phase( "Initialize GL" );
+
 	GLenum err;
 	
 	if ( scene->options & Scene::DoMultisampling ) {
@@ -303,8 +307,9 @@ void GLView::initializeGL()
 
 	initializeTextureUnits( glContext );
 
+	// Start compiling the shaders after the first frame, which is drawn without them
 	if ( scene->renderer->initialize() )
-		updateShaders();
+		QTimer::singleShot( 0, this, &GLView::updateShaders );
 
 	// Initial viewport values
 	//	Made viewport and aspect member variables.
@@ -684,6 +689,8 @@ void GLView::paintGL()
 	// Manually handle the buffer swap
 	swapBuffers();
 
+	StartupTrace::finish();
+
 #ifdef USE_GL_QPAINTER
 	painter.end();
 #endif
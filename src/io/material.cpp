@@ -116,7 +116,8 @@ QByteArray Material::find( QString path )
 		}
 	}
 
-	for ( FSArchiveFile * archive : FSManager::archiveList() ) {
+	for ( const std::shared_ptr<FSArchiveHandler> & handler : FSManager::archiveList() ) {
+		FSArchiveFile * archive = handler->getArchive();
 		if ( archive ) {
 			filename = QDir::fromNativeSeparators( path.toLower() );
 			if ( archive->hasFile( filename ) ) {
@@ -307,7 +307,7 @@ bool NifIStream::read( NifValue & val )
 			if ( len < 0 )
 				return false;
 
-			*static_cast<QByteArray *>(val.val.data) = device->read( len );
+			*static_cast<QByteArray *>(val.val.data) = NifValue::share( device->read( len ) );
 			return static_cast<QByteArray *>(val.val.data)->count() == len;
 		}
 	case NifValue::tStringPalette:
@@ -318,7 +318,7 @@ bool NifIStream::read( NifValue & val )
 			if ( len > 0xffff || len < 0 )
 				return false;
 
-			*static_cast<QByteArray *>(val.val.data) = device->read( len );
+			*static_cast<QByteArray *>(val.val.data) = NifValue::share( device->read( len ) );
 			device->read( (char *)&len, 4 );
 			return true;
 		}
@@ -467,7 +467,11 @@ bool NifIStream::read( NifValue & val )
 		{
 			if ( val.val.data ) {
 				QByteArray * array = static_cast<QByteArray *>(val.val.data);
-				return device->read( array->data(), array->size() ) == array->size();
+				if ( device->read( array->data(), array->size() ) != array->size() )
+					return false;
+
+				*array = NifValue::share( *array );
+				return true;
 			}
 
 			return false;
@@ -778,7 +782,7 @@ bool NifOStream::write( const NifValue & val )
 
 		if ( val.val.data ) {
 			QByteArray * array = static_cast<QByteArray *>(val.val.data);
-			return device->write( array->data(), array->size() ) == array->size();
+			return device->write( array->constData(), array->size() ) == array->size();
 		}
 
 		return true;
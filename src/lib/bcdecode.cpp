@@ -0,0 +1,425 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "bcdecode.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+/*! \file bcdecode.cpp
+ * \brief Software decoding of BC1-BC5 and BC7 textures
+ *
+ * Used when the GL cannot sample a compressed format itself, as with software
+ * renderers lacking S3TC or BPTC support.
+ */
+
+//! Expands 5 or 6 bit color components to 8 bits
+static inline quint8 expandBits( quint32 v, int bits )
+{
+	v <<= 8 - bits;
+	return quint8( v | (v >> bits) );
+}
+
+//! Decodes the color part of a BC1-BC3 block
+static void decodeColorBlock( const quint8 * b, quint8 * out, bool fourColor, bool punchAlpha )
+{
+	quint32 c0 = b[0] | (b[1] << 8);
+	quint32 c1 = b[2] | (b[3] << 8);
+	quint32 indices = b[4] | (b[5] << 8) | (b[6] << 16) | (quint32( b[7] ) << 24);
+
+	quint8 colors[4][4];
+	colors[0][0] = expandBits( c0 >> 11, 5 );
+	colors[0][1] = expandBits( (c0 >> 5) & 0x3f, 6 );
+	colors[0][2] = expandBits( c0 & 0x1f, 5 );
+	colors[0][3] = 255;
+	colors[1][0] = expandBits( c1 >> 11, 5 );
+	colors[1][1] = expandBits( (c1 >> 5) & 0x3f, 6 );
+	colors[1][2] = expandBits( c1 & 0x1f, 5 );
+	colors[1][3] = 255;
+
+	if ( fourColor || c0 > c1 ) {
+		for ( int c = 0; c < 3; c++ ) {
+			colors[2][c] = quint8( (2 * colors[0][c] + colors[1][c]) / 3 );
+			colors[3][c] = quint8( (colors[0][c] + 2 * colors[1][c]) / 3 );
+		}
+		colors[3][3] = 255;
+	} else {
+		for ( int c = 0; c < 3; c++ ) {
+			colors[2][c] = quint8( (colors[0][c] + colors[1][c]) / 2 );
+			colors[3][c] = 0;
+		}
+		colors[3][3] = punchAlpha ? 0 : 255;
+	}
+	colors[2][3] = 255;
+
+	for ( int i = 0; i < 16; i++ )
+		memcpy( out + i * 4, colors[(indices >> (2 * i)) & 3], 4 );
+}
+
+//! Decodes a BC3 alpha or BC4 channel block into one channel
+static void decodeChannelBlock( const quint8 * b, quint8 * out, int channel )
+{
+	quint32 a0 = b[0];
+	quint32 a1 = b[1];
+
+	quint8 values[8];
+	values[0] = quint8( a0 );
+	values[1] = quint8( a1 );
+
+	if ( a0 > a1 ) {
+		for ( int i = 1; i < 7; i++ )
+			values[i + 1] = quint8( ((7 - i) * a0 + i * a1) / 7 );
+	} else {
+		for ( int i = 1; i < 5; i++ )
+			values[i + 1] = quint8( ((5 - i) * a0 + i * a1) / 5 );
+		values[6] = 0;
+		values[7] = 255;
+	}
+
+	quint64 indices = 0;
+	for ( int i = 0; i < 6; i++ )
+		indices |= quint64( b[2 + i] ) << (8 * i);
+
+	for ( int i = 0; i < 16; i++ )
+		out[i * 4 + channel] = values[(indices >> (3 * i)) & 7];
+}
+
+//! Decodes the explicit 4-bit alpha of a BC2 block
+static void decodeExplicitAlpha( const quint8 * b, quint8 * out )
+{
+	for ( int i = 0; i < 16; i++ )
+		out[i * 4 + 3] = quint8( ((b[i / 2] >> (4 * (i & 1))) & 0xf) * 17 );
+}
+
+
+//! Layout of a BC7 mode
+struct BC7Mode
+{
+	int subsets;
+	int partitionBits;
+	int rotationBits;
+	int indexSelectionBits;
+	int colorBits;
+	int alphaBits;
+	int endpointPBits;
+	int sharedPBits;
+	int indexBits;
+	int indexBits2;
+};
+
+static const BC7Mode bc7Modes[8] = {
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+};
+
+//! Subset of each pixel for two subsets, one bit per pixel
+static const quint16 bc7Partitions2[64] = {
+	0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+	0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+	0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+	0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+	0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+	0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+	0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+	0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+};
+
+//! Subset of each pixel for three subsets, two bits per pixel
+static const quint32 bc7Partitions3[64] = {
+	0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+	0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+	0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+	0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+	0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+	0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+	0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+	0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254
+};
+
+//! Anchor pixel of the second subset for two subsets
+static const quint8 bc7Anchors2[64] = {
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+	15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+	 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+};
+
+//! Anchor pixel of the second subset for three subsets
+static const quint8 bc7Anchors3a[64] = {
+	 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+	 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+	 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+	 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3
+};
+
+//! Anchor pixel of the third subset for three subsets
+static const quint8 bc7Anchors3b[64] = {
+	15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+	15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+	15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+	15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8
+};
+
+static const quint8 bc7Weights2[4] = { 0, 21, 43, 64 };
+static const quint8 bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const quint8 bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static inline const quint8 * bc7Weights( int bits )
+{
+	return (bits == 2) ? bc7Weights2 : (bits == 3) ? bc7Weights3 : bc7Weights4;
+}
+
+static inline quint8 bc7Interpolate( int e0, int e1, int weight )
+{
+	return quint8( ((64 - weight) * e0 + weight * e1 + 32) >> 6 );
+}
+
+//! Reads the fields of a 128-bit block from the lowest bit up
+class BlockBits
+{
+public:
+	BlockBits( const quint8 * b )
+	{
+		for ( int i = 0; i < 8; i++ ) {
+			lo |= quint64( b[i] ) << (8 * i);
+			hi |= quint64( b[8 + i] ) << (8 * i);
+		}
+	}
+
+	quint32 read( int count )
+	{
+		if ( count == 0 )
+			return 0;
+
+		quint64 v;
+		if ( pos >= 64 )
+			v = hi >> (pos - 64);
+		else if ( pos + count <= 64 )
+			v = lo >> pos;
+		else
+			v = (lo >> pos) | (hi << (64 - pos));
+
+		pos += count;
+		return quint32( v & ((quint64( 1 ) << count) - 1) );
+	}
+
+	int pos = 0;
+
+private:
+	quint64 lo = 0;
+	quint64 hi = 0;
+};
+
+//! Decodes a BC7 block
+static void decodeBC7Block( const quint8 * b, quint8 * out )
+{
+	int mode = 0;
+	while ( mode < 8 && !(b[0] & (1 << mode)) )
+		mode++;
+
+	// Reserved mode, decodes to transparent black
+	if ( mode == 8 ) {
+		memset( out, 0, 64 );
+		return;
+	}
+
+	const BC7Mode & m = bc7Modes[mode];
+	BlockBits bits( b );
+	bits.pos = mode + 1;
+
+	int partition = bits.read( m.partitionBits );
+	int rotation = bits.read( m.rotationBits );
+	int indexSelection = bits.read( m.indexSelectionBits );
+
+	const int endpointCount = m.subsets * 2;
+	int endpoints[6][4];
+
+	for ( int c = 0; c < 3; c++ ) {
+		for ( int e = 0; e < endpointCount; e++ )
+			endpoints[e][c] = bits.read( m.colorBits );
+	}
+	for ( int e = 0; e < endpointCount; e++ )
+		endpoints[e][3] = m.alphaBits ? bits.read( m.alphaBits ) : 255;
+
+	int colorBits = m.colorBits;
+	int alphaBits = m.alphaBits;
+
+	if ( m.endpointPBits || m.sharedPBits ) {
+		int pbits[6];
+		if ( m.endpointPBits ) {
+			for ( int e = 0; e < endpointCount; e++ )
+				pbits[e] = bits.read( 1 );
+		} else {
+			for ( int s = 0; s < m.subsets; s++ )
+				pbits[2 * s] = pbits[2 * s + 1] = bits.read( 1 );
+		}
+
+		for ( int e = 0; e < endpointCount; e++ ) {
+			for ( int c = 0; c < (alphaBits ? 4 : 3); c++ )
+				endpoints[e][c] = (endpoints[e][c] << 1) | pbits[e];
+		}
+
+		colorBits++;
+		if ( alphaBits )
+			alphaBits++;
+	}
+
+	for ( int e = 0; e < endpointCount; e++ ) {
+		for ( int c = 0; c < 3; c++ )
+			endpoints[e][c] = expandBits( endpoints[e][c], colorBits );
+		if ( alphaBits )
+			endpoints[e][3] = expandBits( endpoints[e][3], alphaBits );
+	}
+
+	int subset[16];
+	for ( int i = 0; i < 16; i++ ) {
+		if ( m.subsets == 2 )
+			subset[i] = (bc7Partitions2[partition] >> i) & 1;
+		else if ( m.subsets == 3 )
+			subset[i] = (bc7Partitions3[partition] >> (2 * i)) & 3;
+		else
+			subset[i] = 0;
+	}
+
+	// Anchor indices have their top bit left out
+	int indices[16];
+	for ( int i = 0; i < 16; i++ ) {
+		bool anchor = (i == 0)
+			|| (m.subsets == 2 && i == bc7Anchors2[partition])
+			|| (m.subsets == 3 && (i == bc7Anchors3a[partition] || i == bc7Anchors3b[partition]));
+		indices[i] = bits.read( m.indexBits - (anchor ? 1 : 0) );
+	}
+
+	int indices2[16];
+	if ( m.indexBits2 ) {
+		for ( int i = 0; i < 16; i++ )
+			indices2[i] = bits.read( m.indexBits2 - (i == 0 ? 1 : 0) );
+	}
+
+	for ( int i = 0; i < 16; i++ ) {
+		const int * e0 = endpoints[2 * subset[i]];
+		const int * e1 = endpoints[2 * subset[i] + 1];
+		quint8 * p = out + i * 4;
+
+		int colorWeight, alphaWeight;
+		if ( !m.indexBits2 ) {
+			colorWeight = alphaWeight = bc7Weights( m.indexBits )[indices[i]];
+		} else if ( indexSelection ) {
+			colorWeight = bc7Weights( m.indexBits2 )[indices2[i]];
+			alphaWeight = bc7Weights( m.indexBits )[indices[i]];
+		} else {
+			colorWeight = bc7Weights( m.indexBits )[indices[i]];
+			alphaWeight = bc7Weights( m.indexBits2 )[indices2[i]];
+		}
+
+		for ( int c = 0; c < 3; c++ )
+			p[c] = bc7Interpolate( e0[c], e1[c], colorWeight );
+		p[3] = bc7Interpolate( e0[3], e1[3], alphaWeight );
+
+		// Rotation swaps alpha with a color channel
+		if ( rotation )
+			std::swap( p[3], p[rotation - 1] );
+	}
+}
+
+// see bcdecode.h
+int bcBlockSize( BCFormat format )
+{
+	switch ( format ) {
+	case BCFormat::BC1:
+	case BCFormat::BC1A:
+	case BCFormat::BC4:
+		return 8;
+	default:
+		return 16;
+	}
+}
+
+// see bcdecode.h
+void decodeBC( BCFormat format, const quint8 * src, int width, int height, quint8 * dst )
+{
+	const int blockSize = bcBlockSize( format );
+	const int blocksX = (width + 3) / 4;
+	const int blocksY = (height + 3) / 4;
+
+	quint8 block[64];
+
+	for ( int by = 0; by < blocksY; by++ ) {
+		for ( int bx = 0; bx < blocksX; bx++, src += blockSize ) {
+			switch ( format ) {
+			case BCFormat::BC1:
+				decodeColorBlock( src, block, false, false );
+				break;
+			case BCFormat::BC1A:
+				decodeColorBlock( src, block, false, true );
+				break;
+			case BCFormat::BC2:
+				decodeColorBlock( src + 8, block, true, false );
+				decodeExplicitAlpha( src, block );
+				break;
+			case BCFormat::BC3:
+				decodeColorBlock( src + 8, block, true, false );
+				decodeChannelBlock( src, block, 3 );
+				break;
+			case BCFormat::BC4:
+				memset( block, 0, sizeof( block ) );
+				decodeChannelBlock( src, block, 0 );
+				for ( int i = 0; i < 16; i++ )
+					block[i * 4 + 3] = 255;
+				break;
+			case BCFormat::BC5:
+				memset( block, 0, sizeof( block ) );
+				decodeChannelBlock( src, block, 0 );
+				decodeChannelBlock( src + 8, block, 1 );
+				for ( int i = 0; i < 16; i++ )
+					block[i * 4 + 3] = 255;
+				break;
+			case BCFormat::BC7:
+				decodeBC7Block( src, block );
+				break;
+			}
+
+			// Copy the part of the block inside the image
+			const int x = bx * 4;
+			const int w = std::min( 4, width - x );
+			for ( int row = 0; row < 4 && by * 4 + row < height; row++ )
+				memcpy( dst + ((by * 4 + row) * width + x) * 4, block + row * 16, w * 4 );
+		}
+	}
+}
@@ -0,0 +1,68 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef BCDECODE_H
+#define BCDECODE_H
+
+#include <QtGlobal>
+
+
+//! Block compressed texture formats which can be decoded in software
+enum class BCFormat
+{
+	BC1,  //!< DXT1, opaque
+	BC1A, //!< DXT1 with 1-bit alpha
+	BC2,  //!< DXT3
+	BC3,  //!< DXT5
+	BC4,  //!< ATI1, one unsigned channel
+	BC5,  //!< ATI2, two unsigned channels
+	BC7   //!< BPTC, unsigned
+};
+
+//! Size in bytes of a 4x4 block of a format
+int bcBlockSize( BCFormat format );
+
+/*! Decode consecutive rows of blocks into RGBA8
+ *
+ * Single channel formats give ( r, 0, 0, 255 ) and two channel formats
+ * ( r, g, 0, 255 ), as the GL would sample them. Blocks are decoded
+ * independently, so bands of rows can be decoded on several threads.
+ *
+ * @param format		The format of the blocks
+ * @param src			The first block of the rows
+ * @param width			Width of the image in pixels
+ * @param height		Number of pixel rows to decode; the last row of blocks may be cut off
+ * @param dst			Receives width * height pixels, tightly packed
+ */
+void decodeBC( BCFormat format, const quint8 * src, int width, int height, quint8 * dst );
+
+#endif
@@ -0,0 +1,356 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "boundingvolume.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+
+//! Point in double precision, so nearly degenerate supports stay stable
+struct BoundPoint
+{
+	double x = 0, y = 0, z = 0;
+
+	BoundPoint() {}
+	BoundPoint( double a, double b, double c ) : x( a ), y( b ), z( c ) {}
+	BoundPoint( const Vector3 & v ) : x( v[0] ), y( v[1] ), z( v[2] ) {}
+
+	BoundPoint operator+( const BoundPoint & o ) const { return BoundPoint( x + o.x, y + o.y, z + o.z ); }
+	BoundPoint operator-( const BoundPoint & o ) const { return BoundPoint( x - o.x, y - o.y, z - o.z ); }
+	BoundPoint operator*( double s ) const { return BoundPoint( x * s, y * s, z * s ); }
+
+	double dot( const BoundPoint & o ) const { return x * o.x + y * o.y + z * o.z; }
+	BoundPoint cross( const BoundPoint & o ) const
+	{
+		return BoundPoint( y * o.z - z * o.y, z * o.x - x * o.z, x * o.y - y * o.x );
+	}
+};
+
+//! Sphere with squared radius
+struct BoundBall
+{
+	BoundPoint center;
+	double radius2 = -1;
+
+	bool contains( const BoundPoint & p ) const
+	{
+		BoundPoint d = p - center;
+		return d.dot( d ) <= radius2 * ( 1.0 + 1e-9 ) + 1e-12;
+	}
+};
+
+static BoundBall ballFrom( const BoundPoint & a )
+{
+	BoundBall b;
+	b.center = a;
+	b.radius2 = 0;
+	return b;
+}
+
+static BoundBall ballFrom( const BoundPoint & a, const BoundPoint & b )
+{
+	BoundBall s;
+	s.center = ( a + b ) * 0.5;
+	BoundPoint d = b - a;
+	s.radius2 = d.dot( d ) * 0.25;
+	return s;
+}
+
+//! Smallest of the candidate balls that contains all given points
+static BoundBall smallestContaining( const BoundBall * candidates, int count, const BoundPoint * points, int numPoints )
+{
+	BoundBall best;
+	for ( int i = 0; i < count; i++ ) {
+		const BoundBall & c = candidates[i];
+		if ( best.radius2 >= 0 && c.radius2 >= best.radius2 )
+			continue;
+
+		bool all = true;
+		for ( int p = 0; p < numPoints && all; p++ )
+			all = c.contains( points[p] );
+
+		if ( all )
+			best = c;
+	}
+	return best;
+}
+
+//! Smallest ball with three points on its boundary
+static BoundBall ballFrom( const BoundPoint & a, const BoundPoint & b, const BoundPoint & c )
+{
+	BoundPoint u = b - a;
+	BoundPoint v = c - a;
+	BoundPoint w = u.cross( v );
+	double w2 = w.dot( w );
+
+	if ( w2 <= 1e-18 * u.dot( u ) * v.dot( v ) ) {
+		// Collinear, the ball through the farthest pair encloses the third point
+		BoundBall pairs[3] = { ballFrom( a, b ), ballFrom( a, c ), ballFrom( b, c ) };
+		BoundPoint pts[3] = { a, b, c };
+		return smallestContaining( pairs, 3, pts, 3 );
+	}
+
+	BoundBall s;
+	BoundPoint offset = ( v * u.dot( u ) - u * v.dot( v ) ).cross( w ) * ( 0.5 / w2 );
+	s.center = a + offset;
+	s.radius2 = offset.dot( offset );
+	return s;
+}
+
+//! Smallest ball with four points on its boundary
+static BoundBall ballFrom( const BoundPoint & a, const BoundPoint & b, const BoundPoint & c, const BoundPoint & d )
+{
+	BoundPoint u = b - a;
+	BoundPoint v = c - a;
+	BoundPoint t = d - a;
+	double det = u.dot( v.cross( t ) );
+	double scale = std::sqrt( u.dot( u ) * v.dot( v ) * t.dot( t ) );
+
+	if ( std::abs( det ) <= 1e-12 * scale ) {
+		// Coplanar, one of the triangles has a circumcircle around the fourth point
+		BoundBall tris[4] = { ballFrom( a, b, c ), ballFrom( a, b, d ), ballFrom( a, c, d ), ballFrom( b, c, d ) };
+		BoundPoint pts[4] = { a, b, c, d };
+		BoundBall s = smallestContaining( tris, 4, pts, 4 );
+		return ( s.radius2 >= 0 ) ? s : tris[0];
+	}
+
+	BoundBall s;
+	BoundPoint offset = ( v.cross( t ) * u.dot( u ) + t.cross( u ) * v.dot( v ) + u.cross( v ) * t.dot( t ) ) * ( 0.5 / det );
+	s.center = a + offset;
+	s.radius2 = offset.dot( offset );
+	return s;
+}
+
+void boundingSphere( const QVector<Vector3> & points, Vector3 & center, float & radius )
+{
+	int n = points.count();
+	if ( n == 0 ) {
+		center = Vector3();
+		radius = -1;
+		return;
+	}
+
+	QVector<BoundPoint> p( n );
+	BoundPoint * pts = p.data();
+	for ( int i = 0; i < n; i++ )
+		pts[i] = BoundPoint( points[i] );
+
+	// A fixed seed keeps the result identical between runs
+	std::mt19937 rng( 0x9e3779b9 );
+	std::shuffle( pts, pts + n, rng );
+
+	// Visit the extreme points along each axis first
+	int extremes[6] = { 0, 0, 0, 0, 0, 0 };
+	for ( int i = 1; i < n; i++ ) {
+		const BoundPoint & q = pts[i];
+		if ( q.x < pts[extremes[0]].x ) extremes[0] = i;
+		if ( q.x > pts[extremes[1]].x ) extremes[1] = i;
+		if ( q.y < pts[extremes[2]].y ) extremes[2] = i;
+		if ( q.y > pts[extremes[3]].y ) extremes[3] = i;
+		if ( q.z < pts[extremes[4]].z ) extremes[4] = i;
+		if ( q.z > pts[extremes[5]].z ) extremes[5] = i;
+	}
+
+	int front = 0;
+	for ( int e = 0; e < 6; e++ ) {
+		int idx = extremes[e];
+		if ( idx < front )
+			continue;
+
+		std::swap( pts[front], pts[idx] );
+		for ( int f = e + 1; f < 6; f++ ) {
+			if ( extremes[f] == front )
+				extremes[f] = idx;
+		}
+		front++;
+	}
+
+	BoundBall ball = ballFrom( pts[0] );
+	for ( int i = 1; i < n; i++ ) {
+		if ( ball.contains( pts[i] ) )
+			continue;
+
+		ball = ballFrom( pts[i] );
+		for ( int j = 0; j < i; j++ ) {
+			if ( ball.contains( pts[j] ) )
+				continue;
+
+			ball = ballFrom( pts[i], pts[j] );
+			for ( int k = 0; k < j; k++ ) {
+				if ( ball.contains( pts[k] ) )
+					continue;
+
+				ball = ballFrom( pts[i], pts[j], pts[k] );
+				for ( int l = 0; l < k; l++ ) {
+					if ( !ball.contains( pts[l] ) )
+						ball = ballFrom( pts[i], pts[j], pts[k], pts[l] );
+				}
+			}
+		}
+	}
+
+	center = Vector3( float( ball.center.x ), float( ball.center.y ), float( ball.center.z ) );
+
+	// Round up so that every point stays inside in single precision
+	radius = 0;
+	for ( const Vector3 & v : points )
+		radius = std::max( radius, ( v - center ).squaredLength() );
+	radius = std::sqrt( radius );
+}
+
+//! Eigenvectors of a symmetric 3x3 matrix by Jacobi rotations, as the columns of \a vecs
+static void symmetricEigenvectors( double a[3][3], double vecs[3][3] )
+{
+	for ( int r = 0; r < 3; r++ ) {
+		for ( int c = 0; c < 3; c++ )
+			vecs[r][c] = ( r == c ) ? 1.0 : 0.0;
+	}
+
+	for ( int sweep = 0; sweep < 32; sweep++ ) {
+		double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+		if ( off < 1e-24 )
+			break;
+
+		for ( int p = 0; p < 2; p++ ) {
+			for ( int q = p + 1; q < 3; q++ ) {
+				if ( std::abs( a[p][q] ) < 1e-30 )
+					continue;
+
+				double theta = ( a[q][q] - a[p][p] ) / ( 2.0 * a[p][q] );
+				double t = ( theta >= 0 ? 1.0 : -1.0 ) / ( std::abs( theta ) + std::sqrt( theta * theta + 1.0 ) );
+				double c = 1.0 / std::sqrt( t * t + 1.0 );
+				double s = t * c;
+
+				for ( int k = 0; k < 3; k++ ) {
+					double akp = a[k][p];
+					double akq = a[k][q];
+					a[k][p] = c * akp - s * akq;
+					a[k][q] = s * akp + c * akq;
+				}
+
+				for ( int k = 0; k < 3; k++ ) {
+					double apk = a[p][k];
+					double aqk = a[q][k];
+					a[p][k] = c * apk - s * aqk;
+					a[q][k] = s * apk + c * aqk;
+				}
+
+				for ( int k = 0; k < 3; k++ ) {
+					double vkp = vecs[k][p];
+					double vkq = vecs[k][q];
+					vecs[k][p] = c * vkp - s * vkq;
+					vecs[k][q] = s * vkp + c * vkq;
+				}
+			}
+		}
+	}
+}
+
+//! Fit a box with the given axes around the points
+static OrientedBox fitBox( const QVector<Vector3> & points, const Vector3 axis[3] )
+{
+	Vector3 mn( FLT_MAX, FLT_MAX, FLT_MAX );
+	Vector3 mx( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+
+	for ( const Vector3 & v : points ) {
+		for ( int a = 0; a < 3; a++ ) {
+			float d = Vector3::dotproduct( v, axis[a] );
+			mn[a] = std::min( mn[a], d );
+			mx[a] = std::max( mx[a], d );
+		}
+	}
+
+	OrientedBox box;
+	Vector3 mid = ( mn + mx ) / 2;
+	box.extents = ( mx - mn ) / 2;
+	box.center = axis[0] * mid[0] + axis[1] * mid[1] + axis[2] * mid[2];
+
+	for ( int a = 0; a < 3; a++ ) {
+		for ( int c = 0; c < 3; c++ )
+			box.axes( a, c ) = axis[a][c];
+	}
+
+	return box;
+}
+
+OrientedBox boundingBox( const QVector<Vector3> & points )
+{
+	static const Vector3 worldAxes[3] = { Vector3( 1, 0, 0 ), Vector3( 0, 1, 0 ), Vector3( 0, 0, 1 ) };
+
+	if ( points.isEmpty() )
+		return OrientedBox();
+
+	OrientedBox aligned = fitBox( points, worldAxes );
+	if ( points.count() < 4 )
+		return aligned;
+
+	double mean[3] = { 0, 0, 0 };
+	for ( const Vector3 & v : points ) {
+		for ( int a = 0; a < 3; a++ )
+			mean[a] += v[a];
+	}
+	for ( int a = 0; a < 3; a++ )
+		mean[a] /= points.count();
+
+	double cov[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+	for ( const Vector3 & v : points ) {
+		double d[3] = { v[0] - mean[0], v[1] - mean[1], v[2] - mean[2] };
+		for ( int r = 0; r < 3; r++ ) {
+			for ( int c = r; c < 3; c++ )
+				cov[r][c] += d[r] * d[c];
+		}
+	}
+	cov[1][0] = cov[0][1];
+	cov[2][0] = cov[0][2];
+	cov[2][1] = cov[1][2];
+
+	double vecs[3][3];
+	symmetricEigenvectors( cov, vecs );
+
+	Vector3 principal[3];
+	for ( int a = 0; a < 3; a++ ) {
+		principal[a] = Vector3( float( vecs[0][a] ), float( vecs[1][a] ), float( vecs[2][a] ) );
+		principal[a].normalize();
+	}
+
+	// Keep a right-handed basis so the axes form a rotation
+	principal[2] = Vector3::crossproduct( principal[0], principal[1] );
+	principal[2].normalize();
+	principal[1] = Vector3::crossproduct( principal[2], principal[0] );
+
+	OrientedBox oriented = fitBox( points, principal );
+
+	return ( oriented.volume() < aligned.volume() ) ? oriented : aligned;
+}
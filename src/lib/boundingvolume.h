@@ -0,0 +1,77 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef BOUNDINGVOLUME_H
+#define BOUNDINGVOLUME_H
+
+#include "data/niftypes.h"
+
+#include <QVector>
+
+
+//! A box with arbitrary orientation
+struct OrientedBox
+{
+	//! Center of the box
+	Vector3 center;
+	//! Orthonormal axes of the box, as the rows of a rotation
+	Matrix axes;
+	//! Half the size of the box along each axis
+	Vector3 extents;
+
+	//! The volume of the box
+	float volume() const { return 8.0f * extents[0] * extents[1] * extents[2]; }
+};
+
+/*! Find the smallest sphere enclosing a set of points
+ *
+ * Uses Welzl's randomized incremental algorithm, which runs in linear expected
+ * time. The points are visited in a fixed pseudo-random order with the extreme
+ * points first, so results are repeatable and the first guess is already close.
+ *
+ * @param points		The points to enclose
+ * @param center		Receives the center of the sphere
+ * @param radius		Receives the radius of the sphere, -1 if there are no points
+ */
+void boundingSphere( const QVector<Vector3> & points, Vector3 & center, float & radius );
+
+/*! Find a tight box enclosing a set of points
+ *
+ * The box is aligned with the principal axes of the points, unless the box
+ * aligned with the coordinate axes is smaller.
+ *
+ * @param points		The points to enclose
+ * @return The box, with zero extents if there are no points
+ */
+OrientedBox boundingBox( const QVector<Vector3> & points );
+
+#endif
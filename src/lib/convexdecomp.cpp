@@ -0,0 +1,290 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "convexdecomp.h"
+
+#include "lib/qhull.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+
+//! Indices of the points furthest along @p numDirs directions spread over the sphere
+static QVector<int> extremePoints( const QVector<Vector3> & points, int numDirs )
+{
+	QVector<int> picked;
+	QVector<bool> used( points.count(), false );
+
+	// Fibonacci sphere
+	const float golden = float( PI ) * ( 3.0f - std::sqrt( 5.0f ) );
+
+	for ( int d = 0; d < numDirs; d++ ) {
+		float z = 1.0f - ( 2.0f * d + 1.0f ) / numDirs;
+		float r = std::sqrt( std::max( 0.0f, 1.0f - z * z ) );
+		Vector3 dir( r * std::cos( golden * d ), r * std::sin( golden * d ), z );
+
+		int best = 0;
+		float bestDist = -FLT_MAX;
+		for ( int i = 0; i < points.count(); i++ ) {
+			float dist = Vector3::dotproduct( points[i], dir );
+			if ( dist > bestDist ) {
+				bestDist = dist;
+				best = i;
+			}
+		}
+
+		if ( !used[best] ) {
+			used[best] = true;
+			picked.append( best );
+		}
+	}
+
+	return picked;
+}
+
+//! The most extreme points, at most @p budget of them
+static QVector<Vector3> reducePoints( const QVector<Vector3> & points, int budget )
+{
+	// More directions find more distinct points, find the most directions within the budget
+	int good = budget;
+	QVector<int> picked = extremePoints( points, good );
+
+	int bad = 0;
+	for ( int k = good * 2; k <= budget * 16; k *= 2 ) {
+		QVector<int> p = extremePoints( points, k );
+		if ( p.count() > budget ) {
+			bad = k;
+			break;
+		}
+		good = k;
+		picked = p;
+	}
+
+	if ( bad ) {
+		for ( int step = 0; step < 6 && bad - good > 1; step++ ) {
+			int k = ( good + bad ) / 2;
+			QVector<int> p = extremePoints( points, k );
+			if ( p.count() > budget ) {
+				bad = k;
+			} else {
+				good = k;
+				picked = p;
+			}
+		}
+	}
+
+	QVector<Vector3> reduced;
+	reduced.reserve( picked.count() );
+	for ( int i : picked )
+		reduced.append( points[i] );
+
+	return reduced;
+}
+
+ConvexHull convexHull( const QVector<Vector3> & points, int maxVerts, float roundError )
+{
+	ConvexHull hull;
+
+	if ( points.count() < 4 )
+		return hull;
+
+	QVector<Vector4> hullVerts, hullNorms;
+	compute_convex_hull( points, hullVerts, hullNorms, roundError );
+
+	for ( const Vector4 & v : hullVerts )
+		hull.verts.append( Vector3( v ) );
+
+	std::sort( hull.verts.begin(), hull.verts.end(), Vector3::lexLessThan );
+	hull.verts.erase( std::unique( hull.verts.begin(), hull.verts.end() ), hull.verts.end() );
+
+	hull.planes = hullNorms;
+	std::sort( hull.planes.begin(), hull.planes.end(), Vector4::lexLessThan );
+	hull.planes.erase( std::unique( hull.planes.begin(), hull.planes.end() ), hull.planes.end() );
+
+	if ( maxVerts >= 4 && hull.verts.count() > maxVerts ) {
+		QVector<Vector3> reduced = reducePoints( hull.verts, maxVerts );
+		if ( reduced.count() >= 4 )
+			return convexHull( reduced, 0, roundError );
+	}
+
+	return hull;
+}
+
+//! Depth of a point inside a hull, negative if outside
+static float hullDepth( const ConvexHull & hull, const Vector3 & p )
+{
+	float depth = FLT_MAX;
+	for ( const Vector4 & plane : hull.planes )
+		depth = std::min( depth, -( Vector3::dotproduct( Vector3( plane ), p ) + plane[3] ) );
+
+	return depth;
+}
+
+//! A part of the mesh during decomposition
+struct ConvexPart
+{
+	QVector<int> triangles;
+	ConvexHull hull;
+	//! Deepest vertex inside the hull, and its depth
+	Vector3 deepest;
+	float depth = 0;
+	bool final = false;
+};
+
+QVector<ConvexHull> convexDecomposition( const QVector<Vector3> & verts, const QVector<Triangle> & triangles,
+										 int maxHulls, float concavity, int maxVerts, float roundError )
+{
+	// Build a part from triangles, measuring how concave it is
+	auto makePart = [&]( const QVector<int> & tris ) {
+		ConvexPart part;
+		part.triangles = tris;
+
+		QVector<bool> used( verts.count(), false );
+		QVector<Vector3> points;
+		for ( int t : tris ) {
+			for ( int c = 0; c < 3; c++ ) {
+				int v = triangles[t][c];
+				if ( !used[v] ) {
+					used[v] = true;
+					points.append( verts[v] );
+				}
+			}
+		}
+
+		part.hull = convexHull( points, 0, roundError );
+
+		for ( const Vector3 & p : points ) {
+			float d = hullDepth( part.hull, p );
+			if ( d > part.depth ) {
+				part.depth = d;
+				part.deepest = p;
+			}
+		}
+
+		return part;
+	};
+
+	QVector<int> all;
+	all.reserve( triangles.count() );
+
+	Vector3 bbMin( FLT_MAX, FLT_MAX, FLT_MAX ), bbMax( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+	for ( int t = 0; t < triangles.count(); t++ ) {
+		const Triangle & tri = triangles[t];
+		if ( tri[0] >= verts.count() || tri[1] >= verts.count() || tri[2] >= verts.count() )
+			continue;
+
+		all.append( t );
+		for ( int c = 0; c < 3; c++ ) {
+			for ( int a = 0; a < 3; a++ ) {
+				bbMin[a] = std::min( bbMin[a], verts[tri[c]][a] );
+				bbMax[a] = std::max( bbMax[a], verts[tri[c]][a] );
+			}
+		}
+	}
+
+	if ( all.isEmpty() )
+		return QVector<ConvexHull>();
+
+	float maxDepth = concavity * ( bbMax - bbMin ).length();
+
+	QVector<ConvexPart> parts;
+	parts.append( makePart( all ) );
+
+	while ( parts.count() < maxHulls ) {
+		// Split the most concave part
+		int worst = -1;
+		for ( int p = 0; p < parts.count(); p++ ) {
+			if ( !parts[p].final && parts[p].depth > maxDepth && ( worst < 0 || parts[p].depth > parts[worst].depth ) )
+				worst = p;
+		}
+
+		if ( worst < 0 )
+			break;
+
+		ConvexPart & part = parts[worst];
+
+		Vector3 lo( FLT_MAX, FLT_MAX, FLT_MAX ), hi( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+		for ( const Vector3 & v : part.hull.verts ) {
+			for ( int a = 0; a < 3; a++ ) {
+				lo[a] = std::min( lo[a], v[a] );
+				hi[a] = std::max( hi[a], v[a] );
+			}
+		}
+
+		int axis = 0;
+		for ( int a = 1; a < 3; a++ ) {
+			if ( hi[a] - lo[a] > hi[axis] - lo[axis] )
+				axis = a;
+		}
+
+		// Cut through the deepest point, but not too close to the ends
+		float extent = hi[axis] - lo[axis];
+		float cut = std::max( lo[axis] + extent * 0.25f, std::min( hi[axis] - extent * 0.25f, part.deepest[axis] ) );
+
+		QVector<int> below, above;
+		for ( int t : part.triangles ) {
+			const Triangle & tri = triangles[t];
+			float center = ( verts[tri[0]][axis] + verts[tri[1]][axis] + verts[tri[2]][axis] ) / 3.0f;
+			( center < cut ? below : above ).append( t );
+		}
+
+		if ( below.isEmpty() || above.isEmpty() ) {
+			part.final = true;
+			continue;
+		}
+
+		ConvexPart partBelow = makePart( below );
+		ConvexPart partAbove = makePart( above );
+
+		if ( partBelow.hull.isEmpty() || partAbove.hull.isEmpty() ) {
+			part.final = true;
+			continue;
+		}
+
+		parts[worst] = partBelow;
+		parts.append( partAbove );
+	}
+
+	QVector<ConvexHull> hulls;
+	for ( const ConvexPart & part : parts ) {
+		if ( part.hull.isEmpty() )
+			continue;
+
+		if ( maxVerts >= 4 && part.hull.verts.count() > maxVerts )
+			hulls.append( convexHull( part.hull.verts, maxVerts, roundError ) );
+		else
+			hulls.append( part.hull );
+	}
+
+	return hulls;
+}
@@ -0,0 +1,79 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef CONVEXDECOMP_H
+#define CONVEXDECOMP_H
+
+#include "data/niftypes.h"
+
+#include <QVector>
+
+
+//! A convex hull, as its vertices and face planes
+struct ConvexHull
+{
+	QVector<Vector3> verts;
+	//! Outward normal and offset of each face, n * p + offset is 0 on the face
+	QVector<Vector4> planes;
+
+	bool isEmpty() const { return verts.isEmpty(); }
+};
+
+/*! Compute the convex hull of a point cloud
+ *
+ * Safe to call from several threads at once.
+ *
+ * @param points		The points
+ * @param maxVerts		The largest number of hull vertices, 0 for no limit
+ * @param roundError	The maximum roundoff error passed to Qhull
+ * @return The hull, empty if the points are degenerate
+ */
+ConvexHull convexHull( const QVector<Vector3> & points, int maxVerts = 0, float roundError = 0 );
+
+/*! Approximate a triangle mesh by several convex hulls
+ *
+ * The part of the mesh lying deepest inside its hull is split by an axis
+ * aligned plane through that point until every part is within the concavity
+ * or the number of hulls is reached.
+ *
+ * @param verts			The vertices
+ * @param triangles		The triangles
+ * @param maxHulls		The largest number of hulls
+ * @param concavity		The largest depth of the mesh inside a hull, relative to the mesh size
+ * @param maxVerts		The largest number of vertices per hull, 0 for no limit
+ * @param roundError	The maximum roundoff error passed to Qhull
+ * @return The hulls
+ */
+QVector<ConvexHull> convexDecomposition( const QVector<Vector3> & verts, const QVector<Triangle> & triangles,
+										 int maxHulls, float concavity, int maxVerts = 0, float roundError = 0 );
+
+#endif
@@ -10,7 +10,7 @@
 #include "spellbook.h"
 #include "gl/gltex.h"
 
-#include "lib/nvtristripwrapper.h"
+#include "lib/stripify.h"
 
 #include <QCoreApplication>
 #include <QDebug>
@@ -34,7 +34,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "gl/gltex.h"
 #include "model/nifmodel.h"
 
-#include "lib/nvtristripwrapper.h"
+#include "lib/stripify.h"
 
 #include <QApplication>
 #include <QDebug>
@@ -844,7 +844,7 @@ void attachNiShape ( const NifModel * nif, QDomElement parentNode, int idx )
 			if ( iPoints.isValid() ) {
 				QVector<QVector<quint16> > strips;
 
-				for ( int r = 0; r < nif->rowCount( iPoints ); r++ )
+				for ( int r = 0; r < nif->childCount( iPoints ); r++ )
 					strips.append( nif->getArray<quint16>( iPoints.child( r, 0 ) ) );
 
 				tri = triangulate( strips );
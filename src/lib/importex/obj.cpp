@@ -35,7 +35,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "model/nifmodel.h"
 #include "spells/tangentspace.h"
 
-#include "lib/nvtristripwrapper.h"
+#include "lib/stripify.h"
 
 #include <QApplication>
 #include <QDebug>
@@ -101,7 +101,7 @@ static void writeData( const NifModel * nif, const QModelIndex & iData, QTextStr
 		if ( iPoints.isValid() ) {
 			QVector<QVector<quint16> > strips;
 
-			for ( int r = 0; r < nif->rowCount( iPoints ); r++ )
+			for ( int r = 0; r < nif->childCount( iPoints ); r++ )
 				strips.append( nif->getArray<quint16>( iPoints.child( r, 0 ) ) );
 
 			tris = triangulate( strips );
@@ -341,7 +341,7 @@ static void writeParent( const NifModel * nif, const QModelIndex & iNode, QTextS
 
 							QModelIndex iTris = nif->getIndex( iData, "Triangles" );
 
-							for ( int t = 0; t < nif->rowCount( iTris ); t++ ) {
+							for ( int t = 0; t < nif->childCount( iTris ); t++ ) {
 								Triangle tri = nif->get<Triangle>( iTris.child( t, 0 ), "Triangle" );
 								Vector3 n = nif->get<Vector3>( iTris.child( t, 0 ), "Normal" );
 
@@ -369,7 +369,7 @@ static void writeParent( const NifModel * nif, const QModelIndex & iNode, QTextS
 					obj << "\r\n# bhkNiTriStripsShape\r\n\r\ng collision\r\n" << "usemtl collision\r\n\r\n";
 					QModelIndex iStrips = nif->getIndex( iShape, "Strips Data" );
 
-					for ( int r = 0; r < nif->rowCount( iStrips ); r++ )
+					for ( int r = 0; r < nif->childCount( iStrips ); r++ )
 						writeData( nif, nif->getBlock( nif->getLink( iStrips.child( r, 0 ) ), "NiTriStripsData" ), obj, ofs, t * bt );
 				}
 			}
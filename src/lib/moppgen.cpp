@@ -0,0 +1,366 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "moppgen.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+
+//! Quantized coordinates of the code span [0, MOPP_RANGE]
+#define MOPP_RANGE ( 254.0f * 65536.0f )
+
+//! MOPP commands used by the encoder
+enum MoppCommand
+{
+	MOPP_JUMP24 = 0x07,
+	MOPP_SPLIT_X = 0x10,        //!< Split on an axis, 8 bit jump: hi, lo, jump
+	MOPP_SPLIT_JUMP_X = 0x23,   //!< Split on an axis, 16 bit jumps: hi, lo, jump left, jump right
+	MOPP_TERM4 = 0x30,          //!< Terminal for keys 0 to 31
+	MOPP_TERM8 = 0x50,
+	MOPP_TERM16 = 0x51,
+	MOPP_TERM32 = 0x53
+};
+
+//! Quantized bounds of a triangle
+struct MoppBounds
+{
+	float min[3];
+	float max[3];
+	float center[3];
+};
+
+//! Recursive encoder over a range of triangle indices
+class MoppEncoder final
+{
+public:
+	MoppEncoder( const QVector<MoppBounds> & bounds ) : bounds( bounds ) {}
+
+	QByteArray encode( int * first, int * last ) const
+	{
+		QByteArray code;
+
+		if ( last - first == 1 ) {
+			terminal( code, *first );
+			return code;
+		}
+
+		// Split at the median center on the axis where the centers spread the most
+		float lo[3] = { MOPP_RANGE, MOPP_RANGE, MOPP_RANGE };
+		float hi[3] = { 0, 0, 0 };
+		for ( int * t = first; t != last; t++ ) {
+			for ( int a = 0; a < 3; a++ ) {
+				lo[a] = std::min( lo[a], bounds[*t].center[a] );
+				hi[a] = std::max( hi[a], bounds[*t].center[a] );
+			}
+		}
+
+		int axis = 0;
+		for ( int a = 1; a < 3; a++ ) {
+			if ( hi[a] - lo[a] > hi[axis] - lo[axis] )
+				axis = a;
+		}
+
+		int * mid = first + ( last - first ) / 2;
+		std::nth_element( first, mid, last, [this, axis]( int a, int b ) {
+			return bounds[a].center[axis] < bounds[b].center[axis];
+		} );
+
+		float leftMax = 0;
+		for ( int * t = first; t != mid; t++ )
+			leftMax = std::max( leftMax, bounds[*t].max[axis] );
+
+		float rightMin = MOPP_RANGE;
+		for ( int * t = mid; t != last; t++ )
+			rightMin = std::min( rightMin, bounds[*t].min[axis] );
+
+		// Planes compare against the top byte of the query, rounding down keeps them conservative
+		char planeHi = char( quint8( std::floor( leftMax / 65536.0f ) ) );
+		char planeLo = char( quint8( std::floor( rightMin / 65536.0f ) ) );
+
+		QByteArray left = encode( first, mid );
+		QByteArray right = encode( mid, last );
+
+		if ( left.size() <= 0xFF ) {
+			code.reserve( 4 + left.size() + right.size() );
+			code.append( char( MOPP_SPLIT_X + axis ) );
+			code.append( planeHi );
+			code.append( planeLo );
+			code.append( char( left.size() ) );
+		} else if ( left.size() <= 0xFFFF ) {
+			code.reserve( 7 + left.size() + right.size() );
+			code.append( char( MOPP_SPLIT_JUMP_X + axis ) );
+			code.append( planeHi );
+			code.append( planeLo );
+			appendInt( code, 0, 2 );
+			appendInt( code, left.size(), 2 );
+		} else {
+			// The right branch starts with a long jump over the left one
+			code.reserve( 11 + left.size() + right.size() );
+			code.append( char( MOPP_SPLIT_JUMP_X + axis ) );
+			code.append( planeHi );
+			code.append( planeLo );
+			appendInt( code, 4, 2 );
+			appendInt( code, 0, 2 );
+			code.append( char( MOPP_JUMP24 ) );
+			appendInt( code, left.size(), 3 );
+		}
+
+		code.append( left );
+		code.append( right );
+		return code;
+	}
+
+private:
+	//! Append a big endian integer
+	static void appendInt( QByteArray & code, quint32 value, int bytes )
+	{
+		for ( int b = bytes - 1; b >= 0; b-- )
+			code.append( char( ( value >> ( 8 * b ) ) & 0xFF ) );
+	}
+
+	static void terminal( QByteArray & code, quint32 key )
+	{
+		if ( key < 32 ) {
+			code.append( char( MOPP_TERM4 + key ) );
+		} else if ( key <= 0xFF ) {
+			code.append( char( MOPP_TERM8 ) );
+			appendInt( code, key, 1 );
+		} else if ( key <= 0xFFFF ) {
+			code.append( char( MOPP_TERM16 ) );
+			appendInt( code, key, 2 );
+		} else {
+			code.append( char( MOPP_TERM32 ) );
+			appendInt( code, key, 4 );
+		}
+	}
+
+	const QVector<MoppBounds> & bounds;
+};
+
+QByteArray generateMoppCode( const QVector<Vector3> & verts, const QVector<Triangle> & triangles, Vector3 & origin, float & scale )
+{
+	QVector<int> keys;
+	keys.reserve( triangles.count() );
+
+	float bbMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float bbMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for ( int t = 0; t < triangles.count(); t++ ) {
+		const Triangle & tri = triangles[t];
+		if ( tri[0] >= verts.count() || tri[1] >= verts.count() || tri[2] >= verts.count() )
+			continue;
+
+		keys.append( t );
+		for ( int c = 0; c < 3; c++ ) {
+			for ( int a = 0; a < 3; a++ ) {
+				bbMin[a] = std::min( bbMin[a], verts[tri[c]][a] );
+				bbMax[a] = std::max( bbMax[a], verts[tri[c]][a] );
+			}
+		}
+	}
+
+	if ( keys.isEmpty() )
+		return QByteArray();
+
+	// Keep a margin so no vertex quantizes onto the edge of the range
+	float extent = std::max( bbMax[0] - bbMin[0], std::max( bbMax[1] - bbMin[1], bbMax[2] - bbMin[2] ) );
+	float margin = extent * 0.005f + 0.01f;
+
+	origin = Vector3( bbMin[0] - margin, bbMin[1] - margin, bbMin[2] - margin );
+	scale = MOPP_RANGE / ( extent + 2.0f * margin );
+
+	QVector<MoppBounds> bounds( triangles.count() );
+	for ( int t : keys ) {
+		const Triangle & tri = triangles[t];
+		MoppBounds & b = bounds[t];
+
+		for ( int a = 0; a < 3; a++ ) {
+			float q0 = ( verts[tri[0]][a] - origin[a] ) * scale;
+			float q1 = ( verts[tri[1]][a] - origin[a] ) * scale;
+			float q2 = ( verts[tri[2]][a] - origin[a] ) * scale;
+
+			b.min[a] = std::max( 0.0f, std::min( q0, std::min( q1, q2 ) ) );
+			b.max[a] = std::min( MOPP_RANGE, std::max( q0, std::max( q1, q2 ) ) );
+			b.center[a] = ( b.min[a] + b.max[a] ) / 2.0f;
+		}
+	}
+
+	return MoppEncoder( bounds ).encode( keys.data(), keys.data() + keys.count() );
+}
+
+//! Read a big endian integer, returns false if it runs past the end of the code
+static bool readInt( const QByteArray & code, int pos, int bytes, quint32 & value )
+{
+	if ( pos < 0 || pos + bytes > code.size() )
+		return false;
+
+	value = 0;
+	for ( int b = 0; b < bytes; b++ )
+		value = ( value << 8 ) | quint8( code[pos + b] );
+
+	return true;
+}
+
+/*! Walk MOPP code and collect the keys of the terminals reached
+ *
+ * Without a query both branches of every split are taken. With a query, given
+ * as the top bytes of its quantized bounds, the left branch is taken when the
+ * query starts at or below the high plane and the right branch when it ends at
+ * or above the low plane.
+ */
+static bool walkMoppCode( const QByteArray & code, const quint8 * queryMin, const quint8 * queryMax, QVector<quint32> & keys )
+{
+	keys.clear();
+
+	QVector<int> branches;
+	branches.append( 0 );
+
+	while ( !branches.isEmpty() ) {
+		int pos = branches.takeLast();
+		if ( pos < 0 || pos >= code.size() )
+			return false;
+
+		quint8 cmd = quint8( code[pos] );
+		quint32 value, jump, planeHi, planeLo;
+
+		if ( cmd >= MOPP_SPLIT_X && cmd <= MOPP_SPLIT_X + 2 ) {
+			if ( !readInt( code, pos + 1, 1, planeHi ) || !readInt( code, pos + 2, 1, planeLo )
+			     || !readInt( code, pos + 3, 1, jump ) )
+				return false;
+
+			int axis = cmd - MOPP_SPLIT_X;
+			if ( !queryMax || queryMax[axis] >= planeLo )
+				branches.append( pos + 4 + int( jump ) );
+			if ( !queryMin || queryMin[axis] <= planeHi )
+				branches.append( pos + 4 );
+		} else if ( cmd >= MOPP_SPLIT_JUMP_X && cmd <= MOPP_SPLIT_JUMP_X + 2 ) {
+			if ( !readInt( code, pos + 1, 1, planeHi ) || !readInt( code, pos + 2, 1, planeLo )
+			     || !readInt( code, pos + 3, 2, value ) || !readInt( code, pos + 5, 2, jump ) )
+				return false;
+
+			int axis = cmd - MOPP_SPLIT_JUMP_X;
+			if ( !queryMax || queryMax[axis] >= planeLo )
+				branches.append( pos + 7 + int( jump ) );
+			if ( !queryMin || queryMin[axis] <= planeHi )
+				branches.append( pos + 7 + int( value ) );
+		} else if ( cmd == MOPP_JUMP24 ) {
+			if ( !readInt( code, pos + 1, 3, jump ) )
+				return false;
+
+			branches.append( pos + 4 + int( jump ) );
+		} else if ( cmd >= MOPP_TERM4 && cmd < MOPP_TERM8 ) {
+			keys.append( cmd - MOPP_TERM4 );
+		} else if ( cmd == MOPP_TERM8 || cmd == MOPP_TERM16 || cmd == MOPP_TERM32 ) {
+			int bytes = ( cmd == MOPP_TERM8 ) ? 1 : ( cmd == MOPP_TERM16 ) ? 2 : 4;
+			if ( !readInt( code, pos + 1, bytes, value ) )
+				return false;
+
+			keys.append( value );
+		} else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool moppCodeKeys( const QByteArray & code, QVector<quint32> & keys )
+{
+	return walkMoppCode( code, nullptr, nullptr, keys );
+}
+
+bool checkMoppCode( const QByteArray & code, const Vector3 & origin, float scale, const QVector<Vector3> & verts, const QVector<Triangle> & triangles )
+{
+	QVector<quint32> valid;
+	QVector<MoppBounds> bounds( triangles.count() );
+
+	for ( int t = 0; t < triangles.count(); t++ ) {
+		const Triangle & tri = triangles[t];
+		if ( tri[0] >= verts.count() || tri[1] >= verts.count() || tri[2] >= verts.count() )
+			continue;
+
+		valid.append( t );
+		for ( int a = 0; a < 3; a++ ) {
+			float q0 = ( verts[tri[0]][a] - origin[a] ) * scale;
+			float q1 = ( verts[tri[1]][a] - origin[a] ) * scale;
+			float q2 = ( verts[tri[2]][a] - origin[a] ) * scale;
+
+			bounds[t].min[a] = std::max( 0.0f, std::min( q0, std::min( q1, q2 ) ) );
+			bounds[t].max[a] = std::min( MOPP_RANGE, std::max( q0, std::max( q1, q2 ) ) );
+		}
+	}
+
+	// Every valid triangle must be reachable exactly once
+	QVector<quint32> keys;
+	if ( !moppCodeKeys( code, keys ) )
+		return false;
+
+	std::sort( keys.begin(), keys.end() );
+	if ( keys != valid )
+		return false;
+
+	// Query boxes around sampled triangles, growing with the sample, and compare the
+	// keys the code returns against a brute force overlap test of all triangles
+	const int samples = std::min( valid.count(), 256 );
+	for ( int s = 0; s < samples; s++ ) {
+		const MoppBounds & b = bounds[valid[int( ( qint64( s ) * valid.count() ) / samples )]];
+		float grow = float( s % 8 ) * 131072.0f;
+
+		float boxMin[3], boxMax[3];
+		quint8 queryMin[3], queryMax[3];
+		for ( int a = 0; a < 3; a++ ) {
+			boxMin[a] = std::max( 0.0f, b.min[a] - grow );
+			boxMax[a] = std::min( MOPP_RANGE, b.max[a] + grow );
+			queryMin[a] = quint8( std::min( 254.0f, std::floor( boxMin[a] / 65536.0f ) ) );
+			queryMax[a] = quint8( std::min( 254.0f, std::floor( boxMax[a] / 65536.0f ) ) );
+		}
+
+		if ( !walkMoppCode( code, queryMin, queryMax, keys ) )
+			return false;
+
+		std::sort( keys.begin(), keys.end() );
+
+		for ( quint32 t : valid ) {
+			const MoppBounds & o = bounds[t];
+			bool overlaps = true;
+			for ( int a = 0; a < 3; a++ )
+				overlaps = overlaps && o.min[a] <= boxMax[a] && o.max[a] >= boxMin[a];
+
+			if ( overlaps && !std::binary_search( keys.begin(), keys.end(), t ) )
+				return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,89 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef MOPPGEN_H
+#define MOPPGEN_H
+
+#include "data/niftypes.h"
+
+#include <QByteArray>
+#include <QVector>
+
+
+/*! Generate Havok MOPP code for a triangle mesh
+ *
+ * Builds a bounding volume tree over the triangles and encodes it as MOPP
+ * byte code, with the triangle index as the key of each leaf. Split planes are
+ * quantized conservatively, so every triangle is reached by any query
+ * overlapping it.
+ *
+ * @param verts		The vertices
+ * @param triangles	The triangles
+ * @param origin	Set to the origin of the code
+ * @param scale		Set to the scale of the code
+ * @return The MOPP code, empty if there are no triangles
+ */
+QByteArray generateMoppCode( const QVector<Vector3> & verts, const QVector<Triangle> & triangles, Vector3 & origin, float & scale );
+
+/*! Collect the keys reachable in MOPP code
+ *
+ * Walks both branches of every split, so each key is listed once per
+ * terminal that holds it. Only the commands written by generateMoppCode()
+ * are understood.
+ *
+ * @param code	The MOPP code
+ * @param keys	Set to the keys of the terminals
+ * @return False if the code holds an unknown command or runs out of range
+ */
+bool moppCodeKeys( const QByteArray & code, QVector<quint32> & keys );
+
+/*! Check MOPP code against its triangles
+ *
+ * Every valid triangle must be reached exactly once. The code is then queried
+ * with boxes around sampled triangles, walking only the branches whose split
+ * planes the box crosses, and the keys returned are compared against a brute
+ * force overlap test of the quantized triangle bounds. A triangle overlapping
+ * a box but missing from its keys fails the check.
+ *
+ * The check covers the commands written by generateMoppCode() and is not a
+ * comparison against the output of the Havok tools.
+ *
+ * @param code		The MOPP code
+ * @param origin	The origin of the code
+ * @param scale		The scale of the code
+ * @param verts		The vertices
+ * @param triangles	The triangles
+ * @return True if the code passes
+ */
+bool checkMoppCode( const QByteArray & code, const Vector3 & origin, float scale, const QVector<Vector3> & verts, const QVector<Triangle> & triangles );
+
+#endif
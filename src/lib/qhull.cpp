@@ -55,25 +55,25 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #endif
 extern "C"
 {
-#include <libqhull/qhull_a.h>
-
-#include <libqhull/libqhull.c>
-#include <libqhull/mem.c>
-#include <libqhull/qset.c>
-#include <libqhull/geom.c>
-#include <libqhull/merge.c>
-#include <libqhull/poly.c>
-#include <libqhull/io.c>
-#include <libqhull/stat.c>
-#include <libqhull/global.c>
-#include <libqhull/user.c>
-#include <libqhull/poly2.c>
-#include <libqhull/geom2.c>
-#include <libqhull/userprintf.c>
-#include <libqhull/userprintf_rbox.c>
-#include <libqhull/usermem.c>
-#include <libqhull/random.c>
-#include <libqhull/rboxlib.c>
+#include <libqhull_r/qhull_ra.h>
+
+#include <libqhull_r/libqhull_r.c>
+#include <libqhull_r/mem_r.c>
+#include <libqhull_r/qset_r.c>
+#include <libqhull_r/geom_r.c>
+#include <libqhull_r/merge_r.c>
+#include <libqhull_r/poly_r.c>
+#include <libqhull_r/io_r.c>
+#include <libqhull_r/stat_r.c>
+#include <libqhull_r/global_r.c>
+#include <libqhull_r/user_r.c>
+#include <libqhull_r/poly2_r.c>
+#include <libqhull_r/geom2_r.c>
+#include <libqhull_r/userprintf_r.c>
+#include <libqhull_r/userprintf_rbox_r.c>
+#include <libqhull_r/usermem_r.c>
+#include <libqhull_r/random_r.c>
+#include <libqhull_r/rboxlib_r.c>
 }
 #ifdef _MSC_VER
 #pragma warning(pop)
@@ -88,7 +88,7 @@ extern "C"
 
 //! \file qhull.cpp Computes a convex hull
 
-// TODO: investigate the C++ interfaces to Qhull; the Qt interface requires GCC 4.3
+// The reentrant library keeps all of its state in qhT, so hulls can be computed on several threads at once.
 
 //! An interface to <a href="http://www.qhull.org">Qhull</a> for generating Havok-compatible convex shapes
 QVector<Triangle> compute_convex_hull( const QVector<Vector3> & verts, QVector<Vector4> & hullVerts, QVector<Vector4> & hullNorms, float roundError )
@@ -114,7 +114,7 @@ QVector<Triangle> compute_convex_hull( const QVector<Vector3> & verts, QVector<V
 	/* output from qh_produce_output()
 	 * use NULL to skip qh_produce_output()
 	 */
-	FILE * outfile = stdout;
+	FILE * outfile = NULL;
 	/* error messages from qhull code */
 	FILE * errfile = stderr;
 	/* 0 if no error from qhull */
@@ -128,6 +128,12 @@ QVector<Triangle> compute_convex_hull( const QVector<Vector3> & verts, QVector<V
 	vertexT * vertex, ** vertexp;
 	setT * vertices;
 
+	/* all state of this qhull run, the FORALL macros expect it to be called qh */
+	qhT qh_qh;
+	qhT * qh = &qh_qh;
+
+	qh_zero( qh, errfile );
+
 	numpoints = verts.size();
 	points = new coordT[3 * numpoints];
 
@@ -142,7 +148,7 @@ QVector<Triangle> compute_convex_hull( const QVector<Vector3> & verts, QVector<V
 	}
 
 	/* initialize dim, numpoints, points[], ismalloc here */
-	exitcode = qh_new_qhull( dim, numpoints, points, ismalloc,
+	exitcode = qh_new_qhull( qh, dim, numpoints, points, ismalloc,
 		flags, outfile, errfile );
 
 	if ( !exitcode ) {
@@ -150,7 +156,7 @@ QVector<Triangle> compute_convex_hull( const QVector<Vector3> & verts, QVector<V
 		/* 'qh facet_list' contains the convex hull */
 		FORALLfacets {
 			/* from poly2.c */
-			vertices = qh_facet3vertex( facet );
+			vertices = qh_facet3vertex( qh, facet );
 			Vector4 hullNorm( facet->normal[0], facet->normal[1], facet->normal[2], facet->offset );
 			hullNorms.append( hullNorm );
 
@@ -158,7 +164,7 @@ QVector<Triangle> compute_convex_hull( const QVector<Vector3> & verts, QVector<V
 				Triangle tri;
 				int i = 0;
 				FOREACHvertex_( vertices ) {
-					tri[i++] = qh_pointid( vertex->point );
+					tri[i++] = qh_pointid( qh, vertex->point );
 					/* find the hull vertices */
 					Vector4 hullVert( vertex->point[0], vertex->point[1], vertex->point[2], 0 );
 					hullVerts.append( hullVert );
@@ -166,12 +172,12 @@ QVector<Triangle> compute_convex_hull( const QVector<Vector3> & verts, QVector<V
 				tris.push_back( tri );
 			}
 
-			qh_settempfree( &vertices );
+			qh_settempfree( qh, &vertices );
 		}
 	}
 
-	qh_freeqhull( !qh_ALL );
-	qh_memfreeshort( &curlong, &totlong );
+	qh_freeqhull( qh, !qh_ALL );
+	qh_memfreeshort( qh, &curlong, &totlong );
 
 	if ( curlong || totlong )
 		fprintf( errfile, "qhull internal warning (main): did not free %d bytes of long memory (%d pieces)\n",
@@ -0,0 +1,425 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "skinpartition.h"
+
+#include "lib/vertexweld.h"
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <queue>
+#include <vector>
+
+
+//! A set of bone indices stored as a bitset
+class BoneSet final
+{
+public:
+	BoneSet( int numBones = 0 ) : words( ( numBones + 63 ) / 64, 0 ) {}
+
+	bool contains( int bone ) const
+	{
+		return words[bone >> 6] & ( quint64( 1 ) << ( bone & 63 ) );
+	}
+
+	void insert( int bone )
+	{
+		if ( !contains( bone ) ) {
+			words[bone >> 6] |= quint64( 1 ) << ( bone & 63 );
+			size++;
+		}
+	}
+
+	void unite( const BoneSet & other )
+	{
+		size = 0;
+		for ( int w = 0; w < words.count(); w++ ) {
+			words[w] |= other.words[w];
+			size += popcount( words[w] );
+		}
+	}
+
+	//! Size of the union with another set
+	int unitedCount( const BoneSet & other ) const
+	{
+		int n = 0;
+		for ( int w = 0; w < words.count(); w++ )
+			n += popcount( words[w] | other.words[w] );
+		return n;
+	}
+
+	int count() const { return size; }
+
+	QVector<int> toVector() const
+	{
+		QVector<int> bones;
+		bones.reserve( size );
+		for ( int w = 0; w < words.count(); w++ ) {
+			for ( int b = 0; b < 64; b++ ) {
+				if ( words[w] & ( quint64( 1 ) << b ) )
+					bones.append( w * 64 + b );
+			}
+		}
+		return bones;
+	}
+
+private:
+	static int popcount( quint64 v )
+	{
+		int n = 0;
+		for ( ; v; n++ )
+			v &= v - 1;
+		return n;
+	}
+
+	QVector<quint64> words;
+	int size = 0;
+};
+
+//! The unique bones of every triangle, in compressed rows
+struct TriangleBones
+{
+	QVector<int> start;
+	QVector<int> bones;
+
+	TriangleBones( const QVector<Triangle> & triangles, const QVector<QList<BoneWeight> > & weights )
+		: start( triangles.count() + 1, 0 )
+	{
+		bones.reserve( triangles.count() * 4 );
+
+		for ( int t = 0; t < triangles.count(); t++ ) {
+			start[t] = bones.count();
+
+			for ( int c = 0; c < 3; c++ ) {
+				for ( const BoneWeight & bw : weights[triangles[t][c]] ) {
+					bool found = false;
+					for ( int i = start[t]; i < bones.count() && !found; i++ )
+						found = ( bones[i] == bw.first );
+
+					if ( !found )
+						bones.append( bw.first );
+				}
+			}
+		}
+
+		start[triangles.count()] = bones.count();
+	}
+
+	int count( int t ) const { return start[t + 1] - start[t]; }
+
+	//! Number of bones of a triangle missing from a set
+	int missing( int t, const BoneSet & set ) const
+	{
+		int n = 0;
+		for ( int i = start[t]; i < start[t + 1]; i++ ) {
+			if ( !set.contains( bones[i] ) )
+				n++;
+		}
+		return n;
+	}
+
+	void addTo( int t, BoneSet & set ) const
+	{
+		for ( int i = start[t]; i < start[t + 1]; i++ )
+			set.insert( bones[i] );
+	}
+};
+
+bool limitTriangleBones( const QVector<Triangle> & triangles, const QVector<Vector3> & verts,
+						 QVector<QList<BoneWeight> > & weights, int maxBones, int & removed )
+{
+	removed = 0;
+
+	// Coincident vertices, in compressed rows, built on first use
+	QVector<int> groupStart;
+	QVector<int> groupVerts;
+	QVector<int> group;
+
+	QVector<int> tribones;
+	QVector<float> sums;
+	QVector<int> nono;
+
+	for ( const Triangle & tri : triangles ) {
+		forever {
+			tribones.clear();
+			sums.clear();
+			nono.clear();
+
+			for ( int c = 0; c < 3; c++ ) {
+				const QList<BoneWeight> & bws = weights[tri[c]];
+
+				// Bones with weight 1 can't be removed
+				if ( bws.count() == 1 )
+					nono.append( bws.first().first );
+
+				for ( const BoneWeight & bw : bws ) {
+					int i = tribones.indexOf( bw.first );
+					if ( i < 0 ) {
+						tribones.append( bw.first );
+						sums.append( bw.second );
+					} else {
+						sums[i] += bw.second;
+					}
+				}
+			}
+
+			if ( tribones.count() <= maxBones )
+				break;
+
+			// Select the bone to remove
+			float minWeight = 5.0;
+			int minBone = -1;
+
+			for ( int i = 0; i < tribones.count(); i++ ) {
+				if ( !nono.contains( tribones[i] ) && sums[i] < minWeight ) {
+					minWeight = sums[i];
+					minBone = tribones[i];
+				}
+			}
+
+			if ( minBone < 0 )
+				return false;
+
+			if ( group.isEmpty() ) {
+				group = VertexWelder( verts ).weld();
+
+				groupStart.fill( 0, verts.count() + 1 );
+				for ( int v = 0; v < verts.count(); v++ )
+					groupStart[group[v] + 1]++;
+				for ( int v = 0; v < verts.count(); v++ )
+					groupStart[v + 1] += groupStart[v];
+
+				groupVerts.resize( verts.count() );
+				QVector<int> fill( groupStart );
+				for ( int v = 0; v < verts.count(); v++ )
+					groupVerts[fill[group[v]]++] = v;
+			}
+
+			// Remove the bone from the triangle and from matching vertices
+			for ( int c = 0; c < 3; c++ ) {
+				const QList<BoneWeight> match = weights[tri[c]];
+				int g = group[tri[c]];
+				bool rem = false;
+
+				for ( int i = groupStart[g]; i < groupStart[g + 1]; i++ ) {
+					QList<BoneWeight> & bws = weights[groupVerts[i]];
+					if ( bws != match )
+						continue;
+
+					float totalWeight = 0;
+					for ( int b = bws.count() - 1; b >= 0; b-- ) {
+						if ( bws[b].first == minBone ) {
+							bws.removeAt( b );
+							rem = true;
+						} else {
+							totalWeight += bws[b].second;
+						}
+					}
+
+					if ( totalWeight == 0 )
+						return false;
+
+					for ( BoneWeight & bw : bws )
+						bw.second /= totalWeight;
+				}
+
+				if ( rem )
+					removed++;
+			}
+		}
+	}
+
+	return true;
+}
+
+QVector<SkinPartition> partitionSkin( const QVector<Triangle> & triangles, const QVector<QList<BoneWeight> > & weights,
+									  int maxBones, const QVector<int> & fixed )
+{
+	int numTris = triangles.count();
+	int numVerts = weights.count();
+
+	int numBones = 0;
+	for ( const QList<BoneWeight> & bws : weights ) {
+		for ( const BoneWeight & bw : bws )
+			numBones = std::max( numBones, bw.first + 1 );
+	}
+
+	TriangleBones triBones( triangles, weights );
+
+	QVector<BoneSet> sets;
+	QVector<QVector<int> > members;
+
+	if ( !fixed.isEmpty() ) {
+		// Explicit mapping, no merging is allowed
+		for ( int t = 0; t < numTris; t++ ) {
+			int p = fixed[t];
+
+			while ( p >= sets.count() ) {
+				sets.append( BoneSet( numBones ) );
+				members.append( QVector<int>() );
+			}
+
+			triBones.addTo( t, sets[p] );
+			members[p].append( t );
+		}
+	} else {
+		// Triangles of every vertex, in compressed rows
+		QVector<int> vertStart( numVerts + 1, 0 );
+		for ( const Triangle & tri : triangles ) {
+			for ( int c = 0; c < 3; c++ )
+				vertStart[tri[c] + 1]++;
+		}
+		for ( int v = 0; v < numVerts; v++ )
+			vertStart[v + 1] += vertStart[v];
+
+		QVector<int> vertTris( numTris * 3 );
+		QVector<int> fill( vertStart );
+		for ( int t = 0; t < numTris; t++ ) {
+			for ( int c = 0; c < 3; c++ )
+				vertTris[fill[triangles[t][c]]++] = t;
+		}
+
+		QVector<int> owner( numTris, -1 );
+		QVector<int> queuedBy( numTris, -1 );
+		QVector<int> queuedCost( numTris, INT_MAX );
+
+		typedef std::pair<int, int> Candidate; // new bones, triangle
+		std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate> > queue;
+
+		int seed = 0;
+
+		forever {
+			while ( seed < numTris && owner[seed] >= 0 )
+				seed++;
+
+			if ( seed >= numTris )
+				break;
+
+			int p = sets.count();
+			BoneSet set( numBones );
+			QVector<int> tris;
+
+			queue.push( { 0, seed } );
+
+			while ( !queue.empty() ) {
+				int t = queue.top().second;
+				queue.pop();
+
+				if ( owner[t] >= 0 )
+					continue;
+
+				// The cost only ever drops, but bone count plus cost never does
+				if ( set.count() + triBones.missing( t, set ) > maxBones && !tris.isEmpty() )
+					continue;
+
+				owner[t] = p;
+				triBones.addTo( t, set );
+				tris.append( t );
+
+				for ( int c = 0; c < 3; c++ ) {
+					int v = triangles[t][c];
+
+					for ( int i = vertStart[v]; i < vertStart[v + 1]; i++ ) {
+						int u = vertTris[i];
+						if ( owner[u] >= 0 )
+							continue;
+
+						int cost = triBones.missing( u, set );
+						if ( set.count() + cost > maxBones )
+							continue;
+
+						if ( queuedBy[u] != p || cost < queuedCost[u] ) {
+							queuedBy[u] = p;
+							queuedCost[u] = cost;
+							queue.push( { cost, u } );
+						}
+					}
+				}
+			}
+
+			sets.append( set );
+			members.append( tris );
+		// Merge partitions, largest first, into the one whose union of bones stays smallest within the limit
+
+		// Merge partitions, largest first, into the fullest one they fit
+		QVector<int> order( sets.count() );
+		for ( int p = 0; p < order.count(); p++ )
+			order[p] = p;
+
+		std::stable_sort( order.begin(), order.end(), [&sets]( int a, int b ) {
+			return sets[a].count() > sets[b].count();
+		} );
+
+		QVector<BoneSet> mergedSets;
+		QVector<QVector<int> > mergedMembers;
+
+		for ( int p : order ) {
+			int best = -1;
+			int bestCount = INT_MAX;
+
+			for ( int m = 0; m < mergedSets.count(); m++ ) {
+				int n = mergedSets[m].unitedCount( sets[p] );
+				if ( n <= maxBones && n < bestCount ) {
+					best = m;
+					bestCount = n;
+				}
+			}
+
+			if ( best >= 0 ) {
+				mergedSets[best].unite( sets[p] );
+				mergedMembers[best] += members[p];
+			} else {
+				mergedSets.append( sets[p] );
+				mergedMembers.append( members[p] );
+			}
+		}
+
+		sets = mergedSets;
+		members = mergedMembers;
+	}
+
+	QVector<SkinPartition> parts( sets.count() );
+
+	for ( int p = 0; p < sets.count(); p++ ) {
+		parts[p].bones = sets[p].toVector();
+
+		// Keep the original triangle order within a partition
+		std::sort( members[p].begin(), members[p].end() );
+
+		parts[p].triangles.reserve( members[p].count() );
+		for ( int t : members[p] )
+			parts[p].triangles.append( triangles[t] );
+	}
+
+	return parts;
+}
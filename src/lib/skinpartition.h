@@ -0,0 +1,83 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef SKINPARTITION_H
+#define SKINPARTITION_H
+
+#include "data/niftypes.h"
+
+#include <QPair>
+#include <QVector>
+
+
+//! A bone influence of a vertex, as bone index and weight
+typedef QPair<int, float> BoneWeight;
+
+//! A set of triangles and the bones they use
+struct SkinPartition
+{
+	QVector<int> bones;
+	QVector<Triangle> triangles;
+};
+
+/*! Remove bone influences until every triangle uses at most @p maxBones bones
+ *
+ * The influence with the lowest weight over the triangle is removed, also from
+ * coincident vertices with the same weights so no seams open up. Influences of
+ * vertices with a single bone are never removed.
+ *
+ * @param triangles	The triangles
+ * @param verts		The vertex positions
+ * @param weights	The influences of every vertex, renormalized on return
+ * @param maxBones	The largest number of bones per triangle
+ * @param removed	Set to the number of vertices which lost an influence
+ * @return False if a triangle cannot be reduced to @p maxBones bones
+ */
+bool limitTriangleBones( const QVector<Triangle> & triangles, const QVector<Vector3> & verts,
+						 QVector<QList<BoneWeight> > & weights, int maxBones, int & removed );
+
+/*! Split triangles into partitions using at most @p maxBones bones each
+ *
+ * Partitions are grown over the triangle adjacency from a priority queue which
+ * prefers triangles adding the fewest new bones, then partitions are merged
+ * best fit first. Runs in roughly linear time in the number of triangles.
+ *
+ * @param triangles	The triangles, each using at most @p maxBones bones
+ * @param weights	The influences of every vertex
+ * @param maxBones	The largest number of bones per partition
+ * @param fixed		For every triangle its partition, or empty to choose them; fixed partitions are not merged
+ * @return The partitions
+ */
+QVector<SkinPartition> partitionSkin( const QVector<Triangle> & triangles, const QVector<QList<BoneWeight> > & weights,
+									  int maxBones, const QVector<int> & fixed = QVector<int>() );
+
+#endif
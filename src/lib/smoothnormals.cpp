@@ -0,0 +1,171 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "smoothnormals.h"
+
+#include "lib/vertexweld.h"
+
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <cmath>
+
+
+//! Vertices per task when smoothing in parallel
+static const int SMOOTH_CHUNK_SIZE = 16384;
+
+//! Angle of a triangle corner
+static float cornerAngle( const Vector3 & p, const Vector3 & a, const Vector3 & b )
+{
+	Vector3 e1 = a - p;
+	Vector3 e2 = b - p;
+	e1.normalize();
+	e2.normalize();
+	return std::acos( std::max( -1.0f, std::min( 1.0f, Vector3::dotproduct( e1, e2 ) ) ) );
+}
+
+QVector<Vector3> smoothNormals( const QVector<Vector3> & verts, const QVector<Vector3> & norms, const QVector<Triangle> & triangles,
+								float maxAngle, float tolerance, NormalWeighting weighting, bool parallel )
+{
+	int numVerts = verts.count();
+
+	QVector<int> group = VertexWelder( verts, tolerance ).weld();
+
+	// Contributions are unit normals, only their weights are kept per corner
+	QVector<Vector3> contribNormal;
+	QVector<float> contribWeight;
+	QVector<int> contribVertex;
+
+	if ( triangles.isEmpty() ) {
+		contribNormal = norms;
+		contribWeight.fill( 1.0f, numVerts );
+		contribVertex.resize( numVerts );
+		for ( int i = 0; i < numVerts; i++ ) {
+			contribNormal[i].normalize();
+			contribVertex[i] = i;
+		}
+	} else {
+		contribNormal.reserve( triangles.count() * 3 );
+		contribWeight.reserve( triangles.count() * 3 );
+		contribVertex.reserve( triangles.count() * 3 );
+
+		for ( const Triangle & tri : triangles ) {
+			if ( tri[0] >= numVerts || tri[1] >= numVerts || tri[2] >= numVerts )
+				continue;
+
+			const Vector3 & a = verts[tri[0]];
+			const Vector3 & b = verts[tri[1]];
+			const Vector3 & c = verts[tri[2]];
+
+			Vector3 fn = Vector3::crossproduct( b - a, c - a );
+			float area = fn.length() / 2.0f;
+			if ( area <= 0.0f )
+				continue;
+
+			fn.normalize();
+
+			for ( int j = 0; j < 3; j++ ) {
+				float weight = 1.0f;
+				if ( weighting == NormalWeighting::Area )
+					weight = area;
+				else if ( weighting == NormalWeighting::Angle )
+					weight = cornerAngle( verts[tri[j]], verts[tri[( j + 1 ) % 3]], verts[tri[( j + 2 ) % 3]] );
+
+				contribNormal.append( fn );
+				contribWeight.append( weight );
+				contribVertex.append( tri[j] );
+			}
+		}
+	}
+
+	int numContribs = contribVertex.count();
+
+	// Reference normal of each vertex, from its own faces
+	QVector<Vector3> reference( numVerts );
+	for ( int k = 0; k < numContribs; k++ )
+		reference[contribVertex[k]] += contribNormal[k] * contribWeight[k];
+
+	for ( int i = 0; i < numVerts; i++ ) {
+		if ( reference[i].squaredLength() > 0.0f )
+			reference[i].normalize();
+		else
+			reference[i] = Vector3( norms.value( i ) ).normalize();
+	}
+
+	// Bucket the contributions by vertex group
+	QVector<int> groupStart( numVerts + 1, 0 );
+	for ( int k = 0; k < numContribs; k++ )
+		groupStart[group[contribVertex[k]] + 1]++;
+	for ( int i = 0; i < numVerts; i++ )
+		groupStart[i + 1] += groupStart[i];
+
+	QVector<int> groupContribs( numContribs );
+	QVector<int> fill( groupStart );
+	for ( int k = 0; k < numContribs; k++ )
+		groupContribs[fill[group[contribVertex[k]]]++] = k;
+
+	float minCos = std::cos( maxAngle );
+
+	QVector<Vector3> result( numVerts );
+
+	auto smoothRange = [&]( int first, int last ) {
+		for ( int i = first; i < last; i++ ) {
+			const Vector3 & ref = reference[i];
+			int g = group[i];
+
+			Vector3 sum;
+			for ( int c = groupStart[g]; c < groupStart[g + 1]; c++ ) {
+				int k = groupContribs[c];
+				if ( Vector3::dotproduct( contribNormal[k], ref ) >= minCos )
+					sum += contribNormal[k] * contribWeight[k];
+			}
+
+			if ( sum.squaredLength() > 0.0f )
+				result[i] = sum.normalize();
+			else
+				result[i] = ref;
+		}
+	};
+
+	QVector<QPair<int, int> > chunks;
+	for ( int first = 0; first < numVerts; first += SMOOTH_CHUNK_SIZE )
+		chunks.append( { first, std::min( first + SMOOTH_CHUNK_SIZE, numVerts ) } );
+
+	if ( parallel && chunks.count() > 1 ) {
+		QtConcurrent::blockingMap( chunks, [&smoothRange]( const QPair<int, int> & c ) { smoothRange( c.first, c.second ); } );
+	} else {
+		for ( const auto & c : chunks )
+			smoothRange( c.first, c.second );
+	}
+
+	return result;
+}
@@ -0,0 +1,68 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef SMOOTHNORMALS_H
+#define SMOOTHNORMALS_H
+
+#include "data/niftypes.h"
+
+#include <QVector>
+
+
+//! How face normals contribute to a smoothed vertex normal
+enum class NormalWeighting
+{
+	Equal, //!< Every face counts the same
+	Area,  //!< Faces are weighted by their area
+	Angle  //!< Faces are weighted by their angle at the vertex
+};
+
+/*! Smooth vertex normals across faces and coincident vertices
+ *
+ * Vertices are grouped with a spatial hash so seams are smoothed too, in linear
+ * expected time. A face contributes to a vertex if its normal is within the
+ * angle of the faces using the vertex itself. Without triangles, the normals
+ * of coincident vertices are averaged instead.
+ *
+ * @param verts			The vertex positions
+ * @param norms			The current vertex normals
+ * @param triangles		The triangles, may be empty
+ * @param maxAngle		The largest angle between smoothed faces, in radians
+ * @param tolerance		The largest difference per axis between coincident positions
+ * @param weighting		How faces are weighted
+ * @param parallel		Whether to use the global thread pool for large meshes
+ * @return The smoothed normals
+ */
+QVector<Vector3> smoothNormals( const QVector<Vector3> & verts, const QVector<Vector3> & norms, const QVector<Triangle> & triangles,
+								float maxAngle, float tolerance, NormalWeighting weighting = NormalWeighting::Angle, bool parallel = true );
+
+#endif
@@ -0,0 +1,165 @@
+#include "stripify.h"
+#include "data/niftypes.h"
+
+#include <QHash>
+
+#include <algorithm>
+#include <climits>
+
+
+//! Key of a directed edge
+static inline quint32 edgeKey( quint16 a, quint16 b )
+{
+	return ( quint32( a ) << 16 ) | b;
+}
+
+//! Find an unused triangle containing the directed edge a -> b, returns its third vertex
+static int nextVertex( const QMultiHash<quint32, int> & edges, const QVector<Triangle> & tris,
+                       const QVector<bool> & used, quint16 a, quint16 b, int & tri )
+{
+	for ( auto it = edges.constFind( edgeKey( a, b ) ); it != edges.constEnd() && it.key() == edgeKey( a, b ); ++it ) {
+		if ( used[it.value()] )
+			continue;
+
+		const Triangle & t = tris[it.value()];
+		for ( int c = 0; c < 3; c++ ) {
+			if ( t[c] == a && t[( c + 1 ) % 3] == b ) {
+				tri = it.value();
+				return t[( c + 2 ) % 3];
+			}
+		}
+	}
+
+	return -1;
+}
+
+QVector<QVector<quint16> > stripify( QVector<Triangle> triangles, bool stitch, int cacheSize )
+{
+	QVector<Triangle> tris;
+	tris.reserve( triangles.count() );
+	for ( const Triangle & t : triangles ) {
+		if ( t[0] != t[1] && t[1] != t[2] && t[2] != t[0] )
+			tris.append( t );
+	}
+
+	// Starting the strips in cache order keeps the strips cache friendly too
+	tris = optimizeVertexCache( tris, cacheSize );
+
+	QMultiHash<quint32, int> edges;
+	edges.reserve( tris.count() * 3 );
+	for ( int t = 0; t < tris.count(); t++ ) {
+		for ( int c = 0; c < 3; c++ )
+			edges.insert( edgeKey( tris[t][c], tris[t][( c + 1 ) % 3] ), t );
+	}
+
+	QVector<bool> used( tris.count(), false );
+	QVector<QVector<quint16> > strips;
+
+	int maxLength = std::max( cacheSize / 2, 4 );
+
+	for ( int start = 0; start < tris.count(); start++ ) {
+		if ( used[start] )
+			continue;
+
+		used[start] = true;
+		const Triangle & first = tris[start];
+
+		// Begin with the rotation of the first triangle which can be continued
+		int rot = 0;
+		for ( int r = 0; r < 3; r++ ) {
+			int tri;
+			if ( nextVertex( edges, tris, used, first[( r + 2 ) % 3], first[( r + 1 ) % 3], tri ) >= 0 ) {
+				rot = r;
+				break;
+			}
+		}
+
+		QVector<quint16> strip;
+		strip << first[rot] << first[( rot + 1 ) % 3] << first[( rot + 2 ) % 3];
+
+		forever {
+			// Triangle k of a strip is (k, k+1, k+2), with every odd triangle flipped
+			int n = strip.count();
+			int k = n - 2;
+			quint16 b = strip[n - 2], c = strip[n - 1];
+			int tri = -1;
+			int d = ( k % 2 == 0 ) ? nextVertex( edges, tris, used, b, c, tri )
+			                       : nextVertex( edges, tris, used, c, b, tri );
+
+			// Long strips walk out of the vertex cache, stitched strips can restart at little cost
+			if ( d < 0 || n >= USHRT_MAX || ( stitch && k >= maxLength ) )
+				break;
+
+			used[tri] = true;
+			strip << quint16( d );
+		}
+
+		strips << strip;
+	}
+
+	if ( !stitch || strips.count() < 2 )
+		return strips;
+
+	// Join the strips with degenerate triangles
+	QVector<QVector<quint16> > stitched;
+	QVector<quint16> current;
+
+	for ( const QVector<quint16> & strip : strips ) {
+		if ( current.isEmpty() ) {
+			current = strip;
+			continue;
+		}
+
+		// The joined strip must start on an even triangle to keep its winding
+		int extra = ( current.count() % 2 ) ? 3 : 2;
+		if ( current.count() + extra + strip.count() > USHRT_MAX ) {
+			stitched << current;
+			current = strip;
+			continue;
+		}
+
+		current << current.last() << strip.first();
+		if ( extra == 3 )
+			current << strip.first();
+
+		current += strip;
+	}
+
+	stitched << current;
+
+	return stitched;
+}
+
+QVector<Triangle> triangulate( QVector<quint16> strip )
+{
+	QVector<Triangle> tris;
+	quint16 a, b = strip.value( 0 ), c = strip.value( 1 );
+	bool flip = false;
+
+	for ( int s = 2; s < strip.count(); s++ ) {
+		a = b;
+		b = c;
+		c = strip.value( s );
+
+		if ( a != b && b != c && c != a ) {
+			if ( !flip )
+				tris.append( Triangle( a, b, c ) );
+			else
+				tris.append( Triangle( a, c, b ) );
+		}
+
+		flip = !flip;
+	}
+
+	return tris;
+}
+
+QVector<Triangle> triangulate( QVector<QVector<quint16> > strips )
+{
+	QVector<Triangle> tris;
+	for ( const QVector<quint16>& strip : strips ) {
+		tris += triangulate( strip );
+	}
+	return tris;
+}
+
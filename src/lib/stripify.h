@@ -0,0 +1,24 @@
+#ifndef STRIPIFY_H
+#define STRIPIFY_H
+
+#include "vertexcache.h"
+
+#include <QList>
+#include <QVector>
+
+
+class Triangle;
+
+/*! Convert triangles to strips
+ *
+ * The triangles are first reordered for the vertex cache, then greedily joined into strips.
+ *
+ * @param triangles	The triangles, degenerate triangles are dropped
+ * @param stitch	Join the strips with degenerate triangles, up to 65535 indices per strip
+ * @param cacheSize	The size of the simulated vertex cache
+ */
+QVector<QVector<quint16> > stripify( QVector<Triangle> triangles, bool stitch = true, int cacheSize = VERTEX_CACHE_SIZE );
+QVector<Triangle> triangulate( QVector<quint16> strips );
+QVector<Triangle> triangulate( QVector<QVector<quint16> > strips );
+
+#endif
@@ -0,0 +1,241 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "vertexcache.h"
+#include "data/niftypes.h"
+
+#include <QSet>
+
+#include <algorithm>
+#include <cmath>
+
+
+// Scoring constants from Forsyth's article
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRI_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+//! Score of a vertex from its LRU cache position and the number of triangles still using it
+static float vertexScore( int cachePos, int remaining, int cacheSize )
+{
+	if ( remaining == 0 )
+		return -1.0f;
+
+	float score = 0.0f;
+	if ( cachePos >= 0 ) {
+		if ( cachePos < 3 ) {
+			// The vertices of the last triangle get a fixed score, to avoid reusing them at once
+			score = LAST_TRI_SCORE;
+		} else {
+			float scaler = 1.0f / ( cacheSize - 3 );
+			score = std::pow( 1.0f - ( cachePos - 3 ) * scaler, CACHE_DECAY_POWER );
+		}
+	}
+
+	// Bonus for vertices with few remaining triangles, so lone triangles are not left behind
+	score += VALENCE_BOOST_SCALE * std::pow( float( remaining ), -VALENCE_BOOST_POWER );
+	return score;
+}
+
+QVector<Triangle> optimizeVertexCache( const QVector<Triangle> & triangles, int cacheSize )
+{
+	int numTris = triangles.count();
+	if ( numTris == 0 )
+		return triangles;
+
+	cacheSize = std::max( cacheSize, 4 );
+
+	int numVerts = 0;
+	for ( const Triangle & t : triangles )
+		numVerts = std::max( numVerts, int( std::max( { t[0], t[1], t[2] } ) ) + 1 );
+
+	// Triangles of each vertex, packed
+	QVector<int> remaining( numVerts, 0 );
+	for ( const Triangle & t : triangles ) {
+		for ( int c = 0; c < 3; c++ )
+			remaining[t[c]]++;
+	}
+
+	QVector<int> offsets( numVerts + 1, 0 );
+	for ( int v = 0; v < numVerts; v++ )
+		offsets[v + 1] = offsets[v] + remaining[v];
+
+	QVector<int> vertTris( offsets[numVerts] );
+	QVector<int> fill = offsets;
+	for ( int t = 0; t < numTris; t++ ) {
+		for ( int c = 0; c < 3; c++ )
+			vertTris[fill[triangles[t][c]]++] = t;
+	}
+
+	QVector<int> cachePos( numVerts, -1 );
+	QVector<float> vertScore( numVerts );
+	for ( int v = 0; v < numVerts; v++ )
+		vertScore[v] = vertexScore( -1, remaining[v], cacheSize );
+
+	QVector<float> triScore( numTris );
+	QVector<bool> added( numTris, false );
+	for ( int t = 0; t < numTris; t++ )
+		triScore[t] = vertScore[triangles[t][0]] + vertScore[triangles[t][1]] + vertScore[triangles[t][2]];
+
+	QVector<int> cache;
+	cache.reserve( cacheSize + 3 );
+
+	QVector<Triangle> result;
+	result.reserve( numTris );
+
+	int best = int( std::max_element( triScore.constBegin(), triScore.constEnd() ) - triScore.constBegin() );
+	int scan = 0;
+
+	while ( best >= 0 ) {
+		const Triangle & tri = triangles[best];
+		added[best] = true;
+		result.append( tri );
+
+		// Remove the triangle from its vertices
+		for ( int c = 0; c < 3; c++ ) {
+			int v = tri[c];
+			int * first = vertTris.data() + offsets[v];
+			int * last = first + remaining[v];
+			std::remove( first, last, best );
+			remaining[v]--;
+		}
+
+		// Move its vertices to the front of the cache
+		QVector<int> newCache;
+		newCache.reserve( cacheSize + 3 );
+		for ( int c = 0; c < 3; c++ )
+			newCache.append( tri[c] );
+		for ( int v : cache ) {
+			if ( v != tri[0] && v != tri[1] && v != tri[2] )
+				newCache.append( v );
+		}
+
+		// Vertices pushed out of the cache
+		for ( int i = cacheSize; i < newCache.count(); i++ ) {
+			cachePos[newCache[i]] = -1;
+			vertScore[newCache[i]] = vertexScore( -1, remaining[newCache[i]], cacheSize );
+		}
+
+		newCache.resize( std::min( newCache.count(), cacheSize ) );
+		cache = newCache;
+
+		for ( int i = 0; i < cache.count(); i++ ) {
+			cachePos[cache[i]] = i;
+			vertScore[cache[i]] = vertexScore( i, remaining[cache[i]], cacheSize );
+		}
+
+		// Only the triangles of cached vertices change score, take the best of them
+		best = -1;
+		float bestScore = -1.0f;
+		for ( int v : cache ) {
+			for ( int i = offsets[v]; i < offsets[v] + remaining[v]; i++ ) {
+				int t = vertTris[i];
+				const Triangle & other = triangles[t];
+				triScore[t] = vertScore[other[0]] + vertScore[other[1]] + vertScore[other[2]];
+
+				if ( triScore[t] > bestScore ) {
+					bestScore = triScore[t];
+					best = t;
+				}
+			}
+		}
+
+		// Nothing connected to the cache, continue with the next unused triangle
+		if ( best < 0 ) {
+			while ( scan < numTris && added[scan] )
+				scan++;
+
+			if ( scan < numTris )
+				best = scan;
+		}
+	}
+
+	return result;
+}
+
+QVector<int> optimizeVertexFetch( QVector<Triangle> & triangles, int numVerts )
+{
+	QVector<int> remap( numVerts, -1 );
+	QVector<int> order;
+	order.reserve( numVerts );
+
+	for ( Triangle & t : triangles ) {
+		for ( int c = 0; c < 3; c++ ) {
+			int v = t[c];
+			if ( v >= numVerts )
+				continue;
+
+			if ( remap[v] < 0 ) {
+				remap[v] = order.count();
+				order.append( v );
+			}
+
+			t[c] = remap[v];
+		}
+	}
+
+	for ( int v = 0; v < numVerts; v++ ) {
+		if ( remap[v] < 0 )
+			order.append( v );
+	}
+
+	return order;
+}
+
+VertexCacheStats vertexCacheStats( const QVector<Triangle> & triangles, int cacheSize )
+{
+	VertexCacheStats stats;
+	stats.triangles = triangles.count();
+
+	// FIFO cache, as found in most hardware
+	QVector<int> fifo( std::max( cacheSize, 1 ), -1 );
+	int head = 0;
+	QSet<int> used;
+
+	for ( const Triangle & t : triangles ) {
+		for ( int c = 0; c < 3; c++ ) {
+			int v = t[c];
+			used.insert( v );
+
+			if ( std::find( fifo.constBegin(), fifo.constEnd(), v ) != fifo.constEnd() )
+				continue;
+
+			stats.misses++;
+			fifo[head] = v;
+			head = ( head + 1 ) % fifo.count();
+		}
+	}
+
+	stats.vertices = used.count();
+	return stats;
+}
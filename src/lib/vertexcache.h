@@ -0,0 +1,86 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef VERTEXCACHE_H
+#define VERTEXCACHE_H
+
+#include <QVector>
+
+
+class Triangle;
+
+//! Default size of the simulated post-transform vertex cache
+#define VERTEX_CACHE_SIZE 32
+
+/*! Reorder triangles for post-transform vertex cache efficiency
+ *
+ * Implements Tom Forsyth's linear-speed vertex cache optimisation.
+ *
+ * @param triangles	The triangles to reorder
+ * @param cacheSize	The size of the simulated LRU cache
+ * @return The same triangles in an order which reuses recently used vertices
+ */
+QVector<Triangle> optimizeVertexCache( const QVector<Triangle> & triangles, int cacheSize = VERTEX_CACHE_SIZE );
+
+/*! Order vertices by their first use in the triangles
+ *
+ * @param triangles	The triangles, remapped to the new vertex order on return
+ * @param numVerts	The number of vertices
+ * @return For every new vertex index, the old vertex index; unused vertices are appended at the end
+ */
+QVector<int> optimizeVertexFetch( QVector<Triangle> & triangles, int numVerts );
+
+//! Statistics of a triangle list in a simulated FIFO vertex cache
+struct VertexCacheStats
+{
+	int triangles = 0; //!< Number of triangles
+	int vertices = 0;  //!< Number of distinct vertices used
+	int misses = 0;    //!< Number of cache misses, i.e. transformed vertices
+
+	//! Average cache miss ratio, transformed vertices per triangle (0.5 is ideal, 3 is worst)
+	float acmr() const { return triangles ? float( misses ) / triangles : 0.0f; }
+	//! Average transform to vertex ratio, transformed vertices per vertex (1 is ideal)
+	float atvr() const { return vertices ? float( misses ) / vertices : 0.0f; }
+
+	VertexCacheStats & operator+=( const VertexCacheStats & other )
+	{
+		triangles += other.triangles;
+		vertices += other.vertices;
+		misses += other.misses;
+		return *this;
+	}
+};
+
+//! Measure the vertex cache efficiency of a triangle list
+VertexCacheStats vertexCacheStats( const QVector<Triangle> & triangles, int cacheSize = VERTEX_CACHE_SIZE );
+
+#endif
@@ -0,0 +1,172 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "vertexweld.h"
+
+#include <QHash>
+
+#include <cmath>
+#include <cstring>
+
+
+//! A cell of the spatial hash
+struct WeldCell
+{
+	qint64 x, y, z;
+
+	bool operator==( const WeldCell & other ) const
+	{
+		return x == other.x && y == other.y && z == other.z;
+	}
+};
+
+inline uint qHash( const WeldCell & c )
+{
+	return qHash( c.x ) ^ ( qHash( c.y ) * 31 ) ^ ( qHash( c.z ) * 131 );
+}
+
+//! Cell coordinate of a position component
+static qint64 cellOf( float v, float tolerance )
+{
+	if ( tolerance > 0.0f )
+		return qint64( std::floor( double( v ) / tolerance ) );
+
+	// Exact matching, hash the bits with -0 folded onto +0
+	float f = v + 0.0f;
+	quint32 bits;
+	std::memcpy( &bits, &f, sizeof( bits ) );
+	return bits;
+}
+
+
+VertexWelder::VertexWelder( const QVector<Vector3> & positions, float tolerance )
+	: positions( positions ), tolerance( tolerance )
+{
+}
+
+void VertexWelder::addAttribute( const QVector<float> & data, int components, float tolerance )
+{
+	if ( components <= 0 || data.count() != positions.count() * components )
+		return;
+
+	attributes.append( { data, components, tolerance } );
+}
+
+bool VertexWelder::matches( int a, int b ) const
+{
+	const Vector3 & pa = positions[a];
+	const Vector3 & pb = positions[b];
+
+	for ( int i = 0; i < 3; i++ ) {
+		if ( !( std::fabs( pa[i] - pb[i] ) <= tolerance ) )
+			return false;
+	}
+
+	for ( const Attribute & attr : attributes ) {
+		const float * da = attr.data.constData() + a * attr.components;
+		const float * db = attr.data.constData() + b * attr.components;
+
+		for ( int c = 0; c < attr.components; c++ ) {
+			if ( !( std::fabs( da[c] - db[c] ) <= attr.tolerance ) )
+				return false;
+		}
+	}
+
+	return true;
+}
+
+QVector<int> VertexWelder::weld() const
+{
+	int numVerts = positions.count();
+
+	QVector<int> welded( numVerts );
+
+	// First vertex of each cell, further vertices of the cell are chained through next
+	QHash<WeldCell, int> heads;
+	QVector<int> next( numVerts, -1 );
+	heads.reserve( numVerts );
+
+	// Positions within the tolerance can be in the neighbouring cells
+	int span = ( tolerance > 0.0f ) ? 1 : 0;
+
+	for ( int i = 0; i < numVerts; i++ ) {
+		const Vector3 & p = positions[i];
+		WeldCell cell = { cellOf( p[0], tolerance ), cellOf( p[1], tolerance ), cellOf( p[2], tolerance ) };
+
+		int match = -1;
+
+		for ( int dx = -span; dx <= span && match < 0; dx++ ) {
+			for ( int dy = -span; dy <= span && match < 0; dy++ ) {
+				for ( int dz = -span; dz <= span && match < 0; dz++ ) {
+					auto it = heads.constFind( { cell.x + dx, cell.y + dy, cell.z + dz } );
+					if ( it == heads.constEnd() )
+						continue;
+
+					for ( int j = it.value(); j >= 0; j = next[j] ) {
+						if ( matches( i, j ) ) {
+							match = j;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		if ( match >= 0 ) {
+			welded[i] = match;
+		} else {
+			welded[i] = i;
+			next[i] = heads.value( cell, -1 );
+			heads.insert( cell, i );
+		}
+	}
+
+	return welded;
+}
+
+QVector<int> VertexWelder::compact( const QVector<int> & welded, QVector<int> & kept )
+{
+	QVector<int> map( welded.count() );
+	kept.clear();
+
+	for ( int i = 0; i < welded.count(); i++ ) {
+		if ( welded[i] == i ) {
+			map[i] = kept.count();
+			kept.append( i );
+		} else {
+			// Welded vertices always point to an earlier vertex
+			map[i] = map[welded[i]];
+		}
+	}
+
+	return map;
+}
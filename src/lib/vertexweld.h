@@ -0,0 +1,101 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef VERTEXWELD_H
+#define VERTEXWELD_H
+
+#include "data/niftypes.h"
+
+#include <QVector>
+
+
+//! Finds mergeable vertices using a spatial hash of their positions
+class VertexWelder final
+{
+public:
+	/*! Constructor
+	 *
+	 * @param positions	The vertex positions
+	 * @param tolerance	The largest difference per axis between welded positions
+	 */
+	VertexWelder( const QVector<Vector3> & positions, float tolerance = 0.0f );
+
+	/*! Add an attribute which must also match for vertices to be welded
+	 *
+	 * @param data			The attribute values, @p components floats per vertex
+	 * @param components	The number of floats per vertex
+	 * @param tolerance		The largest difference per component
+	 */
+	void addAttribute( const QVector<float> & data, int components, float tolerance = 0.0f );
+
+	/*! Weld the vertices, in O(n) expected time
+	 *
+	 * @return For every vertex, the index of the first vertex matching it (itself if there is none)
+	 */
+	QVector<int> weld() const;
+
+	/*! Convert the result of weld() to a map for removing the welded vertices
+	 *
+	 * @param welded	The result of weld()
+	 * @param kept		Set to the indices of the remaining vertices, in order
+	 * @return For every vertex, its index in the remaining vertices
+	 */
+	static QVector<int> compact( const QVector<int> & welded, QVector<int> & kept );
+
+	//! Flatten a list of Vector2, Vector3, Color4 etc. into an attribute
+	template <typename T> static QVector<float> attribute( const QVector<T> & values, int components )
+	{
+		QVector<float> data;
+		data.reserve( values.count() * components );
+		for ( const T & v : values ) {
+			for ( int c = 0; c < components; c++ )
+				data.append( v.data()[c] );
+		}
+		return data;
+	}
+
+private:
+	bool matches( int a, int b ) const;
+
+	struct Attribute
+	{
+		QVector<float> data;
+		int components;
+		float tolerance;
+	};
+
+	QVector<Vector3> positions;
+	float tolerance;
+	QVector<Attribute> attributes;
+};
+
+#endif
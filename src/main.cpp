@@ -31,6 +31,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ***** END LICENCE BLOCK *****/
 
 #include "nifskope.h"
+#include "startuptrace.h"
 #include "version.h"
 #include "data/nifvalue.h"
 #include "model/nifmodel.h"
@@ -39,12 +40,17 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QApplication>
 #include <QtGlobal>
 #include <QCommandLineParser>
+#include <QDataStream>
 #include <QDesktopServices>
 #include <QDir>
+#include <QFile>
+#include <QLocalServer>
+#include <QLocalSocket>
 #include <QSettings>
-#include <QStack>
-#include <QUdpSocket>
+#include <QTimer>
 #include <QUrl>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QtConcurrent/QtConcurrentRun>
 #include <cstdio>
 bool OnlyFix = 0;
 
@@ -73,7 +79,11 @@ QCoreApplication * createApplication( int &argc, char *argv[] )
 //! The main program
 int main( int argc, char * argv[] )
 {
-	QScopedPointer<QCoreApplication> app( createApplication( argc, argv ) );
+	QScopedPointer<QCoreApplication> app;
+	{
+		StartupTrace::Phase phase( "Create application" );
+		app.reset( createApplication( argc, argv ) );
+	}
 
 	if ( auto a = qobject_cast<QApplication *>(app.data()) ) {
 
@@ -100,13 +110,9 @@ int main( int argc, char * argv[] )
 		NifSkope::SetAppLocale( cfg.value( "Locale", "en" ).toLocale() );
 		cfg.endGroup();
 
-		// Load XML files
-		NifModel::loadXML();
-		KfmModel::loadXML();
-
 		int port = NIFSKOPE_IPC_PORT;
 
-		QStack<QString> fnames;
+		QStringList fnames;
 
 		// Command Line setup
 		QCommandLineParser parser;
@@ -114,12 +120,19 @@ int main( int argc, char * argv[] )
 		parser.addVersionOption();
 
 		// Add port option
-		QCommandLineOption portOption( {"p", "port"}, "Port NifSkope listens on", "port" );
+		QCommandLineOption portOption( {"p", "port"}, "Instance number; NifSkope started again with the same one opens its files in the running instance", "port" );
 		parser.addOption( portOption );
 
+		// Add startup trace option
+		QCommandLineOption traceOption( "startup-trace", "Write the duration of each startup phase to <file>, or - for stderr", "file" );
+		parser.addOption( traceOption );
+
 		// Process options
 		parser.process( *a );
 
+		if ( parser.isSet( traceOption ) )
+			StartupTrace::setOutput( parser.value( traceOption ) );
+
 		// Override port value
 		if ( parser.isSet( portOption ) )
 			port = parser.value( portOption ).toInt();
@@ -129,31 +142,44 @@ int main( int argc, char * argv[] )
 			QString fname = QDir::current().filePath( arg );
 
 			if ( QFileInfo( fname ).exists() ) {
-				fnames.push( fname );
+				fnames << fname;
 			}
 		}
 
-		// No files were passed to NifSkope, push empty string
+		// No files were passed to NifSkope, open an empty window
 		if ( fnames.isEmpty() ) {
-			fnames.push( QString() );
+			fnames << QString();
 		}
 
-		if ( IPCsocket * ipc = IPCsocket::create( port ) ) {
-			//qDebug() << "IPCSocket exec";
-			ipc->execCommand( QString( "NifSkope::open %1" ).arg( fnames.pop() ) );
+		// Hand the files to the running instance, if there is one
+		if ( IPCsocket::sendFiles( fnames, port ) )
+			return 0;
 
-			while ( !fnames.isEmpty() ) {
-				IPCsocket::sendCommand( QString( "NifSkope::open %1" ).arg( fnames.pop() ), port );
-			}
+		IPCsocket * ipc = IPCsocket::create( port );
+
+		// Load XML files, only needed by the instance which opens the files
+		{
+			StartupTrace::Phase phase( "Load nif.xml" );
+			NifModel::loadXML();
+		}
+		{
+			StartupTrace::Phase phase( "Load kfm.xml" );
+			KfmModel::loadXML();
+		}
+
+		{
+			StartupTrace::Phase phase( "Create window" );
+			NifSkope::createWindow( fnames.takeFirst() );
+		}
 
-			return a->exec();
+		if ( ipc ) {
+			ipc->queueFiles( fnames );
 		} else {
-			//qDebug() << "IPCSocket send";
-			while ( !fnames.isEmpty() ) {
-				IPCsocket::sendCommand( QString( "NifSkope::open %1" ).arg( fnames.pop() ), port );
-			}
-			return 0;
+			for ( const QString & fname : fnames )
+				NifSkope::createWindow( fname );
 		}
+
+		return a->exec();
 	} else {
 		// Future command line batch tools here
 	}
@@ -167,57 +193,185 @@ int main( int argc, char * argv[] )
 *  IPC socket
 */
 
+//! Identifies a batch of files sent to another instance
+static const quint32 IPC_MAGIC = 0x4E534950;
+//! Largest batch the server will buffer before dropping the connection
+static const qint64 IPC_MAX_BATCH = 16 * 1024 * 1024;
+//! How long to wait for the running instance to acknowledge a batch, in milliseconds
+static const int IPC_TIMEOUT = 10000;
+
+QString IPCsocket::serverName( int port )
+{
+	// Server names are shared by every user of the machine
+	QByteArray user = qgetenv( "USER" );
+	if ( user.isEmpty() )
+		user = qgetenv( "USERNAME" );
+
+	return QString( "NifSkope-%1-%2" ).arg( port ).arg( QString::fromLocal8Bit( user ) );
+}
+
 IPCsocket * IPCsocket::create( int port )
 {
-	QUdpSocket * udp = new QUdpSocket();
+	QString name = serverName( port );
+	QLocalServer * server = new QLocalServer();
+	server->setSocketOptions( QLocalServer::UserAccessOption );
+
+	// A server nobody answers on was left behind by an instance that crashed
+	if ( !server->listen( name ) && server->serverError() == QAbstractSocket::AddressInUseError ) {
+		QLocalSocket probe;
+		probe.connectToServer( name );
+		if ( !probe.waitForConnected( 1000 ) ) {
+			QLocalServer::removeServer( name );
+			server->listen( name );
+		}
+	}
 
-	if ( udp->bind( QHostAddress( QHostAddress::LocalHost ), port, QUdpSocket::DontShareAddress ) ) {
-		IPCsocket * ipc = new IPCsocket( udp );
+	if ( server->isListening() ) {
+		IPCsocket * ipc = new IPCsocket( server );
 		QDesktopServices::setUrlHandler( "nif", ipc, "openNif" );
 		return ipc;
 	}
 
+	delete server;
 	return nullptr;
 }
 
-void IPCsocket::sendCommand( const QString & cmd, int port )
+bool IPCsocket::sendFiles( const QStringList & files, int port )
 {
-	QUdpSocket udp;
-	udp.writeDatagram( (const char *)cmd.data(), cmd.length() * sizeof( QChar ), QHostAddress( QHostAddress::LocalHost ), port );
+	QLocalSocket socket;
+	socket.connectToServer( serverName( port ) );
+	if ( !socket.waitForConnected( 1000 ) )
+		return false;
+
+	QDataStream stream( &socket );
+	stream.setVersion( QDataStream::Qt_5_7 );
+	stream << IPC_MAGIC << files;
+
+	while ( socket.bytesToWrite() > 0 ) {
+		if ( !socket.waitForBytesWritten( IPC_TIMEOUT ) )
+			return false;
+	}
+
+	// The running instance replies with the number of files it queued
+	while ( socket.bytesAvailable() < qint64( sizeof( quint32 ) ) ) {
+		if ( !socket.waitForReadyRead( IPC_TIMEOUT ) )
+			return false;
+	}
+
+	quint32 accepted = 0;
+	stream >> accepted;
+
+	return stream.status() == QDataStream::Ok && accepted == quint32( files.count() );
 }
 
-IPCsocket::IPCsocket( QUdpSocket * s ) : QObject(), socket( s )
+IPCsocket::IPCsocket( QLocalServer * s ) : QObject(), server( s )
 {
-	QObject::connect( socket, &QUdpSocket::readyRead, this, &IPCsocket::processDatagram );
+	QObject::connect( server, &QLocalServer::newConnection, this, &IPCsocket::acceptConnection );
 }
 
 IPCsocket::~IPCsocket()
 {
-	delete socket;
+	delete server;
 }
 
-void IPCsocket::processDatagram()
+void IPCsocket::acceptConnection()
 {
-	while ( socket->hasPendingDatagrams() ) {
-		QByteArray data;
-		data.resize( socket->pendingDatagramSize() );
-		QHostAddress host;
-		quint16 port = 0;
-
-		socket->readDatagram( data.data(), data.size(), &host, &port );
-
-		if ( host == QHostAddress( QHostAddress::LocalHost ) && (data.size() % sizeof( QChar )) == 0 ) {
-			QString cmd;
-			cmd.setUnicode( (QChar *)data.data(), data.size() / sizeof( QChar ) );
-			execCommand( cmd );
-		}
+	while ( QLocalSocket * socket = server->nextPendingConnection() ) {
+		QObject::connect( socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater );
+		QObject::connect( socket, &QLocalSocket::readyRead, this, [this, socket]() { readBatch( socket ); } );
+
+		// The batch may have arrived along with the connection
+		if ( socket->bytesAvailable() > 0 )
+			readBatch( socket );
 	}
 }
 
+void IPCsocket::readBatch( QLocalSocket * socket )
+{
+	QDataStream stream( socket );
+	stream.setVersion( QDataStream::Qt_5_7 );
+
+	quint32 magic = 0;
+	QStringList files;
+
+	stream.startTransaction();
+	stream >> magic;
+
+	if ( stream.status() == QDataStream::Ok && magic != IPC_MAGIC ) {
+		stream.abortTransaction();
+		socket->abort();
+		return;
+	}
+
+	stream >> files;
+
+	if ( !stream.commitTransaction() ) {
+		// Wait for the rest of the batch, unless it is too large to be one
+		if ( stream.status() == QDataStream::ReadPastEnd && socket->bytesAvailable() < IPC_MAX_BATCH )
+			return;
+
+		socket->abort();
+		return;
+	}
+
+	// Only queue what the sender will know was received, so it can open the files itself otherwise
+	if ( socket->state() != QLocalSocket::ConnectedState )
+		return;
+
+	QDataStream reply( socket );
+	reply.setVersion( QDataStream::Qt_5_7 );
+	reply << quint32( files.count() );
+	socket->flush();
+
+	queueFiles( files );
+}
+
+void IPCsocket::queueFiles( const QStringList & files )
+{
+	if ( files.isEmpty() )
+		return;
+
+	// Read the files ahead in parallel so that the windows opening them one by one hit the file cache
+	QStringList paths;
+	for ( const QString & fname : files ) {
+		if ( !fname.isEmpty() )
+			paths << fname;
+	}
+
+	if ( paths.count() > 1 ) {
+		QtConcurrent::run( [paths]() mutable {
+			QtConcurrent::blockingMap( paths, []( const QString & fname ) {
+				QFile file( fname );
+				if ( file.open( QIODevice::ReadOnly ) ) {
+					while ( !file.read( 1024 * 1024 ).isEmpty() )
+						;
+				}
+			} );
+		} );
+	}
+
+	bool idle = queue.isEmpty();
+	queue << files;
+
+	if ( idle )
+		QTimer::singleShot( 0, this, &IPCsocket::openQueued );
+}
+
+void IPCsocket::openQueued()
+{
+	if ( queue.isEmpty() )
+		return;
+
+	openNif( queue.takeFirst() );
+
+	if ( !queue.isEmpty() )
+		QTimer::singleShot( 0, this, &IPCsocket::openQueued );
+}
+
 void IPCsocket::execCommand( const QString & cmd )
 {
 	if ( cmd.startsWith( "NifSkope::open" ) ) {
-		openNif( cmd.right( cmd.length() - 15 ) );
+		queueFiles( { cmd.right( cmd.length() - 15 ) } );
 	}
 }
 
@@ -41,6 +41,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QFileInfo>
 #include <QTime>
 
+#include <algorithm>
 
 //! @file basemodel.cpp Abstract base class for NIF data models
 
@@ -58,6 +59,7 @@ BaseModel::BaseModel( QObject * p ) : QAbstractItemModel( p )
 BaseModel::~BaseModel()
 {
 	delete root;
+	NifValue::purgeShared();
 }
 
 QWidget * BaseModel::getWindow()
@@ -83,24 +85,94 @@ void BaseModel::testMsg( const QString & m ) const
 void BaseModel::beginInsertRows( const QModelIndex & parent, int first, int last )
 {
 	setState( Inserting );
-	QAbstractItemModel::beginInsertRows( parent, first, last );
+
+	NifItem * item = indexItem( parent );
+	if ( !item || item == root || !isArray( item ) ) {
+		rowChanges.push( { nullptr, -1, true } );
+		QAbstractItemModel::beginInsertRows( parent, first, last );
+		return;
+	}
+
+	int rows = item->childCount();
+	int shown = shownRows( item );
+	int count = last - first + 1;
+
+	if ( first < shown ) {
+		// Rows inserted among the shown ones are shown as well
+		rowChanges.push( { item, shown + count, true } );
+		QAbstractItemModel::beginInsertRows( parent, first, last );
+	} else if ( shown == rows ) {
+		// Appended rows are shown up to the end of the current chunk
+		int chunk = qMax( fetchedRows.value( item, ArrayChunkSize ), ArrayChunkSize );
+		int newShown = qMin( rows + count, chunk );
+
+		rowChanges.push( { item, newShown, newShown > shown } );
+		if ( newShown > shown )
+			QAbstractItemModel::beginInsertRows( parent, first, newShown - 1 );
+	} else {
+		rowChanges.push( { item, -1, false } );
+	}
 }
 
 void BaseModel::endInsertRows()
 {
-	QAbstractItemModel::endInsertRows();
+	RowChange change = rowChanges.pop();
+	if ( change.item && change.shown >= 0 )
+		setShownRows( change.item, change.shown );
+
+	if ( change.signalled )
+		QAbstractItemModel::endInsertRows();
+
 	restoreState();
 }
 
+void BaseModel::beginResetModel()
+{
+	fetchedRows.clear();
+
+	QAbstractItemModel::beginResetModel();
+}
+
 void BaseModel::beginRemoveRows( const QModelIndex & parent, int first, int last )
 {
 	setState( Removing );
-	QAbstractItemModel::beginRemoveRows( parent, first, last );
+
+	NifItem * item = indexItem( parent );
+	if ( item ) {
+		for ( int row = first; row <= last && row < item->childCount(); row++ )
+			forgetFetchedRows( item->child( row ) );
+	}
+
+	if ( !item || item == root || !isArray( item ) ) {
+		rowChanges.push( { nullptr, -1, true } );
+		QAbstractItemModel::beginRemoveRows( parent, first, last );
+		return;
+	}
+
+	int rows = item->childCount();
+	int shown = shownRows( item );
+
+	if ( first < shown ) {
+		// Rows after the shown ones must not move into view without being fetched
+		int shownLast = qMin( last, shown - 1 );
+		int newShown = ( shown < rows ) ? shown - ( shownLast - first + 1 ) : -1;
+
+		rowChanges.push( { item, newShown, true } );
+		QAbstractItemModel::beginRemoveRows( parent, first, shownLast );
+	} else {
+		rowChanges.push( { item, -1, false } );
+	}
 }
 
 void BaseModel::endRemoveRows()
 {
-	QAbstractItemModel::endRemoveRows();
+	RowChange change = rowChanges.pop();
+	if ( change.item && change.shown >= 0 )
+		setShownRows( change.item, change.shown );
+
+	if ( change.signalled )
+		QAbstractItemModel::endRemoveRows();
+
 	restoreState();
 }
 
@@ -113,6 +185,58 @@ bool BaseModel::getProcessingResult()
 	return result;
 }
 
+void BaseModel::beginBatch()
+{
+	batchDepth++;
+	setState( Processing );
+}
+
+void BaseModel::endBatch()
+{
+	if ( batchDepth == 0 )
+		return;
+
+	if ( !states.isEmpty() )
+		restoreState();
+	else
+		state = Default;
+
+	if ( --batchDepth > 0 )
+		return;
+
+	// Items may have been removed during the batch, only emit for those still present
+	QVector<int> rows;
+	rows.reserve( batchItems.count() );
+	for ( NifItem * item : batchItems ) {
+		int r = root->children().indexOf( item );
+		if ( r >= 0 )
+			rows << r;
+	}
+	batchItems.clear();
+
+	std::sort( rows.begin(), rows.end() );
+
+	// One signal per top-level item, spanning the columns so that views repaint its branch
+	for ( int r : rows ) {
+		NifItem * item = root->child( r );
+		emit dataChanged( createIndex( r, NameCol, item ), createIndex( r, ValueCol, item ) );
+	}
+}
+
+void BaseModel::batchChanged( NifItem * item )
+{
+	changedWhileProcessing = true;
+
+	if ( batchDepth == 0 || !item )
+		return;
+
+	while ( item->parent() && item->parent() != root )
+		item = item->parent();
+
+	if ( item != root )
+		batchItems.insert( item );
+}
+
 QList<TestMessage> BaseModel::getMessages() const
 {
 	QList<TestMessage> lst = messages;
@@ -345,14 +469,74 @@ QModelIndex BaseModel::parent( const QModelIndex & child ) const
 
 int BaseModel::rowCount( const QModelIndex & parent ) const
 {
-	NifItem * parentItem;
+	NifItem * item = indexItem( parent );
 
-	if ( !( parent.isValid() && parent.model() == this ) )
-		parentItem = root;
+	return ( item ? shownRows( item ) : 0 );
+}
+
+int BaseModel::childCount( const QModelIndex & parent ) const
+{
+	NifItem * item = indexItem( parent );
+
+	return ( item ? item->childCount() : 0 );
+}
+
+bool BaseModel::canFetchMore( const QModelIndex & parent ) const
+{
+	NifItem * item = indexItem( parent );
+
+	return ( item && shownRows( item ) < item->childCount() );
+}
+
+void BaseModel::fetchMore( const QModelIndex & parent )
+{
+	NifItem * item = indexItem( parent );
+	if ( !item )
+		return;
+
+	int shown = shownRows( item );
+	int rows = qMin( item->childCount(), shown + ArrayChunkSize );
+	if ( rows <= shown )
+		return;
+
+	QAbstractItemModel::beginInsertRows( createIndex( item->row(), 0, item ), shown, rows - 1 );
+	setShownRows( item, rows );
+	QAbstractItemModel::endInsertRows();
+}
+
+int BaseModel::shownRows( NifItem * item ) const
+{
+	if ( item == root || !isArray( item ) )
+		return item->childCount();
+
+	return qMin( item->childCount(), fetchedRows.value( item, ArrayChunkSize ) );
+}
+
+void BaseModel::setShownRows( NifItem * item, int shown )
+{
+	// Only arrays which differ from the default are listed
+	if ( shown == qMin( item->childCount(), ArrayChunkSize ) )
+		fetchedRows.remove( item );
 	else
-		parentItem = static_cast<NifItem *>( parent.internalPointer() );
+		fetchedRows.insert( item, shown );
+}
+
+void BaseModel::forgetFetchedRows( NifItem * item )
+{
+	if ( fetchedRows.isEmpty() || !item )
+		return;
 
-	return ( parentItem ? parentItem->childCount() : 0 );
+	fetchedRows.remove( item );
+	for ( NifItem * c : item->children() )
+		forgetFetchedRows( c );
+}
+
+NifItem * BaseModel::indexItem( const QModelIndex & parent ) const
+{
+	if ( !( parent.isValid() && parent.model() == this ) )
+		return root;
+
+	return static_cast<NifItem *>( parent.internalPointer() );
 }
 
 QVariant BaseModel::data( const QModelIndex & index, int role ) const
@@ -509,6 +693,8 @@ bool BaseModel::setData( const QModelIndex & index, const QVariant & value, int
 	if ( !( index.isValid() && role == Qt::EditRole && index.model() == this && item ) )
 		return false;
 
+	itemAboutToChange( item );
+
 	switch ( index.column() ) {
 	case BaseModel::NameCol:
 		item->setName( value.toString() );
@@ -546,6 +732,8 @@ bool BaseModel::setData( const QModelIndex & index, const QVariant & value, int
 
 	if ( state == Default )
 		emit dataChanged( index, index );
+	else if ( state == Processing )
+		batchChanged( item );
 
 	return true;
 }
@@ -37,7 +37,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <QAbstractItemModel> // Inherited
 #include <QFileInfo>
+#include <QHash>
 #include <QIODevice>
+#include <QSet>
 #include <QStack>
 #include <QString>
 #include <QVariant>
@@ -233,6 +235,23 @@ public:
 	//! Were there updates while batch processing (also clears the result)
 	bool getProcessingResult();
 
+	/*! Begin a batch of changes
+	 *
+	 * Suspends the per-item dataChanged() signals of set<T>, setArray<T> and setData
+	 * until the matching endBatch(). Batches may be nested.
+	 */
+	void beginBatch();
+
+	/*! End a batch of changes
+	 *
+	 * When the outermost batch is closed, emits a single dataChanged() for each
+	 * top-level item (header, block or footer) which was modified during the batch.
+	 */
+	void endBatch();
+
+	//! Is a batch of changes currently open
+	bool isBatching() const { return batchDepth > 0; }
+
 	//! Get Messages collected
 	QList<TestMessage> getMessages() const;
 
@@ -252,6 +271,9 @@ public:
 		NumColumns = 10,
 	};
 
+	//! Number of array elements shown to views at a time
+	static const int ArrayChunkSize = 1000;
+
 	// QAbstractItemModel
 
 	/*! Creates a model index for the given row and column
@@ -262,8 +284,20 @@ public:
 	//! Finds the parent of the specified index
 	QModelIndex parent( const QModelIndex & index ) const override;
 
-	//! Finds the number of rows
+	/*! Finds the number of rows shown to views
+	 *
+	 * Large arrays show their elements in chunks of ArrayChunkSize rows,
+	 * use childCount() for the number of elements.
+	 */
 	int rowCount( const QModelIndex & parent = QModelIndex() ) const override;
+	//! Finds the number of child items, including array elements not shown yet
+	int childCount( const QModelIndex & parent = QModelIndex() ) const;
+	//! Does the item have children, shown or not
+	bool hasChildren( const QModelIndex & parent = QModelIndex() ) const override { return childCount( parent ) > 0; }
+	//! Are there array elements not shown yet
+	bool canFetchMore( const QModelIndex & parent ) const override;
+	//! Shows the next chunk of array elements
+	void fetchMore( const QModelIndex & parent ) override;
 	//! Finds the number of columns
 	int columnCount( const QModelIndex & parent = QModelIndex() ) const override { Q_UNUSED( parent ); return NumColumns; }
 
@@ -355,12 +389,39 @@ protected:
 	//! Evaluate conditions
 	bool evalCondition( NifItem * item, bool chkParents = false ) const;
 
+	//! Record a change to an item while signals are suspended
+	void batchChanged( NifItem * item );
+	//! Called before the value or children of an item are modified
+	virtual void itemAboutToChange( NifItem * item ) { Q_UNUSED( item ); }
+
+	/*! Begin inserting rows
+	 *
+	 * For arrays shown in chunks only the rows shown are signalled; rows inserted among them
+	 * stay shown and appended rows are shown up to the current chunk.
+	 */
 	void beginInsertRows( const QModelIndex & parent, int first, int last );
 	void endInsertRows();
 
+	//! Begin resetting the model, forgetting the rows fetched for arrays
+	void beginResetModel();
+
+	/*! Begin removing rows
+	 *
+	 * For arrays shown in chunks only the rows shown are signalled, the rows after them
+	 * stay hidden until fetched. The rows fetched for the removed items are forgotten.
+	 */
 	void beginRemoveRows( const QModelIndex & parent, int first, int last );
 	void endRemoveRows();
 
+	//! Number of rows of an item shown to views
+	int shownRows( NifItem * item ) const;
+	//! Record the number of rows of an array shown to views
+	void setShownRows( NifItem * item, int shown );
+	//! Forget the rows fetched for an item and its descendants
+	void forgetFetchedRows( NifItem * item );
+	//! Item of an index, or the root item
+	NifItem * indexItem( const QModelIndex & parent ) const;
+
 	//! NifSkope window the model belongs to
 	QWidget * parentWindow;
 
@@ -390,6 +451,28 @@ protected:
 
 	//! Has any data changed while processing
 	bool changedWhileProcessing = false;
+
+	//! Nesting depth of beginBatch()/endBatch()
+	int batchDepth = 0;
+	//! Top-level items changed during the current batch
+	QSet<NifItem *> batchItems;
+
+	/*! Rows shown by arrays whose count differs from the default chunk
+	 *
+	 * Keyed by item, so entries are dropped on reset and when their rows are removed.
+	 */
+	QHash<NifItem *, int> fetchedRows;
+
+	//! A pending row insertion or removal, see beginInsertRows()
+	struct RowChange
+	{
+		NifItem * item;
+		//! Rows shown once the change is done, or -1 if unchanged
+		int shown;
+		//! Were views told about the change
+		bool signalled;
+	};
+	QStack<RowChange> rowChanges;
 };
 
 
@@ -478,11 +561,13 @@ template <typename T> inline T BaseModel::get( const QModelIndex & index ) const
 
 template <typename T> inline bool BaseModel::set( NifItem * item, const T & d )
 {
+	itemAboutToChange( item );
+
 	if ( item->value().set( d ) ) {
 		if ( state != Processing )
 			emit dataChanged( createIndex( item->row(), ValueCol, item ), createIndex( item->row(), ValueCol, item ) );
 		else
-			changedWhileProcessing = true;
+			batchChanged( item );
 
 		return true;
 	}
@@ -520,11 +605,16 @@ template <typename T> inline void BaseModel::setArray( const QModelIndex & iArra
 	NifItem * item = static_cast<NifItem *>( iArray.internalPointer() );
 
 	if ( isArray( iArray ) && item && iArray.model() == this ) {
+		itemAboutToChange( item );
 		item->setArray<T>( array );
 		int x = item->childCount() - 1;
 
-		if ( x >= 0 )
-			emit dataChanged( createIndex( 0, ValueCol, item->child( 0 ) ), createIndex( x, ValueCol, item->child( x ) ) );
+		if ( x >= 0 ) {
+			if ( state != Processing )
+				emit dataChanged( createIndex( 0, ValueCol, item->child( 0 ) ), createIndex( x, ValueCol, item->child( x ) ) );
+			else
+				batchChanged( item );
+		}
 	}
 }
 
@@ -533,11 +623,16 @@ template <typename T> inline void BaseModel::setArray( const QModelIndex & iArra
 	NifItem * item = static_cast<NifItem *>(iArray.internalPointer());
 
 	if ( isArray( iArray ) && item && iArray.model() == this ) {
+		itemAboutToChange( item );
 		item->setArray<T>( val );
 		int x = item->childCount() - 1;
 
-		if ( x >= 0 )
-			emit dataChanged( createIndex( 0, ValueCol, item->child( 0 ) ), createIndex( x, ValueCol, item->child( x ) ) );
+		if ( x >= 0 ) {
+			if ( state != Processing )
+				emit dataChanged( createIndex( 0, ValueCol, item->child( 0 ) ), createIndex( x, ValueCol, item->child( x ) ) );
+			else
+				batchChanged( item );
+		}
 	}
 }
 
@@ -34,14 +34,18 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "message.h"
 #include "spellbook.h"
+#include "undocommands.h"
 #include "data/niftypes.h"
 #include "io/nifstream.h"
 
+#include <QBuffer>
 #include <QByteArray>
 #include <QColor>
 #include <QDebug>
 #include <QFile>
 #include <QSettings>
+#include <QThread>
+#include <QUndoStack>
 
 
 
@@ -49,6 +53,14 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 NifModel::NifModel( QObject * parent ) : BaseModel( parent )
 {
+	// Any change can affect the text of other rows (e.g. link targets), so drop everything
+	connect( this, &NifModel::dataChanged, this, &NifModel::clearDisplayCache );
+	connect( this, &NifModel::rowsInserted, this, &NifModel::clearDisplayCache );
+	connect( this, &NifModel::rowsRemoved, this, &NifModel::clearDisplayCache );
+	connect( this, &NifModel::rowsMoved, this, &NifModel::clearDisplayCache );
+	connect( this, &NifModel::layoutChanged, this, &NifModel::clearDisplayCache );
+	connect( this, &NifModel::modelReset, this, &NifModel::clearDisplayCache );
+
 	updateSettings();
 
 	clear();
@@ -65,6 +77,8 @@ void NifModel::updateSettings()
 	cfg.userVersion2 = settings.value( "User Version 2", "11" ).toInt();
 
 	settings.endGroup();
+
+	cfg.undoMemoryLimit = settings.value( "Settings/NIF/Undo Memory Limit", 256 ).toInt();
 }
 
 QString NifModel::version2string( quint32 v )
@@ -186,6 +200,7 @@ void NifModel::clear()
 	filename = QString();
 	folder = QString();
 	root->killChildren();
+	NifValue::purgeShared();
 
 	NifData headerData = NifData( "NiHeader", "Header" );
 	NifData footerData = NifData( "NiFooter", "Footer" );
@@ -277,6 +292,8 @@ void NifModel::updateFooter()
 	if ( !roots )
 		return;
 
+	itemAboutToChange( footer );
+
 	set<int>( footer, "Num Roots", rootLinks.count() );
 	updateArrayItem( roots );
 
@@ -343,6 +360,7 @@ void NifModel::updateHeader()
 	}
 
 	NifItem * header = getHeaderItem();
+	itemAboutToChange( header );
 
 	set<int>( header, "Num Blocks", getBlockCount() );
 	NifItem * idxBlockTypes = getItem( header, "Block Types" );
@@ -473,6 +491,8 @@ static QString parentPrefix( const QString & x )
 
 bool NifModel::updateByteArrayItem( NifItem * array )
 {
+	itemAboutToChange( array );
+
 	// New row count
 	int rows = getArraySize( array );
 	if ( rows == 0 )
@@ -533,6 +553,8 @@ bool NifModel::updateArrayItem( NifItem * array )
 	if ( !isArray( array ) )
 		return false;
 
+	itemAboutToChange( array );
+
 	// New row count
 	int rows = getArraySize( array );
 
@@ -1081,6 +1103,7 @@ void NifModel::insertType( const QModelIndex & parent, const NifData & data, int
 
 void NifModel::insertType( NifItem * parent, const NifData & data, int at )
 {
+	itemAboutToChange( parent );
 	setState( Inserting );
 
 	if ( data.isArray() ) {
@@ -1145,8 +1168,12 @@ void NifModel::insertType( NifItem * parent, const NifData & data, int at )
 
 bool NifModel::setItemValue( NifItem * item, const NifValue & val )
 {
+	itemAboutToChange( item );
 	item->value() = val;
-	emit dataChanged( createIndex( item->row(), ValueCol, item ), createIndex( item->row(), ValueCol, item ) );
+	if ( state != Processing )
+		emit dataChanged( createIndex( item->row(), ValueCol, item ), createIndex( item->row(), ValueCol, item ) );
+	else
+		batchChanged( item );
 
 	if ( itemIsLink( item ) ) {
 		NifItem * parent = item;
@@ -1168,7 +1195,39 @@ bool NifModel::setItemValue( NifItem * item, const NifValue & val )
  *  QAbstractModel interface
  */
 
+//! Upper bound of cached display entries, a few screens worth of rows
+static const int DISPLAY_CACHE_SIZE = 4096;
+
 QVariant NifModel::data( const QModelIndex & idx, int role ) const
+{
+	NifItem * item = static_cast<NifItem *>( idx.internalPointer() );
+
+	if ( !( idx.isValid() && item && idx.model() == this ) )
+		return QVariant();
+
+	// The value strings are the costly part of painting the tree, reuse them until something changes
+	bool cached = idx.column() == ValueCol && thread() == QThread::currentThread()
+	              && ( role == Qt::DisplayRole || role == NifSkopeDisplayRole || role == Qt::BackgroundColorRole );
+	if ( !cached )
+		return itemData( idx, role );
+
+	if ( role == NifSkopeDisplayRole )
+		role = Qt::DisplayRole;
+
+	auto key = qMakePair( item, role );
+	auto it = displayCache.constFind( key );
+	if ( it != displayCache.constEnd() )
+		return it.value();
+
+	if ( displayCache.count() >= DISPLAY_CACHE_SIZE )
+		displayCache.clear();
+
+	QVariant v = itemData( idx, role );
+	displayCache.insert( key, v );
+	return v;
+}
+
+QVariant NifModel::itemData( const QModelIndex & idx, int role ) const
 {
 	QModelIndex index = buddy( idx );
 	if ( index != idx )
@@ -1535,6 +1594,8 @@ bool NifModel::setData( const QModelIndex & index, const QVariant & value, int r
 	if ( index != idx )
 		return setData( idx, value, role );
 
+	itemAboutToChange( item );
+
 	switch ( index.column() ) {
 	case NifModel::NameCol:
 		item->setName( value.toString() );
@@ -1589,7 +1650,7 @@ bool NifModel::setData( const QModelIndex & index, const QVariant & value, int r
 	}
 
 	// reverse buddy lookup
-	if ( index.column() == ValueCol ) {
+	if ( index.column() == ValueCol && state != Processing ) {
 		if ( item->name() == "File Name" ) {
 			NifItem * parent = item->parent();
 
@@ -1612,6 +1673,9 @@ bool NifModel::setData( const QModelIndex & index, const QVariant & value, int r
 		invalidateDependentConditions( item );
 		// update original index
 		emit dataChanged( index, index );
+	} else if ( state == Processing ) {
+		invalidateDependentConditions( item );
+		batchChanged( item );
 	}
 
 	return true;
@@ -1633,12 +1697,14 @@ bool NifModel::removeRows( int row, int count, const QModelIndex & parent )
 		return false;
 
 	if ( row >= 0 && ( (row + count) <= item->childCount() ) ) {
+		itemAboutToChange( item );
+
 		bool link = false;
 
 		for ( int r = row; r < row + count; r++ )
 			link |= itemIsLink( item->child( r ) );
 
-		beginRemoveRows( parent, row, row + count );
+		beginRemoveRows( parent, row, row + count - 1 );
 		item->removeChildren( row, count );
 		endRemoveRows();
 
@@ -1718,6 +1784,9 @@ bool NifModel::setHeaderString( const QString & s )
 		return false;
 	}
 
+	// The version is read back from the header when it is restored
+	itemAboutToChange( getHeaderItem() );
+
 	int p = s.indexOf( "Version", 0, Qt::CaseInsensitive );
 
 	if ( p >= 0 ) {
@@ -2087,11 +2156,16 @@ bool NifModel::loadIndex( QIODevice & device, const QModelIndex & index )
 	NifItem * item = static_cast<NifItem *>( index.internalPointer() );
 
 	if ( item && index.isValid() && index.model() == this ) {
+		itemAboutToChange( item );
+
 		NifIStream stream( this, &device );
 		bool ok = loadItem( item, stream );
+		if ( state == Processing )
+			batchChanged( item );
 		updateLinks();
 		updateFooter();
-		emit linksChanged();
+		if ( !lockUpdates )
+			emit linksChanged();
 		return ok;
 	}
 
@@ -2104,6 +2178,8 @@ bool NifModel::loadAndMapLinks( QIODevice & device, const QModelIndex & index, c
 	NifItem * item = static_cast<NifItem *>( index.internalPointer() );
 
 	if ( item && index.isValid() && index.model() == this ) {
+		itemAboutToChange( item );
+
 		NifIStream stream( this, &device );
 		bool ok = loadItem( item, stream );
 		mapLinks( item, map );
@@ -2690,8 +2766,17 @@ bool NifModel::setLink( const QModelIndex & parent, const QString & name, qint32
 
 	NifItem * item = getItem( parentItem, name );
 
-	if ( item && item->value().setLink( l ) ) {
-		emit dataChanged( createIndex( item->row(), ValueCol, item ), createIndex( item->row(), ValueCol, item ) );
+	if ( !item )
+		return false;
+
+	itemAboutToChange( item );
+
+	if ( item->value().setLink( l ) ) {
+		if ( state != Processing )
+			emit dataChanged( createIndex( item->row(), ValueCol, item ), createIndex( item->row(), ValueCol, item ) );
+		else
+			batchChanged( item );
+
 		NifItem * parent = item;
 
 		while ( parent->parent() && parent->parent() != root )
@@ -2716,8 +2801,17 @@ bool NifModel::setLink( const QModelIndex & index, qint32 l )
 	if ( !( index.isValid() && item && index.model() == this ) )
 		return false;
 
-	if ( item && item->value().setLink( l ) ) {
-		emit dataChanged( createIndex( item->row(), ValueCol, item ), createIndex( item->row(), ValueCol, item ) );
+	if ( !item )
+		return false;
+
+	itemAboutToChange( item );
+
+	if ( item->value().setLink( l ) ) {
+		if ( state != Processing )
+			emit dataChanged( createIndex( item->row(), ValueCol, item ), createIndex( item->row(), ValueCol, item ) );
+		else
+			batchChanged( item );
+
 		NifItem * parent = item;
 
 		while ( parent->parent() && parent->parent() != root )
@@ -2740,6 +2834,8 @@ bool NifModel::setLinkArray( const QModelIndex & iArray, const QVector<qint32> &
 	NifItem * item = static_cast<NifItem *>( iArray.internalPointer() );
 
 	if ( isArray( iArray ) && item && iArray.model() == this ) {
+		itemAboutToChange( item );
+
 		bool ret = true;
 
 		for ( int c = 0; c < item->childCount() && c < links.count(); c++ ) {
@@ -2749,8 +2845,12 @@ bool NifModel::setLinkArray( const QModelIndex & iArray, const QVector<qint32> &
 		ret &= item->childCount() == links.count();
 		int x = item->childCount() - 1;
 
-		if ( x >= 0 )
-			emit dataChanged( createIndex( 0, ValueCol, item->child( 0 ) ), createIndex( x, ValueCol, item->child( x ) ) );
+		if ( x >= 0 ) {
+			if ( state != Processing )
+				emit dataChanged( createIndex( 0, ValueCol, item->child( 0 ) ), createIndex( x, ValueCol, item->child( x ) ) );
+			else
+				batchChanged( item );
+		}
 
 		NifItem * parent = item;
 
@@ -2863,6 +2963,8 @@ bool NifModel::assignString( const QModelIndex & index, const QString & string,
 
 bool NifModel::assignString( NifItem * item, const QString & string, bool replace )
 {
+	itemAboutToChange( item );
+
 	NifValue & v = item->value();
 
 	if ( getVersionNumber() >= 0x14010003 ) {
@@ -2964,6 +3066,10 @@ void NifModel::convertNiBlock( const QString & identifier, const QModelIndex & i
 	NifBlockPtr dstBlock = blocks.value( identifier );
 
 	if ( srcBlock && dstBlock && branch ) {
+		// The block type changes, it cannot be restored in place
+		if ( snapshotDepth > 0 )
+			snapshotBlocks.clear();
+
 		branch->setName( identifier );
 
 		if ( inherits( btype, identifier ) ) {
@@ -3025,6 +3131,83 @@ void NifModel::convertNiBlock( const QString & identifier, const QModelIndex & i
 	}
 }
 
+/*
+ *  undo snapshots
+ */
+
+void NifModel::beginSnapshot()
+{
+	if ( snapshotDepth++ > 0 )
+		return;
+
+	snapshots.clear();
+	snapshotBlocks = root->children();
+}
+
+BlockSnapshotCommand * NifModel::endSnapshot( const QString & text )
+{
+	if ( snapshotDepth == 0 || --snapshotDepth > 0 )
+		return nullptr;
+
+	BlockSnapshotCommand * cmd = nullptr;
+
+	// Blocks which were added, removed or moved cannot be restored in place
+	if ( root->children() == snapshotBlocks ) {
+		for ( int r = 0; r < root->childCount(); r++ ) {
+			NifItem * item = root->child( r );
+
+			auto it = snapshots.constFind( item );
+			if ( it == snapshots.constEnd() )
+				continue;
+
+			QBuffer buffer;
+			if ( !( buffer.open( QIODevice::WriteOnly ) && saveIndex( buffer, createIndex( r, 0, item ) ) ) )
+				continue;
+
+			if ( buffer.data() == it.value() )
+				continue;
+
+			if ( !cmd )
+				cmd = new BlockSnapshotCommand( text, this );
+
+			cmd->addBlock( createIndex( r, 0, item ), it.value(), buffer.data() );
+		}
+	} else if ( undoStack ) {
+		// The rows held by the earlier snapshots no longer match the blocks
+		undoStack->clear();
+	}
+
+	snapshots.clear();
+	snapshotBlocks.clear();
+
+	return cmd;
+}
+
+qint64 NifModel::undoMemoryLimit() const
+{
+	return qint64( cfg.undoMemoryLimit ) * 1024 * 1024;
+}
+
+void NifModel::itemAboutToChange( NifItem * item )
+{
+	displayCache.clear();
+
+	if ( snapshotDepth == 0 || !item )
+		return;
+
+	while ( item->parent() && item->parent() != root )
+		item = item->parent();
+
+	if ( item == root || snapshots.contains( item ) )
+		return;
+
+	QBuffer buffer;
+	if ( buffer.open( QIODevice::WriteOnly ) )
+		saveIndex( buffer, createIndex( item->row(), 0, item ) );
+
+	snapshots.insert( item, buffer.data() );
+}
+
 bool NifModel::holdUpdates( bool value )
 {
 	bool retval = lockUpdates;
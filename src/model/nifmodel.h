@@ -43,6 +43,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <memory>
 
 
+class BlockSnapshotCommand;
 class SpellBook;
 class QUndoStack;
 
@@ -165,6 +166,23 @@ public:
 	//! Set delayed updating of model links
 	bool holdUpdates( bool value );
 
+	//! Begin recording snapshots of the blocks modified until endSnapshot()
+	void beginSnapshot();
+
+	/*! Stop recording block snapshots
+	 *
+	 * If blocks were inserted, removed, moved or converted while recording, the earlier
+	 * commands no longer match the blocks and the undo stack is cleared instead.
+	 *
+	 * @param text	The undo text
+	 * @return		An undo command restoring the modified blocks, or nullptr if nothing changed
+	 *				or if the change could not be recorded
+	 */
+	BlockSnapshotCommand * endSnapshot( const QString & text );
+
+	//! Memory limit of the block snapshots held by the undo stack, in bytes
+	qint64 undoMemoryLimit() const;
+
 	//! Insert or append ( row == -1 ) a new NiBlock
 	QModelIndex insertNiBlock( const QString & identifier, int row = -1 );
 	//! Remove a block from the list
@@ -322,6 +340,8 @@ protected:
 
 	bool setHeaderString( const QString & ) override final;
 
+	void itemAboutToChange( NifItem * item ) override final;
+
 	template <typename T> T get( NifItem * parent, const QString & name ) const;
 	template <typename T> T get( NifItem * item ) const;
 	template <typename T> bool set( NifItem * parent, const QString & name, const T & d );
@@ -378,6 +398,21 @@ protected:
 
 	void updateModel( UpdateType value = utAll );
 
+	//! Nesting depth of beginSnapshot()/endSnapshot()
+	int snapshotDepth = 0;
+	//! Serialized top-level items from before their first modification
+	QHash<NifItem *, QByteArray> snapshots;
+	//! Top-level items when recording started
+	QVector<NifItem *> snapshotBlocks;
+
+	//! Build the data of an item for data(), bypassing the display cache
+	QVariant itemData( const QModelIndex & index, int role ) const;
+	//! Forget all cached display data
+	void clearDisplayCache() { displayCache.clear(); }
+
+	//! Value column display strings and colors, reused until the model changes
+	mutable QHash<QPair<NifItem *, int>, QVariant> displayCache;
+
 	//! Parse the XML file using a NifXmlHandler
 	static QString parseXmlDescription( const QString & filename );
 
@@ -394,6 +429,8 @@ private:
 		QString startupVersion;
 		int userVersion;
 		int userVersion2;
+		//! Undo snapshot memory limit in MB
+		int undoMemoryLimit;
 	} cfg;
 };
 
@@ -35,10 +35,12 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "data/nifvalue.h"
 #include "model/nifmodel.h"
 
+#include <QBuffer>
 #include <QCoreApplication>
+#include <QUndoStack>
 
 
-//! @file undocommands.cpp ChangeValueCommand, ToggleCheckBoxListCommand
+//! @file undocommands.cpp ChangeValueCommand, ToggleCheckBoxListCommand, ArrayUpdateCommand, BlockSnapshotCommand
 
 size_t ChangeValueCommand::lastID = 0;
 
@@ -90,7 +92,7 @@ void ChangeValueCommand::redo()
 	Q_ASSERT( idxs.size() == newValues.size() && newValues.size() == oldValues.size() );
 
 	if ( idxs.size() > 1 )
-		nif->setState( BaseModel::Processing );
+		nif->beginBatch();
 
 	int i = 0;
 	for ( auto idx : idxs ) {
@@ -98,10 +100,8 @@ void ChangeValueCommand::redo()
 			nif->setData( idx, newValues.at( i++ ), Qt::EditRole );
 	}
 
-	if ( idxs.size() > 1 ) {
-		nif->restoreState();
-		nif->dataChanged( idxs.first(), idxs.last() );
-	}
+	if ( idxs.size() > 1 )
+		nif->endBatch();
 
 	//qDebug() << nif->data( idx ).toString();
 }
@@ -111,7 +111,7 @@ void ChangeValueCommand::undo()
 	//qDebug() << "Undoing";
 
 	if ( idxs.size() > 1 )
-		nif->setState( BaseModel::Processing );
+		nif->beginBatch();
 
 	int i = 0;
 	for ( auto idx : idxs ) {
@@ -119,10 +119,8 @@ void ChangeValueCommand::undo()
 			nif->setData( idx, oldValues.at( i++ ), Qt::EditRole );
 	}
 
-	if ( idxs.size() > 1 ) {
-		nif->restoreState();
-		nif->dataChanged( idxs.first(), idxs.last() );
-	}
+	if ( idxs.size() > 1 )
+		nif->endBatch();
 
 	//qDebug() << nif->data( idx ).toString();
 }
@@ -195,9 +193,9 @@ ArrayUpdateCommand::ArrayUpdateCommand( const QModelIndex & index, NifModel * mo
 void ArrayUpdateCommand::redo()
 {
 	if ( idx.isValid() ) {
-		oldSize = nif->rowCount( idx );
+		oldSize = nif->childCount( idx );
 		nif->updateArray( idx );
-		newSize = nif->rowCount( idx );
+		newSize = nif->childCount( idx );
 	}
 }
 
@@ -208,3 +206,138 @@ void ArrayUpdateCommand::undo()
 		nif->updateArray( idx );
 	}
 }
+
+
+/*
+ *  BlockSnapshotCommand
+ */
+
+BlockSnapshotCommand::BlockSnapshotCommand( const QString & text, NifModel * model )
+	: QUndoCommand(), nif( model )
+{
+	setText( text );
+}
+
+void BlockSnapshotCommand::addBlock( const QModelIndex & iBlock, const QByteArray & before, const QByteArray & after )
+{
+	// XOR against the previous data so that unchanged bytes compress away
+	QByteArray delta = after;
+	int n = qMin( before.size(), after.size() );
+	const char * src = before.constData();
+	char * dst = delta.data();
+	for ( int i = 0; i < n; i++ )
+		dst[i] ^= src[i];
+
+	Snapshot s;
+	s.block = iBlock;
+	s.before = qCompress( before, 1 );
+	s.delta = qCompress( delta, 1 );
+	s.afterSize = after.size();
+
+	bytes += s.before.size() + s.delta.size();
+	blocks.append( s );
+}
+
+void BlockSnapshotCommand::restore( bool after )
+{
+	bool hold = nif->holdUpdates( true );
+	nif->beginBatch();
+
+	for ( const Snapshot & s : blocks ) {
+		if ( !s.block.isValid() )
+			continue;
+
+		QByteArray data = qUncompress( s.before );
+
+		if ( after ) {
+			QByteArray delta = qUncompress( s.delta );
+			if ( delta.size() != s.afterSize )
+				continue;
+
+			int n = qMin( data.size(), delta.size() );
+			const char * src = data.constData();
+			char * dst = delta.data();
+			for ( int i = 0; i < n; i++ )
+				dst[i] ^= src[i];
+
+			data = delta;
+		}
+
+		QBuffer buffer( &data );
+		if ( buffer.open( QIODevice::ReadOnly ) )
+			nif->loadIndex( buffer, s.block );
+	}
+
+	nif->endBatch();
+	nif->holdUpdates( hold );
+}
+
+void BlockSnapshotCommand::release()
+{
+	blocks.clear();
+	bytes = 0;
+}
+
+void BlockSnapshotCommand::redo()
+{
+	if ( firstRedo ) {
+		firstRedo = false;
+		return;
+	}
+
+	restore( true );
+}
+
+void BlockSnapshotCommand::undo()
+{
+	restore( false );
+}
+
+void BlockSnapshotCommand::push( BlockSnapshotCommand * cmd, qint64 limit )
+{
+	NifModel * model = cmd->nif;
+	if ( !model->undoStack ) {
+		delete cmd;
+		return;
+	}
+
+	QUndoStack * stack = model->undoStack;
+
+	// Find the newest command that no longer fits, the pushed command is always kept.
+	//	Commands above the index were undone and are deleted by the push.
+	qint64 total = cmd->cost();
+	int drop = -1;
+	for ( int i = stack->index() - 1; i >= 0; i-- ) {
+		auto c = dynamic_cast<const BlockSnapshotCommand *>( stack->command( i ) );
+		if ( c && c->nif == model )
+			total += c->cost();
+
+		if ( total > limit ) {
+			drop = i;
+			break;
+		}
+	}
+
+#if QT_VERSION >= QT_VERSION_CHECK( 5, 9, 0 )
+	stack->push( cmd );
+
+	// QUndoStack cannot remove its oldest commands directly, obsolete commands are
+	//	removed without being undone once the history reaches them
+	for ( int i = 0; i <= drop; i++ ) {
+		auto c = const_cast<QUndoCommand *>( stack->command( i ) );
+		if ( c->isObsolete() )
+			continue;
+
+		if ( auto s = dynamic_cast<BlockSnapshotCommand *>( c ) )
+			s->release();
+
+		c->setObsolete( true );
+	}
+#else
+	// Without obsolete commands only the whole history can be dropped
+	if ( drop >= 0 )
+		stack->clear();
+
+	stack->push( cmd );
+#endif
+}
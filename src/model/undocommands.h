@@ -34,11 +34,13 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define UNDOCOMMANDS_H
 
 #include <QUndoCommand>
+#include <QByteArray>
+#include <QList>
 #include <QModelIndex>
 #include <QVariant>
 
 
-//! @file undocommands.h ChangeValueCommand, ToggleCheckBoxListCommand
+//! @file undocommands.h ChangeValueCommand, ToggleCheckBoxListCommand, ArrayUpdateCommand, BlockSnapshotCommand
 
 class NifModel;
 class NifValue;
@@ -100,4 +102,64 @@ private:
 	QPersistentModelIndex idx;
 };
 
+
+/*! Undoes a batch of changes by restoring whole blocks
+ *
+ * Each block is kept as it was serialized by NifModel::saveIndex() before and after
+ * the change. The "before" data is compressed, the "after" data is stored as a
+ * compressed XOR delta against it, which is mostly zeros for in-place edits.
+ */
+class BlockSnapshotCommand : public QUndoCommand
+{
+public:
+	BlockSnapshotCommand( const QString & text, NifModel * model );
+
+	void redo() override;
+	void undo() override;
+
+	//! Add the serialized data of a block from before and after the change
+	void addBlock( const QModelIndex & iBlock, const QByteArray & before, const QByteArray & after );
+
+	//! Number of blocks held by the command
+	int count() const { return blocks.count(); }
+	//! Memory held by the snapshots in bytes
+	qint64 cost() const { return bytes; }
+
+	/*! Push onto the model's undo stack, keeping the memory held by the snapshots of the model
+	 * below the limit.
+	 *
+	 * Snapshots only apply on top of the state they were recorded from, so the history cannot
+	 * skip one. When the limit is exceeded the oldest commands are made obsolete, which drops
+	 * them from the stack instead of undoing them; the command pushed is always kept.
+	 *
+	 * @param cmd	The command to push; the undo stack takes ownership
+	 * @param limit	The memory limit in bytes
+	 */
+	static void push( BlockSnapshotCommand * cmd, qint64 limit );
+
+private:
+	struct Snapshot
+	{
+		QPersistentModelIndex block;
+		//! Compressed block data before the change
+		QByteArray before;
+		//! Compressed XOR of the block data after the change against the data before
+		QByteArray delta;
+		//! Uncompressed size of the block data after the change
+		int afterSize;
+	};
+
+	//! Load the block data before or after the change back into the model
+	void restore( bool after );
+	//! Free the snapshots of a command that can no longer be undone
+	void release();
+
+	NifModel * nif;
+	QList<Snapshot> blocks;
+	qint64 bytes = 0;
+
+	//! QUndoStack::push() calls redo() but the changes are already applied
+	bool firstRedo = true;
+};
+
 #endif // UNDOCOMMANDS_H
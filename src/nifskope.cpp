@@ -36,6 +36,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "glview.h"
 #include "message.h"
 #include "spellbook.h"
+#include "startuptrace.h"
 #include "version.h"
 #include "gl/glscene.h"
 #include "model/kfmmodel.h"
@@ -68,7 +69,6 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <QListView>
 #include <QTreeView>
-#include <QStandardItemModel>
 
 #include <fsengine/bsa.h>
 #include <fsengine/fsmanager.h>
@@ -145,8 +145,10 @@ NifSkope::NifSkope()
 	
 	// Init Dialogs
 	
-	if ( !options )
+	if ( !options ) {
+		StartupTrace::Phase phase( "Settings dialog" );
 		options = new SettingsDialog;
+	}
 
 	// Migrate settings from older versions of NifSkope
 	migrateSettings();
@@ -232,10 +234,15 @@ NifSkope::NifSkope()
 	connect( bsaView, &QTreeView::doubleClicked, this, &NifSkope::openArchiveFile );
 
 	bsaModel = new BSAModel( this );
-	bsaProxyModel = new BSAProxyModel( this );
+	bsaView->setModel( bsaModel );
+
+	// Filter once typing pauses
+	auto filterTimer = new QTimer( this );
+	filterTimer->setSingleShot( true );
 
-	// Empty Model for swapping out before model fill
-	emptyModel = new QStandardItemModel( this );
+	connect( ui->bsaFilter, &QLineEdit::textChanged, [filterTimer]() { filterTimer->start( 300 ); } );
+	connect( filterTimer, &QTimer::timeout, this, &NifSkope::filterArchive );
+	connect( ui->bsaFilenameOnly, &QCheckBox::toggled, this, &NifSkope::filterArchive );
 
 	// Connect models with views
 	/* ********************** */
@@ -251,7 +258,10 @@ NifSkope::NifSkope()
 	// Create GLView
 	/* ********************** */
 
-	ogl = GLView::create( this );
+	{
+		StartupTrace::Phase phase( "Create GL view" );
+		ogl = GLView::create( this );
+	}
 	ogl->setObjectName( "OGL1" );
 	ogl->setNif( nif );
 	ogl->installEventFilter( this );
@@ -306,6 +316,8 @@ NifSkope::NifSkope()
 	resizeTimer->setSingleShot( true );
 	connect( resizeTimer, &QTimer::timeout, this, &NifSkope::resizeDone );
 
+	StartupTrace::Phase phase( "Actions, docks and menus" );
+
 	// Set Actions
 	initActions();
 
@@ -769,10 +781,6 @@ void NifSkope::openArchive( const QString & archive )
 {
 	// Clear memory from previously opened archives
 	bsaModel->clear();
-	bsaProxyModel->clear();
-	bsaProxyModel->setSourceModel( emptyModel );
-	bsaView->setModel( emptyModel );
-	bsaView->setSortingEnabled( false );
 
 	archiveHandler.reset();
 
@@ -787,32 +795,22 @@ void NifSkope::openArchive( const QString & archive )
 
 		setCurrentArchive( bsa );
 
-		// Models
-		bsaModel->init();
-
 		// Populate model from BSA
-		bsa->fillModel( bsaModel, "meshes" );
+		bsaModel->setArchive( bsa, "meshes", { ".nif", ".bto", ".btr" } );
 
-		if ( bsaModel->rowCount() == 0 ) {
+		if ( bsaModel->fileCount() == 0 ) {
 			qCWarning( nsIo ) << "The BSA does not contain any meshes.";
 			clearCurrentArchive();
 			return;
 		}
 
-		// Set proxy and view only after filling source model
-		bsaProxyModel->setSourceModel( bsaModel );
-		bsaView->setModel( bsaProxyModel );
 		bsaView->setSortingEnabled( true );
+		bsaView->sortByColumn( 0, Qt::AscendingOrder );
 
 		bsaView->hideColumn( 1 );
 		bsaView->setColumnWidth( 0, 300 );
 		bsaView->setColumnWidth( 2, 50 );
 
-		// Sort proxy after model/view is populated
-		bsaProxyModel->sort( 0, Qt::AscendingOrder );
-		bsaProxyModel->setFiletypes( { ".nif", ".bto", ".btr" } );
-		bsaProxyModel->resetFilter();
-
 		// Set filename label
 		ui->bsaName->setText( currentArchive->name() );
 
@@ -822,29 +820,20 @@ void NifSkope::openArchive( const QString & archive )
 		// Bring tab to front
 		dBrowser->raise();
 
-		// Filter
-		auto filterTimer = new QTimer( this );
-		filterTimer->setSingleShot( true );
-
-		connect( ui->bsaFilter, &QLineEdit::textChanged, [filterTimer]() { filterTimer->start( 300 ); } );
-		connect( filterTimer, &QTimer::timeout, [this]() {
-			auto text = ui->bsaFilter->text();
-
-			bsaProxyModel->setFilterRegExp( QRegExp( text, Qt::CaseInsensitive, QRegExp::Wildcard ) );
-			bsaView->expandAll();
+		// Keep the filter when switching open archives
+		filterArchive();
+	}
+}
 
-			if ( text.isEmpty() ) {
-				bsaView->collapseAll();
-				bsaProxyModel->resetFilter();
-			}
-				
-		} );
+void NifSkope::filterArchive()
+{
+	QString text = ui->bsaFilter->text();
 
-		connect( ui->bsaFilenameOnly, &QCheckBox::toggled, bsaProxyModel, &BSAProxyModel::setFilterByNameOnly );
+	bsaModel->setFilter( text, ui->bsaFilenameOnly->isChecked() );
 
-		// Update filter when switching open archives
-		filterTimer->start( 0 );
-	}
+	// Expanding every folder of a broad match would stall the view
+	if ( !text.isEmpty() && bsaModel->matchCount() <= 2000 )
+		bsaView->expandAll();
 }
 
 void NifSkope::openArchiveFile( const QModelIndex & index )
@@ -71,8 +71,6 @@ class SpellBook;
 class FSArchiveHandler;
 class BSA;
 class BSAModel;
-class BSAProxyModel;
-class QStandardItemModel;
 class QAction;
 class QActionGroup;
 class QComboBox;
@@ -81,7 +79,8 @@ class QProgressBar;
 class QStringList;
 class QTimer;
 class QTreeView;
-class QUdpSocket;
+class QLocalServer;
+class QLocalSocket;
 
 namespace nstheme
 {
@@ -170,6 +169,8 @@ public slots:
 	void openArchive( const QString & );
 	void openArchiveFile( const QModelIndex & );
 	void openArchiveFileString( BSA *, const QString & );
+	//! Applies the archive browser filter
+	void filterArchive();
 
 	void enableUi();
 
@@ -427,8 +428,6 @@ private:
 	//QAction * idxBackAction;
 
 	BSAModel * bsaModel;
-	BSAProxyModel * bsaProxyModel;
-	QStandardItemModel * emptyModel;
 
 	QMenu * mRecentArchiveFiles;
 };
@@ -447,17 +446,20 @@ private:
 };
 
 
-//! UDP communication between instances
+//! Local socket communication between instances
 class IPCsocket final : public QObject
 {
 	Q_OBJECT
 
 public:
-	//! Creates a socket
+	//! Creates the server other instances send their files to
 	static IPCsocket * create( int port );
 
-	//! Sends a command
-	static void sendCommand( const QString & cmd, int port );
+	//! Sends a batch of files to the running instance, returns false if it did not acknowledge them
+	static bool sendFiles( const QStringList & files, int port );
+
+	//! Queues files to be opened, one window per event loop pass
+	void queueFiles( const QStringList & files );
 
 public slots:
 	//! Acts on a command
@@ -469,13 +471,23 @@ public slots:
 	void openNif( const QString & );
 
 protected slots:
-	void processDatagram();
+	void acceptConnection();
+	void openQueued();
 
 protected:
-	IPCsocket( QUdpSocket * );
+	IPCsocket( QLocalServer * );
 	~IPCsocket();
 
-	QUdpSocket * socket;
+	//! Name of the local server for the given port
+	static QString serverName( int port );
+
+	//! Reads a batch of files from a connection once it has fully arrived, and acknowledges it
+	void readBatch( QLocalSocket * socket );
+
+	QLocalServer * server;
+
+	//! Files waiting to be opened
+	QStringList queue;
 };
 
 #endif
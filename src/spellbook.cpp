@@ -32,11 +32,13 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "spellbook.h"
 
+#include "model/undocommands.h"
 #include "ui/checkablemessagebox.h"
 
 #include <QCache>
 #include <QDir>
 #include <QSettings>
+#include <QTimer>
 
 
 
@@ -82,14 +84,13 @@ SpellBook::SpellBook( NifModel * nif, const QModelIndex & index, QObject * recei
 	// attach this book to the specified nif
 	sltNif( nif );
 
-	// fill in the known spells
-	for ( SpellPtr spell : spells() ) {
-		newSpellRegistered( spell );
-	}
-
 	// set the current index
 	sltIndex( index );
 
+	// fill in the known spells once the event loop runs, so that their hotkeys work,
+	//	and check them only when the menu is shown
+	QTimer::singleShot( 0, this, &SpellBook::populate );
+	connect( this, &SpellBook::aboutToShow, this, &SpellBook::sltAboutToShow );
 	connect( this, &SpellBook::triggered, this, &SpellBook::sltSpellTriggered );
 
 	if ( receiver && member )
@@ -111,27 +112,33 @@ void SpellBook::cast( NifModel * nif, const QModelIndex & index, SpellPtr spell
 	QDialogButtonBox::StandardButton response = QDialogButtonBox::Yes;
 
 	if ( !suppressConfirm && spell->page() != "Array" ) {
-		response = CheckableMessageBox::question( this, "Confirmation", "This action cannot currently be undone. Do you want to continue?", "Do not ask me again", &accepted );
+		response = CheckableMessageBox::question( this, "Confirmation", "This action may not be undoable. Do you want to continue?", "Do not ask me again", &accepted );
 
 		if ( accepted )
 			cfg.setValue( "Settings/Suppress Undoable Confirmation", true );
 	}
 	
 	if ( (response == QDialogButtonBox::Yes) && spell && spell->isApplicable( nif, index ) ) {
+		// Record the blocks modified by the spell for undo
+		bool snapshot = spell->page() != "Array";
+		if ( snapshot )
+			nif->beginSnapshot();
+
 		bool noSignals = spell->batch();
 		if ( noSignals )
-			nif->setState( BaseModel::Processing );
+			nif->beginBatch();
 		// Cast the spell and return index
 		auto idx = spell->cast( nif, index );
 		if ( noSignals )
-			nif->resetState();
+			nif->endBatch();
 
 		// Refresh the header
 		nif->invalidateConditions( nif->getHeader(), true );
 		nif->updateHeader();
 
-		if ( noSignals && nif->getProcessingResult() ) {
-			emit nif->dataChanged( idx, idx );
+		if ( snapshot ) {
+			if ( auto cmd = nif->endSnapshot( spell->name() ) )
+				BlockSnapshotCommand::push( cmd, nif->undoMemoryLimit() );
 		}
 
 		emit sigIndex( idx );
@@ -147,13 +154,14 @@ void SpellBook::sltSpellTriggered( QAction * action )
 void SpellBook::sltNif( NifModel * nif )
 {
 	if ( Nif )
-		disconnect( Nif, &NifModel::modelReset, this, static_cast<void (SpellBook::*)()>(&SpellBook::checkActions) );
+		disconnect( Nif, &NifModel::modelReset, this, &SpellBook::sltStale );
 
 	Nif = nif;
 	Index = QModelIndex();
+	Stale = true;
 
 	if ( Nif )
-		connect( Nif, &NifModel::modelReset, this, static_cast<void (SpellBook::*)()>(&SpellBook::checkActions) );
+		connect( Nif, &NifModel::modelReset, this, &SpellBook::sltStale );
 }
 
 void SpellBook::sltIndex( const QModelIndex & index )
@@ -163,38 +171,88 @@ void SpellBook::sltIndex( const QModelIndex & index )
 	else
 		Index = QModelIndex();
 
+	// Checking every spell is deferred until the menu is shown,
+	//	selection changes are far more frequent than menu use
+	Stale = true;
+	checkHotkeys();
+}
+
+void SpellBook::sltStale()
+{
+	Stale = true;
+	checkHotkeys();
+}
+
+void SpellBook::sltAboutToShow()
+{
+	populate();
+
+	if ( Stale )
+		checkActions();
+
+	// The book itself must stay enabled to be shown again once spells apply
+	setEnabled( true );
+}
+
+void SpellBook::populate()
+{
+	if ( Populated )
+		return;
+
+	Populated = true;
+
+	for ( SpellPtr spell : spells() ) {
+		newSpellRegistered( spell );
+	}
+
 	checkActions();
 }
 
 void SpellBook::checkActions()
 {
-	checkActions( this, QString() );
+	populate();
+	checkActions( this );
+	Stale = false;
 }
 
-void SpellBook::checkActions( QMenu * menu, const QString & page )
+void SpellBook::checkActions( QMenu * menu )
 {
 	bool menuEnable = false;
 	for ( QAction * action : menu->actions() ) {
 		if ( action->menu() ) {
-			checkActions( action->menu(), action->menu()->title() );
+			checkActions( action->menu() );
 			menuEnable |= action->menu()->isEnabled();
 			action->setVisible( action->menu()->isEnabled() );
-		} else {
-			for ( SpellPtr spell : spells() ) {
-				if ( action->text() == spell->name() && page == spell->page() ) {
-					bool actionEnable = Nif && spell->isApplicable( Nif, Index );
-					action->setVisible( actionEnable );
-					action->setEnabled( actionEnable );
-					menuEnable |= actionEnable;
-				}
-			}
+		} else if ( SpellPtr spell = Map.value( action ) ) {
+			bool actionEnable = Nif && spell->isApplicable( Nif, Index );
+			action->setVisible( actionEnable );
+			action->setEnabled( actionEnable );
+			menuEnable |= actionEnable;
 		}
 	}
 	menu->setEnabled( menuEnable );
 }
 
+void SpellBook::checkHotkeys()
+{
+	if ( !Populated )
+		return;
+
+	for ( auto it = Map.constBegin(); it != Map.constEnd(); ++it ) {
+		if ( it.key()->shortcut().isEmpty() )
+			continue;
+
+		bool actionEnable = Nif && it.value()->isApplicable( Nif, Index );
+		it.key()->setVisible( actionEnable );
+		it.key()->setEnabled( actionEnable );
+	}
+}
+
 void SpellBook::newSpellRegistered( SpellPtr spell )
 {
+	if ( !Populated )
+		return;
+
 	if ( spell->page().isEmpty() ) {
 		Map.insert( addAction( spell->icon(), spell->name() ), spell );
 	} else {
@@ -295,6 +353,9 @@ QModelIndex SpellBook::sanitize( NifModel * nif )
 
 QAction * SpellBook::exec( const QPoint & pos, QAction * act )
 {
+	if ( Stale )
+		checkActions();
+
 	if ( isEnabled() )
 		return QMenu::exec( pos, act );
 
@@ -149,14 +149,25 @@ signals:
 
 protected slots:
 	void sltSpellTriggered( QAction * action );
+	//! Marks the actions as needing to be checked before the menu is shown
+	void sltStale();
+	void sltAboutToShow();
 
 protected:
 	NifModel * Nif;
 	QPersistentModelIndex Index;
 	QMap<QAction *, SpellPtr> Map;
+	//! The spells have been added as actions
+	bool Populated = false;
+	//! The actions have not been checked against the current index
+	bool Stale = true;
 
+	//! Add the actions of all spells, done when the book is first needed
+	void populate();
 	void newSpellRegistered( SpellPtr spell );
-	void checkActions( QMenu * menu, const QString & page );
+	void checkActions( QMenu * menu );
+	//! Check only the actions with a hotkey, their shortcuts work without showing the menu
+	void checkHotkeys();
 
 private:
 	static QList<SpellPtr> & spells();
@@ -86,7 +86,7 @@ public:
 
 					QModelIndex iCtrlBlcks = kf.getIndex( iSeq, "Controlled Blocks" );
 
-					for ( int r = 0; r < kf.rowCount( iCtrlBlcks ); r++ ) {
+					for ( int r = 0; r < kf.childCount( iCtrlBlcks ); r++ ) {
 						QString nodeName = kf.string( iCtrlBlcks.child( r, 0 ), "Node Name", false );
 
 						if ( nodeName.isEmpty() )
@@ -146,7 +146,7 @@ public:
 
 					QModelIndex iCtrlBlcks = nif->getIndex( iSeq, "Controlled Blocks" );
 
-					for ( int r = 0; r < nif->rowCount( iCtrlBlcks ); r++ ) {
+					for ( int r = 0; r < nif->childCount( iCtrlBlcks ); r++ ) {
 						QModelIndex iCtrlBlck = iCtrlBlcks.child( r, 0 );
 
 						if ( nif->getLink( iCtrlBlck, "Controller" ) == -1 )
@@ -273,12 +273,12 @@ public:
 			QString name = nif->get<QString>( idx, "Name" );
 			int r;
 
-			for ( r = 0; r < nif->rowCount( iArray ); r++ ) {
+			for ( r = 0; r < nif->childCount( iArray ); r++ ) {
 				if ( nif->get<QString>( iArray.child( r, 0 ), "Name" ) == name )
 					break;
 			}
 
-			if ( r == nif->rowCount( iArray ) )
+			if ( r == nif->childCount( iArray ) )
 				blocksToAdd << idx;
 		}
 
@@ -333,7 +333,7 @@ public:
 	        nif->updateArray( iRot, "Keys" );
 	    }
 
-	    for ( int q = 0; q < nif->rowCount( iQuats ); q++ )
+	    for ( int q = 0; q < nif->childCount( iQuats ); q++ )
 	    {
 	        QModelIndex iQuat = iQuats.child( q, 0 );
 
@@ -386,7 +386,7 @@ public:
 		int invalid = 0;
 
 		auto objs = nif->getIndex( index, "Objs" );
-		auto numObjs = nif->rowCount( objs );
+		auto numObjs = nif->childCount( objs );
 		for ( int i = 0; i < numObjs; i++ ) {
 			auto c = objs.child( i, 0 );
 			auto iAV = nif->getIndex( c, "AV Object" );
@@ -197,10 +197,10 @@ QStringList getStringsArray( NifModel * nif, const QModelIndex & parent,
 		return {};
 
 	if ( name.isEmpty() ) {
-		for ( int i = 0; i < nif->rowCount( iArr ); i++ )
+		for ( int i = 0; i < nif->childCount( iArr ); i++ )
 			strings << nif->string( iArr.child( i, 0 ) );
 	} else {
-		for ( int i = 0; i < nif->rowCount( iArr ); i++ )
+		for ( int i = 0; i < nif->childCount( iArr ); i++ )
 			strings << nif->string( iArr.child( i, 0 ), name, false );
 	}
 
@@ -215,10 +215,10 @@ void setStringsArray( NifModel * nif, const QModelIndex & parent, QStringList &
 		return;
 
 	if ( name.isEmpty() ) {
-		for ( int i = 0; i < nif->rowCount( iArr ); i++ )
+		for ( int i = 0; i < nif->childCount( iArr ); i++ )
 			nif->set<QString>( iArr.child( i, 0 ), strings.takeFirst() );
 	} else {
-		for ( int i = 0; i < nif->rowCount( iArr ); i++ )
+		for ( int i = 0; i < nif->childCount( iArr ); i++ )
 			nif->set<QString>( iArr.child( i, 0 ), name, strings.takeFirst() );
 	}
 }
@@ -226,7 +226,7 @@ void setStringsArray( NifModel * nif, const QModelIndex & parent, QStringList &
 QStringList getNiObjectRootStrings( NifModel * nif, const QModelIndex & iBlock )
 {
 	QStringList strings;
-	for ( int i = 0; i < nif->rowCount( iBlock ); i++ ) {
+	for ( int i = 0; i < nif->childCount( iBlock ); i++ ) {
 		auto iString = iBlock.child( i, 0 );
 		if ( rootStringList.contains( nif->itemName( iString ) ) )
 			strings << nif->string( iString );
@@ -237,7 +237,7 @@ QStringList getNiObjectRootStrings( NifModel * nif, const QModelIndex & iBlock )
 //! Set "Name" et al. for NiObjectNET, NiExtraData, NiPSysModifier, etc.
 void setNiObjectRootStrings( NifModel * nif, const QModelIndex & iBlock, QStringList & strings )
 {
-	for ( int i = 0; i < nif->rowCount( iBlock ); i++ ) {
+	for ( int i = 0; i < nif->childCount( iBlock ); i++ ) {
 		auto iString = iBlock.child( i, 0 );
 		if ( rootStringList.contains( nif->itemName( iString ) ) )
 			nif->set<QString>( iString, strings.takeFirst() );
@@ -252,7 +252,7 @@ QStringList getStringsNiMesh( NifModel * nif, const QModelIndex & iBlock )
 	if ( !iData.isValid() )
 		return {};
 
-	for ( int i = 0; i < nif->rowCount( iData ); i++ )
+	for ( int i = 0; i < nif->childCount( iData ); i++ )
 		strings << getStringsArray( nif, iData.child( i, 0 ), "Component Semantics", "Name" );
 
 	return strings;
@@ -264,7 +264,7 @@ void setStringsNiMesh( NifModel * nif, const QModelIndex & iBlock, QStringList &
 	if ( !iData.isValid() )
 		return;
 
-	for ( int i = 0; i < nif->rowCount( iData ); i++ )
+	for ( int i = 0; i < nif->childCount( iData ); i++ )
 		setStringsArray( nif, iData.child( i, 0 ), strings, "Component Semantics", "Name" );
 }
 //! Get strings for NiSequence
@@ -275,7 +275,7 @@ QStringList getStringsNiSequence( NifModel * nif, const QModelIndex & iBlock )
 	if ( !iControlledBlocks.isValid() )
 		return {};
 
-	for ( int i = 0; i < nif->rowCount( iControlledBlocks ); i++ ) {
+	for ( int i = 0; i < nif->childCount( iControlledBlocks ); i++ ) {
 		auto iChild = iControlledBlocks.child( i, 0 );
 		strings << nif->string( iChild, "Target Name", false )
 				<< nif->string( iChild, "Node Name", false )
@@ -294,7 +294,7 @@ void setStringsNiSequence( NifModel * nif, const QModelIndex & iBlock, QStringLi
 	if ( !iControlledBlocks.isValid() )
 		return;
 
-	for ( int i = 0; i < nif->rowCount( iControlledBlocks ); i++ ) {
+	for ( int i = 0; i < nif->childCount( iControlledBlocks ); i++ ) {
 		auto iChild = iControlledBlocks.child( i, 0 );
 		nif->set<QString>( iChild, "Target Name", strings.takeFirst() );
 		nif->set<QString>( iChild, "Node Name", strings.takeFirst() );
@@ -2017,7 +2017,7 @@ public:
 			if ( iNumChildren.isValid() && iChildren.isValid() ) {
 				QList<QPair<QString, qint32> > links;
 
-				for ( int r = 0; r < nif->rowCount( iChildren ); r++ ) {
+				for ( int r = 0; r < nif->childCount( iChildren ); r++ ) {
 					qint32 l = nif->getLink( iChildren.child( r, 0 ) );
 
 					if ( l >= 0 )
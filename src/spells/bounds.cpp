@@ -1,11 +1,12 @@
 #include "spellbook.h"
 
+#include "lib/boundingvolume.h"
 #include "ui/widgets/nifeditors.h"
 
 
 // Brief description is deliberately not autolinked to class Spell
 /*! \file bounds.cpp
- * \brief Bounding box editing spells (spEditBounds)
+ * \brief Bounding box editing spells (spEditBounds, spUpdateMultiBound)
  *
  * All classes here inherit from the Spell class.
  */
@@ -63,3 +64,94 @@ public:
 };
 
 REGISTER_SPELL( spEditBounds )
+
+//! Collect the vertices of the geometry below a node, in the space of that node
+static void collectVertices( const NifModel * nif, const QModelIndex & iNode, const Transform & trans, QVector<Vector3> & verts )
+{
+	QModelIndex iChildren = nif->getIndex( iNode, "Children" );
+
+	for ( int c = 0; c < nif->childCount( iChildren ); c++ ) {
+		QModelIndex iChild = nif->getBlock( nif->getLink( iChildren.child( c, 0 ) ) );
+		if ( !iChild.isValid() )
+			continue;
+
+		Transform t = trans * Transform( nif, iChild );
+
+		if ( nif->inherits( iChild, "NiNode" ) ) {
+			collectVertices( nif, iChild, t, verts );
+		} else if ( nif->inherits( iChild, "BSTriShape" ) ) {
+			QModelIndex iVertData = nif->getIndex( iChild, "Vertex Data" );
+			for ( int v = 0; v < nif->childCount( iVertData ); v++ )
+				verts << t * nif->get<Vector3>( iVertData.child( v, 0 ), "Vertex" );
+		} else if ( nif->inherits( iChild, "NiTriBasedGeom" ) ) {
+			QModelIndex iData = nif->getBlock( nif->getLink( iChild, "Data" ) );
+			for ( const Vector3 & v : nif->getArray<Vector3>( iData, "Vertices" ) )
+				verts << t * v;
+		}
+	}
+}
+
+//! Fit a BSMultiBound box to the geometry below its node
+class spUpdateMultiBound final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Update Multi Bound" ); }
+	QString page() const override final { return Spell::tr( "Bounds" ); }
+
+	//! The node owning a BSMultiBoundAABB or BSMultiBoundOBB
+	static QModelIndex getNode( const NifModel * nif, const QModelIndex & iData )
+	{
+		QModelIndex iMultiBound = nif->getBlock( nif->getParent( iData ), "BSMultiBound" );
+		return nif->getBlock( nif->getParent( iMultiBound ), "NiNode" );
+	}
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		QModelIndex iData = nif->getBlock( index );
+
+		if ( !nif->isNiBlock( iData, { "BSMultiBoundAABB", "BSMultiBoundOBB" } ) )
+			return false;
+
+		return getNode( nif, iData ).isValid();
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		QModelIndex iData = nif->getBlock( index );
+
+		QVector<Vector3> verts;
+		collectVertices( nif, getNode( nif, iData ), Transform(), verts );
+
+		if ( verts.isEmpty() )
+			return index;
+
+		if ( nif->isNiBlock( iData, "BSMultiBoundAABB" ) ) {
+			Vector3 mn = verts.first();
+			Vector3 mx = verts.first();
+			for ( const Vector3 & v : verts ) {
+				mn.boundMin( v );
+				mx.boundMax( v );
+			}
+
+			nif->set<Vector3>( iData, "Position", ( mn + mx ) / 2 );
+			nif->set<Vector3>( iData, "Extent", ( mx - mn ) / 2 );
+		} else {
+			OrientedBox box = boundingBox( verts );
+
+			// The box is drawn as rotation * corner + center, so its axes are the columns
+			Matrix rotation;
+			for ( int r = 0; r < 3; r++ ) {
+				for ( int c = 0; c < 3; c++ )
+					rotation( r, c ) = box.axes( c, r );
+			}
+
+			nif->set<Vector3>( iData, "Center", box.center );
+			nif->set<Vector3>( iData, "Size", box.extents );
+			nif->set<Matrix>( iData, "Rotation", rotation );
+		}
+
+		return index;
+	}
+};
+
+REGISTER_SPELL( spUpdateMultiBound )
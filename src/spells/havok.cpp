@@ -2,16 +2,20 @@
 
 #include "spells/blocks.h"
 
-#include "lib/nvtristripwrapper.h"
-#include "lib/qhull.h"
+#include "lib/convexdecomp.h"
+#include "lib/stripify.h"
 
 #include <QDialog>
 #include <QDoubleSpinBox>
+#include <QElapsedTimer>
 #include <QLabel>
 #include <QLayout>
 #include <QMap>
 #include <QMessageBox>
 #include <QPushButton>
+#include <QSettings>
+#include <QSpinBox>
+#include <QtConcurrent/QtConcurrentMap>
 
 #include <algorithm> // std::sort
 
@@ -26,6 +30,28 @@
 //! For Havok coordinate transforms
 static const float havokConst = 7.0;
 
+//! Mesh of a shape, for computing its collision hulls off the main thread
+struct ConvexJob
+{
+	QPersistentModelIndex iShape;
+	QPersistentModelIndex iParent;
+
+	QVector<Vector3> verts;
+	QVector<Triangle> triangles;
+
+	QVector<ConvexHull> hulls;
+};
+
+//! Options of spCreateCVS
+struct ConvexOptions
+{
+	float roundError = 0.25f;
+	float radius = 0.05f;
+	int maxVerts = 0;
+	int maxHulls = 1;
+	float concavity = 0.05f;
+};
+
 //! Creates a convex hull using Qhull
 class spCreateCVS final : public Spell
 {
@@ -44,30 +70,17 @@ public:
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
 	{
-		QModelIndex iData = nif->getBlock( nif->getLink( index, "Data" ) );
-
-		if ( !iData.isValid() )
-			return index;
-
-		float havokScale = (nif->checkVersion( 0x14020007, 0x14020007 ) && nif->getUserVersion() >= 12) ? 10.0f : 1.0f;
-
-		havokScale *= havokConst;
-
-		/* those will be filled with the CVS data */
-		QVector<Vector4> convex_verts, convex_norms;
+		createShapes( nif, { index } );
 
-		/* get the verts of our mesh */
-		QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
-		QVector<Vector3> vertsTrans;
-
-		// Offset by translation of NiTriShape
-		Vector3 trans = nif->get<Vector3>( index, "Translation" );
-		for ( auto v : verts ) {
-			vertsTrans.append( v + trans );
-		}
+		// returning iCVS here can crash NifSkope if a child array is selected
+		return index;
+	}
 
-		// to store results
-		QVector<Vector4> hullVerts, hullNorms;
+	//! Ask for the hull options, returns false if cancelled
+	static bool getOptions( ConvexOptions & options )
+	{
+		QSettings settings;
+		QString key = QString( "%1/%2/%3/" ).arg( "Spells", Spell::tr( "Havok" ), Spell::tr( "Create Convex Shape" ) );
 
 		// ask for precision
 		QDialog dlg;
@@ -81,7 +94,7 @@ public:
 		precSpin->setRange( 0, 5 );
 		precSpin->setDecimals( 3 );
 		precSpin->setSingleStep( 0.01 );
-		precSpin->setValue( 0.25 );
+		precSpin->setValue( settings.value( key + "Roundoff Error", 0.25 ).toDouble() );
 		vbox->addWidget( precSpin );
 
 		vbox->addWidget( new QLabel( Spell::tr( "Collision Radius" ) ) );
@@ -90,9 +103,32 @@ public:
 		spnRadius->setRange( 0, 0.5 );
 		spnRadius->setDecimals( 4 );
 		spnRadius->setSingleStep( 0.001 );
-		spnRadius->setValue( 0.05 );
+		spnRadius->setValue( settings.value( key + "Collision Radius", 0.05 ).toDouble() );
 		vbox->addWidget( spnRadius );
 
+		vbox->addWidget( new QLabel( Spell::tr( "Maximum vertices per hull (0 for no limit)" ) ) );
+
+		QSpinBox * spnVerts = new QSpinBox;
+		spnVerts->setRange( 0, 1000 );
+		spnVerts->setValue( settings.value( key + "Max Vertices", 0 ).toInt() );
+		vbox->addWidget( spnVerts );
+
+		vbox->addWidget( new QLabel( Spell::tr( "Maximum hulls per shape (more than 1 splits concave meshes)" ) ) );
+
+		QSpinBox * spnHulls = new QSpinBox;
+		spnHulls->setRange( 1, 64 );
+		spnHulls->setValue( settings.value( key + "Max Hulls", 1 ).toInt() );
+		vbox->addWidget( spnHulls );
+
+		vbox->addWidget( new QLabel( Spell::tr( "Allowed concavity, relative to the shape size" ) ) );
+
+		QDoubleSpinBox * spnConcavity = new QDoubleSpinBox;
+		spnConcavity->setRange( 0, 1 );
+		spnConcavity->setDecimals( 3 );
+		spnConcavity->setSingleStep( 0.01 );
+		spnConcavity->setValue( settings.value( key + "Concavity", 0.05 ).toDouble() );
+		vbox->addWidget( spnConcavity );
+
 		QHBoxLayout * hbox = new QHBoxLayout;
 		vbox->addLayout( hbox );
 
@@ -107,46 +143,88 @@ public:
 		QObject::connect( ok, &QPushButton::clicked, &dlg, &QDialog::accept );
 		QObject::connect( cancel, &QPushButton::clicked, &dlg, &QDialog::reject );
 
-		if ( dlg.exec() != QDialog::Accepted ) {
-			return index;
-		}
+		if ( dlg.exec() != QDialog::Accepted )
+			return false;
 
-		/* make a convex hull from it */
-		compute_convex_hull( vertsTrans, hullVerts, hullNorms, (float)precSpin->value() );
+		settings.setValue( key + "Roundoff Error", precSpin->value() );
+		settings.setValue( key + "Collision Radius", spnRadius->value() );
+		settings.setValue( key + "Max Vertices", spnVerts->value() );
+		settings.setValue( key + "Max Hulls", spnHulls->value() );
+		settings.setValue( key + "Concavity", spnConcavity->value() );
 
-		// sort and remove duplicate vertices
-		QList<Vector4> sortedVerts;
-		for ( Vector4 vert : hullVerts ) {
-			vert /= havokScale;
+		options.roundError = precSpin->value();
+		options.radius = spnRadius->value();
+		options.maxVerts = spnVerts->value();
+		options.maxHulls = spnHulls->value();
+		options.concavity = spnConcavity->value();
 
-			if ( !sortedVerts.contains( vert ) ) {
-				sortedVerts.append( vert );
-			}
-		}
-		std::sort( sortedVerts.begin(), sortedVerts.end(), Vector4::lexLessThan );
-		QListIterator<Vector4> vertIter( sortedVerts );
+		return true;
+	}
 
-		while ( vertIter.hasNext() ) {
-			Vector4 sorted = vertIter.next();
-			convex_verts.append( sorted );
-		}
+	//! Read the mesh of a shape
+	static bool readJob( const NifModel * nif, const QModelIndex & index, ConvexJob & job )
+	{
+		QModelIndex iData = nif->getBlock( nif->getLink( index, "Data" ) );
 
-		// sort and remove duplicate normals
-		QList<Vector4> sortedNorms;
-		for ( Vector4 norm : hullNorms ) {
-			norm = Vector4( Vector3( norm ), norm[3] / havokScale );
+		if ( !iData.isValid() )
+			return false;
 
-			if ( !sortedNorms.contains( norm ) ) {
-				sortedNorms.append( norm );
-			}
+		job.iShape = index;
+		job.iParent = nif->getBlock( nif->getParent( nif->getBlockNumber( index ) ) );
+
+		// Offset by translation of NiTriShape
+		Vector3 trans = nif->get<Vector3>( index, "Translation" );
+		for ( const Vector3 & v : nif->getArray<Vector3>( iData, "Vertices" ) )
+			job.verts.append( v + trans );
+
+		QModelIndex iPoints = nif->getIndex( iData, "Points" );
+
+		if ( iPoints.isValid() ) {
+			QVector<QVector<quint16> > strips;
+
+			for ( int r = 0; r < nif->childCount( iPoints ); r++ )
+				strips.append( nif->getArray<quint16>( iPoints.child( r, 0 ) ) );
+
+			job.triangles = triangulate( strips );
+		} else {
+			job.triangles = nif->getArray<Triangle>( iData, "Triangles" );
 		}
-		std::sort( sortedNorms.begin(), sortedNorms.end(), Vector4::lexLessThan );
-		QListIterator<Vector4> normIter( sortedNorms );
 
-		while ( normIter.hasNext() ) {
-			Vector4 sorted = normIter.next();
-			convex_norms.append( sorted );
+		return job.iParent.isValid() && !job.verts.isEmpty();
+	}
+
+	//! Compute the hulls of a shape; safe to run on any thread
+	static void computeJob( ConvexJob & job, const ConvexOptions & options )
+	{
+		if ( options.maxHulls > 1 && !job.triangles.isEmpty() ) {
+			job.hulls = convexDecomposition( job.verts, job.triangles, options.maxHulls, options.concavity,
+											 options.maxVerts, options.roundError );
+		} else {
+			ConvexHull hull = convexHull( job.verts, options.maxVerts, options.roundError );
+			if ( !hull.isEmpty() )
+				job.hulls.append( hull );
 		}
+	}
+
+	//! Create a bhkConvexVerticesShape from a hull
+	static QModelIndex createCVS( NifModel * nif, const ConvexHull & hull, float havokScale, float radius )
+	{
+		/* those will be filled with the CVS data */
+		QVector<Vector4> convex_verts, convex_norms;
+
+		// sort and remove duplicate vertices
+		for ( const Vector3 & vert : hull.verts )
+			convex_verts.append( Vector4( vert / havokScale, 0 ) );
+
+		std::sort( convex_verts.begin(), convex_verts.end(), Vector4::lexLessThan );
+		convex_verts.erase( std::unique( convex_verts.begin(), convex_verts.end() ), convex_verts.end() );
+
+		// sort and remove duplicate normals
+		for ( const Vector4 & norm : hull.planes )
+			convex_norms.append( Vector4( Vector3( norm ), norm[3] / havokScale ) );
+
+		std::sort( convex_norms.begin(), convex_norms.end(), Vector4::lexLessThan );
+		convex_norms.erase( std::unique( convex_norms.begin(), convex_norms.end() ), convex_norms.end() );
 
 		/* create the CVS block */
 		QModelIndex iCVS = nif->insertNiBlock( "bhkConvexVerticesShape" );
@@ -163,13 +241,18 @@ public:
 
 		// radius is always 0.1?
 		// TODO: Figure out if radius is not arbitrarily set in vanilla NIFs
-		nif->set<float>( iCVS, "Radius", spnRadius->value() );
+		nif->set<float>( iCVS, "Radius", radius );
 
 		// for arrow detection: [0, 0, -0, 0, 0, -0]
 		nif->set<float>( nif->getIndex( iCVS, "Unknown 6 Floats" ).child( 2, 0 ), -0.0 );
 		nif->set<float>( nif->getIndex( iCVS, "Unknown 6 Floats" ).child( 5, 0 ), -0.0 );
 
-		QModelIndex iParent = nif->getBlock( nif->getParent( nif->getBlockNumber( index ) ) );
+		return iCVS;
+	}
+
+	//! Link a collision shape to a node, creating its collision object and rigid body if needed
+	static void setCollisionShape( NifModel * nif, const QModelIndex & iParent, const QModelIndex & iShape )
+	{
 		QModelIndex collisionLink = nif->getIndex( iParent, "Collision Object" );
 		QModelIndex collisionObject = nif->getBlock( nif->getLink( collisionLink ) );
 
@@ -195,22 +278,133 @@ public:
 		QModelIndex shape = nif->getBlock( nif->getLink( shapeLink ) );
 
 		// set link and delete old one
-		nif->setLink( shapeLink, nif->getBlockNumber( iCVS ) );
+		nif->setLink( shapeLink, nif->getBlockNumber( iShape ) );
 
 		if ( shape.isValid() ) {
 			// cheaper than calling spRemoveBranch
 			nif->removeNiBlock( nif->getBlockNumber( shape ) );
 		}
+	}
 
-		Message::info( nullptr, Spell::tr( "Created hull with %1 vertices, %2 normals" ).arg( convex_verts.count() ).arg( convex_norms.count() ) );
+	//! Create the collision of several shapes, computing the hulls concurrently
+	static void createShapes( NifModel * nif, const QList<QPersistentModelIndex> & shapes )
+	{
+		QVector<ConvexJob> jobs;
+		for ( const QModelIndex & idx : shapes ) {
+			ConvexJob job;
+			if ( readJob( nif, idx, job ) )
+				jobs.append( job );
+		}
 
-		// returning iCVS here can crash NifSkope if a child array is selected
-		return index;
+		if ( jobs.isEmpty() )
+			return;
+
+		ConvexOptions options;
+		if ( !getOptions( options ) )
+			return;
+
+		QElapsedTimer timer;
+		timer.start();
+
+		QtConcurrent::blockingMap( jobs, [&options]( ConvexJob & job ) { computeJob( job, options ); } );
+
+		qint64 elapsed = timer.elapsed();
+
+		float havokScale = (nif->checkVersion( 0x14020007, 0x14020007 ) && nif->getUserVersion() >= 12) ? 10.0f : 1.0f;
+
+		havokScale *= havokConst;
+
+		// Shapes under the same node share its collision object
+		QMap<int, QVector<ConvexHull> > nodeHulls;
+		QMap<int, QPersistentModelIndex> nodes;
+		for ( const ConvexJob & job : jobs ) {
+			int node = nif->getBlockNumber( job.iParent );
+			nodeHulls[node] += job.hulls;
+			nodes[node] = job.iParent;
+		}
+
+		int numHulls = 0, numVerts = 0;
+
+		nif->beginBatch();
+		for ( auto it = nodeHulls.constBegin(); it != nodeHulls.constEnd(); ++it ) {
+			const QVector<ConvexHull> & hulls = it.value();
+			if ( hulls.isEmpty() )
+				continue;
+
+			QList<QPersistentModelIndex> convexShapes;
+			for ( const ConvexHull & hull : hulls ) {
+				convexShapes << createCVS( nif, hull, havokScale, options.radius );
+				numVerts += hull.verts.count();
+			}
+
+			numHulls += hulls.count();
+
+			QModelIndex iShape = convexShapes.first();
+
+			if ( convexShapes.count() > 1 ) {
+				iShape = nif->insertNiBlock( "bhkListShape" );
+
+				nif->set<uint>( iShape, "Num Sub Shapes", convexShapes.count() );
+				nif->updateArray( iShape, "Sub Shapes" );
+				nif->set<uint>( iShape, "Num Unknown Ints", convexShapes.count() );
+				nif->updateArray( iShape, "Unknown Ints" );
+
+				QModelIndex iSubShapes = nif->getIndex( iShape, "Sub Shapes" );
+				for ( int i = 0; i < convexShapes.count(); i++ )
+					nif->setLink( iSubShapes.child( i, 0 ), nif->getBlockNumber( convexShapes[i] ) );
+			}
+
+			setCollisionShape( nif, nodes[it.key()], iShape );
+		}
+		nif->endBatch();
+
+		if ( numHulls == 0 ) {
+			Message::append( Spell::tr( "Create Convex Shape failed on one or more blocks." ),
+				Spell::tr( "Could not compute a convex hull, the meshes may be flat or have too few vertices." )
+			);
+			return;
+		}
+
+		Message::info( nullptr, Spell::tr( "Created %1 hulls with %2 vertices for %3 shapes in %4 ms" )
+			.arg( numHulls ).arg( numVerts ).arg( jobs.count() ).arg( elapsed ) );
 	}
 };
 
 REGISTER_SPELL( spCreateCVS )
 
+//! Creates convex hulls for all shapes
+class spCreateAllCVS final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Create All Convex Shapes" ); }
+	QString page() const override final { return Spell::tr( "Batch" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif && !index.isValid() && nif->checkVersion( 0x0A000100, 0 );
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
+	{
+		QList<QPersistentModelIndex> shapes;
+
+		spCreateCVS CVS;
+
+		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
+			QModelIndex idx = nif->getBlock( n );
+
+			if ( CVS.isApplicable( nif, idx ) )
+				shapes << idx;
+		}
+
+		spCreateCVS::createShapes( nif, shapes );
+
+		return QModelIndex();
+	}
+};
+
+REGISTER_SPELL( spCreateAllCVS )
+
 //! Transforms Havok constraints
 class spConstraintHelper final : public Spell
 {
@@ -415,7 +609,7 @@ public:
 
 				QModelIndex iPoints = nif->getIndex( iData, "Points" );
 
-				for ( int x = 0; x < nif->rowCount( iPoints ); x++ ) {
+				for ( int x = 0; x < nif->childCount( iPoints ); x++ ) {
 					tris += triangulate( nif->getArray<quint16>( iPoints.child( x, 0 ) ) );
 				}
 
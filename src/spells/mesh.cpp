@@ -1,8 +1,16 @@
 #include "mesh.h"
 #include "gl/gltools.h"
+#include "lib/boundingvolume.h"
+#include "lib/vertexcache.h"
+#include "lib/vertexweld.h"
 
 #include <QDialog>
+#include <QDoubleSpinBox>
 #include <QGridLayout>
+#include <QLabel>
+#include <QPushButton>
+#include <QSettings>
+#include <QtConcurrent/QtConcurrentMap>
 
 #include <cfloat>
 
@@ -14,6 +22,13 @@
  * All classes here inherit from the Spell class.
  */
 
+// see mesh.h
+int vertexCacheSize()
+{
+	QSettings settings;
+	return settings.value( "Settings/Nif/Mesh/Vertex Cache Size", VERTEX_CACHE_SIZE ).toInt();
+}
+
 //! Find shape data of triangle geometry
 static QModelIndex getShape( const NifModel * nif, const QModelIndex & index )
 {
@@ -76,7 +91,7 @@ static void removeWasteVertices( NifModel * nif, const QModelIndex & iData, cons
 		QList<QVector<Vector2> > texco;
 		QModelIndex iUVSets = nif->getIndex( iData, "UV Sets" );
 
-		for ( int r = 0; r < nif->rowCount( iUVSets ); r++ ) {
+		for ( int r = 0; r < nif->childCount( iUVSets ); r++ ) {
 			texco << nif->getArray<Vector2>( iUVSets.child( r, 0 ) );
 
 			if ( texco.last().count() != verts.count() )
@@ -106,7 +121,7 @@ static void removeWasteVertices( NifModel * nif, const QModelIndex & iData, cons
 		QList<QVector<quint16> > strips;
 		QModelIndex iPoints = nif->getIndex( iData, "Points" );
 
-		for ( int r = 0; r < nif->rowCount( iPoints ); r++ ) {
+		for ( int r = 0; r < nif->childCount( iPoints ); r++ ) {
 			strips << nif->getArray<quint16>( iPoints.child( r, 0 ) );
 			for ( const auto p : strips.last() ) {
 				used.insert( p, true );
@@ -164,7 +179,7 @@ static void removeWasteVertices( NifModel * nif, const QModelIndex & iData, cons
 
 		nif->setArray<Triangle>( iData, "Triangles", tris );
 
-		for ( int r = 0; r < nif->rowCount( iPoints ); r++ )
+		for ( int r = 0; r < nif->childCount( iPoints ); r++ )
 			nif->setArray<quint16>( iPoints.child( r, 0 ), strips[r] );
 
 		nif->set<int>( iData, "Num Vertices", verts.count() );
@@ -175,7 +190,7 @@ static void removeWasteVertices( NifModel * nif, const QModelIndex & iData, cons
 		nif->updateArray( iData, "Vertex Colors" );
 		nif->setArray<Color4>( iData, "Vertex Colors", colors );
 
-		for ( int r = 0; r < nif->rowCount( iUVSets ); r++ ) {
+		for ( int r = 0; r < nif->childCount( iUVSets ); r++ ) {
 			nif->updateArray( iUVSets.child( r, 0 ) );
 			nif->setArray<Vector2>( iUVSets.child( r, 0 ), texco[r] );
 		}
@@ -187,11 +202,11 @@ static void removeWasteVertices( NifModel * nif, const QModelIndex & iData, cons
 		QModelIndex iSkinData = nif->getBlock( nif->getLink( iSkinInst, "Data" ), "NiSkinData" );
 		QModelIndex iBones = nif->getIndex( iSkinData, "Bone List" );
 
-		for ( int b = 0; b < nif->rowCount( iBones ); b++ ) {
+		for ( int b = 0; b < nif->childCount( iBones ); b++ ) {
 			QVector<QPair<int, float> > weights;
 			QModelIndex iWeights = nif->getIndex( iBones.child( b, 0 ), "Vertex Weights" );
 
-			for ( int w = 0; w < nif->rowCount( iWeights ); w++ ) {
+			for ( int w = 0; w < nif->childCount( iWeights ); w++ ) {
 				weights.append( QPair<int, float>( nif->get<int>( iWeights.child( w, 0 ), "Index" ), nif->get<float>( iWeights.child( w, 0 ), "Weight" ) ) );
 			}
 
@@ -455,6 +470,59 @@ public:
 
 REGISTER_SPELL( spPruneRedundantTriangles )
 
+//! Flatten a vertex value into a weld attribute
+static void appendWeldValue( QVector<float> & out, const NifValue & v )
+{
+	switch ( v.type() ) {
+	case NifValue::tVector2:
+	case NifValue::tHalfVector2:
+		{
+			Vector2 x = v.get<Vector2>();
+			out << x[0] << x[1];
+		}
+		break;
+	case NifValue::tVector3:
+	case NifValue::tHalfVector3:
+		{
+			Vector3 x = v.get<Vector3>();
+			out << x[0] << x[1] << x[2];
+		}
+		break;
+	case NifValue::tByteVector3:
+		{
+			Vector3 x = v.get<ByteVector3>();
+			out << x[0] << x[1] << x[2];
+		}
+		break;
+	case NifValue::tColor4:
+	case NifValue::tByteColor4:
+		{
+			Color4 x = ( v.type() == NifValue::tColor4 ) ? v.get<Color4>() : v.get<ByteColor4>();
+			out << x[0] << x[1] << x[2] << x[3];
+		}
+		break;
+	default:
+		if ( v.isFloat() )
+			out << v.toFloat();
+		else if ( v.isCount() )
+			out << float( v.toCount() );
+		break;
+	}
+}
+
+//! Copy all values of a vertex row to another row of the same layout
+static void copyVertexRow( NifModel * nif, const QModelIndex & src, const QModelIndex & dst )
+{
+	int rows = nif->childCount( src );
+	if ( rows == 0 ) {
+		nif->setValue( dst, nif->getValue( src ) );
+		return;
+	}
+
+	for ( int r = 0; r < rows; r++ )
+		copyVertexRow( nif, src.child( r, 0 ), dst.child( r, 0 ) );
+}
+
 //! Removes duplicate vertices from a mesh
 class spRemoveDuplicateVertices final : public Spell
 {
@@ -464,121 +532,296 @@ public:
 
 	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
 	{
-		return getShape( nif, index ).isValid();
+		return getShape( nif, index ).isValid() || getBSTriShape( nif, index ).isValid();
 	}
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
 	{
+		QModelIndex iShape = getShape( nif, index );
+		QModelIndex iSkinInst = iShape.isValid()
+			? nif->getBlock( nif->getLink( iShape, "Skin Instance" ), "NiSkinInstance" )
+			: nif->getBlock( nif->getLink( getBSTriShape( nif, index ), "Skin" ), "NiSkinInstance" );
+		QModelIndex iSkinData = nif->getBlock( nif->getLink( iSkinInst, "Data" ), "NiSkinData" );
+
+		// The vertex maps of a skin partition would no longer match the welded vertices
+		if ( nif->getBlock( nif->getLink( iSkinInst, "Skin Partition" ), "NiSkinPartition" ).isValid()
+		     || nif->getBlock( nif->getLink( iSkinData, "Skin Partition" ), "NiSkinPartition" ).isValid() )
+		{
+			Message::warning( nullptr, Spell::tr( "Remove Duplicate Vertices does not support shapes with a skin partition." ),
+				Spell::tr( "Remove the NiSkinPartition first and regenerate it with the skin partition spell afterwards." )
+			);
+			return index;
+		}
+
+		if ( !getOptions() )
+			return index;
+
 		try
 		{
-			QModelIndex iShape = getShape( nif, index );
-			QModelIndex iData  = nif->getBlock( nif->getLink( iShape, "Data" ) );
+			if ( iShape.isValid() )
+				castTriShape( nif, iShape );
+			else
+				castBSTriShape( nif, getBSTriShape( nif, index ) );
+		}
+		catch ( QString & e )
+		{
+			Message::warning( nullptr, Spell::tr( "There were errors during the operation" ), e );
+		}
 
-			// read the data
+		return index;
+	}
 
-			QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
+	//! Ask for the matching tolerances, returns false if cancelled
+	bool getOptions()
+	{
+		QSettings settings;
+		QString key = QString( "%1/%2/%3/" ).arg( "Spells", page(), name() );
+
+		QDialog dlg;
+		dlg.setWindowTitle( name() );
+
+		QGridLayout * grid = new QGridLayout;
+		dlg.setLayout( grid );
+
+		grid->addWidget( new QLabel( Spell::tr( "Largest difference per component between welded vertices" ) ), 0, 0, 1, 2 );
+
+		// Vertices must be identical by default
+		const QStringList names = { "Position Tolerance", "Normal Tolerance", "UV Tolerance", "Color Tolerance", "Weight Tolerance" };
+		const QStringList labels = {
+			Spell::tr( "Position Tolerance" ), Spell::tr( "Normal Tolerance" ), Spell::tr( "UV Tolerance" ),
+			Spell::tr( "Color Tolerance" ), Spell::tr( "Weight Tolerance" )
+		};
+		QList<QDoubleSpinBox *> spins;
+		for ( int i = 0; i < names.count(); i++ ) {
+			QDoubleSpinBox * spn = new QDoubleSpinBox;
+			spn->setRange( 0, i == 0 ? 10 : 1 );
+			spn->setDecimals( 4 );
+			spn->setSingleStep( 0.001 );
+			spn->setValue( settings.value( key + names[i], 0.0 ).toDouble() );
+			spins << spn;
+
+			grid->addWidget( new QLabel( labels[i] ), i + 1, 0 );
+			grid->addWidget( spn, i + 1, 1 );
+		}
 
-			if ( !verts.count() )
-				throw QString( Spell::tr( "No vertices" ) );
+		QPushButton * btOk = new QPushButton;
+		btOk->setText( Spell::tr( "Remove" ) );
+		QObject::connect( btOk, &QPushButton::clicked, &dlg, &QDialog::accept );
 
-			QVector<Vector3> norms = nif->getArray<Vector3>( iData, "Normals" );
-			QVector<Color4> colors = nif->getArray<Color4>( iData, "Vertex Colors" );
-			QList<QVector<Vector2> > texco;
-			QModelIndex iUVSets = nif->getIndex( iData, "UV Sets" );
+		QPushButton * btCancel = new QPushButton;
+		btCancel->setText( Spell::tr( "Cancel" ) );
+		QObject::connect( btCancel, &QPushButton::clicked, &dlg, &QDialog::reject );
 
-			for ( int r = 0; r < nif->rowCount( iUVSets ); r++ ) {
-				texco << nif->getArray<Vector2>( iUVSets.child( r, 0 ) );
+		grid->addWidget( btOk, names.count() + 1, 0 );
+		grid->addWidget( btCancel, names.count() + 1, 1 );
 
-				if ( texco.last().count() != verts.count() )
-					throw QString( Spell::tr( "UV array size differs" ) );
-			}
+		if ( dlg.exec() != QDialog::Accepted )
+			return false;
 
-			int numVerts = verts.count();
+		for ( int i = 0; i < names.count(); i++ )
+			settings.setValue( key + names[i], spins[i]->value() );
 
-			if ( numVerts != nif->get<int>( iData, "Num Vertices" )
-			     || ( norms.count() && norms.count() != numVerts )
-			     || ( colors.count() && colors.count() != numVerts ) )
-			{
-				throw QString( Spell::tr( "Vertex array size differs" ) );
-			}
+		tolPosition = spins[0]->value();
+		tolNormal = spins[1]->value();
+		tolUV = spins[2]->value();
+		tolColor = spins[3]->value();
+		tolWeight = spins[4]->value();
+
+		return true;
+	}
+
+	//! BSTriShape with its vertices on the shape itself
+	static QModelIndex getBSTriShape( const NifModel * nif, const QModelIndex & index )
+	{
+		QModelIndex iShape = nif->getBlock( index );
+		if ( nif->inherits( iShape, "BSTriShape" ) && !nif->inherits( iShape, "BSDynamicTriShape" )
+		     && nif->childCount( nif->getIndex( iShape, "Vertex Data" ) ) > 0 )
+			return iShape;
 
-			// detect the dublicates
+		return QModelIndex();
+	}
+
+	void castTriShape( NifModel * nif, const QModelIndex & iShape )
+	{
+		QModelIndex iData = nif->getBlock( nif->getLink( iShape, "Data" ) );
+
+		// read the data
+
+		QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
 
-			QMap<quint16, quint16> map;
+		if ( !verts.count() )
+			throw QString( Spell::tr( "No vertices" ) );
 
-			for ( int a = 0; a < numVerts; a++ ) {
-				Vector3 v = verts[a];
+		QVector<Vector3> norms = nif->getArray<Vector3>( iData, "Normals" );
+		QVector<Color4> colors = nif->getArray<Color4>( iData, "Vertex Colors" );
+		QList<QVector<Vector2> > texco;
+		QModelIndex iUVSets = nif->getIndex( iData, "UV Sets" );
 
-				for ( int b = 0; b < a; b++ ) {
-					if ( !( v == verts[b] ) )
-						continue;
+		for ( int r = 0; r < nif->childCount( iUVSets ); r++ ) {
+			texco << nif->getArray<Vector2>( iUVSets.child( r, 0 ) );
 
-					if ( norms.count() && !( norms[a] == norms[b] ) )
-						continue;
+			if ( texco.last().count() != verts.count() )
+				throw QString( Spell::tr( "UV array size differs" ) );
+		}
 
-					if ( colors.count() && !( colors[a] == colors[b] ) )
-						continue;
+		int numVerts = verts.count();
 
-					int t = 0;
+		if ( numVerts != nif->get<int>( iData, "Num Vertices" )
+		     || ( norms.count() && norms.count() != numVerts )
+		     || ( colors.count() && colors.count() != numVerts ) )
+		{
+			throw QString( Spell::tr( "Vertex array size differs" ) );
+		}
 
-					for ( t = 0; t < texco.count(); t++ ) {
-						if ( !( texco[t][a] == texco[t][b] ) )
-							break;
-					}
+		// detect the duplicates
 
-					if ( t < texco.count() )
-						continue;
+		VertexWelder welder( verts, tolPosition );
+		welder.addAttribute( VertexWelder::attribute( norms, 3 ), 3, tolNormal );
+		welder.addAttribute( VertexWelder::attribute( colors, 4 ), 4, tolColor );
+		for ( const auto & uv : texco )
+			welder.addAttribute( VertexWelder::attribute( uv, 2 ), 2, tolUV );
 
-					map.insert( b, a );
+		// Skinned vertices must also have the same weights
+		QModelIndex iSkinInst = nif->getBlock( nif->getLink( iShape, "Skin Instance" ), "NiSkinInstance" );
+		QModelIndex iBones = nif->getIndex( nif->getBlock( nif->getLink( iSkinInst, "Data" ), "NiSkinData" ), "Bone List" );
+		int numBones = nif->childCount( iBones );
+		if ( numBones > 0 ) {
+			QVector<float> weights( numVerts * numBones, 0.0f );
+			for ( int b = 0; b < numBones; b++ ) {
+				QModelIndex iWeights = nif->getIndex( iBones.child( b, 0 ), "Vertex Weights" );
+				for ( int w = 0; w < nif->childCount( iWeights ); w++ ) {
+					int v = nif->get<int>( iWeights.child( w, 0 ), "Index" );
+					if ( v >= 0 && v < numVerts )
+						weights[v * numBones + b] = nif->get<float>( iWeights.child( w, 0 ), "Weight" );
 				}
 			}
+			welder.addAttribute( weights, numBones, tolWeight );
+		}
 
-			//qDebug() << QString( Spell::tr("detected % duplicates") ).arg( map.count() );
+		QVector<int> welded = welder.weld();
 
-			// adjust the faces
+		// adjust the faces
 
-			QVector<Triangle> tris = nif->getArray<Triangle>( iData, "Triangles" );
-			QMutableVectorIterator<Triangle> itri( tris );
+		QVector<Triangle> tris = nif->getArray<Triangle>( iData, "Triangles" );
+		for ( Triangle & t : tris ) {
+			for ( int p = 0; p < 3; p++ ) {
+				if ( t[p] < numVerts )
+					t[p] = welded[t[p]];
+			}
+		}
 
-			while ( itri.hasNext() ) {
-				Triangle & t = itri.next();
+		nif->setArray<Triangle>( iData, "Triangles", tris );
 
-				for ( int p = 0; p < 3; p++ ) {
-					if ( map.contains( t[p] ) )
-						t[p] = map.value( t[p] );
-				}
+		QModelIndex iPoints = nif->getIndex( iData, "Points" );
 
+		for ( int r = 0; r < nif->childCount( iPoints ); r++ ) {
+			QVector<quint16> strip = nif->getArray<quint16>( iPoints.child( r, 0 ) );
+			for ( quint16 & p : strip ) {
+				if ( p < numVerts )
+					p = welded[p];
 			}
 
-			nif->setArray<Triangle>( iData, "Triangles", tris );
+			nif->setArray<quint16>( iPoints.child( r, 0 ), strip );
+		}
+
+		// finally, remove the now unused vertices
+
+		removeWasteVertices( nif, iData, iShape );
+	}
+
+	void castBSTriShape( NifModel * nif, const QModelIndex & iShape )
+	{
+		QModelIndex iVertData = nif->getIndex( iShape, "Vertex Data" );
+		int numVerts = nif->childCount( iVertData );
 
-			QModelIndex iPoints = nif->getIndex( iData, "Points" );
+		// Read the vertices, grouping the other values by tolerance
+		enum { Normal, UV, Color, Weight, Exact, NumGroups };
+		QVector<float> groups[NumGroups];
+		QVector<Vector3> verts;
+		verts.reserve( numVerts );
 
-			for ( int r = 0; r < nif->rowCount( iPoints ); r++ ) {
-				QVector<quint16> strip = nif->getArray<quint16>( iPoints.child( r, 0 ) );
-				QMutableVectorIterator<quint16> istrp( strip );
+		for ( int i = 0; i < numVerts; i++ ) {
+			QModelIndex iVert = iVertData.child( i, 0 );
 
-				while ( istrp.hasNext() ) {
-					quint16 & p = istrp.next();
+			for ( int r = 0; r < nif->childCount( iVert ); r++ ) {
+				QModelIndex iValue = iVert.child( r, 0 );
+				QString n = nif->itemName( iValue );
 
-					if ( map.contains( p ) )
-						p = map.value( p );
+				if ( n == "Vertex" ) {
+					verts << nif->get<Vector3>( iValue );
+					continue;
 				}
 
-				nif->setArray<quint16>( iPoints.child( r, 0 ), strip );
+				int g = Exact;
+				if ( n == "Normal" || n == "Tangent" || n.startsWith( "Bitangent" ) )
+					g = Normal;
+				else if ( n == "UV" )
+					g = UV;
+				else if ( n == "Vertex Colors" )
+					g = Color;
+				else if ( n == "Bone Weights" )
+					g = Weight;
+
+				if ( nif->childCount( iValue ) > 0 ) {
+					for ( int c = 0; c < nif->childCount( iValue ); c++ )
+						appendWeldValue( groups[g], nif->getValue( iValue.child( c, 0 ) ) );
+				} else {
+					appendWeldValue( groups[g], nif->getValue( iValue ) );
+				}
 			}
+		}
+
+		if ( verts.count() != numVerts )
+			throw QString( Spell::tr( "No vertices" ) );
+
+		const float tolerances[NumGroups] = { tolNormal, tolUV, tolColor, tolWeight, 0.0f };
+
+		VertexWelder welder( verts, tolPosition );
+		for ( int g = 0; g < NumGroups; g++ )
+			welder.addAttribute( groups[g], groups[g].count() / numVerts, tolerances[g] );
 
-			// finally, remove the now unused vertices
+		QVector<int> kept;
+		QVector<int> map = VertexWelder::compact( welder.weld(), kept );
 
-			removeWasteVertices( nif, iData, iShape );
+		// Remap the faces and keep only the used vertices
+
+		QVector<Triangle> tris = nif->getArray<Triangle>( iShape, "Triangles" );
+		for ( Triangle & t : tris ) {
+			for ( int p = 0; p < 3; p++ ) {
+				if ( t[p] < numVerts )
+					t[p] = map[t[p]];
+			}
 		}
-		catch ( QString & e )
-		{
-			Message::warning( nullptr, Spell::tr( "There were errors during the operation" ), e );
+
+		qCInfo( nsSpell ) << Spell::tr( "Block %1: Removed %2 vertices" )
+			.arg( nif->getBlockNumber( iShape ) ).arg( numVerts - kept.count() );
+
+		if ( kept.count() == numVerts )
+			return;
+
+		// Vertices only move towards the front, so they can be compacted in place
+		for ( int i = 0; i < kept.count(); i++ ) {
+			if ( kept[i] != i )
+				copyVertexRow( nif, iVertData.child( kept[i], 0 ), iVertData.child( i, 0 ) );
 		}
 
-		return index;
+		nif->set<int>( iShape, "Num Vertices", kept.count() );
+		nif->updateArray( iVertData );
+		nif->setArray<Triangle>( iShape, "Triangles", tris );
+
+		auto iDataSize = nif->getIndex( iShape, "Data Size" );
+		if ( iDataSize.isValid() ) {
+			auto desc = nif->get<BSVertexDesc>( iShape, "Vertex Desc" );
+			nif->set<uint>( iDataSize, desc.GetVertexSize() * kept.count() + 6 * nif->get<uint>( iShape, "Num Triangles" ) );
+		}
 	}
+
+private:
+	float tolPosition = 0.0f;
+	float tolNormal = 0.0f;
+	float tolUV = 0.0f;
+	float tolColor = 0.0f;
+	float tolWeight = 0.0f;
 };
 
 REGISTER_SPELL( spRemoveDuplicateVertices )
@@ -636,38 +879,22 @@ QModelIndex spUpdateCenterRadius::cast( NifModel * nif, const QModelIndex & inde
 	     || ( nif->get<ushort>( iData, "Consistency Flags" ) & 0x8000 ) )
 	{
 		/* is a Oblivion mesh! */
-		float xMin( FLT_MAX ), xMax( -FLT_MAX );
-		float yMin( FLT_MAX ), yMax( -FLT_MAX );
-		float zMin( FLT_MAX ), zMax( -FLT_MAX );
+		Vector3 mn = verts.first();
+		Vector3 mx = verts.first();
 		for ( const Vector3& v : verts ) {
-			if ( v[0] < xMin )
-				xMin = v[0];
-			else if ( v[0] > xMax )
-				xMax = v[0];
-
-			if ( v[1] < yMin )
-				yMin = v[1];
-			else if ( v[1] > yMax )
-				yMax = v[1];
-
-			if ( v[2] < zMin )
-				zMin = v[2];
-			else if ( v[2] > zMax )
-				zMax = v[2];
+			mn.boundMin( v );
+			mx.boundMax( v );
 		}
 
-		center = Vector3( xMin + xMax, yMin + yMax, zMin + zMax ) / 2;
-	} else {
+		center = ( mn + mx ) / 2;
+
+		float d;
 		for ( const Vector3& v : verts ) {
-			center += v;
+			if ( ( d = ( center - v ).length() ) > radius )
+				radius = d;
 		}
-		center /= verts.count();
-	}
-
-	float d;
-	for ( const Vector3& v : verts ) {
-		if ( ( d = ( center - v ).length() ) > radius )
-			radius = d;
+	} else {
+		boundingSphere( verts, center, radius );
 	}
 
 	nif->set<Vector3>( iData, "Center", center );
@@ -678,6 +905,16 @@ QModelIndex spUpdateCenterRadius::cast( NifModel * nif, const QModelIndex & inde
 
 REGISTER_SPELL( spUpdateCenterRadius )
 
+//! Vertices of a BSTriShape, for fitting its bounding sphere off the main thread
+struct BoundsJob
+{
+	QPersistentModelIndex iShape;
+	QVector<Vector3> verts;
+
+	Vector3 center;
+	float radius = -1;
+};
+
 //! Updates Bounds of BSTriShape
 class spUpdateBounds final : public Spell
 {
@@ -690,28 +927,49 @@ public:
 		return nif->inherits( index, "BSTriShape" ) && nif->getIndex( index, "Vertex Data" ).isValid();
 	}
 
-	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	//! Fit the bounding spheres of several shapes, computing them concurrently
+	static void updateBounds( NifModel * nif, const QList<QPersistentModelIndex> & shapes )
 	{
-		auto vertData = nif->getIndex( index, "Vertex Data" );
+		QVector<BoundsJob> jobs;
+		jobs.reserve( shapes.count() );
+
+		for ( const QModelIndex & iShape : shapes ) {
+			BoundsJob job;
+			job.iShape = iShape;
+
+			// Retrieve the verts
+			auto vertData = nif->getIndex( iShape, "Vertex Data" );
+			int numVerts = nif->childCount( vertData );
+			job.verts.reserve( numVerts );
+			for ( int i = 0; i < numVerts; i++ ) {
+				job.verts << nif->get<Vector3>( vertData.child( i, 0 ), "Vertex" );
+			}
 
-		// Retrieve the verts
-		QVector<Vector3> verts;
-		for ( int i = 0; i < nif->rowCount( vertData ); i++ ) {
-			verts << nif->get<Vector3>( vertData.child( i, 0 ), "Vertex" );
+			if ( !job.verts.isEmpty() )
+				jobs.append( job );
 		}
 
-		if ( verts.isEmpty() )
-			return index;
+		QtConcurrent::blockingMap( jobs, []( BoundsJob & job ) {
+			boundingSphere( job.verts, job.center, job.radius );
+		} );
 
-		// Creating a bounding sphere from the verts
-		BoundSphere bounds = BoundSphere( verts );
+		// Update the bounding spheres
+		nif->beginBatch();
+		for ( const BoundsJob & job : jobs ) {
+			auto boundsIdx = nif->getIndex( job.iShape, "Bounding Sphere" );
+			nif->set<Vector3>( boundsIdx, "Center", job.center );
+			nif->set<float>( boundsIdx, "Radius", job.radius );
+		}
+		nif->endBatch();
+	}
 
-		// Update the bounding sphere
-		auto boundsIdx = nif->getIndex( index, "Bounding Sphere" );
-		nif->set<Vector3>( boundsIdx, "Center", bounds.center );
-		nif->set<float>( boundsIdx, "Radius", bounds.radius );
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		QPersistentModelIndex iShape = index;
 
-		return index;
+		updateBounds( nif, { iShape } );
+
+		return iShape;
 	}
 };
 
@@ -748,9 +1006,7 @@ public:
 				indices << idx;
 		}
 
-		for ( const QModelIndex& idx : indices ) {
-			updBounds.castIfApplicable( nif, idx );
-		}
+		spUpdateBounds::updateBounds( nif, indices );
 
 		return QModelIndex();
 	}
@@ -775,7 +1031,7 @@ QModelIndex spUpdateTrianglesFromSkin::cast( NifModel * nif, const QModelIndex &
 
 	QVector<Triangle> tris;
 	auto iParts = nif->getIndex( iSkinPart, "Skin Partition Blocks" );
-	for ( int i = 0; i < nif->rowCount( iParts ) && iParts.isValid(); i++ )
+	for ( int i = 0; i < nif->childCount( iParts ) && iParts.isValid(); i++ )
 		tris << SkinPartition( nif, iParts.child( i, 0 ) ).getRemappedTriangles();
 
 	nif->set<bool>( iData, "Has Triangles", true );
@@ -788,3 +1044,329 @@ QModelIndex spUpdateTrianglesFromSkin::cast( NifModel * nif, const QModelIndex &
 }
 
 REGISTER_SPELL( spUpdateTrianglesFromSkin )
+
+//! Read all leaf values of a row
+static void readLeaves( const NifModel * nif, const QModelIndex & index, QVector<NifValue> & values )
+{
+	int rows = nif->childCount( index );
+	if ( rows == 0 ) {
+		values << nif->getValue( index );
+		return;
+	}
+
+	for ( int r = 0; r < rows; r++ )
+		readLeaves( nif, index.child( r, 0 ), values );
+}
+
+//! Write all leaf values of a row, as read by readLeaves()
+static void writeLeaves( NifModel * nif, const QModelIndex & index, const QVector<NifValue> & values, int & pos )
+{
+	int rows = nif->childCount( index );
+	if ( rows == 0 ) {
+		nif->setValue( index, values.value( pos++ ) );
+		return;
+	}
+
+	for ( int r = 0; r < rows; r++ )
+		writeLeaves( nif, index.child( r, 0 ), values, pos );
+}
+
+//! Reorder the rows of an array, row i becomes old row order[i]
+static void reorderRows( NifModel * nif, const QModelIndex & iArray, const QVector<int> & order )
+{
+	if ( !iArray.isValid() || nif->childCount( iArray ) != order.count() )
+		return;
+
+	QVector<QVector<NifValue> > rows( order.count() );
+	for ( int i = 0; i < order.count(); i++ )
+		readLeaves( nif, iArray.child( i, 0 ), rows[i] );
+
+	for ( int i = 0; i < order.count(); i++ ) {
+		if ( order[i] == i )
+			continue;
+
+		int pos = 0;
+		writeLeaves( nif, iArray.child( i, 0 ), rows[order[i]], pos );
+	}
+}
+
+//! Replace vertex indices using a map from old to new index
+template <typename T> static void remapIndices( NifModel * nif, const QModelIndex & iArray, const QVector<int> & map )
+{
+	if ( !iArray.isValid() )
+		return;
+
+	QVector<T> indices = nif->getArray<T>( iArray );
+	for ( T & i : indices ) {
+		if ( int( i ) < map.count() )
+			i = map[i];
+	}
+
+	nif->setArray<T>( iArray, indices );
+}
+
+static void remapTriangles( NifModel * nif, const QModelIndex & iArray, const QVector<int> & map )
+{
+	if ( !iArray.isValid() )
+		return;
+
+	QVector<Triangle> tris = nif->getArray<Triangle>( iArray );
+	for ( Triangle & t : tris ) {
+		for ( int c = 0; c < 3; c++ ) {
+			if ( t[c] < map.count() )
+				t[c] = map[t[c]];
+		}
+	}
+
+	nif->setArray<Triangle>( iArray, tris );
+}
+
+//! Invert a vertex order into a map from old to new index
+static QVector<int> invertOrder( const QVector<int> & order )
+{
+	QVector<int> map( order.count() );
+	for ( int i = 0; i < order.count(); i++ )
+		map[order[i]] = i;
+
+	return map;
+}
+
+//! The skin partitions of a NiSkinPartition
+static QModelIndex getPartitions( const NifModel * nif, const QModelIndex & iSkinPart )
+{
+	QModelIndex iParts = nif->getIndex( iSkinPart, "Partition" );
+	if ( !iParts.isValid() )
+		iParts = nif->getIndex( iSkinPart, "Skin Partition Blocks" );
+
+	return iParts;
+}
+
+//! Reorders triangles and vertices for the vertex cache
+class spOptimizeVertexCache final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Optimize Vertex Cache" ); }
+	QString page() const override final { return Spell::tr( "Mesh" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		QModelIndex iShape = getShape( nif, index );
+		if ( iShape.isValid() )
+			return nif->isNiBlock( nif->getBlock( nif->getLink( iShape, "Data" ) ), "NiTriShapeData" );
+
+		QModelIndex iBlock = nif->getBlock( index );
+		if ( nif->isNiBlock( iBlock, "NiSkinPartition" ) ) {
+			// Partition -> skin instance -> shape
+			int shape = nif->getParent( nif->getParent( nif->getBlockNumber( iBlock ) ) );
+			return !isSegmented( nif, nif->getBlock( shape ) );
+		}
+
+		return nif->inherits( iBlock, "BSTriShape" ) && !isSegmented( nif, iBlock );
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		before = after = VertexCacheStats();
+		cacheSize = vertexCacheSize();
+
+		QModelIndex iBlock = nif->getBlock( index );
+		QModelIndex iShape = getShape( nif, index );
+
+		if ( iShape.isValid() ) {
+			optimizeTriShape( nif, iShape );
+		} else if ( nif->isNiBlock( iBlock, "NiSkinPartition" ) ) {
+			optimizeSkinPartition( nif, iBlock );
+		} else if ( nif->childCount( nif->getIndex( iBlock, "Vertex Data" ) ) > 0 ) {
+			optimizeBSTriShape( nif, iBlock );
+		} else {
+			// Skinned Skyrim SE shapes keep their vertices on the skin partition
+			QModelIndex iSkin = nif->getBlock( nif->getLink( iBlock, "Skin" ) );
+			optimizeSkinPartition( nif, nif->getBlock( nif->getLink( iSkin, "Skin Partition" ), "NiSkinPartition" ) );
+		}
+
+		// Logged rather than shown, the spell is also cast on every shape of a batch
+		if ( before.triangles > 0 ) {
+			qCInfo( nsSpell ) << Spell::tr( "Block %1: ACMR %2 -> %3, ATVR %4 -> %5" )
+				.arg( nif->getBlockNumber( iBlock ) )
+				.arg( before.acmr(), 0, 'f', 3 ).arg( after.acmr(), 0, 'f', 3 )
+				.arg( before.atvr(), 0, 'f', 3 ).arg( after.atvr(), 0, 'f', 3 );
+		}
+
+		return index;
+	}
+
+private:
+	//! Segmented shapes address their triangles by range, which reordering the whole list would break
+	static bool isSegmented( const NifModel * nif, const QModelIndex & iShape )
+	{
+		return nif->inherits( iShape, "BSSubIndexTriShape" ) || nif->inherits( iShape, "BSSegmentedTriShape" );
+	}
+
+	//! Reorder a triangle list and return the new vertex order
+	QVector<int> optimize( QVector<Triangle> & tris, int numVerts )
+	{
+		before += vertexCacheStats( tris, cacheSize );
+		tris = optimizeVertexCache( tris, cacheSize );
+		after += vertexCacheStats( tris, cacheSize );
+
+		return optimizeVertexFetch( tris, numVerts );
+	}
+
+	void optimizeTriShape( NifModel * nif, const QModelIndex & iShape )
+	{
+		QModelIndex iData = nif->getBlock( nif->getLink( iShape, "Data" ), "NiTriShapeData" );
+		int numVerts = nif->get<int>( iData, "Num Vertices" );
+
+		QVector<Triangle> tris = nif->getArray<Triangle>( iData, "Triangles" );
+		QVector<int> order = optimize( tris, numVerts );
+		QVector<int> map = invertOrder( order );
+
+		nif->setArray<Triangle>( iData, "Triangles", tris );
+
+		for ( const QString & name : { "Vertices", "Normals", "Tangents", "Bitangents", "Vertex Colors" } )
+			reorderRows( nif, nif->getIndex( iData, name ), order );
+
+		QModelIndex iUVSets = nif->getIndex( iData, "UV Sets" );
+		for ( int r = 0; r < nif->childCount( iUVSets ); r++ )
+			reorderRows( nif, iUVSets.child( r, 0 ), order );
+
+		QModelIndex iMatchGroups = nif->getIndex( iData, "Match Groups" );
+		for ( int r = 0; r < nif->childCount( iMatchGroups ); r++ )
+			remapIndices<quint16>( nif, nif->getIndex( iMatchGroups.child( r, 0 ), "Vertex Indices" ), map );
+
+		// Tangent space extra data, all tangents followed by all bitangents
+		for ( int lnk : nif->getLinkArray( iShape, "Extra Data List" ) ) {
+			QModelIndex iExtra = nif->getBlock( lnk, "NiBinaryExtraData" );
+			if ( !nif->get<QString>( iExtra, "Name" ).startsWith( "Tangent space" ) )
+				continue;
+
+			QModelIndex iBinary = nif->getIndex( iExtra, "Binary Data" );
+			QByteArray data = nif->get<QByteArray>( iBinary );
+			if ( data.size() != numVerts * 2 * int( sizeof( Vector3 ) ) )
+				continue;
+
+			QByteArray sorted( data.size(), 0 );
+			for ( int half = 0; half < 2; half++ ) {
+				const Vector3 * src = reinterpret_cast<const Vector3 *>( data.constData() ) + half * numVerts;
+				Vector3 * dst = reinterpret_cast<Vector3 *>( sorted.data() ) + half * numVerts;
+				for ( int i = 0; i < numVerts; i++ )
+					dst[i] = src[order[i]];
+			}
+
+			nif->set<QByteArray>( iBinary, sorted );
+		}
+
+		// Morph targets
+		for ( int lnk = nif->getLink( iShape, "Controller" ); lnk >= 0; ) {
+			QModelIndex iCtrl = nif->getBlock( lnk );
+			if ( nif->isNiBlock( iCtrl, "NiGeomMorpherController" ) ) {
+				QModelIndex iMorphs = nif->getIndex( nif->getBlock( nif->getLink( iCtrl, "Data" ), "NiMorphData" ), "Morphs" );
+				for ( int r = 0; r < nif->childCount( iMorphs ); r++ )
+					reorderRows( nif, nif->getIndex( iMorphs.child( r, 0 ), "Vectors" ), order );
+			}
+
+			lnk = nif->getLink( iCtrl, "Next Controller" );
+		}
+
+		// Skinning
+		QModelIndex iSkinInst = nif->getBlock( nif->getLink( iShape, "Skin Instance" ) );
+		QModelIndex iSkinData = nif->getBlock( nif->getLink( iSkinInst, "Data" ), "NiSkinData" );
+		QModelIndex iBones = nif->getIndex( iSkinData, "Bone List" );
+
+		for ( int b = 0; b < nif->childCount( iBones ); b++ ) {
+			QModelIndex iWeights = nif->getIndex( iBones.child( b, 0 ), "Vertex Weights" );
+			for ( int w = 0; w < nif->childCount( iWeights ); w++ ) {
+				QModelIndex iIndex = nif->getIndex( iWeights.child( w, 0 ), "Index" );
+				int v = nif->get<int>( iIndex );
+				if ( v >= 0 && v < map.count() )
+					nif->set<int>( iIndex, map[v] );
+			}
+		}
+
+		QModelIndex iSkinPart = nif->getBlock( nif->getLink( iSkinInst, "Skin Partition" ), "NiSkinPartition" );
+		if ( !iSkinPart.isValid() )
+			iSkinPart = nif->getBlock( nif->getLink( iSkinData, "Skin Partition" ), "NiSkinPartition" );
+
+		QModelIndex iParts = getPartitions( nif, iSkinPart );
+		for ( int p = 0; p < nif->childCount( iParts ); p++ )
+			remapIndices<quint16>( nif, nif->getIndex( iParts.child( p, 0 ), "Vertex Map" ), map );
+	}
+
+	void optimizeBSTriShape( NifModel * nif, const QModelIndex & iShape )
+	{
+		QModelIndex iVertData = nif->getIndex( iShape, "Vertex Data" );
+		int numVerts = nif->childCount( iVertData );
+
+		QVector<Triangle> tris = nif->getArray<Triangle>( iShape, "Triangles" );
+		QVector<int> order = optimize( tris, numVerts );
+
+		nif->setArray<Triangle>( iShape, "Triangles", tris );
+		reorderRows( nif, iVertData, order );
+
+		// BSDynamicTriShape
+		reorderRows( nif, nif->getIndex( iShape, "Vertices" ), order );
+	}
+
+	void optimizeSkinPartition( NifModel * nif, const QModelIndex & iSkinPart )
+	{
+		QModelIndex iParts = getPartitions( nif, iSkinPart );
+		QModelIndex iVertData = nif->getIndex( iSkinPart, "Vertex Data" );
+		int numVerts = nif->childCount( iVertData );
+
+		if ( numVerts > 0 ) {
+			// Skyrim SE: the partitions index the shared vertex data
+			QVector<Triangle> tris;
+			QVector<int> counts;
+			for ( int p = 0; p < nif->childCount( iParts ); p++ ) {
+				QVector<Triangle> part = nif->getArray<Triangle>( iParts.child( p, 0 ), "Triangles" );
+
+				before += vertexCacheStats( part, cacheSize );
+				part = optimizeVertexCache( part, cacheSize );
+				after += vertexCacheStats( part, cacheSize );
+
+				tris += part;
+				counts << part.count();
+			}
+
+			QVector<int> order = optimizeVertexFetch( tris, numVerts );
+			QVector<int> map = invertOrder( order );
+
+			reorderRows( nif, iVertData, order );
+
+			int first = 0;
+			for ( int p = 0; p < nif->childCount( iParts ); p++ ) {
+				QModelIndex iPart = iParts.child( p, 0 );
+				nif->setArray<Triangle>( iPart, "Triangles", tris.mid( first, counts[p] ) );
+				remapIndices<quint16>( nif, nif->getIndex( iPart, "Vertex Map" ), map );
+
+				QModelIndex iCopy = nif->getIndex( iPart, "Triangles Copy" );
+				if ( nif->childCount( iCopy ) == counts[p] )
+					nif->setArray<Triangle>( iCopy, tris.mid( first, counts[p] ) );
+
+				first += counts[p];
+			}
+
+			return;
+		}
+
+		// The partitions index their own vertices through the vertex map
+		for ( int p = 0; p < nif->childCount( iParts ); p++ ) {
+			QModelIndex iPart = iParts.child( p, 0 );
+			if ( nif->get<int>( iPart, "Num Strips" ) > 0 )
+				continue;
+
+			QVector<Triangle> tris = nif->getArray<Triangle>( iPart, "Triangles" );
+			QVector<int> order = optimize( tris, nif->get<int>( iPart, "Num Vertices" ) );
+
+			nif->setArray<Triangle>( iPart, "Triangles", tris );
+			for ( const QString & name : { "Vertex Map", "Vertex Weights", "Bone Indices" } )
+				reorderRows( nif, nif->getIndex( iPart, name ), order );
+		}
+	}
+
+	VertexCacheStats before;
+	VertexCacheStats after;
+	int cacheSize = VERTEX_CACHE_SIZE;
+};
+
+REGISTER_SPELL( spOptimizeVertexCache )
@@ -6,6 +6,9 @@
 
 //! \file mesh.h Mesh spell headers
 
+//! The vertex cache size that the mesh spells optimize for, from the settings
+int vertexCacheSize();
+
 //! Update center and radius of a mesh
 class spUpdateCenterRadius final : public Spell
 {
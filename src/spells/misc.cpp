@@ -274,14 +274,14 @@ QModelIndex spCollapseArray::numCollapser( NifModel * nif, QModelIndex & iNumEle
 	if ( iNumElem.isValid() && iArray.isValid() ) {
 		QVector<qint32> links;
 
-		for ( int r = 0; r < nif->rowCount( iArray ); r++ ) {
+		for ( int r = 0; r < nif->childCount( iArray ); r++ ) {
 			qint32 l = nif->getLink( iArray.child( r, 0 ) );
 
 			if ( l >= 0 )
 				links.append( l );
 		}
 
-		if ( links.count() < nif->rowCount( iArray ) ) {
+		if ( links.count() < nif->childCount( iArray ) ) {
 			nif->set<int>( iNumElem, links.count() );
 			nif->updateArray( iArray );
 			nif->setLinkArray( iArray, links );
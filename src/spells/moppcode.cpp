@@ -1,12 +1,20 @@
 #include "spellbook.h"
 
+#include "lib/moppgen.h"
+
+#include <QCoreApplication>
+#include <QtConcurrent/QtConcurrentMap>
+
 
 // Brief description is deliberately not autolinked to class Spell
 /*! \file moppcode.cpp
  * \brief Havok MOPP spells
  *
- * Note that this code only works on the Windows platform due an external
- * dependency on the Havok SDK, with which NifMopp.dll is compiled.
+ * The MOPP code is generated natively by generateMoppCode() and checked by
+ * checkMoppCode() against a brute force triangle query before it is written.
+ * The native keys are plain triangle indices, so meshes with several sub
+ * shapes still go through the external NifMopp.dll, which is compiled with
+ * the Havok SDK and only available on Windows.
  *
  * Most classes here inherit from the Spell class.
  */
@@ -65,31 +73,6 @@ public:
 		return (GenerateMoppCode && RetrieveMoppCode && RetrieveMoppScale && RetrieveMoppOrigin);
 	}
 
-	QByteArray CalculateMoppCode( QVector<Vector3> const & verts, QVector<Triangle> const & tris, Vector3 * origin, float * scale )
-	{
-		QByteArray code;
-
-		if ( Initialize() ) {
-			int len = GenerateMoppCode( verts.size(), &verts[0], tris.size(), &tris[0] );
-
-			if ( len > 0 ) {
-				code.resize( len );
-
-				if ( 0 != RetrieveMoppCode( len, code.data() ) ) {
-					if ( scale )
-						RetrieveMoppScale( scale );
-
-					if ( origin )
-						RetrieveMoppOrigin( origin );
-				} else {
-					code.clear();
-				}
-			}
-		}
-
-		return code;
-	}
-
 	QByteArray CalculateMoppCode( QVector<int> const & subShapesVerts,
 	                              QVector<Vector3> const & verts,
 	                              QVector<Triangle> const & tris,
@@ -125,6 +108,22 @@ public:
 }
 TheHavokCode;
 
+#endif // Q_OS_WIN32
+
+//! Collision mesh of a bhkMoppBvTreeShape, for generating its code off the main thread
+struct MoppJob
+{
+	QPersistentModelIndex iMoppBvTree;
+
+	QVector<Vector3> verts;
+	QVector<Triangle> triangles;
+	QVector<int> subshapeVerts;
+
+	QByteArray code;
+	Vector3 origin;
+	float scale = 1.0f;
+};
+
 //! Update Havok MOPP for a given shape
 class spMoppCode final : public Spell
 {
@@ -137,101 +136,156 @@ public:
 		if ( nif->getUserVersion() != 10 && nif->getUserVersion() != 11 )
 			return false;
 
-		if ( TheHavokCode.Initialize() ) {
-			//QModelIndex iData = nif->getBlock( nif->getLink( index, "Data" ) );
-
-			if ( nif->isNiBlock( index, "bhkMoppBvTreeShape" ) ) {
-				return ( nif->checkVersion( 0x14000004, 0x14000005 )
-				         || nif->checkVersion( 0x14020007, 0x14020007 ) );
-			}
+		if ( nif->isNiBlock( index, "bhkMoppBvTreeShape" ) ) {
+			return ( nif->checkVersion( 0x14000004, 0x14000005 )
+			         || nif->checkVersion( 0x14020007, 0x14020007 ) );
 		}
 
 		return false;
 	}
 
-	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock ) override final
+	//! Read the collision mesh of a bhkMoppBvTreeShape, returns false if unsupported
+	static bool readJob( const NifModel * nif, const QModelIndex & iBlock, MoppJob & job )
 	{
-		if ( !TheHavokCode.Initialize() ) {
-			Message::critical( nullptr, Spell::tr( "Unable to locate NifMopp.dll" ) );
-			return iBlock;
-		}
-
-		QPersistentModelIndex ibhkMoppBvTreeShape = iBlock;
-
-		QModelIndex ibhkPackedNiTriStripsShape = nif->getBlock( nif->getLink( ibhkMoppBvTreeShape, "Shape" ) );
+		QModelIndex ibhkPackedNiTriStripsShape = nif->getBlock( nif->getLink( iBlock, "Shape" ) );
 
 		if ( !nif->isNiBlock( ibhkPackedNiTriStripsShape, "bhkPackedNiTriStripsShape" ) ) {
-			Message::warning( nullptr, Spell::tr( "Only bhkPackedNiTriStripsShape is supported at this time." ) );
-			return iBlock;
+			Message::append( Spell::tr( "Update MOPP Code failed on one or more blocks." ),
+				Spell::tr( "Block %1: Only bhkPackedNiTriStripsShape is supported at this time." ).arg( nif->getBlockNumber( iBlock ) )
+			);
+			return false;
 		}
 
 		QModelIndex ihkPackedNiTriStripsData = nif->getBlock( nif->getLink( ibhkPackedNiTriStripsShape, "Data" ) );
 
 		if ( !nif->isNiBlock( ihkPackedNiTriStripsData, "hkPackedNiTriStripsData" ) )
-			return iBlock;
+			return false;
 
-		QVector<int> subshapeVerts;
+		job.iMoppBvTree = iBlock;
 
-		if ( nif->checkVersion( 0x14000004, 0x14000005 ) ) {
-			int nSubShapes = nif->get<int>( ibhkPackedNiTriStripsShape, "Num Sub Shapes" );
-			QModelIndex ihkSubShapes = nif->getIndex( ibhkPackedNiTriStripsShape, "Sub Shapes" );
-			subshapeVerts.resize( nSubShapes );
+		QModelIndex iSubShapeParent;
+		if ( nif->checkVersion( 0x14000004, 0x14000005 ) )
+			iSubShapeParent = ibhkPackedNiTriStripsShape;
+		else if ( nif->checkVersion( 0x14020007, 0x14020007 ) )
+			iSubShapeParent = ihkPackedNiTriStripsData;
 
-			for ( int t = 0; t < nSubShapes; t++ ) {
-				subshapeVerts[t] = nif->get<int>( ihkSubShapes.child( t, 0 ), "Num Vertices" );
-			}
-		} else if ( nif->checkVersion( 0x14020007, 0x14020007 ) ) {
-			int nSubShapes = nif->get<int>( ihkPackedNiTriStripsData, "Num Sub Shapes" );
-			QModelIndex ihkSubShapes = nif->getIndex( ihkPackedNiTriStripsData, "Sub Shapes" );
-			subshapeVerts.resize( nSubShapes );
+		if ( iSubShapeParent.isValid() ) {
+			int nSubShapes = nif->get<int>( iSubShapeParent, "Num Sub Shapes" );
+			QModelIndex ihkSubShapes = nif->getIndex( iSubShapeParent, "Sub Shapes" );
+			job.subshapeVerts.resize( nSubShapes );
 
 			for ( int t = 0; t < nSubShapes; t++ ) {
-				subshapeVerts[t] = nif->get<int>( ihkSubShapes.child( t, 0 ), "Num Vertices" );
+				job.subshapeVerts[t] = nif->get<int>( ihkSubShapes.child( t, 0 ), "Num Vertices" );
 			}
 		}
 
-		QVector<Vector3> verts = nif->getArray<Vector3>( ihkPackedNiTriStripsData, "Vertices" );
-		QVector<Triangle> triangles;
+		job.verts = nif->getArray<Vector3>( ihkPackedNiTriStripsData, "Vertices" );
 
 		int nTriangles = nif->get<int>( ihkPackedNiTriStripsData, "Num Triangles" );
 		QModelIndex iTriangles = nif->getIndex( ihkPackedNiTriStripsData, "Triangles" );
-		triangles.resize( nTriangles );
+		job.triangles.resize( nTriangles );
 
 		for ( int t = 0; t < nTriangles; t++ ) {
-			triangles[t] = nif->get<Triangle>( iTriangles.child( t, 0 ), "Triangle" );
+			job.triangles[t] = nif->get<Triangle>( iTriangles.child( t, 0 ), "Triangle" );
+		}
+
+		if ( job.verts.isEmpty() || job.triangles.isEmpty() ) {
+			Message::append( Spell::tr( "Update MOPP Code failed on one or more blocks." ),
+				Spell::tr( "Block %1: Insufficient data to calculate MOPP code. Vertices: %2, Triangles: %3" )
+				.arg( nif->getBlockNumber( iBlock ) ).arg( job.verts.count() ).arg( job.triangles.count() )
+			);
+			return false;
 		}
 
-		if ( verts.isEmpty() || triangles.isEmpty() ) {
-			Message::critical( nullptr, Spell::tr( "Insufficient data to calculate MOPP code" ),
-				Spell::tr("Vertices: %1, Triangles: %2").arg( !verts.isEmpty() ).arg( !triangles.isEmpty() )
+		return true;
+	}
+
+	//! Generate the code natively and check that it holds every triangle exactly once
+	static void generateJob( MoppJob & job )
+	{
+		job.code = generateMoppCode( job.verts, job.triangles, job.origin, job.scale );
+
+		if ( !checkMoppCode( job.code, job.origin, job.scale, job.verts, job.triangles ) )
+			job.code.clear();
+	}
+
+	//! Write the generated code to its bhkMoppBvTreeShape
+	static void writeJob( NifModel * nif, const MoppJob & job )
+	{
+		if ( job.code.isEmpty() ) {
+			Message::append( Spell::tr( "Update MOPP Code failed on one or more blocks." ),
+				Spell::tr( "Block %1: Failed to generate MOPP code" ).arg( nif->getBlockNumber( job.iMoppBvTree ) )
 			);
-			return iBlock;
+			return;
+		}
+
+		QModelIndex ibhkMoppBvTreeShape = job.iMoppBvTree;
+
+		QModelIndex iCodeOrigin = nif->getIndex( ibhkMoppBvTreeShape, "Origin" );
+		nif->set<Vector3>( iCodeOrigin, job.origin );
+
+		QModelIndex iCodeScale = nif->getIndex( ibhkMoppBvTreeShape, "Scale" );
+		nif->set<float>( iCodeScale, job.scale );
+
+		QModelIndex iCodeSize = nif->getIndex( ibhkMoppBvTreeShape, "MOPP Data Size" );
+		QModelIndex iCode = nif->getIndex( ibhkMoppBvTreeShape, "MOPP Data" ).child( 0, 0 );
+
+		if ( iCodeSize.isValid() && iCode.isValid() ) {
+			nif->set<int>( iCodeSize, job.code.size() );
+			nif->updateArray( iCode );
+			nif->set<QByteArray>( iCode, job.code );
 		}
+	}
 
-		Vector3 origin;
-		float scale;
-		QByteArray moppcode = TheHavokCode.CalculateMoppCode( subshapeVerts, verts, triangles, &origin, &scale );
+	//! Update the MOPP code of several shapes, generating them concurrently
+	static void updateMoppCodes( NifModel * nif, const QList<QPersistentModelIndex> & shapes )
+	{
+		QVector<MoppJob> jobs;
+		jobs.reserve( shapes.count() );
 
-		if ( moppcode.size() == 0 ) {
-			Message::critical( nullptr, Spell::tr( "Failed to generate MOPP code" ) );
-		} else {
-			QModelIndex iCodeOrigin = nif->getIndex( ibhkMoppBvTreeShape, "Origin" );
-			nif->set<Vector3>( iCodeOrigin, origin );
+		QVector<MoppJob> havokJobs;
 
-			QModelIndex iCodeScale = nif->getIndex( ibhkMoppBvTreeShape, "Scale" );
-			nif->set<float>( iCodeScale, scale );
+		for ( const QModelIndex & idx : shapes ) {
+			MoppJob job;
+			if ( !readJob( nif, idx, job ) )
+				continue;
+
+			// The native keys do not encode sub shapes yet
+			if ( job.subshapeVerts.count() > 1 )
+				havokJobs.append( job );
+			else
+				jobs.append( job );
+		}
 
-			QModelIndex iCodeSize = nif->getIndex( ibhkMoppBvTreeShape, "MOPP Data Size" );
-			QModelIndex iCode = nif->getIndex( ibhkMoppBvTreeShape, "MOPP Data" ).child( 0, 0 );
+		QtConcurrent::blockingMap( jobs, &spMoppCode::generateJob );
 
-			if ( iCodeSize.isValid() && iCode.isValid() ) {
-				nif->set<int>( iCodeSize, moppcode.size() );
-				nif->updateArray( iCode );
-				nif->set<QByteArray>( iCode, moppcode );
+		for ( MoppJob & job : havokJobs ) {
+#ifdef Q_OS_WIN32
+			if ( TheHavokCode.Initialize() ) {
+				job.code = TheHavokCode.CalculateMoppCode( job.subshapeVerts, job.verts, job.triangles, &job.origin, &job.scale );
+				jobs.append( job );
+				continue;
 			}
+#endif
+			Message::append( Spell::tr( "Update MOPP Code failed on one or more blocks." ),
+				Spell::tr( "Block %1: Shapes with %2 sub shapes require NifMopp.dll" )
+				.arg( nif->getBlockNumber( job.iMoppBvTree ) ).arg( job.subshapeVerts.count() )
+			);
 		}
 
-		return iBlock;
+		nif->beginBatch();
+		for ( const MoppJob & job : jobs )
+			writeJob( nif, job );
+		nif->endBatch();
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock ) override final
+	{
+		QPersistentModelIndex ibhkMoppBvTreeShape = iBlock;
+
+		updateMoppCodes( nif, { ibhkMoppBvTreeShape } );
+
+		return ibhkMoppBvTreeShape;
 	}
 };
 
@@ -249,11 +303,9 @@ public:
 		if ( nif && nif->getUserVersion() != 10 && nif->getUserVersion() != 11 )
 			return false;
 
-		if ( TheHavokCode.Initialize() ) {
-			if ( nif && !idx.isValid() ) {
-				return ( nif->checkVersion( 0x14000004, 0x14000005 )
-				         || nif->checkVersion( 0x14020007, 0x14020007 ) );
-			}
+		if ( nif && !idx.isValid() ) {
+			return ( nif->checkVersion( 0x14000004, 0x14000005 )
+			         || nif->checkVersion( 0x14020007, 0x14020007 ) );
 		}
 
 		return false;
@@ -272,15 +324,10 @@ public:
 				indices << idx;
 		}
 
-		for ( const QModelIndex& idx : indices ) {
-			TSpacer.castIfApplicable( nif, idx );
-		}
+		spMoppCode::updateMoppCodes( nif, indices );
 
 		return QModelIndex();
 	}
 };
 
 REGISTER_SPELL( spAllMoppCodes )
-
-#endif // Q_OS_WIN32
-
@@ -54,7 +54,7 @@ public:
 				nif->setArray( iFrames.child( 0, 0 ), "Vectors", verts );
 				verts.fill( Vector3() );
 
-				for ( int f = 1; f < nif->rowCount( iFrames ); f++ ) {
+				for ( int f = 1; f < nif->childCount( iFrames ); f++ ) {
 					nif->updateArray( iFrames.child( f, 0 ), "Vectors" );
 					nif->setArray<Vector3>( iFrames.child( f, 0 ), "Vectors", verts );
 				}
@@ -110,7 +110,7 @@ public:
 		if ( iFrames.isValid() ) {
 			QStringList list;
 
-			for ( int i = 0; i < nif->rowCount( iFrames ); i++ ) {
+			for ( int i = 0; i < nif->childCount( iFrames ); i++ ) {
 				list << nif->get<QString>( iFrames.child( i, 0 ), "Frame Name" );
 			}
 
@@ -1,12 +1,16 @@
 #include "spellbook.h"
 
-#include "lib/nvtristripwrapper.h"
+#include "lib/smoothnormals.h"
+#include "lib/stripify.h"
 
+#include <QComboBox>
 #include <QDialog>
 #include <QDoubleSpinBox>
 #include <QLabel>
 #include <QLayout>
 #include <QPushButton>
+#include <QSettings>
+#include <QtConcurrent/QtConcurrentMap>
 
 
 // Brief description is deliberately not autolinked to class Spell
@@ -84,7 +88,7 @@ public:
 			if ( iPoints.isValid() ) {
 				QVector<QVector<quint16> > strips;
 
-				for ( int r = 0; r < nif->rowCount( iPoints ); r++ )
+				for ( int r = 0; r < nif->childCount( iPoints ); r++ )
 					strips.append( nif->getArray<quint16>( iPoints.child( r, 0 ) ) );
 
 				triangles = triangulate( strips );
@@ -132,11 +136,11 @@ public:
 			faceNormals( verts, triangles, norms );
 
 			// Pause updates between model/view
-			nif->setState( BaseModel::Processing );
+			nif->beginBatch();
 			for ( int i = 0; i < numVerts; i++ ) {
 				nif->set<ByteVector3>( nif->index( i, 0, iData ), "Normal", norms[i] );
 			}
-			nif->resetState();
+			nif->endBatch();
 		}
 
 		return index;
@@ -175,6 +179,17 @@ public:
 
 REGISTER_SPELL( spFlipNormals )
 
+//! Shape data for smoothing its normals off the main thread
+struct SmoothJob
+{
+	QPersistentModelIndex iShape;
+	QPersistentModelIndex iData;
+
+	QVector<Vector3> verts;
+	QVector<Vector3> norms;
+	QVector<Triangle> triangles;
+};
+
 //! Smooths the normals of a mesh
 class spSmoothNormals final : public Spell
 {
@@ -187,42 +202,11 @@ public:
 		return spFaceNormals::getShapeData( nif, index ).isValid();
 	}
 
-	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	//! Ask for the smoothing options, returns false if cancelled
+	static bool getOptions( float & maxAngle, float & maxDist, NormalWeighting & weighting )
 	{
-		QModelIndex iData = spFaceNormals::getShapeData( nif, index );
-
-		QVector<Vector3> verts;
-		QVector<Vector3> norms;
-
-		int numVerts = 0;
-
-		if ( nif->getUserVersion2() < 100 ) {
-			verts = nif->getArray<Vector3>( iData, "Vertices" );
-			norms = nif->getArray<Vector3>( iData, "Normals" );
-		} else {
-			auto vf = nif->get<BSVertexDesc>( index, "Vertex Desc" );
-			if ( !((vf & VertexFlags::VF_SKINNED) && nif->getUserVersion2() == 100) ) {
-				numVerts = nif->get<int>( index, "Num Vertices" );
-			} else {
-				// Skinned SSE
-				// "Num Vertices" does not exist in the partition
-				auto iPart = iData.parent();
-				numVerts = nif->get<uint>( iPart, "Data Size" ) / nif->get<uint>( iPart, "Vertex Size" );
-			}
-
-			verts.reserve( numVerts );
-			norms.reserve( numVerts );
-
-			for ( int i = 0; i < numVerts; i++ ) {
-				auto idx = nif->index( i, 0, iData );
-
-				verts += nif->get<Vector3>( idx, "Vertex" );
-				norms += nif->get<ByteVector3>( idx, "Normal" );
-			}
-		}
-
-		if ( verts.isEmpty() || verts.count() != norms.count() )
-			return index;
+		QSettings settings;
+		QString key = QString( "%1/%2/%3/" ).arg( "Spells", Spell::tr( "Mesh" ), Spell::tr( "Smooth Normals" ) );
 
 		QDialog dlg;
 		dlg.setWindowTitle( Spell::tr( "Smooth Normals" ) );
@@ -232,7 +216,7 @@ public:
 
 		QDoubleSpinBox * angle = new QDoubleSpinBox;
 		angle->setRange( 0, 180 );
-		angle->setValue( 60 );
+		angle->setValue( settings.value( key + "Max Smooth Angle", 60.0 ).toDouble() );
 		angle->setSingleStep( 5 );
 
 		grid->addWidget( new QLabel( Spell::tr( "Max Smooth Angle" ) ), 0, 0 );
@@ -242,11 +226,20 @@ public:
 		dist->setRange( 0, 1 );
 		dist->setDecimals( 4 );
 		dist->setSingleStep( 0.01 );
-		dist->setValue( 0.001 );
+		dist->setValue( settings.value( key + "Max Vertex Distance", 0.001 ).toDouble() );
 
 		grid->addWidget( new QLabel( Spell::tr( "Max Vertex Distance" ) ), 1, 0 );
 		grid->addWidget( dist, 1, 1 );
 
+		QComboBox * weight = new QComboBox;
+		weight->addItem( Spell::tr( "Equal" ), int( NormalWeighting::Equal ) );
+		weight->addItem( Spell::tr( "Face Area" ), int( NormalWeighting::Area ) );
+		weight->addItem( Spell::tr( "Corner Angle" ), int( NormalWeighting::Angle ) );
+		weight->setCurrentIndex( weight->findData( settings.value( key + "Weighting", int( NormalWeighting::Angle ) ).toInt() ) );
+
+		grid->addWidget( new QLabel( Spell::tr( "Weighting" ) ), 2, 0 );
+		grid->addWidget( weight, 2, 1 );
+
 		QPushButton * btOk = new QPushButton;
 		btOk->setText( Spell::tr( "Smooth" ) );
 		QObject::connect( btOk, &QPushButton::clicked, &dlg, &QDialog::accept );
@@ -255,56 +248,171 @@ public:
 		btCancel->setText( Spell::tr( "Cancel" ) );
 		QObject::connect( btCancel, &QPushButton::clicked, &dlg, &QDialog::reject );
 
-		grid->addWidget( btOk, 2, 0 );
-		grid->addWidget( btCancel, 2, 1 );
+		grid->addWidget( btOk, 3, 0 );
+		grid->addWidget( btCancel, 3, 1 );
 
 		if ( dlg.exec() != QDialog::Accepted )
-			return index;
+			return false;
 
+		settings.setValue( key + "Max Smooth Angle", angle->value() );
+		settings.setValue( key + "Max Vertex Distance", dist->value() );
+		settings.setValue( key + "Weighting", weight->currentData() );
 
-		float maxa = angle->value() / 180 * PI;
-		float maxd = dist->value();
+		maxAngle = angle->value() / 180 * PI;
+		maxDist = dist->value();
+		weighting = NormalWeighting( weight->currentData().toInt() );
 
-		QVector<Vector3> snorms( norms );
+		return true;
+	}
 
-		for ( int i = 0; i < verts.count(); i++ ) {
-			const Vector3 & a = verts[i];
-			Vector3 an = norms[i];
+	//! Read the vertices, normals and triangles of a shape
+	static bool readShape( const NifModel * nif, const QModelIndex & index, SmoothJob & job )
+	{
+		QModelIndex iData = spFaceNormals::getShapeData( nif, index );
 
-			for ( int j = i + 1; j < verts.count(); j++ ) {
-				const Vector3 & b = verts[j];
+		job.iShape = index;
+		job.iData = iData;
 
-				if ( ( a - b ).squaredLength() < maxd ) {
-					Vector3 bn = norms[j];
+		QVector<Vector3> & verts = job.verts;
+		QVector<Vector3> & norms = job.norms;
+		QVector<Triangle> & triangles = job.triangles;
 
-					if ( Vector3::angle( an, bn ) < maxa ) {
-						snorms[i] += bn;
-						snorms[j] += an;
-					}
-				}
+		if ( nif->getUserVersion2() < 100 ) {
+			verts = nif->getArray<Vector3>( iData, "Vertices" );
+			norms = nif->getArray<Vector3>( iData, "Normals" );
+
+			QModelIndex iPoints = nif->getIndex( iData, "Points" );
+
+			if ( iPoints.isValid() ) {
+				QVector<QVector<quint16> > strips;
+
+				for ( int r = 0; r < nif->childCount( iPoints ); r++ )
+					strips.append( nif->getArray<quint16>( iPoints.child( r, 0 ) ) );
+
+				triangles = triangulate( strips );
+			} else {
+				triangles = nif->getArray<Triangle>( iData, "Triangles" );
+			}
+		} else {
+			int numVerts = 0;
+
+			auto vf = nif->get<BSVertexDesc>( index, "Vertex Desc" );
+			if ( !((vf & VertexFlags::VF_SKINNED) && nif->getUserVersion2() == 100) ) {
+				numVerts = nif->get<int>( index, "Num Vertices" );
+				triangles = nif->getArray<Triangle>( index, "Triangles" );
+			} else {
+				// Skinned SSE
+				// "Num Vertices" does not exist in the partition
+				auto iPart = iData.parent();
+				numVerts = nif->get<uint>( iPart, "Data Size" ) / nif->get<uint>( iPart, "Vertex Size" );
+
+				// Get triangles from all partitions
+				auto numParts = nif->get<int>( iPart, "Num Skin Partition Blocks" );
+				auto iParts = nif->getIndex( iPart, "Partition" );
+				for ( int i = 0; i < numParts; i++ )
+					triangles << nif->getArray<Triangle>( iParts.child( i, 0 ), "Triangles" );
+			}
+
+			verts.reserve( numVerts );
+			norms.reserve( numVerts );
+
+			for ( int i = 0; i < numVerts; i++ ) {
+				auto idx = nif->index( i, 0, iData );
+
+				verts += nif->get<Vector3>( idx, "Vertex" );
+				norms += nif->get<ByteVector3>( idx, "Normal" );
 			}
 		}
 
-		for ( int i = 0; i < verts.count(); i++ )
-			snorms[i].normalize();
+		return !verts.isEmpty() && verts.count() == norms.count();
+	}
 
+	//! Write the smoothed normals back to a shape
+	static void writeShape( NifModel * nif, const SmoothJob & job )
+	{
 		if ( nif->getUserVersion2() < 100 ) {
-			nif->setArray<Vector3>( iData, "Normals", snorms );
+			nif->setArray<Vector3>( job.iData, "Normals", job.norms );
 		} else {
-			// Pause updates between model/view
-			nif->setState( BaseModel::Processing );
-			for ( int i = 0; i < numVerts; i++ )
-				nif->set<ByteVector3>( nif->index( i, 0, iData ), "Normal", snorms[i] );
-			nif->resetState();
+			for ( int i = 0; i < job.norms.count(); i++ )
+				nif->set<ByteVector3>( nif->index( i, 0, job.iData ), "Normal", job.norms[i] );
 		}
-		
+	}
 
+	//! Smooth the normals of several shapes, computing them concurrently
+	static void smoothShapes( NifModel * nif, const QList<QPersistentModelIndex> & shapes )
+	{
+		QVector<SmoothJob> jobs;
+		for ( const QModelIndex & idx : shapes ) {
+			SmoothJob job;
+			if ( readShape( nif, idx, job ) )
+				jobs.append( job );
+		}
+
+		if ( jobs.isEmpty() )
+			return;
+
+		float maxAngle, maxDist;
+		NormalWeighting weighting;
+		if ( !getOptions( maxAngle, maxDist, weighting ) )
+			return;
+
+		auto smooth = [=]( SmoothJob & job, bool parallel ) {
+			job.norms = smoothNormals( job.verts, job.norms, job.triangles, maxAngle, maxDist, weighting, parallel );
+		};
+
+		if ( jobs.count() == 1 )
+			smooth( jobs[0], true );
+		else
+			QtConcurrent::blockingMap( jobs, [&smooth]( SmoothJob & job ) { smooth( job, false ); } );
+
+		// Pause updates between model/view
+		nif->beginBatch();
+		for ( const SmoothJob & job : jobs )
+			writeShape( nif, job );
+		nif->endBatch();
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
+	{
+		smoothShapes( nif, { index } );
 		return index;
 	}
 };
 
 REGISTER_SPELL( spSmoothNormals )
 
+//! Smooths the normals of all meshes
+class spSmoothAllNormals final : public Spell
+{
+public:
+	QString name() const override final { return Spell::tr( "Smooth All Normals" ); }
+	QString page() const override final { return Spell::tr( "Batch" ); }
+
+	bool isApplicable( const NifModel * nif, const QModelIndex & index ) override final
+	{
+		return nif && !index.isValid();
+	}
+
+	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
+	{
+		QList<QPersistentModelIndex> shapes;
+
+		for ( int n = 0; n < nif->getBlockCount(); n++ ) {
+			QModelIndex idx = nif->getBlock( n );
+
+			if ( nif->isNiBlock( idx, { "NiTriShape", "BSLODTriShape", "NiTriStrips", "BSTriShape", "BSMeshLODTriShape", "BSSubIndexTriShape" } )
+				 && spFaceNormals::getShapeData( nif, idx ).isValid() )
+				shapes << idx;
+		}
+
+		spSmoothNormals::smoothShapes( nif, shapes );
+
+		return QModelIndex();
+	}
+};
+
+REGISTER_SPELL( spSmoothAllNormals )
+
 //! Normalises any single Vector3 or array.
 /**
  * Most used on Normals, Bitangents and Tangents.
@@ -416,7 +416,7 @@ public:
 			if ( iA.isValid() != iB.isValid() )
 				return false;
 
-			if ( id == "UV Sets" && nif->rowCount( iA ) != nif->rowCount( iB ) )
+			if ( id == "UV Sets" && nif->childCount( iA ) != nif->childCount( iB ) )
 				return false;
 		}
 		return true;
@@ -446,7 +446,7 @@ public:
 		QModelIndex iUVa = nif->getIndex( iDataA, "UV Sets" );
 		QModelIndex iUVb = nif->getIndex( iDataB, "UV Sets" );
 
-		for ( int r = 0; r < nif->rowCount( iUVa ); r++ ) {
+		for ( int r = 0; r < nif->childCount( iUVa ); r++ ) {
 			nif->updateArray( iUVa.child( r, 0 ) );
 			nif->setArray<Vector2>( iUVa.child( r, 0 ), nif->getArray<Vector2>( iUVa.child( r, 0 ) ).mid( 0, numA ) + nif->getArray<Vector2>( iUVb.child( r, 0 ) ) );
 		}
@@ -498,9 +498,9 @@ REGISTER_SPELL( spCombiTris )
 
 void scan( const QModelIndex & idx, NifModel * nif, QMap<QString, qint32> & usedStrings, bool hasCED )
 {
-	for ( int i = 0; i < nif->rowCount( idx ); i++ ) {
+	for ( int i = 0; i < nif->childCount( idx ); i++ ) {
 		auto child = idx.child( i, 2 );
-		if ( nif->rowCount( child ) > 0 ) {
+		if ( nif->childCount( child ) > 0 ) {
 			scan( child, nif, usedStrings, hasCED );
 			continue;
 		}
@@ -51,7 +51,7 @@ public:
 			if ( iNumChildren.isValid() && iChildren.isValid() ) {
 				QList<QPair<qint32, bool> > links;
 
-				for ( int r = 0; r < nif->rowCount( iChildren ); r++ ) {
+				for ( int r = 0; r < nif->childCount( iChildren ); r++ ) {
 					qint32 l = nif->getLink( iChildren.child( r, 0 ) );
 
 					if ( l >= 0 ) {
@@ -292,7 +292,7 @@ public:
 
 	QModelIndex check( NifModel * nif, const QModelIndex & iParent )
 	{
-		for ( int r = 0; r < nif->rowCount( iParent ); r++ ) {
+		for ( int r = 0; r < nif->childCount( iParent ); r++ ) {
 			QModelIndex idx = iParent.child( r, 0 );
 			bool child;
 
@@ -324,7 +324,7 @@ public:
 				}
 			}
 
-			if ( nif->rowCount( idx ) > 0 ) {
+			if ( nif->childCount( idx ) > 0 ) {
 				QModelIndex x = check( nif, idx );
 
 				if ( x.isValid() )
@@ -548,7 +548,7 @@ public:
 				continue;
 
 			auto controlledBlocks = nif->getIndex( iBlock, "Controlled Blocks" );
-			auto numBlocks = nif->rowCount( controlledBlocks );
+			auto numBlocks = nif->childCount( controlledBlocks );
 
 			for ( int i = 0; i < numBlocks; i++ ) {
 				auto ctrlrType =  nif->getIndex( controlledBlocks.child( i, 0 ), "Controller Type" );
@@ -3,7 +3,9 @@
 #include "spellbook.h"
 #include "gl/gltools.h"
 
-#include "lib/nvtristripwrapper.h"
+#include "lib/boundingvolume.h"
+#include "lib/skinpartition.h"
+#include "lib/stripify.h"
 
 #include <QCheckBox>
 #include <QFile>
@@ -12,6 +14,7 @@
 #include <QMessageBox>
 #include <QPushButton>
 #include <QSpinBox>
+#include <QtConcurrent/QtConcurrentMap>
 
 #include <algorithm> // std::sort
 
@@ -146,7 +149,7 @@ public:
 			iNames = nif->getIndex( iNames, "Bones" );
 
 		if ( iNames.isValid() )
-			for ( int n = 0; n < nif->rowCount( iNames ); n++ ) {
+			for ( int n = 0; n < nif->childCount( iNames ); n++ ) {
 				QModelIndex iBone = nif->getBlock( nif->getLink( iNames.child( n, 0 ) ), "NiNode" );
 
 				if ( iBone.isValid() )
@@ -170,7 +173,7 @@ public:
 		t = tparent * t;
 		t.writeBack( nif, iSkinData );
 
-		for ( int b = 0; b < nif->rowCount( iBones ) && b < names.count(); b++ ) {
+		for ( int b = 0; b < nif->childCount( iBones ) && b < names.count(); b++ ) {
 			QModelIndex iBone = iBones.child( b, 0 );
 
 			t = Transform( nif, iBone );
@@ -234,19 +237,6 @@ public:
 
 //REGISTER_SPELL( spScanSkeleton )
 
-//! Unknown; unused?
-template <> inline bool qMapLessThanKey<Triangle>( const Triangle & s1, const Triangle & s2 )
-{
-	// TODO: This function makes no sense. Doxygen comments seem to think it's unused.
-	int d = 0;
-
-	if ( d == 0 ) d = (s1[0] - s2[0]);
-	if ( d == 0 ) d = (s1[1] - s2[1]);
-	if ( d == 0 ) d = (s1[2] - s2[2]);
-
-	return d < 0;
-}
-
 //! Rotate a Triangle
 inline void qRotate( Triangle & t )
 {
@@ -257,6 +247,41 @@ inline void qRotate( Triangle & t )
 	}
 }
 
+//! Hash key of a rotated Triangle
+inline quint64 triangleKey( Triangle t )
+{
+	qRotate( t );
+	return ( quint64( t[0] ) << 32 ) | ( quint64( t[1] ) << 16 ) | quint64( t[2] );
+}
+
+//! Skin data of a shape, for partitioning it off the main thread
+struct SkinPartitionJob
+{
+	QPersistentModelIndex iShape;
+	QPersistentModelIndex iData;
+	QPersistentModelIndex iSkinInst;
+	QPersistentModelIndex iSkinData;
+	QPersistentModelIndex iSkinPart;
+
+	QVector<Vector3> verts;
+	QVector<QList<BoneWeight> > weights;
+	QVector<Triangle> triangles;
+	//! Partition of every triangle from a BSDismemberSkinInstance, or empty
+	QVector<int> fixed;
+	//! Largest number of influences of a vertex
+	int maxInfluences = 0;
+
+	QVector<SkinPartition> parts;
+	//! Vertex map of every partition
+	QVector<QVector<int> > vertexMaps;
+	//! Strips of every partition, if requested
+	QVector<QVector<QVector<quint16> > > strips;
+
+	int reducedVertices = 0;
+	int removedInfluences = 0;
+	QString error;
+};
+
 //! Make skin partition
 class spSkinPartition final : public Spell
 {
@@ -277,7 +302,7 @@ public:
 		return false;
 	}
 
-	typedef QPair<int, float> boneweight;
+	typedef BoneWeight boneweight;
 
 	//! Helper for sorting a boneweight list
 	struct boneweight_equivalence
@@ -300,702 +325,475 @@ public:
 		}
 	};
 
-	//! A bone and Triangle set
-	typedef struct
-	{
-		QList<int> bones;
-		QVector<Triangle> triangles;
-	} Partition;
-
 	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock ) override final
 	{
 		int mbpp = 0, mbpv = 0;
-		bool make_strips = false;
-		return cast( nif, iBlock, mbpp, mbpv, make_strips );
+		bool make_strips = false, pad = false;
+		partition( nif, { iBlock }, mbpp, mbpv, make_strips, pad );
+		return iBlock;
 	}
 
-	//! Cast with extra parameters
-	QModelIndex cast( NifModel * nif, const QModelIndex & iBlock, int & maxBonesPerPartition, int & maxBonesPerVertex, bool make_strips, bool pad = false )
+	/*! Partition several shapes, computing the partitions concurrently
+	 *
+	 * The options are asked for if @p maxBonesPerPartition or @p maxBonesPerVertex is not set.
+	 */
+	static void partition( NifModel * nif, const QList<QPersistentModelIndex> & shapes,
+						   int & maxBonesPerPartition, int & maxBonesPerVertex, bool & make_strips, bool & pad )
 	{
-		QPersistentModelIndex iShape = iBlock;
-		QString iShapeType = "";
+		QVector<SkinPartitionJob> jobs;
+		int maxBones = 0;
 
-		if ( nif->isNiBlock( iShape, "NiTriShape" ) ) {
-			iShapeType = "NiTriShape";
-		} else if ( nif->isNiBlock( iShape, "NiTriStrips" ) ) {
-			iShapeType = "NiTriStrips";
-		}
+		for ( const QModelIndex & iShape : shapes ) {
+			SkinPartitionJob job;
 
-		try
-		{
-			QPersistentModelIndex iData;
+			try
+			{
+				readJob( nif, iShape, job );
+			}
+			catch ( QString & err )
+			{
+				if ( !err.isEmpty() )
+					QMessageBox::warning( 0, "NifSkope", err );
 
-			if ( iShapeType == "NiTriShape" ) {
-				iData = nif->getBlock( nif->getLink( iShape, "Data" ), "NiTriShapeData" );
-			} else if ( iShapeType == "NiTriStrips" ) {
-				iData = nif->getBlock( nif->getLink( iShape, "Data" ), "NiTriStripsData" );
+				continue;
 			}
 
-			QPersistentModelIndex iSkinInst = nif->getBlock( nif->getLink( iShape, "Skin Instance" ), "NiSkinInstance" );
-			QPersistentModelIndex iSkinData = nif->getBlock( nif->getLink( iSkinInst, "Data" ), "NiSkinData" );
-			QModelIndex iSkinPart = nif->getBlock( nif->getLink( iSkinInst, "Skin Partition" ), "NiSkinPartition" );
+			maxBones = std::max( maxBones, job.maxInfluences );
+			jobs.append( job );
+		}
 
-			if ( !iSkinPart.isValid() )
-				iSkinPart = nif->getBlock( nif->getLink( iSkinData, "Skin Partition" ), "NiSkinPartition" );
+		if ( jobs.isEmpty() )
+			return;
 
-			// read in the weights from NiSkinData
+		// query max bones per vertex/partition
 
-			int numVerts = nif->get<int>( iData, "Num Vertices" );
-			QVector<QList<boneweight> > weights( numVerts );
+		if ( maxBonesPerPartition <= 0 || maxBonesPerVertex <= 0 ) {
+			SkinPartitionDialog dlg( maxBones );
 
-			QModelIndex iBoneList = nif->getIndex( iSkinData, "Bone List" );
-			int numBones = nif->rowCount( iBoneList );
+			if ( dlg.exec() != QDialog::Accepted )
+				return;
 
-			for ( int bone = 0; bone < numBones; bone++ ) {
-				QModelIndex iVertexWeights = nif->getIndex( iBoneList.child( bone, 0 ), "Vertex Weights" );
+			maxBonesPerPartition = dlg.maxBonesPerPartition();
+			maxBonesPerVertex = dlg.maxBonesPerVertex();
+			make_strips = dlg.makeStrips();
+			pad = dlg.padPartitions();
+		}
 
-				for ( int r = 0; r < nif->rowCount( iVertexWeights ); r++ ) {
-					int vertex = nif->get<int>( iVertexWeights.child( r, 0 ), "Index" );
-					float weight = nif->get<float>( iVertexWeights.child( r, 0 ), "Weight" );
+		int mbpp = maxBonesPerPartition, mbpv = maxBonesPerVertex;
+		bool strips = make_strips;
 
-					if ( vertex >= weights.count() )
-						throw QString( Spell::tr( "bad NiSkinData - vertex count does not match" ) );
+		QtConcurrent::blockingMap( jobs, [mbpp, mbpv, strips]( SkinPartitionJob & job ) {
+			computeJob( job, mbpp, mbpv, strips );
+		} );
 
-					weights[vertex].append( boneweight( bone, weight ) );
-				}
+		nif->beginBatch();
+		for ( const SkinPartitionJob & job : jobs ) {
+			if ( !job.error.isEmpty() ) {
+				QMessageBox::warning( 0, "NifSkope", job.error );
+				continue;
 			}
 
-			// count min and max bones per vertex
-
-			int minBones, maxBones;
-			minBones = maxBones = weights.value( 0 ).count();
-			for ( const QList<boneweight> list : weights ) {
-				if ( list.count() < minBones )
-					minBones = list.count();
+			if ( job.reducedVertices > 0 )
+				qCWarning( nsSpell ) << Spell::tr( "Reduced %1 vertices to %2 bone influences (maximum number of bones per vertex was %3)" )
+					.arg( job.reducedVertices )
+					.arg( mbpv )
+					.arg( job.maxInfluences );
 
-				if ( list.count() > maxBones )
-					maxBones = list.count();
-			}
+			if ( job.removedInfluences > 0 )
+				qCWarning( nsSpell ) << Spell::tr( "Removed %1 bone influences" ).arg( job.removedInfluences );
 
-			if ( minBones <= 0 )
-				throw QString( Spell::tr( "bad NiSkinData - some vertices have no weights at all" ) );
+			writeJob( nif, job, mbpp, mbpv, strips, pad );
+		}
+		nif->endBatch();
+	}
 
-			// query max bones per vertex/partition
+	//! Read the skin data of a shape, throws a QString on bad data
+	static void readJob( const NifModel * nif, const QModelIndex & iShape, SkinPartitionJob & job )
+	{
+		bool isStrips = nif->isNiBlock( iShape, "NiTriStrips" );
 
-			if ( maxBonesPerPartition <= 0 || maxBonesPerVertex <= 0 ) {
-				SkinPartitionDialog dlg( maxBones );
+		QPersistentModelIndex iData = nif->getBlock( nif->getLink( iShape, "Data" ), isStrips ? "NiTriStripsData" : "NiTriShapeData" );
 
-				if ( dlg.exec() != QDialog::Accepted )
-					return iBlock;
+		QPersistentModelIndex iSkinInst = nif->getBlock( nif->getLink( iShape, "Skin Instance" ), "NiSkinInstance" );
+		QPersistentModelIndex iSkinData = nif->getBlock( nif->getLink( iSkinInst, "Data" ), "NiSkinData" );
+		QModelIndex iSkinPart = nif->getBlock( nif->getLink( iSkinInst, "Skin Partition" ), "NiSkinPartition" );
 
-				maxBonesPerPartition = dlg.maxBonesPerPartition();
-				maxBonesPerVertex = dlg.maxBonesPerVertex();
-				make_strips = dlg.makeStrips();
-				pad = dlg.padPartitions();
-			}
+		if ( !iSkinPart.isValid() )
+			iSkinPart = nif->getBlock( nif->getLink( iSkinData, "Skin Partition" ), "NiSkinPartition" );
 
-			// reduce vertex influences if necessary
+		job.iShape = iShape;
+		job.iData = iData;
+		job.iSkinInst = iSkinInst;
+		job.iSkinData = iSkinData;
+		job.iSkinPart = iSkinPart;
 
-			if ( maxBones > maxBonesPerVertex ) {
-				QMutableVectorIterator<QList<boneweight> > it( weights );
-				int c = 0;
+		// read in the weights from NiSkinData
 
-				while ( it.hasNext() ) {
-					QList<boneweight> & lst = it.next();
-					std::sort( lst.begin(), lst.end(), boneweight_equivalence() );
+		int numVerts = nif->get<int>( iData, "Num Vertices" );
+		QVector<QList<boneweight> > & weights = job.weights;
+		weights.resize( numVerts );
 
-					if ( lst.count() > maxBonesPerVertex )
-						c++;
+		QModelIndex iBoneList = nif->getIndex( iSkinData, "Bone List" );
+		int numBones = nif->childCount( iBoneList );
 
-					while ( lst.count() > maxBonesPerVertex ) {
-						lst.removeLast();
-					}
+		for ( int bone = 0; bone < numBones; bone++ ) {
+			QModelIndex iVertexWeights = nif->getIndex( iBoneList.child( bone, 0 ), "Vertex Weights" );
 
-					float totalWeight = 0;
-					for ( const auto bw : lst ) {
-						totalWeight += bw.second;
-					}
+			for ( int r = 0; r < nif->childCount( iVertexWeights ); r++ ) {
+				int vertex = nif->get<int>( iVertexWeights.child( r, 0 ), "Index" );
+				float weight = nif->get<float>( iVertexWeights.child( r, 0 ), "Weight" );
 
-					for ( int b = 0; b < lst.count(); b++ ) {
-						// normalize
-						lst[b].second /= totalWeight;
-					}
-				}
+				if ( vertex >= weights.count() )
+					throw QString( Spell::tr( "bad NiSkinData - vertex count does not match" ) );
 
-				qCWarning( nsSpell ) << Spell::tr( "Reduced %1 vertices to %2 bone influences (maximum number of bones per vertex was %3)" )
-					.arg( c )
-					.arg( maxBonesPerVertex )
-					.arg( maxBones );
+				weights[vertex].append( boneweight( bone, weight ) );
 			}
+		}
+
+		// count min and max bones per vertex
 
-			maxBones = maxBonesPerVertex;
+		int minBones, maxBones;
+		minBones = maxBones = weights.value( 0 ).count();
+		for ( const QList<boneweight> & list : weights ) {
+			if ( list.count() < minBones )
+				minBones = list.count();
 
-			// reduces bone weights so that the triangles fit into the partitions
+			if ( list.count() > maxBones )
+				maxBones = list.count();
+		}
 
-			QList<Triangle> triangles;
+		if ( minBones <= 0 )
+			throw QString( Spell::tr( "bad NiSkinData - some vertices have no weights at all" ) );
 
-			if ( iShapeType == "NiTriShape" ) {
-				triangles = nif->getArray<Triangle>( iData, "Triangles" ).toList();
-			} else if ( iShapeType == "NiTriStrips" ) {
-				// triangulate first (code copied from strippify.cpp)
-				QVector<QVector<quint16> > strips;
-				QModelIndex iPoints = nif->getIndex( iData, "Points" );
+		job.maxInfluences = maxBones;
 
-				for ( int s = 0; s < nif->rowCount( iPoints ); s++ ) {
-					QVector<quint16> strip;
-					QModelIndex iStrip = iPoints.child( s, 0 );
+		job.verts = nif->getArray<Vector3>( iData, "Vertices" );
 
-					for ( int p = 0; p < nif->rowCount( iStrip ); p++ ) {
-						strip.append( nif->get<int>( iStrip.child( p, 0 ) ) );
-					}
+		if ( !isStrips ) {
+			job.triangles = nif->getArray<Triangle>( iData, "Triangles" );
+		} else {
+			job.triangles = triangulate( readStrips( nif, nif->getIndex( iData, "Points" ) ) );
+		}
 
-					strips.append( strip );
-				}
+		if ( job.verts.count() != numVerts )
+			throw QString( Spell::tr( "bad NiSkinData - vertex count does not match" ) );
 
-				triangles = triangulate( strips ).toList();
-			}
+		for ( const Triangle & tri : job.triangles ) {
+			if ( tri[0] >= numVerts || tri[1] >= numVerts || tri[2] >= numVerts )
+				throw QString( Spell::tr( "bad triangle data - vertex index out of range" ) );
+		}
 
-			QMap<Triangle, quint32> trimap;
+		if ( nif->inherits( iSkinInst, "BSDismemberSkinInstance" ) ) {
+			QHash<quint64, quint32> trimap;
 			quint32 defaultPart = 0;
 
-			if ( nif->inherits( iSkinInst, "BSDismemberSkinInstance" ) ) {
-				// First find a partition to dump dangling faces.  Torso is prefered if available.
-				quint32 nparts = nif->get<uint>( iSkinInst, "Num Partitions" );
-				QModelIndex iPartData = nif->getIndex( iSkinInst, "Partitions" );
+			// First find a partition to dump dangling faces.  Torso is prefered if available.
+			quint32 nparts = nif->get<uint>( iSkinInst, "Num Partitions" );
+			QModelIndex iPartData = nif->getIndex( iSkinInst, "Partitions" );
 
-				for ( quint32 i = 0; i < nparts; ++i ) {
-					QModelIndex iPart = iPartData.child( i, 0 );
+			for ( quint32 i = 0; i < nparts; ++i ) {
+				QModelIndex iPart = iPartData.child( i, 0 );
 
-					if ( !iPart.isValid() )
-						continue;
+				if ( !iPart.isValid() )
+					continue;
 
-					if ( nif->get<uint>( iPart, "Body Part" ) == 0 /* Torso */ ) {
-						defaultPart = i;
-						break;
-					}
+				if ( nif->get<uint>( iPart, "Body Part" ) == 0 /* Torso */ ) {
+					defaultPart = i;
+					break;
 				}
+			}
 
-				defaultPart = qMin( nparts - 1, defaultPart );
-
-				// enumerate existing partitions and select faces into same partition
-				quint32 nskinparts = nif->get<int>( iSkinPart, "Num Skin Partition Blocks" );
-				iPartData = nif->getIndex( iSkinPart, "Skin Partition Blocks" );
-
-				for ( quint32 i = 0; i < nskinparts; ++i ) {
-					QModelIndex iPart = iPartData.child( i, 0 );
-
-					if ( !iPart.isValid() )
-						continue;
+			defaultPart = qMin( nparts - 1, defaultPart );
 
-					quint32 finalPart = qMin( nparts - 1, i );
+			// enumerate existing partitions and select faces into same partition
+			quint32 nskinparts = nif->get<int>( iSkinPart, "Num Skin Partition Blocks" );
+			iPartData = nif->getIndex( iSkinPart, "Skin Partition Blocks" );
 
-					QVector<int> vertmap = nif->getArray<int>( iPart, "Vertex Map" );
+			for ( quint32 i = 0; i < nskinparts; ++i ) {
+				QModelIndex iPart = iPartData.child( i, 0 );
 
-					quint8 hasFaces  = nif->get<quint8>( iPart, "Has Faces" );
-					quint8 numStrips = nif->get<quint8>( iPart, "Num Strips" );
-					QVector<Triangle> partTriangles;
+				if ( !iPart.isValid() )
+					continue;
 
-					if ( hasFaces && numStrips == 0 ) {
-						partTriangles = nif->getArray<Triangle>( iPart, "Triangles" );
-					} else if ( numStrips != 0 ) {
-						// triangulate first (code copied from strippify.cpp)
-						QVector<QVector<quint16> > strips;
-						QModelIndex iPoints = nif->getIndex( iPart, "Strips" );
+				quint32 finalPart = qMin( nparts - 1, i );
 
-						for ( int s = 0; s < nif->rowCount( iPoints ); s++ ) {
-							QVector<quint16> strip;
-							QModelIndex iStrip = iPoints.child( s, 0 );
+				QVector<int> vertmap = nif->getArray<int>( iPart, "Vertex Map" );
 
-							for ( int p = 0; p < nif->rowCount( iStrip ); p++ ) {
-								strip.append( nif->get<int>( iStrip.child( p, 0 ) ) );
-							}
+				quint8 hasFaces  = nif->get<quint8>( iPart, "Has Faces" );
+				quint8 numStrips = nif->get<quint8>( iPart, "Num Strips" );
+				QVector<Triangle> partTriangles;
 
-							strips.append( strip );
-						}
+				if ( hasFaces && numStrips == 0 ) {
+					partTriangles = nif->getArray<Triangle>( iPart, "Triangles" );
+				} else if ( numStrips != 0 ) {
+					partTriangles = triangulate( readStrips( nif, nif->getIndex( iPart, "Strips" ) ) );
+				}
 
-						partTriangles = triangulate( strips );
+				for ( Triangle tri : partTriangles ) {
+					if ( !vertmap.isEmpty() ) {
+						tri[0] = vertmap.value( tri[0] );
+						tri[1] = vertmap.value( tri[1] );
+						tri[2] = vertmap.value( tri[2] );
 					}
 
-					for ( int j = 0; j < partTriangles.count(); ++j ) {
-						Triangle t = partTriangles[j];
-						Triangle tri = t;
-
-						if ( !vertmap.isEmpty() ) {
-							tri[0] = vertmap[tri[0]];
-							tri[1] = vertmap[tri[1]];
-							tri[2] = vertmap[tri[2]];
-						}
-
-						qRotate( tri );
-						trimap.insert( tri, finalPart );
-					}
+					trimap.insert( triangleKey( tri ), finalPart );
 				}
 			}
 
-			QMap<int, int> match;
-			bool doMatch = true;
-
-			QList<int> tribones;
-
-			int cnt = 0;
-
-			for ( const Triangle& tri : triangles )
-			{
-				do {
-					tribones.clear();
-
-					for ( int c = 0; c < 3; c++ ) {
-						for ( const auto bw : weights[tri[c]] ) {
-							if ( !tribones.contains( bw.first ) )
-								tribones.append( bw.first );
-						}
-					}
-
-					if ( tribones.count() > maxBonesPerPartition ) {
-						// sum up the weights for each bone
-						// bones with weight == 1 can't be removed
-
-						QMap<int, float> sum;
-						QList<int> nono;
-
-						for ( int t = 0; t < 3; t++ ) {
-							if ( weights[tri[t]].count() == 1 )
-								nono.append( weights[tri[t]].first().first );
-
-							for ( const auto bw : weights[tri[t]] ) {
-								sum[ bw.first ] += bw.second;
-							}
-						}
-
-						// select the bone to remove
-
-						float minWeight = 5.0;
-						int minBone = -1;
-
-						for ( const auto b : sum.keys() ) {
-							if ( !nono.contains( b ) && sum[b] < minWeight ) {
-								minWeight = sum[b];
-								minBone = b;
-							}
-						}
-
-						if ( minBone < 0 )  // this shouldn't never happen
-							throw QString( "internal error 0x01" );
-
-						// do a vertex match detect
-
-						if ( doMatch ) {
-							QVector<Vector3> verts = nif->getArray<Vector3>( iData, "Vertices" );
-
-							for ( int a = 0; a < verts.count(); a++ ) {
-								match.insertMulti( a, a );
-
-								for ( int b = a + 1; b < verts.count(); b++ ) {
-									if ( verts[a] == verts[b] && weights[a] == weights[b] ) {
-										match.insertMulti( a, b );
-										match.insertMulti( b, a );
-									}
-								}
-							}
-						}
-
-						// now remove that bone from all vertices of this triangle and from all matching vertices too
-
-						for ( int t = 0; t < 3; t++ ) {
-							bool rem = false;
-							for ( const auto v : match.values( tri[t] ) )
-							{
-								QList<boneweight> & bws = weights[ v ];
-								QMutableListIterator<boneweight> it( bws );
-
-								while ( it.hasNext() ) {
-									boneweight & bw = it.next();
-
-									if ( bw.first == minBone ) {
-										it.remove();
-										rem = true;
-									}
-								}
-
-								float totalWeight = 0;
-								for ( const auto bw : bws ) {
-									totalWeight += bw.second;
-								}
-
-								if ( totalWeight == 0 )
-									throw QString( "internal error 0x02" );
-
-								for ( int b = 0; b < bws.count(); b++ ) {
-									// normalize
-									bws[b].second /= totalWeight;
-								}
-							}
-
-							if ( rem )
-								cnt++;
-						}
-					}
-				} while ( tribones.count() > maxBonesPerPartition );
+			if ( !trimap.isEmpty() ) {
+				job.fixed.reserve( job.triangles.count() );
+				for ( const Triangle & tri : job.triangles )
+					job.fixed.append( trimap.value( triangleKey( tri ), defaultPart ) );
 			}
+		}
+	}
 
-			if ( cnt > 0 )
-				qCWarning( nsSpell ) << Spell::tr( "Removed %1 bone influences" ).arg( cnt );
-
-			// split the triangles into partitions
-
-			bool merged = true;
-
-			QList<Partition> parts;
+	//! Read the strips of a NiTriStripsData or partition
+	static QVector<QVector<quint16> > readStrips( const NifModel * nif, const QModelIndex & iPoints )
+	{
+		QVector<QVector<quint16> > strips;
 
-			if ( !trimap.isEmpty() ) {
-				QMutableListIterator<Triangle> it( triangles );
+		for ( int s = 0; s < nif->childCount( iPoints ); s++ )
+			strips.append( nif->getArray<quint16>( iPoints.child( s, 0 ) ) );
 
-				while ( it.hasNext() ) {
-					Triangle tri = it.next();
-					qRotate( tri );
-					QMap<Triangle, quint32>::iterator partItr = trimap.find( tri );
-					int partIdx = ( partItr != trimap.end() ) ? partItr.value() : defaultPart;
+		return strips;
+	}
 
-					if ( partIdx >= 0 ) {
-						//Triangle & tri = *it;
+	//! Compute the partitions of a shape; safe to run on any thread
+	static void computeJob( SkinPartitionJob & job, int maxBonesPerPartition, int maxBonesPerVertex, bool make_strips )
+	{
+		QVector<QList<boneweight> > & weights = job.weights;
 
-						// Ensure enough partitions
-						while ( partIdx >= int( parts.size() ) )
-							parts.push_back( Partition() );
+		// reduce vertex influences if necessary
 
-						Partition & part = parts[partIdx];
+		if ( job.maxInfluences > maxBonesPerVertex ) {
+			for ( QList<boneweight> & lst : weights ) {
+				std::sort( lst.begin(), lst.end(), boneweight_equivalence() );
 
-						QList<int> tribones;
+				if ( lst.count() > maxBonesPerVertex )
+					job.reducedVertices++;
 
-						for ( int c = 0; c < 3; c++ ) {
-							for ( const auto bw : weights[tri[c]] ) {
-								if ( !tribones.contains( bw.first ) )
-									tribones.append( bw.first );
-							}
-						}
+				while ( lst.count() > maxBonesPerVertex ) {
+					lst.removeLast();
+				}
 
-						part.bones = mergeBones( part.bones, tribones );
-						part.triangles.append( tri );
-						it.remove();
-					}
+				float totalWeight = 0;
+				for ( const auto bw : lst ) {
+					totalWeight += bw.second;
 				}
 
-				merged = false; // when explicit mapping enabled, no merging is allowed
+				for ( int b = 0; b < lst.count(); b++ ) {
+					// normalize
+					lst[b].second /= totalWeight;
+				}
 			}
+		}
 
-			while ( !triangles.isEmpty() ) {
-				Partition part;
-
-				QHash<int, bool> usedVerts;
-
-				bool addtriangles;
-
-				do {
-					QMutableListIterator<Triangle> it( triangles );
-
-					while ( it.hasNext() ) {
-						Triangle & tri = it.next();
+		// reduces bone weights so that the triangles fit into the partitions
 
-						QList<int> tribones;
+		if ( !limitTriangleBones( job.triangles, job.verts, weights, maxBonesPerPartition, job.removedInfluences ) ) {
+			job.error = Spell::tr( "Could not reduce the bone influences of a triangle to %1 bones" ).arg( maxBonesPerPartition );
+			return;
+		}
 
-						for ( int c = 0; c < 3; c++ ) {
-							for ( const auto bw : weights[tri[c]] ) {
-								if ( !tribones.contains( bw.first ) )
-									tribones.append( bw.first );
-							}
-						}
+		// split the triangles into partitions
 
-						if ( part.bones.isEmpty() || containsBones( part.bones, tribones ) ) {
-							part.bones = mergeBones( part.bones, tribones );
-							part.triangles.append( tri );
-							usedVerts[ tri[0] ] = true;
-							usedVerts[ tri[1] ] = true;
-							usedVerts[ tri[2] ] = true;
-							it.remove();
-						}
-					}
+		job.parts = partitionSkin( job.triangles, weights, maxBonesPerPartition, job.fixed );
 
-					addtriangles = false;
-
-					if ( part.bones.count() < maxBonesPerPartition ) {
-						// if we have room left in the partition then add an adjacent triangle
-						it.toFront();
-
-						while ( it.hasNext() ) {
-							Triangle & tri = it.next();
-
-							if ( usedVerts.contains( tri[0] ) || usedVerts.contains( tri[1] ) || usedVerts.contains( tri[2] ) ) {
-								QList<int> tribones;
-
-								for ( int c = 0; c < 3; c++ ) {
-									for ( const auto bw : weights[tri[c]] ) {
-										if ( !tribones.contains( bw.first ) )
-											tribones.append( bw.first );
-									}
-								}
-
-								tribones = mergeBones( part.bones, tribones );
-
-								if ( tribones.count() <= maxBonesPerPartition ) {
-									part.bones = tribones;
-									part.triangles.append( tri );
-									usedVerts[ tri[0] ] = true;
-									usedVerts[ tri[1] ] = true;
-									usedVerts[ tri[2] ] = true;
-									it.remove();
-									addtriangles = true;
-									//break;
-								}
-							}
-						}
-					}
-				} while ( addtriangles );
+		// resort the bone weights in bone order
 
-				parts.append( part );
-			}
+		for ( QList<boneweight> & bw : weights )
+			std::sort( bw.begin(), bw.end(), boneweight_equivalence() );
 
-			//qDebug() << parts.count() << "small partitions";
+		// create the vertex maps and map the vertices
 
-			// merge partitions
+		int numVerts = weights.count();
+		QVector<int> vidx( numVerts, -1 );
 
-			while ( merged ) {
-				merged = false;
+		for ( SkinPartition & part : job.parts ) {
+			QVector<int> vertices;
 
-				for ( int p1 = 0; p1 < parts.count() && !merged; p1++ ) {
-					if ( parts[p1].bones.count() < maxBonesPerPartition ) {
-						for ( int p2 = p1 + 1; p2 < parts.count() && !merged; p2++ ) {
-							QList<int> mergedBones = mergeBones( parts[p1].bones, parts[p2].bones );
+			for ( Triangle & tri : part.triangles ) {
+				for ( int t = 0; t < 3; t++ ) {
+					int v = tri[t];
 
-							if ( mergedBones.count() <= maxBonesPerPartition ) {
-								parts[p1].bones = mergedBones;
-								parts[p1].triangles << parts[p2].triangles;
-								parts.removeAt( p2 );
-								merged = true;
-							}
-						}
+					if ( vidx[v] < 0 ) {
+						vidx[v] = vertices.count();
+						vertices.append( v );
 					}
-				}
-			}
 
-			//qDebug() << parts.count() << "partitions";
-
-			// create the NiSkinPartition if it doesn't exist yet
-
-			if ( !iSkinPart.isValid() ) {
-				iSkinPart = nif->insertNiBlock( "NiSkinPartition", nif->getBlockNumber( iSkinData ) + 1 );
-				nif->setLink( iSkinInst, "Skin Partition", nif->getBlockNumber( iSkinPart ) );
-				nif->setLink( iSkinData, "Skin Partition", nif->getBlockNumber( iSkinPart ) );
+					tri[t] = vidx[v];
+				}
 			}
 
-			// start writing NiSkinPartition
+			for ( int v : vertices )
+				vidx[v] = -1;
 
-			nif->set<int>( iSkinPart, "Num Skin Partition Blocks", parts.count() );
-			nif->updateArray( iSkinPart, "Skin Partition Blocks" );
+			job.vertexMaps.append( vertices );
 
-			QModelIndex iBSSkinInstPartData;
-
-			if ( nif->inherits( iSkinInst, "BSDismemberSkinInstance" ) ) {
-				quint32 nparts = nif->get<uint>( iSkinInst, "Num Partitions" );
-				iBSSkinInstPartData = nif->getIndex( iSkinInst, "Partitions" );
+			// stripify the triangles
+			if ( make_strips )
+				job.strips.append( stripify( part.triangles ) );
+			else
+				job.strips.append( QVector<QVector<quint16> >() );
+		}
+	}
 
-				// why is QList.count() signed? cast to squash warning
-				if ( nparts != (quint32)parts.count() ) {
-					qCWarning( nsSpell ) << "BSDismemberSkinInstance partition count does not match Skin Partition count.  Adjusting to fit.";
-					nif->set<uint>( iSkinInst, "Num Partitions", parts.count() );
-					nif->updateArray( iSkinInst, "Partitions" );
-				}
-			}
+	//! Write the partitions of a shape to its NiSkinPartition
+	static void writeJob( NifModel * nif, const SkinPartitionJob & job, int maxBonesPerPartition, int maxBones, bool make_strips, bool pad )
+	{
+		QModelIndex iSkinInst = job.iSkinInst;
+		QModelIndex iSkinData = job.iSkinData;
+		QModelIndex iSkinPart = job.iSkinPart;
 
-			QList<int> prevPartBones;
+		const QVector<SkinPartition> & parts = job.parts;
+		const QVector<QList<boneweight> > & weights = job.weights;
 
-			for ( int p = 0; p < parts.count(); p++ ) {
-				QModelIndex iPart = nif->getIndex( iSkinPart, "Skin Partition Blocks" ).child( p, 0 );
+		// create the NiSkinPartition if it doesn't exist yet
 
-				QList<int> bones = parts[p].bones;
-				std::sort( bones.begin(), bones.end() /*, std::less<int>()*/ );
+		if ( !iSkinPart.isValid() ) {
+			iSkinPart = nif->insertNiBlock( "NiSkinPartition", nif->getBlockNumber( iSkinData ) + 1 );
+			nif->setLink( iSkinInst, "Skin Partition", nif->getBlockNumber( iSkinPart ) );
+			nif->setLink( iSkinData, "Skin Partition", nif->getBlockNumber( iSkinPart ) );
+		}
 
-				// set partition flags for bs skin instance if present
-				if ( iBSSkinInstPartData.isValid() ) {
-					if ( bones != prevPartBones ) {
-						prevPartBones = bones;
-						nif->set<uint>( iBSSkinInstPartData.child( p, 0 ), "Part Flag", 257 );
-					}
-				}
+		// start writing NiSkinPartition
 
-				QVector<Triangle> triangles = parts[p].triangles;
+		nif->set<int>( iSkinPart, "Num Skin Partition Blocks", parts.count() );
+		nif->updateArray( iSkinPart, "Skin Partition Blocks" );
 
-				// Create the vertex map
+		QModelIndex iBSSkinInstPartData;
 
-				int idx = 0;
-				QVector<int> vidx( numVerts, -1 );
-				for ( const Triangle& tri : triangles ) {
-					for ( int t = 0; t < 3; t++ ) {
-						int v = tri[t];
+		if ( nif->inherits( iSkinInst, "BSDismemberSkinInstance" ) ) {
+			quint32 nparts = nif->get<uint>( iSkinInst, "Num Partitions" );
+			iBSSkinInstPartData = nif->getIndex( iSkinInst, "Partitions" );
 
-						if ( vidx[v] < 0 )
-							vidx[v] = idx++;
-					}
-				}
-				QVector<int> vertices( idx, -1 );
+			// why is QList.count() signed? cast to squash warning
+			if ( nparts != (quint32)parts.count() ) {
+				qCWarning( nsSpell ) << "BSDismemberSkinInstance partition count does not match Skin Partition count.  Adjusting to fit.";
+				nif->set<uint>( iSkinInst, "Num Partitions", parts.count() );
+				nif->updateArray( iSkinInst, "Partitions" );
+			}
+		}
 
-				for ( int i = 0; i < numVerts; ++i ) {
-					int v = vidx[i];
+		QVector<int> prevPartBones;
 
-					if ( v >= 0 ) {
-						vertices[v] = i;
-					}
-				}
+		for ( int p = 0; p < parts.count(); p++ ) {
+			QModelIndex iPart = nif->getIndex( iSkinPart, "Skin Partition Blocks" ).child( p, 0 );
 
-				// map the vertices
+			QVector<int> bones = parts[p].bones;
 
-				for ( int tri = 0; tri < triangles.count(); tri++ ) {
-					for ( int t = 0; t < 3; t++ ) {
-						triangles[tri][t] = vertices.indexOf( triangles[tri][t] );
-					}
+			// set partition flags for bs skin instance if present
+			if ( iBSSkinInstPartData.isValid() ) {
+				if ( bones != prevPartBones ) {
+					prevPartBones = bones;
+					nif->set<uint>( iBSSkinInstPartData.child( p, 0 ), "Part Flag", 257 );
 				}
+			}
 
-				// stripify the triangles
-				QVector<QVector<quint16> > strips;
-				int numTriangles = 0;
+			const QVector<Triangle> & triangles = parts[p].triangles;
+			const QVector<int> & vertices = job.vertexMaps[p];
+			const QVector<QVector<quint16> > & strips = job.strips[p];
 
-				if ( make_strips == true ) {
-					strips = stripify( triangles );
+			int numTriangles = 0;
 
-					for ( const QVector<quint16>& strip : strips ) {
-						numTriangles += strip.count() - 2;
-					}
-				} else {
-					numTriangles = triangles.count();
+			if ( make_strips == true ) {
+				for ( const QVector<quint16>& strip : strips ) {
+					numTriangles += strip.count() - 2;
 				}
+			} else {
+				numTriangles = triangles.count();
+			}
 
-				// fill in counts
-				if ( pad ) {
-					while ( bones.size() < maxBonesPerPartition ) {
-						bones.append( 0 );
-					}
-				}
-
-				// resort the bone weights in bone order
-				QMutableVectorIterator<QList<boneweight> > it( weights );
-
-				while ( it.hasNext() ) {
-					QList<boneweight> & bw = it.next();
-					std::sort( bw.begin(), bw.end(), boneweight_equivalence() );
+			// fill in counts
+			if ( pad ) {
+				while ( bones.size() < maxBonesPerPartition ) {
+					bones.append( 0 );
 				}
+			}
 
-				nif->set<int>( iPart, "Num Vertices", vertices.count() );
-				nif->set<int>( iPart, "Num Triangles", numTriangles );
-				nif->set<int>( iPart, "Num Bones", bones.count() );
-				nif->set<int>( iPart, "Num Strips", strips.count() );
-				nif->set<int>( iPart, "Num Weights Per Vertex", maxBones );
-
-				// fill in bone map
-
-				QModelIndex iBoneMap = nif->getIndex( iPart, "Bones" );
-				nif->updateArray( iBoneMap );
-				nif->setArray<int>( iBoneMap, bones.toVector() );
-
-				// fill in vertex map
-
-				nif->set<int>( iPart, "Has Vertex Map", 1 );
-				QModelIndex iVertexMap = nif->getIndex( iPart, "Vertex Map" );
-				nif->updateArray( iVertexMap );
-				nif->setArray<int>( iVertexMap, vertices );
+			nif->set<int>( iPart, "Num Vertices", vertices.count() );
+			nif->set<int>( iPart, "Num Triangles", numTriangles );
+			nif->set<int>( iPart, "Num Bones", bones.count() );
+			nif->set<int>( iPart, "Num Strips", strips.count() );
+			nif->set<int>( iPart, "Num Weights Per Vertex", maxBones );
 
-				// fill in vertex weights
+			// fill in bone map
 
-				nif->set<int>( iPart, "Has Vertex Weights", 1 );
-				QModelIndex iVWeights = nif->getIndex( iPart, "Vertex Weights" );
-				nif->updateArray( iVWeights );
+			QModelIndex iBoneMap = nif->getIndex( iPart, "Bones" );
+			nif->updateArray( iBoneMap );
+			nif->setArray<int>( iBoneMap, bones );
 
-				for ( int v = 0; v < nif->rowCount( iVWeights ); v++ ) {
-					QModelIndex iVertex = iVWeights.child( v, 0 );
-					nif->updateArray( iVertex );
-					QList<boneweight> list = weights.value( vertices[v] );
+			// fill in vertex map
 
-					for ( int b = 0; b < maxBones; b++ )
-						nif->set<float>( iVertex.child( b, 0 ), list.count() > b ? list[ b ].second : 0.0 );
-				}
+			nif->set<int>( iPart, "Has Vertex Map", 1 );
+			QModelIndex iVertexMap = nif->getIndex( iPart, "Vertex Map" );
+			nif->updateArray( iVertexMap );
+			nif->setArray<int>( iVertexMap, vertices );
 
-				nif->set<int>( iPart, "Has Faces", 1 );
+			// fill in vertex weights
 
-				if ( make_strips == true ) {
-					//Clear out any existing triangle data that might be left over from an existing Skin Partition
-					QModelIndex iTriangles = nif->getIndex( iPart, "Triangles" );
-					nif->updateArray( iTriangles );
+			nif->set<int>( iPart, "Has Vertex Weights", 1 );
+			QModelIndex iVWeights = nif->getIndex( iPart, "Vertex Weights" );
+			nif->updateArray( iVWeights );
 
-					// write the strips
-					QModelIndex iStripLengths = nif->getIndex( iPart, "Strip Lengths" );
-					nif->updateArray( iStripLengths );
+			for ( int v = 0; v < nif->childCount( iVWeights ); v++ ) {
+				QModelIndex iVertex = iVWeights.child( v, 0 );
+				nif->updateArray( iVertex );
+				QList<boneweight> list = weights.value( vertices[v] );
 
-					for ( int s = 0; s < nif->rowCount( iStripLengths ); s++ )
-						nif->set<int>( iStripLengths.child( s, 0 ), strips.value( s ).count() );
+				for ( int b = 0; b < maxBones; b++ )
+					nif->set<float>( iVertex.child( b, 0 ), list.count() > b ? list[ b ].second : 0.0 );
+			}
 
-					QModelIndex iStrips = nif->getIndex( iPart, "Strips" );
-					nif->updateArray( iStrips );
+			nif->set<int>( iPart, "Has Faces", 1 );
 
-					for ( int s = 0; s < nif->rowCount( iStrips ); s++ ) {
-						nif->updateArray( iStrips.child( s, 0 ) );
-						nif->setArray<quint16>( iStrips.child( s, 0 ), strips.value( s ) );
-					}
-				} else {
-					//Clear out any existing strip data that might be left over from an existing Skin Partition
-					QModelIndex iStripLengths = nif->getIndex( iPart, "Strip Lengths" );
-					nif->updateArray( iStripLengths );
-					QModelIndex iStrips = nif->getIndex( iPart, "Strips" );
-					nif->updateArray( iStrips );
-
-					QModelIndex iTriangles = nif->getIndex( iPart, "Triangles" );
-					nif->updateArray( iTriangles );
-					nif->setArray<Triangle>( iTriangles, triangles );
-				}
+			if ( make_strips == true ) {
+				//Clear out any existing triangle data that might be left over from an existing Skin Partition
+				QModelIndex iTriangles = nif->getIndex( iPart, "Triangles" );
+				nif->updateArray( iTriangles );
 
-				// fill in vertex bones
+				// write the strips
+				QModelIndex iStripLengths = nif->getIndex( iPart, "Strip Lengths" );
+				nif->updateArray( iStripLengths );
 
-				nif->set<int>( iPart, "Has Bone Indices", 1 );
-				QModelIndex iVBones = nif->getIndex( iPart, "Bone Indices" );
-				nif->updateArray( iVBones );
+				for ( int s = 0; s < nif->childCount( iStripLengths ); s++ )
+					nif->set<int>( iStripLengths.child( s, 0 ), strips.value( s ).count() );
 
-				for ( int v = 0; v < nif->rowCount( iVBones ); v++ ) {
-					QModelIndex iVertex = iVBones.child( v, 0 );
-					nif->updateArray( iVertex );
-					QList<boneweight> list = weights.value( vertices[v] );
+				QModelIndex iStrips = nif->getIndex( iPart, "Strips" );
+				nif->updateArray( iStrips );
 
-					for ( int b = 0; b < maxBones; b++ )
-						nif->set<int>( iVertex.child( b, 0 ), list.count() > b ? bones.indexOf( list[ b ].first ) : 0 );
+				for ( int s = 0; s < nif->childCount( iStrips ); s++ ) {
+					nif->updateArray( iStrips.child( s, 0 ) );
+					nif->setArray<quint16>( iStrips.child( s, 0 ), strips.value( s ) );
 				}
+			} else {
+				//Clear out any existing strip data that might be left over from an existing Skin Partition
+				QModelIndex iStripLengths = nif->getIndex( iPart, "Strip Lengths" );
+				nif->updateArray( iStripLengths );
+				QModelIndex iStrips = nif->getIndex( iPart, "Strips" );
+				nif->updateArray( iStrips );
+
+				QModelIndex iTriangles = nif->getIndex( iPart, "Triangles" );
+				nif->updateArray( iTriangles );
+				nif->setArray<Triangle>( iTriangles, triangles );
 			}
 
-			// done
+			// fill in vertex bones
 
-			return iShape;
-		}
-		catch ( QString & err )
-		{
-			if ( !err.isEmpty() )
-				QMessageBox::warning( 0, "NifSkope", err );
+			nif->set<int>( iPart, "Has Bone Indices", 1 );
+			QModelIndex iVBones = nif->getIndex( iPart, "Bone Indices" );
+			nif->updateArray( iVBones );
 
-			return iShape;
-		}
-	}
+			for ( int v = 0; v < nif->childCount( iVBones ); v++ ) {
+				QModelIndex iVertex = iVBones.child( v, 0 );
+				nif->updateArray( iVertex );
+				QList<boneweight> list = weights.value( vertices[v] );
 
-	static QList<int> mergeBones( QList<int> a, QList<int> b )
-	{
-		for ( const auto c : b ) {
-			if ( !a.contains( c ) ) {
-				a.append( c );
+				for ( int b = 0; b < maxBones; b++ )
+					nif->set<int>( iVertex.child( b, 0 ), list.count() > b ? bones.indexOf( list[ b ].first ) : 0 );
 			}
 		}
-		return a;
-	}
-
-	static bool containsBones( QList<int> a, QList<int> b )
-	{
-		for ( const auto c : b ) {
-			if ( !a.contains( c ) )
-				return false;
-		}
-		return true;
 	}
 };
 
@@ -1028,11 +826,9 @@ public:
 		}
 
 		int mbpp = 0, mbpv = 0;
-		bool make_strips = false;
+		bool make_strips = false, pad = false;
 
-		for ( const QModelIndex& idx : indices ) {
-			Partitioner.cast( nif, idx, mbpp, mbpv, make_strips );
-		}
+		spSkinPartition::partition( nif, indices, mbpp, mbpv, make_strips, pad );
 
 		qCWarning( nsSpell ) << Spell::tr( "did %1 partitions" ).arg( indices.count() );
 
@@ -1140,6 +936,15 @@ bool SkinPartitionDialog::padPartitions()
 	return ckPad->isChecked();
 }
 
+//! Vertices weighted to a bone, for fitting its bounding sphere off the main thread
+struct BoneBoundsJob
+{
+	QVector<Vector3> verts;
+
+	Vector3 center;
+	float radius = -1;
+};
+
 //! Fix bone bounds
 class spFixBoneBounds final : public Spell
 {
@@ -1167,7 +972,7 @@ public:
 		QVector<Transform> boneTrans;
 		QModelIndex iBoneMap = nif->getIndex( iSkinInstance, "Bones" );
 
-		for ( int n = 0; n < nif->rowCount( iBoneMap ); n++ ) {
+		for ( int n = 0; n < nif->childCount( iBoneMap ); n++ ) {
 			QModelIndex iBone = nif->getBlock( nif->getLink( iBoneMap.child( n, 0 ) ), "NiNode" );
 
 			if ( skelRoot != nif->getParent( nif->getBlockNumber( iBone ) ) )
@@ -1180,42 +985,38 @@ public:
 
 		QModelIndex iBoneDataList = nif->getIndex( iSkinData, "Bone List" );
 
-		for ( int b = 0; b < nif->rowCount( iBoneDataList ); b++ ) {
-			Vector3 mn;
-			Vector3 mx;
+		// Gather the weighted vertices of each bone in bone space
+		QVector<BoneBoundsJob> jobs( nif->childCount( iBoneDataList ) );
 
-			Vector3 center;
-			float radius = 0;
+		for ( int b = 0; b < jobs.count() && b < boneTrans.count(); b++ ) {
+			Transform bt( boneTrans[b] );
+			Matrix rot = bt.rotation.inverted();
 
 			QModelIndex iWeightList = nif->getIndex( iBoneDataList.child( b, 0 ), "Vertex Weights" );
+			int numWeights = nif->childCount( iWeightList );
+			jobs[b].verts.reserve( numWeights );
 
-			for ( int w = 0; w < nif->rowCount( iWeightList ); w++ ) {
+			for ( int w = 0; w < numWeights; w++ ) {
 				int v = nif->get<int>( iWeightList.child( w, 0 ), "Index" );
-
-				if ( w == 0 ) {
-					mn = verts.value( v );
-					mx = verts.value( v );
-				} else {
-					mn.boundMin( verts.value( v ) );
-					mx.boundMax( verts.value( v ) );
-				}
+				jobs[b].verts << rot * ( meshTrans * verts.value( v ) - bt.translation ) / bt.scale;
 			}
+		}
 
-			mn = meshTrans * mn;
-			mx = meshTrans * mx;
-
-			Transform bt( boneTrans[b] );
-			mn = bt.rotation.inverted() * ( mn - bt.translation ) / bt.scale;
-			mx = bt.rotation.inverted() * ( mx - bt.translation ) / bt.scale;
+		QtConcurrent::blockingMap( jobs, []( BoneBoundsJob & job ) {
+			boundingSphere( job.verts, job.center, job.radius );
+		} );
 
-			center = ( mn + mx ) / 2;
-			radius = qMax( ( mn - center ).length(), ( mx - center ).length() );
+		nif->beginBatch();
+		for ( int b = 0; b < jobs.count(); b++ ) {
+			if ( jobs[b].radius < 0 )
+				continue;
 
 			auto sphIdx = nif->getIndex( iBoneDataList.child( b, 0 ) , "Bounding Sphere" );
 
-			nif->set<Vector3>( sphIdx, "Bounding Sphere Offset", center );
-			nif->set<float>( sphIdx, "Bounding Sphere Radius", radius );
+			nif->set<Vector3>( sphIdx, "Bounding Sphere Offset", jobs[b].center );
+			nif->set<float>( sphIdx, "Bounding Sphere Radius", jobs[b].radius );
 		}
+		nif->endBatch();
 
 		return iSkinData;
 	}
@@ -1386,7 +1187,7 @@ public:
 			if ( !iBones.isValid() )
 				return;
 
-			for ( int b = 0; b < nif->rowCount( iBones ); b++ ) {
+			for ( int b = 0; b < nif->childCount( iBones ); b++ ) {
 				QModelIndex iBone = iBones.child( b, 0 );
 
 				Transform tlocal( nif, iBone );
@@ -1423,7 +1224,7 @@ public:
 		QModelIndex iQuats = nif->getIndex( keyframeData, "Quaternion Keys" );
 
 		if ( iQuats.isValid() ) {
-			for ( int q = 0; q < nif->rowCount( iQuats ); q++ ) {
+			for ( int q = 0; q < nif->childCount( iQuats ); q++ ) {
 				QModelIndex iQuat = iQuats.child( q, 0 );
 
 				Quat value = nif->get<Quat>( iQuat, "Value" );
@@ -1446,7 +1247,7 @@ public:
 			iTransKeys = nif->getIndex( iTransKeys, "Keys" );
 
 			if ( iTransKeys.isValid() ) {
-				for ( int k = 0; k < nif->rowCount( iTransKeys ); k++ ) {
+				for ( int k = 0; k < nif->childCount( iTransKeys ); k++ ) {
 					QModelIndex iKey = iTransKeys.child( k, 0 );
 
 					Vector3 value = nif->get<Vector3>( iKey, "Value" );
@@ -406,10 +406,10 @@ public:
 
 			QPersistentModelIndex blocks = nif->getIndex( nextBlock, "Controlled Blocks" );
 
-			for ( int i = 0; i < nif->rowCount( blocks ); i++ ) {
+			for ( int i = 0; i < nif->childCount( blocks ); i++ ) {
 				QPersistentModelIndex thisBlock = blocks.child( i, 0 );
 
-				for ( int j = 0; j < nif->rowCount( thisBlock ); j++ ) {
+				for ( int j = 0; j < nif->childCount( thisBlock ); j++ ) {
 					if ( nif->getValue( thisBlock.child( j, 0 ) ).type() == NifValue::tStringOffset ) {
 						// we shouldn't ever exceed the limit of an int, even though the type
 						// is properly a uint
@@ -1,8 +1,11 @@
 #include "spellbook.h"
 
 #include "blocks.h"
+#include "mesh.h"
 
-#include "lib/nvtristripwrapper.h"
+#include "lib/stripify.h"
+
+#include <QtConcurrent/QtConcurrentMap>
 
 #include <climits>
 
@@ -27,6 +30,32 @@ template <typename T> void copyValue( NifModel * nif, const QModelIndex & iDst,
 }
 
 
+//! Strips of one shape, built off the main thread
+struct StripJob
+{
+	QVector<Triangle> triangles;
+	int cacheSize;
+	QVector<QVector<quint16> > strips;
+	VertexCacheStats before;
+	VertexCacheStats after;
+};
+
+static void stripifyJob( StripJob & job )
+{
+	job.strips = stripify( job.triangles, true, job.cacheSize );
+	job.before = vertexCacheStats( job.triangles, job.cacheSize );
+	job.after = vertexCacheStats( triangulate( job.strips ), job.cacheSize );
+}
+
+//! Log the vertex cache efficiency before and after strippifying, without a message box per shape
+static void reportStats( const VertexCacheStats & before, const VertexCacheStats & after )
+{
+	qCInfo( nsSpell ) << Spell::tr( "Stripify: ACMR %1 -> %2, ATVR %3 -> %4" )
+		.arg( before.acmr(), 0, 'f', 3 ).arg( after.acmr(), 0, 'f', 3 )
+		.arg( before.atvr(), 0, 'f', 3 ).arg( after.atvr(), 0, 'f', 3 );
+}
+
+
 class spStrippify final : public Spell
 {
 	QString name() const override final { return Spell::tr( "Stripify" ); }
@@ -39,33 +68,35 @@ class spStrippify final : public Spell
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
 	{
-		QPersistentModelIndex idx = index;
-		QPersistentModelIndex iData = nif->getBlock( nif->getLink( idx, "Data" ), "NiTriShapeData" );
+		StripJob job;
+		job.triangles = triangles( nif, index );
+		job.cacheSize = vertexCacheSize();
+		stripifyJob( job );
 
-		if ( !iData.isValid() )
-			return idx;
-
-		QVector<Triangle> triangles;
-		QModelIndex iTriangles = nif->getIndex( iData, "Triangles" );
-
-		if ( !iTriangles.isValid() )
-			return idx;
+		QModelIndex idx = apply( nif, index, job.strips );
+		if ( job.strips.count() > 0 )
+			reportStats( job.before, job.after );
 
-		int skip = 0;
-
-		for ( int t = 0; t < nif->rowCount( iTriangles ); t++ ) {
-			Triangle tri = nif->get<Triangle>( iTriangles.child( t, 0 ) );
+		return idx;
+	}
 
-			if ( tri[0] != tri[1] && tri[1] != tri[2] && tri[2] != tri[0] )
-				triangles.append( tri );
-			else
-				skip++;
-		}
+public:
+	//! Get the triangles of a NiTriShape
+	static QVector<Triangle> triangles( const NifModel * nif, const QModelIndex & index )
+	{
+		QModelIndex iData = nif->getBlock( nif->getLink( index, "Data" ), "NiTriShapeData" );
 
-		//qDebug() << "num triangles" << triangles.count() << "skipped" << skip;
+		return nif->getArray<Triangle>( iData, "Triangles" );
+	}
 
+	//! Replace the data of a NiTriShape by NiTriStripsData with the given strips
+	static QModelIndex apply( NifModel * nif, const QModelIndex & index, const QVector<QVector<quint16> > & strips )
+	{
+		QPersistentModelIndex idx = index;
+		QPersistentModelIndex iData = nif->getBlock( nif->getLink( idx, "Data" ), "NiTriShapeData" );
 
-		QVector<QVector<quint16> > strips = stripify( triangles, true );
+		if ( !iData.isValid() )
+			return idx;
 
 		if ( strips.count() <= 0 )
 			return idx;
@@ -113,7 +144,7 @@ class spStrippify final : public Spell
 			if ( iDstUV.isValid() && iSrcUV.isValid() ) {
 				nif->updateArray( iDstUV );
 
-				for ( int r = 0; r < nif->rowCount( iDstUV ); r++ ) {
+				for ( int r = 0; r < nif->childCount( iDstUV ); r++ ) {
 					copyArray<Vector2>( nif, iDstUV.child( r, 0 ), iSrcUV.child( r, 0 ) );
 				}
 			}
@@ -124,7 +155,7 @@ class spStrippify final : public Spell
 			if ( iDstUV.isValid() && iSrcUV.isValid() ) {
 				nif->updateArray( iDstUV );
 
-				for ( int r = 0; r < nif->rowCount( iDstUV ); r++ ) {
+				for ( int r = 0; r < nif->childCount( iDstUV ); r++ ) {
 					copyArray<Vector2>( nif, iDstUV.child( r, 0 ), iSrcUV.child( r, 0 ) );
 				}
 			}
@@ -225,20 +256,34 @@ public:
 	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
 	{
 		QList<QPersistentModelIndex> iTriShapes;
+		QVector<StripJob> jobs;
+		int cacheSize = vertexCacheSize();
 
 		for ( int l = 0; l < nif->getBlockCount(); l++ ) {
 			QModelIndex idx = nif->getBlock( l, "NiTriShape" );
 
-			if ( idx.isValid() )
+			if ( idx.isValid() ) {
 				iTriShapes << idx;
+				jobs.append( { spStrippify::triangles( nif, idx ), cacheSize, {}, {}, {} } );
+			}
 		}
 
-		spStrippify Stripper;
+		// Build the strips of all shapes concurrently, the model is only modified from here
+		QtConcurrent::blockingMap( jobs, stripifyJob );
 
-		for ( const QModelIndex& idx : iTriShapes ) {
-			Stripper.castIfApplicable( nif, idx );
+		VertexCacheStats before, after;
+		for ( int i = 0; i < iTriShapes.count(); i++ ) {
+			if ( jobs[i].strips.isEmpty() )
+				continue;
+
+			spStrippify::apply( nif, iTriShapes[i], jobs[i].strips );
+			before += jobs[i].before;
+			after += jobs[i].after;
 		}
 
+		if ( before.triangles > 0 )
+			reportStats( before, after );
+
 		return QModelIndex();
 	}
 };
@@ -271,11 +316,11 @@ class spTriangulate final : public Spell
 		if ( !iPoints.isValid() )
 			return idx;
 
-		for ( int s = 0; s < nif->rowCount( iPoints ); s++ ) {
+		for ( int s = 0; s < nif->childCount( iPoints ); s++ ) {
 			QVector<quint16> strip;
 			QModelIndex iStrip = iPoints.child( s, 0 );
 
-			for ( int p = 0; p < nif->rowCount( iStrip ); p++ )
+			for ( int p = 0; p < nif->childCount( iStrip ); p++ )
 				strip.append( nif->get<int>( iStrip.child( p, 0 ) ) );
 
 			strips.append( strip );
@@ -313,7 +358,7 @@ class spTriangulate final : public Spell
 			if ( iDstUV.isValid() && iSrcUV.isValid() ) {
 				nif->updateArray( iDstUV );
 
-				for ( int r = 0; r < nif->rowCount( iDstUV ); r++ ) {
+				for ( int r = 0; r < nif->childCount( iDstUV ); r++ ) {
 					copyArray<Vector2>( nif, iDstUV.child( r, 0 ), iSrcUV.child( r, 0 ) );
 				}
 			}
@@ -324,7 +369,7 @@ class spTriangulate final : public Spell
 			if ( iDstUV.isValid() && iSrcUV.isValid() ) {
 				nif->updateArray( iDstUV );
 
-				for ( int r = 0; r < nif->rowCount( iDstUV ); r++ ) {
+				for ( int r = 0; r < nif->childCount( iDstUV ); r++ ) {
 					copyArray<Vector2>( nif, iDstUV.child( r, 0 ), iSrcUV.child( r, 0 ) );
 				}
 			}
@@ -419,7 +464,7 @@ public:
 
 		QList<QVector<quint16> > strips;
 
-		for ( int r = 0; r < nif->rowCount( iPoints ); r++ )
+		for ( int r = 0; r < nif->childCount( iPoints ); r++ )
 			strips += nif->getArray<quint16>( iPoints.child( r, 0 ) );
 
 		if ( strips.isEmpty() )
@@ -1,6 +1,11 @@
 #include "tangentspace.h"
 
-#include "lib/nvtristripwrapper.h"
+#include "lib/stripify.h"
+
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <cmath>
 
 
 bool spTangentSpace::isApplicable( const NifModel * nif, const QModelIndex & index )
@@ -38,9 +43,32 @@ bool spTangentSpace::isApplicable( const NifModel * nif, const QModelIndex & ind
 	return false;
 }
 
-QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
+//! Shape data for computing its tangent space off the main thread
+struct TangentJob
 {
-	QPersistentModelIndex iShape = iBlock;
+	QPersistentModelIndex iShape;
+	QPersistentModelIndex iData;
+	QPersistentModelIndex iPartBlock;
+
+	int numUVSets = 0;
+	int tspaceFlags = 0;
+
+	QVector<Vector3> verts;
+	QVector<Vector3> norms;
+	QVector<Vector2> texco;
+	QVector<Triangle> triangles;
+
+	QVector<Vector3> tan;
+	QVector<Vector3> bin;
+};
+
+//! Triangles per task when a single shape is split across threads
+static const int TANGENT_CHUNK_SIZE = 16384;
+
+//! Read the data needed by computeTangents(), returns false if the shape lacks any of it
+static bool readTangentJob( const NifModel * nif, const QModelIndex & iBlock, TangentJob & job )
+{
+	QModelIndex iShape = iBlock;
 	QModelIndex iData;
 	QModelIndex iPartBlock;
 	if ( nif->getUserVersion2() < 100 ) {
@@ -59,9 +87,13 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		}
 	}
 
-	QVector<Vector3> verts;
-	QVector<Vector3> norms;
-	QVector<Vector2> texco;
+	job.iShape = iShape;
+	job.iData = iData;
+	job.iPartBlock = iPartBlock;
+
+	QVector<Vector3> & verts = job.verts;
+	QVector<Vector3> & norms = job.norms;
+	QVector<Vector2> & texco = job.texco;
 
 	if ( nif->getUserVersion2() < 100 ) {
 		verts = nif->getArray<Vector3>( iData, "Vertices" );
@@ -86,9 +118,8 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		}
 	}
 
-	QVector<Color4> vxcol = nif->getArray<Color4>( iData, "Vertex Colors" );
-	int numUVSets = nif->get<int>( iData, "Num UV Sets" );
-	int tspaceFlags = nif->get<int>( iData, "TSpace Flag" );
+	job.numUVSets = nif->get<int>( iData, "Num UV Sets" );
+	job.tspaceFlags = nif->get<int>( iData, "TSpace Flag" );
 
 	if ( nif->getUserVersion2() < 100 ) {
 		QModelIndex iTexCo = nif->getIndex( iData, "UV Sets" );
@@ -101,13 +132,13 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 	}
 
 
-	QVector<Triangle> triangles;
+	QVector<Triangle> & triangles = job.triangles;
 	QModelIndex iPoints = nif->getIndex( iData, "Points" );
 
 	if ( iPoints.isValid() ) {
 		QVector<QVector<quint16> > strips;
 
-		for ( int r = 0; r < nif->rowCount( iPoints ); r++ )
+		for ( int r = 0; r < nif->childCount( iPoints ); r++ )
 			strips.append( nif->getArray<quint16>( iPoints.child( r, 0 ) ) );
 
 		triangles = triangulate( strips );
@@ -125,125 +156,153 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		}
 	}
 
+	// Drop triangles with invalid indices rather than reading out of bounds
+	for ( int t = triangles.count() - 1; t >= 0; t-- ) {
+		const Triangle & tri = triangles[t];
+		if ( tri[0] >= verts.count() || tri[1] >= verts.count() || tri[2] >= verts.count() )
+			triangles.remove( t );
+	}
+
 	if ( verts.isEmpty() || norms.count() != verts.count() || texco.count() != verts.count() || triangles.isEmpty() ) {
-		Message::append( tr( "Update Tangent Spaces failed on one or more blocks." ),
-			tr( "Block %1: Insufficient information to calculate tangents and bitangents. V: %2, N: %3, Tex: %4, Tris: %5" )
+		Message::append( Spell::tr( "Update Tangent Spaces failed on one or more blocks." ),
+			Spell::tr( "Block %1: Insufficient information to calculate tangents and bitangents. V: %2, N: %3, Tex: %4, Tris: %5" )
 			.arg( nif->getBlockNumber( iBlock ) )
 			.arg( verts.count() )
 			.arg( norms.count() )
 			.arg( texco.count() )
 			.arg( triangles.count() )
 		);
-		return iBlock;
+		return false;
 	}
 
-	QVector<Vector3> tan( verts.count() );
-	QVector<Vector3> bin( verts.count() );
-
-	QMultiHash<int, int> vmap;
-
-	//int skptricnt = 0;
+	return true;
+}
 
-	for ( int t = 0; t < triangles.count(); t++ ) {
-		// for each triangle caculate the texture flow direction
-		//qDebug() << "triangle" << t;
+//! Run a function over [0, count) in chunks, concurrently if requested
+template <typename F> static void forChunks( int count, bool parallel, F func )
+{
+	QVector<QPair<int, int> > chunks;
+	for ( int first = 0; first < count; first += TANGENT_CHUNK_SIZE )
+		chunks.append( { first, std::min( first + TANGENT_CHUNK_SIZE, count ) } );
 
-		Triangle & tri = triangles[t];
+	if ( parallel && chunks.count() > 1 ) {
+		QtConcurrent::blockingMap( chunks, [&func]( const QPair<int, int> & c ) { func( c.first, c.second ); } );
+	} else {
+		for ( const auto & c : chunks )
+			func( c.first, c.second );
+	}
+}
 
-		int i1 = tri[0];
-		int i2 = tri[1];
-		int i3 = tri[2];
+/*! Compute the tangent space of a shape, following MikkTSpace
+ *
+ * Each corner contributes the UV derivative of its triangle, projected onto the
+ * plane of its normal and weighted by the corner angle. The bitangent is
+ * rebuilt from the normal and tangent with the handedness of the UV mapping.
+ *
+ * As stored in nifs, job.tan holds the V direction and job.bin the U direction.
+ */
+static void computeTangents( TangentJob & job, bool parallel )
+{
+	const QVector<Vector3> & verts = job.verts;
+	const QVector<Vector3> & norms = job.norms;
+	const QVector<Vector2> & texco = job.texco;
+	const QVector<Triangle> & triangles = job.triangles;
 
-		const Vector3 & v1 = verts[i1];
-		const Vector3 & v2 = verts[i2];
-		const Vector3 & v3 = verts[i3];
+	int numVerts = verts.count();
+	int numTris = triangles.count();
 
-		const Vector2 & w1 = texco[i1];
-		const Vector2 & w2 = texco[i2];
-		const Vector2 & w3 = texco[i3];
+	// Per corner weighted U direction, plus the sign of the UV mapping in w
+	QVector<Vector4> corners( numTris * 3 );
 
-		Vector3 v2v1 = v2 - v1;
-		Vector3 v3v1 = v3 - v1;
+	forChunks( numTris, parallel, [&]( int first, int last ) {
+		for ( int t = first; t < last; t++ ) {
+			const Triangle & tri = triangles[t];
 
-		Vector2 w2w1 = w2 - w1;
-		Vector2 w3w1 = w3 - w1;
+			const Vector3 & v1 = verts[tri[0]];
+			const Vector3 & v2 = verts[tri[1]];
+			const Vector3 & v3 = verts[tri[2]];
 
-		float r = w2w1[0] * w3w1[1] - w3w1[0] * w2w1[1];
+			const Vector2 & w1 = texco[tri[0]];
+			const Vector2 & w2 = texco[tri[1]];
+			const Vector2 & w3 = texco[tri[2]];
 
-		/*
-		if ( fabs( r ) <= 10e-10 )
-		{
-		    //if ( skptricnt++ < 3 )
-		    //	qDebug() << t;
-		    continue;
-		}
+			Vector3 v2v1 = v2 - v1;
+			Vector3 v3v1 = v3 - v1;
 
-		r = 1.0 / r;
-		*/
-		// this seems to produces better results
-		r = ( r >= 0 ? +1 : -1 );
+			Vector2 w2w1 = w2 - w1;
+			Vector2 w3w1 = w3 - w1;
 
-		Vector3 sdir(
-		    ( w3w1[1] * v2v1[0] - w2w1[1] * v3v1[0] ) * r,
-		    ( w3w1[1] * v2v1[1] - w2w1[1] * v3v1[1] ) * r,
-		    ( w3w1[1] * v2v1[2] - w2w1[1] * v3v1[2] ) * r
-		);
+			// Signed UV area, its sign gives the handedness
+			float area = w2w1[0] * w3w1[1] - w3w1[0] * w2w1[1];
+			float sign = ( area < 0 ) ? -1.0f : 1.0f;
 
-		Vector3 tdir(
-		    ( w2w1[0] * v3v1[0] - w3w1[0] * v2v1[0] ) * r,
-		    ( w2w1[0] * v3v1[1] - w3w1[0] * v2v1[1] ) * r,
-		    ( w2w1[0] * v3v1[2] - w3w1[0] * v2v1[2] ) * r
-		);
+			Vector3 sdir = ( v2v1 * w3w1[1] - v3v1 * w2w1[1] ) * sign;
 
-		sdir.normalize();
-		tdir.normalize();
+			for ( int j = 0; j < 3; j++ ) {
+				const Vector3 & n = norms[tri[j]];
+				const Vector3 & p = verts[tri[j]];
 
-		//qDebug() << sdir << tdir;
+				// Corner angle between the edges projected onto the normal plane
+				Vector3 e1 = verts[tri[( j + 1 ) % 3]] - p;
+				Vector3 e2 = verts[tri[( j + 2 ) % 3]] - p;
+				e1 = e1 - n * Vector3::dotproduct( n, e1 );
+				e2 = e2 - n * Vector3::dotproduct( n, e2 );
+				e1.normalize();
+				e2.normalize();
+				float angle = std::acos( std::max( -1.0f, std::min( 1.0f, Vector3::dotproduct( e1, e2 ) ) ) );
 
-		for ( int j = 0; j < 3; j++ ) {
-			int i = tri[j];
+				Vector3 s = sdir - n * Vector3::dotproduct( n, sdir );
+				s.normalize();
 
-			tan[i] += tdir;
-			bin[i] += sdir;
+				corners[t * 3 + j] = Vector4( s * angle, sign * angle );
+			}
 		}
-	}
+	} );
 
-	//qDebug() << "skipped triangles" << skptricnt;
+	// Gather the corners of each vertex
+	QVector<Vector4> accum( numVerts );
+	for ( int t = 0; t < numTris; t++ ) {
+		for ( int j = 0; j < 3; j++ )
+			accum[triangles[t][j]] += corners[t * 3 + j];
+	}
 
-	//int cnt = 0;
+	job.tan.resize( numVerts );
+	job.bin.resize( numVerts );
 
-	for ( int i = 0; i < verts.count(); i++ ) {
-		// for each vertex calculate tangent and binormal
-		const Vector3 & n = norms[i];
+	forChunks( numVerts, parallel, [&]( int first, int last ) {
+		for ( int i = first; i < last; i++ ) {
+			const Vector3 & n = norms[i];
+			Vector3 t = Vector3( accum[i] );
 
-		Vector3 & t = tan[i];
-		Vector3 & b = bin[i];
+			t = t - n * Vector3::dotproduct( n, t );
 
-		//qDebug() << n << t << b;
+			if ( t.length() < 1e-6f ) {
+				// No usable UVs, any tangent perpendicular to the normal will do
+				Vector3 v( n[1], n[2], n[0] );
+				job.tan[i] = v;
+				job.bin[i] = Vector3::crossproduct( n, v );
+				continue;
+			}
 
-		if ( t == Vector3() || b == Vector3() ) {
-			t[0] = n[1]; t[1] = n[2]; t[2] = n[0];
-			b = Vector3::crossproduct( n, t );
-			//if ( cnt++ < 3 )
-			//	qDebug() << i;
-		} else {
-			t.normalize();
-			t = ( t - n * Vector3::dotproduct( n, t ) );
 			t.normalize();
+			float sign = ( accum[i][3] < 0 ) ? -1.0f : 1.0f;
 
-			//b = Vector3::crossproduct( n, t );
-
-			b.normalize();
-			b = ( b - n * Vector3::dotproduct( n, b ) );
-			b = ( b - t * Vector3::dotproduct( t, b ) );
-			b.normalize();
+			job.bin[i] = t;
+			job.tan[i] = Vector3::crossproduct( n, t ) * sign;
 		}
+	} );
+}
 
-		//qDebug() << n << t << b;
-		//qDebug() << "";
-	}
+//! Write the computed tangent space back to the model
+static void writeTangentJob( NifModel * nif, const TangentJob & job )
+{
+	QModelIndex iShape = job.iShape;
+	QModelIndex iData = job.iData;
+	QModelIndex iPartBlock = job.iPartBlock;
+	const QVector<Vector3> & tan = job.tan;
+	const QVector<Vector3> & bin = job.bin;
 
-	//qDebug() << "unassigned vertices" << cnt;
+	int tspaceFlags = job.tspaceFlags;
 
 	bool isOblivion = false;
 
@@ -281,7 +340,7 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 			tspaceFlags = 0x10;
 
 		nif->set<int>( iShape, "TSpace Flag", tspaceFlags );
-		nif->set<int>( iShape, "Num UV Sets", numUVSets );
+		nif->set<int>( iShape, "Num UV Sets", job.numUVSets );
 		QModelIndex iBinorms  = nif->getIndex( iData, "Bitangents" );
 		QModelIndex iTangents = nif->getIndex( iData, "Tangents" );
 		nif->updateArray( iBinorms );
@@ -289,14 +348,8 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 		nif->setArray( iBinorms, bin );
 		nif->setArray( iTangents, tan );
 	} else if ( nif->getUserVersion2() >= 100 ) {
-		int numVerts;
-		// "Num Vertices" does not exist in the partition
-		if ( iPartBlock.isValid() )
-			numVerts = nif->get<uint>( iPartBlock, "Data Size" ) / nif->get<uint>( iPartBlock, "Vertex Size" );
-		else
-			numVerts = nif->get<int>( iShape, "Num Vertices" );
+		int numVerts = std::min( nif->childCount( iData ), tan.count() );
 
-		nif->setState( BaseModel::Processing );
 		for ( int i = 0; i < numVerts; i++ ) {
 			auto idx = nif->index( i, 0, iData );
 
@@ -309,9 +362,40 @@ QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
 			nif->set<quint8>( idx, "Bitangent Y", bitYi );
 			nif->set<quint8>( idx, "Bitangent Z", bitZi );
 		}
-		nif->restoreState();
+	}
+}
+
+//! Update the tangent space of several shapes, computing them concurrently
+static void updateTangentSpaces( NifModel * nif, const QList<QPersistentModelIndex> & shapes )
+{
+	QVector<TangentJob> jobs;
+	jobs.reserve( shapes.count() );
+
+	for ( const QModelIndex & idx : shapes ) {
+		TangentJob job;
+		if ( readTangentJob( nif, idx, job ) )
+			jobs.append( job );
+	}
+
+	if ( jobs.count() == 1 ) {
+		computeTangents( jobs[0], true );
+	} else {
+		QtConcurrent::blockingMap( jobs, []( TangentJob & job ) { computeTangents( job, false ); } );
 	}
 
+	// Write everything in one go, with a single change notification per block
+	nif->beginBatch();
+	for ( const TangentJob & job : jobs )
+		writeTangentJob( nif, job );
+	nif->endBatch();
+}
+
+QModelIndex spTangentSpace::cast( NifModel * nif, const QModelIndex & iBlock )
+{
+	QPersistentModelIndex iShape = iBlock;
+
+	updateTangentSpaces( nif, { iShape } );
+
 	return iShape;
 }
 
@@ -352,9 +436,7 @@ public:
 				indices << idx;
 		}
 
-		for ( const QModelIndex& idx : indices ) {
-			TSpacer.castIfApplicable( nif, idx );
-		}
+		updateTangentSpaces( nif, indices );
 
 		return QModelIndex();
 	}
@@ -376,7 +458,7 @@ public:
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & ) override final
 	{
-		QVector<QModelIndex> blks;
+		QList<QPersistentModelIndex> blks;
 		for ( int l = 0; l < nif->getBlockCount(); l++ ) {
 			QModelIndex idx = nif->getBlock( l, "NiTriShape" );
 			if ( !idx.isValid() )
@@ -400,9 +482,7 @@ public:
 			blks << idx;
 		}
 
-		spTangentSpace update;
-		for ( auto& b : blks )
-			update.cast( nif, b );
+		updateTangentSpaces( nif, blks );
 
 		return QModelIndex();
 	}
@@ -7,7 +7,7 @@
 #include "ui/widgets/nifeditors.h"
 #include "ui/widgets/uvedit.h"
 
-#include "lib/nvtristripwrapper.h"
+#include "lib/stripify.h"
 
 #include <QButtonGroup>
 #include <QCheckBox>
@@ -530,14 +530,14 @@ class spTextureTemplate final : public Spell
 		QModelIndex iUVs = getUV( nif, index );
 		auto iTriData = nif->getIndex( index, "Num Triangles" );
 		bool bstri = nif->getUserVersion2() >= 100 && nif->inherits( index, "BSTriShape" ) && iTriData.isValid();
-		return (iUVs.isValid() && nif->rowCount( iUVs ) >= 1) || bstri;
+		return (iUVs.isValid() && nif->childCount( iUVs ) >= 1) || bstri;
 	}
 
 	QModelIndex cast( NifModel * nif, const QModelIndex & index ) override final
 	{
 		QModelIndex iUVs = getUV( nif, index );
 
-		if ( nif->rowCount( iUVs ) <= 0 && nif->getUserVersion2() < 100 )
+		if ( nif->childCount( iUVs ) <= 0 && nif->getUserVersion2() < 100 )
 			return index;
 
 		// fire up a dialog to set the user parameters
@@ -560,7 +560,7 @@ class spTextureTemplate final : public Spell
 		QComboBox * set = new QComboBox;
 		lay->addWidget( set, 2, 1 );
 
-		for ( int i = 0; i < nif->rowCount( iUVs ); i++ )
+		for ( int i = 0; i < nif->childCount( iUVs ); i++ )
 			set->addItem( QString( "set %1" ).arg( i ) );
 
 		lay->addWidget( new QLabel( "Wrap Mode" ), 3, 0 );
@@ -649,7 +649,7 @@ class spTextureTemplate final : public Spell
 				tri = nif->getArray<Triangle>( index, "Triangles" );
 			}
 
-			for ( int i = 0; i < nif->rowCount( iVertData ); i++ )
+			for ( int i = 0; i < nif->childCount( iVertData ); i++ )
 				uv << nif->get<Vector2>( nif->index( i, 0, iVertData ), "UV" );
 
 		} else {
@@ -663,7 +663,7 @@ class spTextureTemplate final : public Spell
 		if ( iPoints.isValid() ) {
 			QVector<QVector<quint16> > strips;
 
-			for ( int r = 0; r < nif->rowCount( iPoints ); r++ )
+			for ( int r = 0; r < nif->childCount( iPoints ); r++ )
 				strips.append( nif->getArray<quint16>( iPoints.child( r, 0 ) ) );
 
 			tri = triangulate( strips );
@@ -812,7 +812,7 @@ public:
 		QList<qint32> lChildren = nif->getChildLinks( nif->getBlockNumber( index ) );
 
 		if ( iChildren.isValid() ) {
-			for ( int c = 0; c < nif->rowCount( iChildren ); c++ ) {
+			for ( int c = 0; c < nif->childCount( iChildren ); c++ ) {
 				qint32 link = nif->getLink( iChildren.child( c, 0 ) );
 
 				if ( lChildren.contains( link ) ) {
@@ -825,7 +825,7 @@ public:
 		QModelIndex iProperties = nif->getIndex( index, "Properties" );
 
 		if ( iProperties.isValid() ) {
-			for ( int p = 0; p < nif->rowCount( iProperties ); p++ ) {
+			for ( int p = 0; p < nif->childCount( iProperties ); p++ ) {
 				QModelIndex iProp = nif->getBlock( nif->getLink( iProperties.child( p, 0 ) ) );
 				replaceApplyMode( nif, iProp, rep, by );
 			}
@@ -1132,7 +1132,7 @@ void TexFlipDialog::listFromNif()
 	int numSources = nif->get<int>( baseIndex, "Num Sources" );
 	QModelIndex sources = nif->getIndex( baseIndex, "Sources" );
 
-	if ( nif->rowCount( sources ) != numSources ) {
+	if ( nif->childCount( sources ) != numSources ) {
 		qCWarning( nsSpell ) << tr( "'Num Sources' does not match!" );
 		return;
 	}
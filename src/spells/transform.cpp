@@ -148,7 +148,7 @@ QModelIndex spApplyTransformation::cast( NifModel * nif, const QModelIndex & ind
 			if ( iVertices.isValid() ) {
 				QVector<Vector3> a = nif->getArray<Vector3>( iVertices );
 
-				for ( int v = 0; v < nif->rowCount( iVertices ); v++ )
+				for ( int v = 0; v < nif->childCount( iVertices ); v++ )
 					a[v] = t * a[v];
 
 				nif->setArray<Vector3>( iVertices, a );
@@ -203,8 +203,8 @@ QModelIndex spApplyTransformation::cast( NifModel * nif, const QModelIndex & ind
 		if ( iRadius.isValid() )
 			nif->set<float>( iRadius, t.scale * nif->get<float>( iRadius ) );
 
-		nif->setState( BaseModel::Processing );
-		for ( int i = 0; i < nif->rowCount( iVertData ); i++ ) {
+		nif->beginBatch();
+		for ( int i = 0; i < nif->childCount( iVertData ); i++ ) {
 			auto iVert = iVertData.child( i, 0 );
 
 			auto vertex = t * nif->get<Vector3>( iVert, "Vertex" );
@@ -232,7 +232,7 @@ QModelIndex spApplyTransformation::cast( NifModel * nif, const QModelIndex & ind
 			}
 		}
 
-		nif->resetState();
+		nif->endBatch();
 
 		t = Transform();
 		t.writeBack( nif, index );
@@ -0,0 +1,152 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "startuptrace.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+#include <algorithm>
+#include <cstdio>
+
+
+//! @file startuptrace.cpp StartupTrace
+
+//! A finished phase
+struct TraceRecord
+{
+	const char * name;
+	qint64 start;    //!< Nanoseconds since tracing started
+	qint64 duration; //!< Nanoseconds
+	int depth;
+	bool background; //!< Ran outside of the main thread
+};
+
+static QMutex traceMutex;
+static QVector<TraceRecord> traceRecords;
+static QString traceOutput;
+static bool traceFinished = false;
+
+//! Nesting depth of the phases on each thread
+static thread_local int traceDepth = 0;
+
+//! Time since the first phase started
+static qint64 traceTime()
+{
+	static QElapsedTimer timer = []() {
+		QElapsedTimer t;
+		t.start();
+		return t;
+	}();
+
+	return timer.nsecsElapsed();
+}
+
+StartupTrace::Phase::Phase( const char * n )
+	: name( n ), start( traceTime() ), depth( traceDepth++ )
+{
+}
+
+StartupTrace::Phase::~Phase()
+{
+	qint64 end = traceTime();
+	traceDepth--;
+
+	auto app = QCoreApplication::instance();
+	bool background = app && QThread::currentThread() != app->thread();
+
+	QMutexLocker lock( &traceMutex );
+	if ( !traceFinished )
+		traceRecords.append( { name, start, end - start, depth, background } );
+}
+
+void StartupTrace::setOutput( const QString & file )
+{
+	QMutexLocker lock( &traceMutex );
+	traceOutput = file;
+}
+
+void StartupTrace::finish()
+{
+	qint64 end = traceTime();
+
+	QMutexLocker lock( &traceMutex );
+	if ( traceFinished )
+		return;
+
+	traceFinished = true;
+
+	if ( traceOutput.isEmpty() ) {
+		traceRecords.clear();
+		return;
+	}
+
+	QFile f;
+	bool opened = false;
+	if ( traceOutput == "-" ) {
+		opened = f.open( stderr, QIODevice::WriteOnly | QIODevice::Text );
+	} else {
+		f.setFileName( traceOutput );
+		opened = f.open( QIODevice::WriteOnly | QIODevice::Text );
+	}
+
+	if ( opened ) {
+		std::stable_sort( traceRecords.begin(), traceRecords.end(), []( const TraceRecord & a, const TraceRecord & b ) {
+			return a.start < b.start;
+		} );
+
+		auto ms = []( qint64 ns ) {
+			return QString::number( double( ns ) / 1e6, 'f', 2 ).rightJustified( 9 );
+		};
+
+		QTextStream out( &f );
+		out << "NifSkope startup trace (ms)\n";
+		out << "    start     time  phase\n";
+
+		for ( const TraceRecord & r : traceRecords ) {
+			out << ms( r.start ) << ms( r.duration ) << "  " << QString( r.depth * 2, ' ' ) << r.name;
+			if ( r.background )
+				out << " (background)";
+			out << "\n";
+		}
+
+		out << ms( end ) << "           First frame\n";
+	}
+
+	traceRecords.clear();
+	traceRecords.squeeze();
+}
@@ -41,9 +41,14 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QMimeData>
 #include <QClipboard>
 #include <QKeyEvent>
+#include <QScrollBar>
 
 #include <vector>
 
+
+//! Arrays larger than this are not expanded recursively by setAllExpanded()
+static const int ARRAY_EXPAND_LIMIT = 1000;
+
 NifTreeView::NifTreeView( QWidget * parent, Qt::WindowFlags flags ) : QTreeView()
 {
 	Q_UNUSED( flags );
@@ -51,6 +56,8 @@ NifTreeView::NifTreeView( QWidget * parent, Qt::WindowFlags flags ) : QTreeView(
 	setParent( parent );
 
 	connect( this, &NifTreeView::expanded, this, &NifTreeView::scrollExpand );
+	// QTreeView only fetches the rows of an expanded item when laying it out
+	connect( verticalScrollBar(), &QScrollBar::valueChanged, this, &NifTreeView::fetchShownRows );
 }
 
 NifTreeView::~NifTreeView()
@@ -59,15 +66,21 @@ NifTreeView::~NifTreeView()
 
 void NifTreeView::setModel( QAbstractItemModel * model )
 {
-	if ( nif )
+	if ( nif ) {
 		disconnect( nif, &BaseModel::dataChanged, this, &NifTreeView::updateConditions );
+		disconnect( this, &NifTreeView::expanded, this, &NifTreeView::updateConditionRecurse );
+	}
 
 	nif = qobject_cast<BaseModel *>( model );
 
 	QTreeView::setModel( model );
 
-	if ( nif && doRowHiding ) {
-		connect( nif, &BaseModel::dataChanged, this, &NifTreeView::updateConditions );
+	if ( nif ) {
+		// Rows below collapsed items are only updated once they become visible
+		connect( this, &NifTreeView::expanded, this, &NifTreeView::updateConditionRecurse );
+
+		if ( doRowHiding )
+			connect( nif, &BaseModel::dataChanged, this, &NifTreeView::updateConditions );
 	}
 }
 
@@ -119,7 +132,14 @@ void NifTreeView::setAllExpanded( const QModelIndex & index, bool e )
 	if ( !model() )
 		return;
 
-	for ( int r = 0; r < model()->rowCount( index ); r++ ) {
+	auto item = static_cast<NifItem *>(index.internalPointer());
+	int rows = model()->rowCount( index );
+
+	// Leave the elements of huge arrays collapsed, expanding them would lay out every row
+	if ( e && item && item->isArray() && item->childCount() > ARRAY_EXPAND_LIMIT )
+		return;
+
+	for ( int r = 0; r < rows; r++ ) {
 		QModelIndex child = model()->index( r, 0, index );
 
 		if ( model()->hasChildren( child ) ) {
@@ -256,20 +276,17 @@ void NifTreeView::pasteArray()
 	Q_ASSERT( values.size() == 1 );
 
 	auto root = values.at( 0 );
-	auto cnt = nif->rowCount( root );
+	auto cnt = nif->childCount( root );
 
 	ChangeValueCommand::createTransaction();
-	nif->setState( BaseModel::Processing );
+	nif->beginBatch();
 	for ( int i = 0; i < cnt && i < valueClipboard->getValues().size(); i++ ) {
 		auto iDest = root.child( i, NifModel::ValueCol );
 		auto srcValue = valueClipboard->getValues().at( iDest.row() );
 
 		pasteTo( iDest, srcValue );
 	}
-	nif->restoreState();
-
-	if ( cnt > 0 )
-		emit nif->dataChanged( root.child( 0, NifModel::ValueCol ), root.child( cnt - 1, NifModel::ValueCol ) );
+	nif->endBatch();
 }
 
 void NifTreeView::drawBranches( QPainter * painter, const QRect & rect, const QModelIndex & index ) const
@@ -283,30 +300,39 @@ void NifTreeView::updateConditions( const QModelIndex & topLeft, const QModelInd
 	if ( nif->getState() != BaseModel::Default )
 		return;
 
-	Q_UNUSED( bottomRight );
-	updateConditionRecurse( topLeft.parent() );
+	if ( topLeft.parent().isValid() ) {
+		updateConditionRecurse( topLeft.parent() );
+	} else {
+		// Batched changes are signalled on the top-level rows themselves
+		for ( int r = topLeft.row(); r <= bottomRight.row(); r++ )
+			updateConditionRecurse( topLeft.sibling( r, 0 ) );
+	}
+
 	doItemsLayout();
 }
 
 void NifTreeView::updateConditionRecurse( const QModelIndex & index )
 {
-	if ( nif->getState() != BaseModel::Default )
+	// Proxy models such as the block list hold no NifItems
+	if ( !nif || nif->getState() != BaseModel::Default )
 		return;
 
 	NifItem * item = static_cast<NifItem *>(index.internalPointer());
 	if ( !item )
 		return;
 
-	// Skip flat array items
-	if ( item->parent() && item->parent()->isArray() && !item->childCount() )
+	// Array elements share the condition of the array itself
+	if ( !( item->parent() && item->parent()->isArray() ) )
+		setRowHidden( index.row(), index.parent(), doRowHiding && !item->condition() );
+
+	// Skip collapsed items, their rows are updated when expanded
+	if ( index != rootIndex() && !isExpanded( index ) )
 		return;
 
 	for ( int r = 0; r < model()->rowCount( index ); r++ ) {
 		QModelIndex child = model()->index( r, 0, index );
 		updateConditionRecurse( child );
 	}
-
-	setRowHidden( index.row(), index.parent(), doRowHiding && !item->condition() );
 }
 
 auto splitMime = []( QString format ) {
@@ -366,7 +392,7 @@ void NifTreeView::keyPressEvent( QKeyEvent * e )
 					&& (valueClipboard->getValue().isValid() || valueClipboard->getValues().size() > 0)
 					&& !hasBlockCopied ) {
 			// Do row paste if there is no block/branch copied and the NifValue is valid
-			if ( valueColumns.size() == 1 && nif->rowCount( firstRow ) > 0 ) {
+			if ( valueColumns.size() == 1 && nif->childCount( firstRow ) > 0 ) {
 				pasteArray();
 			} else if ( valueClipboard->getValue().isValid() ) {
 				paste();
@@ -429,20 +455,26 @@ void NifTreeView::keyPressEvent( QKeyEvent * e )
 		if ( nif && spell->isApplicable( nif, oldidx ) ) {
 			selectionModel()->setCurrentIndex( QModelIndex(), QItemSelectionModel::Clear | QItemSelectionModel::Rows );
 
+			// Record the blocks modified by the spell for undo
+			bool snapshot = spell->page() != "Array";
+			if ( snapshot )
+				nif->beginSnapshot();
+
 			bool noSignals = spell->batch();
 			if ( noSignals )
-				nif->setState( BaseModel::Processing );
+				nif->beginBatch();
 			// Cast the spell and return index
 			QModelIndex newidx = spell->cast( nif, oldidx );
 			if ( noSignals )
-				nif->resetState();
+				nif->endBatch();
 
 			// Refresh the header
 			nif->invalidateConditions( nif->getHeader(), true );
 			nif->updateHeader();
 
-			if ( noSignals && nif->getProcessingResult() ) {
-				emit nif->dataChanged( newidx, newidx );
+			if ( snapshot ) {
+				if ( auto cmd = nif->endSnapshot( spell->name() ) )
+					BlockSnapshotCommand::push( cmd, nif->undoMemoryLimit() );
 			}
 
 			if ( proxy )
@@ -480,7 +512,7 @@ void NifTreeView::currentChanged( const QModelIndex & current, const QModelIndex
 	autoExpanded = false;
 	auto mdl = static_cast<NifModel *>( nif );
 	if ( mdl && mdl->isNiBlock( current ) ) {
-		auto cnt = mdl->rowCount( current );
+		auto cnt = mdl->childCount( current );
 		const int ARRAY_LIMIT = 100;
 		if ( mdl->inherits( current, "NiTransformInterpolator" ) 
 			 || mdl->inherits( current, "NiBSplineTransformInterpolator" ) ) {
@@ -489,13 +521,13 @@ void NifTreeView::currentChanged( const QModelIndex & current, const QModelIndex
 		} else if ( mdl->inherits( current, "NiNode" ) ) {
 			// Auto-Expand Children array
 			auto iChildren = mdl->getIndex( current, "Children" );
-			if ( mdl->rowCount( iChildren ) < ARRAY_LIMIT )
+			if ( mdl->childCount( iChildren ) < ARRAY_LIMIT )
 				autoExpand( iChildren );
 		} else if ( mdl->inherits( current, "NiSkinPartition" ) ) {
 			// Auto-Expand skin partitions array
 			autoExpand( current.child( 1, 0 ) );
 		} else if ( mdl->getValue( current.child( cnt - 1, 0 ) ).type() == NifValue::tNone
-					&& mdl->rowCount( current.child( cnt - 1, 0 ) ) < ARRAY_LIMIT ) {
+					&& mdl->childCount( current.child( cnt - 1, 0 ) ) < ARRAY_LIMIT ) {
 			// Auto-Expand final arrays/compounds
 			autoExpand( current.child( cnt - 1, 0 ) );
 		}
@@ -516,3 +548,18 @@ void NifTreeView::scrollExpand( const QModelIndex & index )
 	if ( !autoExpanded )
 		scrollTo( index, PositionAtCenter );
 }
+
+void NifTreeView::fetchShownRows()
+{
+	if ( !model() )
+		return;
+
+	for ( QModelIndex idx = indexAt( QPoint( 0, 0 ) ); idx.isValid(); idx = indexBelow( idx ) ) {
+		if ( visualRect( idx ).top() > viewport()->height() )
+			break;
+
+		QModelIndex parent = idx.parent();
+		if ( idx.row() == model()->rowCount( parent ) - 1 && model()->canFetchMore( parent ) )
+			model()->fetchMore( parent );
+	}
+}
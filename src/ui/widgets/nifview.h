@@ -88,6 +88,8 @@ protected slots:
 
 	//! Scroll to index; connected to expanded()
 	void scrollExpand( const QModelIndex & index );
+	//! Fetch the next chunk of the arrays whose last shown row is in view
+	void fetchShownRows();
 
 protected:
 	void drawBranches( QPainter * painter, const QRect & rect, const QModelIndex & index ) const override final;
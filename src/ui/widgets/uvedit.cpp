@@ -39,7 +39,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "model/nifmodel.h"
 #include "ui/settingsdialog.h"
 
-#include "lib/nvtristripwrapper.h"
+#include "lib/stripify.h"
 
 #include <QUndoStack> // QUndoCommand Inherited
 #include <QActionGroup>
@@ -55,6 +55,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QPushButton>
 #include <QSettings>
 
+#include <algorithm>
+
 // TODO: Determine the necessity of this
 // Appears to be used solely for gluErrorString
 // There may be some Qt alternative
@@ -528,8 +530,22 @@ QVector<int> UVWidget::indices( const QRegion & region ) const
 	return hits.toVector();
 }
 
+int UVWidget::viewTextureSize() const
+{
+	double pixels = width() * devicePixelRatio() / std::max( glViewRect[1] - glViewRect[0], 1e-6 );
+
+	int size = 64;
+	while ( size < pixels && size < 16384 )
+		size *= 2;
+
+	return size;
+}
+
 bool UVWidget::bindTexture( const QString & filename )
 {
+	// Only load the mip levels the view can show
+	textures->setPreviewSize( viewTextureSize() );
+
 	GLuint mipmaps = 0;
 	mipmaps = textures->bind( filename );
 
@@ -851,7 +867,7 @@ bool UVWidget::setNifData( NifModel * nifModel, const QModelIndex & nifIndex )
 	if ( nif->inherits( iShapeData, "NiTriBasedGeomData" ) ) {
 		iTexCoords = nif->getIndex( iShapeData, "UV Sets" ).child( 0, 0 );
 
-		if ( !iTexCoords.isValid() || !nif->rowCount( iTexCoords ) ) {
+		if ( !iTexCoords.isValid() || !nif->childCount( iTexCoords ) ) {
 			return false;
 		}
 
@@ -967,7 +983,7 @@ bool UVWidget::setTexCoords()
 		if ( !iPoints.isValid() )
 			return false;
 
-		for ( int r = 0; r < nif->rowCount( iPoints ); r++ ) {
+		for ( int r = 0; r < nif->childCount( iPoints ); r++ ) {
 			tris += triangulate( nif->getArray<quint16>( iPoints.child( r, 0 ) ) );
 		}
 	} else if ( nif->inherits( iShape, "BSTriShape" ) ) {
@@ -975,7 +991,7 @@ bool UVWidget::setTexCoords()
 			tris = nif->getArray<Triangle>( iShape, "Triangles" );
 		} else {
 			auto partIdx = nif->getIndex( iPartBlock, "Partition" );
-			for ( int i = 0; i < nif->rowCount( partIdx ); i++ ) {
+			for ( int i = 0; i < nif->childCount( partIdx ); i++ ) {
 				tris << nif->getArray<Triangle>( nif->index( i, 0, partIdx ), "Triangles" );
 			}
 		}
@@ -1005,7 +1021,7 @@ void UVWidget::updateNif()
 {
 	if ( nif && iTexCoords.isValid() ) {
 		disconnect( nif, &NifModel::dataChanged, this, &UVWidget::nifDataChanged );
-		nif->setState( BaseModel::Processing );
+		nif->beginBatch();
 
 		if ( nif->inherits( iShapeData, "NiTriBasedGeomData" ) ) {
 			nif->setArray<Vector2>( iTexCoords, texcoords );
@@ -1019,11 +1035,9 @@ void UVWidget::updateNif()
 			for ( int i = 0; i < numVerts; i++ ) {
 				nif->set<HalfVector2>( nif->index( i, 0, iShapeData ), "UV", HalfVector2( texcoords.value( i ) ) );
 			}
-
-			nif->dataChanged( iShape, iShape );
 		}
 		
-		nif->restoreState();
+		nif->endBatch();
 		connect( nif, &NifModel::dataChanged, this, &UVWidget::nifDataChanged );
 	}
 }
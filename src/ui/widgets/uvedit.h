@@ -179,6 +179,8 @@ private:
 	void updateViewRect( int width, int height );
 	bool bindTexture( const QString & filename );
 	bool bindTexture( const QModelIndex & iSource );
+	//! Size in pixels of the texture as currently shown, rounded up to a power of two
+	int viewTextureSize() const;
 
 	QVector<int> indices( const QPoint & p ) const;
 	QVector<int> indices( const QRegion & r ) const;
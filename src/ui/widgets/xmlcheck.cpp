@@ -453,7 +453,7 @@ QList<TestMessage> TestThread::checkLinks( const NifModel * nif, const QModelInd
 {
 	QList<TestMessage> messages;
 
-	for ( int r = 0; r < nif->rowCount( iParent ); r++ ) {
+	for ( int r = 0; r < nif->childCount( iParent ); r++ ) {
 		QModelIndex idx = iParent.child( r, 0 );
 		bool child;
 
@@ -478,7 +478,7 @@ QList<TestMessage> TestThread::checkLinks( const NifModel * nif, const QModelInd
 			}
 		}
 
-		if ( nif->rowCount( idx ) > 0 )
+		if ( nif->childCount( idx ) > 0 )
 			messages += checkLinks( nif, idx, kf );
 	}
 
@@ -32,8 +32,10 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "message.h"
 #include "model/kfmmodel.h"
+#include "xml/schemacache.h"
 
 #include <QtXml> // QXmlDefaultHandler Inherited
+#include <QBuffer>
 #include <QCoreApplication>
 #include <QMessageBox>
 
@@ -296,21 +298,50 @@ QString KfmModel::parseXmlDescription( const QString & filename )
 	if ( !f.exists() )
 		return tr( "kfm.xml could not be found. Please install it and restart the application." );
 
-	if ( !f.open( QIODevice::ReadOnly | QIODevice::Text ) )
+	if ( !f.open( QIODevice::ReadOnly ) )
 		return tr( "Couldn't open KFM XML description file: %1" ).arg( filename );
 
+	QByteArray xml = f.readAll();
+
+	// Skip parsing entirely if this XML was processed before
+	SchemaCache cache( filename, xml );
+	QByteArray data;
+
+	if ( cache.load( data ) ) {
+		QDataStream ds( data );
+		SchemaCache::setup( ds );
+		ds >> supportedVersions;
+		SchemaCache::readBlocks( ds, compounds );
+
+		if ( ds.status() == QDataStream::Ok && ds.atEnd() )
+			return QString();
+
+		compounds.clear();
+		supportedVersions.clear();
+	}
+
+	QBuffer buffer( &xml );
+	buffer.open( QIODevice::ReadOnly | QIODevice::Text );
+
 	KfmXmlHandler handler;
 	QXmlSimpleReader reader;
 	reader.setContentHandler( &handler );
 	reader.setErrorHandler( &handler );
-	QXmlInputSource source( &f );
+	QXmlInputSource source( &buffer );
 	reader.parse( source );
 
 	if ( !handler.errorString().isEmpty() ) {
 		compounds.clear();
 		supportedVersions.clear();
+		return handler.errorString();
 	}
 
-	return handler.errorString();
-}
+	data.clear();
+	QDataStream ds( &data, QIODevice::WriteOnly );
+	SchemaCache::setup( ds );
+	ds << supportedVersions;
+	SchemaCache::writeBlocks( ds, compounds );
+	cache.save( data );
 
+	return QString();
+}
@@ -32,6 +32,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "nifexpr.h"
 
+#include <QDataStream>
 
 //! @file nifexpr.cpp Expression parsing for conditions defined in nif.xml.
 
@@ -317,3 +318,52 @@ void NifExpr::NormalizeVariants( QVariant & l, QVariant & r ) const
 		}
 	}
 }
+
+//! Write an operand, tagging nested expressions which QVariant cannot stream itself
+static void writeOperand( QDataStream & ds, const QVariant & v )
+{
+	if ( v.type() == QVariant::UserType && v.canConvert<NifExpr>() ) {
+		ds << quint8( 1 ) << v.value<NifExpr>();
+	} else {
+		ds << quint8( 0 ) << v;
+	}
+}
+
+//! Read an operand written by writeOperand()
+static void readOperand( QDataStream & ds, QVariant & v )
+{
+	quint8 nested;
+	ds >> nested;
+
+	if ( nested ) {
+		NifExpr e;
+		ds >> e;
+		v = QVariant::fromValue( e );
+	} else {
+		ds >> v;
+	}
+}
+
+QDataStream & operator<<( QDataStream & ds, const NifExpr & e )
+{
+	ds << quint8( e.opcode );
+	writeOperand( ds, e.lhs );
+	writeOperand( ds, e.rhs );
+	return ds;
+}
+
+QDataStream & operator>>( QDataStream & ds, NifExpr & e )
+{
+	quint8 opcode;
+	ds >> opcode;
+
+	if ( opcode > NifExpr::e_not ) {
+		ds.setStatus( QDataStream::ReadCorruptData );
+		opcode = NifExpr::e_nop;
+	}
+
+	e.opcode = NifExpr::Operator( opcode );
+	readOperand( ds, e.lhs );
+	readOperand( ds, e.rhs );
+	return ds;
+}
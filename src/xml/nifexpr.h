@@ -39,6 +39,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QVariant>
 
 
+class QDataStream;
+
 //! @file nifexpr.h NifExpr
 
 class NifExpr final
@@ -72,6 +74,10 @@ public:
 
 	QString toString() const;
 
+	//! Write the compiled expression, so that it can be restored without parsing
+	friend QDataStream & operator<<( QDataStream & ds, const NifExpr & e );
+	friend QDataStream & operator>>( QDataStream & ds, NifExpr & e );
+
 public:
 	template <class F>
 	QVariant evaluateValue( const F & convert ) const
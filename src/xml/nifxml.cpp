@@ -33,8 +33,10 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "message.h"
 #include "data/niftypes.h"
 #include "model/nifmodel.h"
+#include "xml/schemacache.h"
 
 #include <QtXml> // QXmlDefaultHandler Inherited
+#include <QBuffer>
 #include <QCoreApplication>
 #include <QMessageBox>
 
@@ -339,18 +341,7 @@ public:
 					data.setIsMultiArray( isMultiArray );
 					data.setIsMixin( isMixin );
 
-					QString defval = list.value( "default" );
-
-					if ( !defval.isEmpty() ) {
-						bool ok;
-						quint32 enumVal = NifValue::enumOptionValue( type, defval, &ok );
-
-						if ( ok ) {
-							data.value.setCount( enumVal );
-						} else {
-							data.value.setFromString( defval );
-						}
-					}
+					data.setDefault( list.value( "default" ) );
 
 					if ( !userver.isEmpty() ) {
 						if ( !vercond.isEmpty() )
@@ -624,39 +615,104 @@ bool NifModel::loadXML()
 	return true;
 }
 
+//! Clear the structures built from nif.xml
+static void clearSchema()
+{
+	NifModel::compounds.clear();
+	NifModel::fixedCompounds.clear();
+	NifModel::blocks.clear();
+	NifModel::blockHashes.clear();
+	NifModel::supportedVersions.clear();
+
+	NifValue::initialize();
+}
+
+//! Write the structures built from nif.xml to its cache
+static void saveSchema( const SchemaCache & cache )
+{
+	QByteArray data;
+	QDataStream ds( &data, QIODevice::WriteOnly );
+	SchemaCache::setup( ds );
+
+	ds << NifModel::supportedVersions;
+	NifValue::writeTypes( ds );
+	SchemaCache::writeBlocks( ds, NifModel::compounds );
+	SchemaCache::writeBlocks( ds, NifModel::blocks );
+	ds << QStringList( NifModel::fixedCompounds.keys() );
+
+	cache.save( data );
+}
+
+//! Restore the structures built from nif.xml from its cache
+static bool loadSchema( const SchemaCache & cache )
+{
+	QByteArray data;
+	if ( !cache.load( data ) )
+		return false;
+
+	QDataStream ds( data );
+	SchemaCache::setup( ds );
+
+	QStringList fixed;
+
+	ds >> NifModel::supportedVersions;
+	NifValue::readTypes( ds );
+	SchemaCache::readBlocks( ds, NifModel::compounds );
+	SchemaCache::readBlocks( ds, NifModel::blocks );
+	ds >> fixed;
+
+	if ( ds.status() != QDataStream::Ok || !ds.atEnd() ) {
+		clearSchema();
+		return false;
+	}
+
+	for ( const QString & id : fixed )
+		NifModel::fixedCompounds.insert( id, NifModel::compounds.value( id, NifModel::blocks.value( id ) ) );
+
+	for ( const NifBlockPtr & blk : NifModel::blocks )
+		NifModel::blockHashes.insert( DJB1Hash( blk->id.toStdString().c_str() ), blk );
+
+	return true;
+}
+
 // documented in nifmodel.h
 QString NifModel::parseXmlDescription( const QString & filename )
 {
 	QWriteLocker lck( &XMLlock );
 
-	compounds.clear();
-	blocks.clear();
-
-	supportedVersions.clear();
-
-	NifValue::initialize();
+	clearSchema();
 
 	QFile f( filename );
 
 	if ( !f.exists() )
 		return tr( "nif.xml could not be found. Please install it and restart the application." );
 
-	if ( !f.open( QIODevice::ReadOnly | QIODevice::Text ) )
+	if ( !f.open( QIODevice::ReadOnly ) )
 		return tr( "Couldn't open NIF XML description file: %1" ).arg( filename );
 
+	QByteArray xml = f.readAll();
+
+	// Skip parsing entirely if this XML was processed before
+	SchemaCache cache( filename, xml );
+	if ( loadSchema( cache ) )
+		return QString();
+
+	QBuffer buffer( &xml );
+	buffer.open( QIODevice::ReadOnly | QIODevice::Text );
+
 	NifXmlHandler handler;
 	QXmlSimpleReader reader;
 	reader.setContentHandler( &handler );
 	reader.setErrorHandler( &handler );
-	QXmlInputSource source( &f );
+	QXmlInputSource source( &buffer );
 	reader.parse( source );
 
 	if ( !handler.errorString().isEmpty() ) {
-		compounds.clear();
-		blocks.clear();
-		supportedVersions.clear();
+		clearSchema();
+		return handler.errorString();
 	}
 
-	return handler.errorString();
-}
+	saveSchema( cache );
 
+	return QString();
+}
@@ -0,0 +1,169 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#include "schemacache.h"
+
+#include "data/nifitem.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringBuilder>
+
+
+//! @file schemacache.cpp SchemaCache, NifData serialization
+
+//! Identifies a schema cache file
+static const quint32 SCHEMA_CACHE_MAGIC = 0x4353534E; // "NSSC"
+//! Layout version of the cached structures; increment when they change
+static const quint32 SCHEMA_CACHE_VERSION = 1;
+
+SchemaCache::SchemaCache( const QString & filename, const QByteArray & xml )
+{
+	QString cache = QStandardPaths::writableLocation( QStandardPaths::CacheLocation );
+	if ( cache.isEmpty() || filename.isEmpty() )
+		return;
+
+	QByteArray key = QCryptographicHash::hash( QFileInfo( filename ).absoluteFilePath().toUtf8(), QCryptographicHash::Sha1 ).toHex();
+	path = cache % "/schema/" % QString::fromLatin1( key ) % ".bin";
+
+	QCryptographicHash h( QCryptographicHash::Sha1 );
+	h.addData( xml );
+	h.addData( NIFSKOPE_VERSION );
+#ifdef NIFSKOPE_REVISION
+	h.addData( NIFSKOPE_REVISION );
+#endif
+	hash = h.result();
+}
+
+bool SchemaCache::load( QByteArray & data ) const
+{
+	if ( path.isEmpty() )
+		return false;
+
+	QFile f( path );
+	if ( !f.open( QIODevice::ReadOnly ) )
+		return false;
+
+	QDataStream ds( &f );
+	setup( ds );
+
+	quint32 magic, version;
+	QByteArray fileHash;
+	ds >> magic >> version >> fileHash;
+
+	if ( ds.status() != QDataStream::Ok || magic != SCHEMA_CACHE_MAGIC
+	     || version != SCHEMA_CACHE_VERSION || fileHash != hash )
+		return false;
+
+	data = f.readAll();
+	return !data.isEmpty();
+}
+
+bool SchemaCache::save( const QByteArray & data ) const
+{
+	if ( path.isEmpty() || !QDir().mkpath( QFileInfo( path ).absolutePath() ) )
+		return false;
+
+	QSaveFile f( path );
+	if ( !f.open( QIODevice::WriteOnly ) )
+		return false;
+
+	QDataStream ds( &f );
+	setup( ds );
+	ds << SCHEMA_CACHE_MAGIC << SCHEMA_CACHE_VERSION << hash;
+	ds.writeRawData( data.constData(), data.size() );
+
+	return ds.status() == QDataStream::Ok && f.commit();
+}
+
+void SchemaCache::setup( QDataStream & ds )
+{
+	ds.setVersion( QDataStream::Qt_5_7 );
+	ds.setByteOrder( QDataStream::LittleEndian );
+}
+
+void SchemaCache::writeBlocks( QDataStream & ds, const QHash<QString, NifBlockPtr> & blocks )
+{
+	ds << quint32( blocks.count() );
+
+	for ( const NifBlockPtr & b : blocks )
+		ds << b->id << b->ancestor << b->text << b->abstract << b->types;
+}
+
+void SchemaCache::readBlocks( QDataStream & ds, QHash<QString, NifBlockPtr> & blocks )
+{
+	quint32 count;
+	ds >> count;
+
+	for ( quint32 i = 0; i < count && ds.status() == QDataStream::Ok; i++ ) {
+		NifBlockPtr b = NifBlockPtr( new NifBlock );
+		ds >> b->id >> b->ancestor >> b->text >> b->abstract >> b->types;
+		blocks.insert( b->id, b );
+	}
+}
+
+
+/*
+ *  NifData
+ */
+
+QDataStream & operator<<( QDataStream & ds, const NifData & d )
+{
+	const NifSharedData & s = *d.d;
+
+	ds << s.name << s.type << s.temp << s.arg << s.arr1 << s.arr2 << s.cond << s.ver1 << s.ver2 << s.text
+	   << s.condexpr << s.arr1expr << s.vercond << s.verexpr << quint32( s.flags )
+	   << quint32( d.value.type() ) << s.defval;
+	return ds;
+}
+
+QDataStream & operator>>( QDataStream & ds, NifData & d )
+{
+	NifSharedData & s = *d.d;
+	quint32 flags, type;
+	QString defval;
+
+	// The expressions are restored as compiled, without being parsed again
+	ds >> s.name >> s.type >> s.temp >> s.arg >> s.arr1 >> s.arr2 >> s.cond >> s.ver1 >> s.ver2 >> s.text
+	   >> s.condexpr >> s.arr1expr >> s.vercond >> s.verexpr >> flags
+	   >> type >> defval;
+
+	s.flags = NifSharedData::DataFlags( QFlag( int( flags ) ) );
+	d.value = NifValue( NifValue::Type( type ) );
+	d.setDefault( defval );
+	return ds;
+}
@@ -0,0 +1,86 @@
+/***** BEGIN LICENSE BLOCK *****
+
+BSD License
+
+Copyright (c) 2005-2015, NIF File Format Library and Tools
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+1. Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. The name of the NIF File Format Library and Tools project may not be
+   used to endorse or promote products derived from this software
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+***** END LICENCE BLOCK *****/
+
+#ifndef SCHEMACACHE_H
+#define SCHEMACACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+#include <memory>
+
+
+//! @file schemacache.h SchemaCache
+
+class QDataStream;
+struct NifBlock;
+
+using NifBlockPtr = std::shared_ptr<NifBlock>;
+
+/*! A binary cache of the structures built from an XML description.
+ *
+ * The cache is stored per XML file and is only used if it was written from
+ * XML with identical contents by the same NifSkope version, so that an edited
+ * or updated XML is parsed again.
+ */
+class SchemaCache final
+{
+public:
+	/*! Constructor
+	 *
+	 * @param filename	The path of the XML file
+	 * @param xml		The contents of the XML file
+	 */
+	SchemaCache( const QString & filename, const QByteArray & xml );
+
+	//! Read the cached data, returns false if there is no valid cache
+	bool load( QByteArray & data ) const;
+	//! Write the data to the cache
+	bool save( const QByteArray & data ) const;
+
+	//! Prepare a stream over the cached data
+	static void setup( QDataStream & ds );
+
+	//! Write a map of compounds or blocks
+	static void writeBlocks( QDataStream & ds, const QHash<QString, NifBlockPtr> & blocks );
+	//! Read a map of compounds or blocks written by writeBlocks()
+	static void readBlocks( QDataStream & ds, QHash<QString, NifBlockPtr> & blocks );
+
+private:
+	//! Path of the cache file
+	QString path;
+	//! Hash of the XML contents and the application version
+	QByteArray hash;
+};
+
+#endif